@@ -15,6 +15,9 @@
 #include "config/ConfigManager.h"
 #include "web/WebInterface.h"
 #include "utils/SystemMonitor.h"
+#include "utils/TaskPlan.h"
+
+#define SIGNALING_POLL_MS 2     // Наибольшее ожидание очереди SIP в задаче Signaling (период опроса веб-сервера)
 
 class ALINASIPPhone {
 public:
@@ -24,9 +27,10 @@ public:
     
     // Основные методы
     bool begin();
+    // Из loop(): SIP и веб, если они не в задаче Signaling (ALINA_SIGNALING_TASK=0)
     void process();
     
-    // Управление вызовами
+    // Управление вызовами (из loop(): команды выполняет владелец SIP)
     bool makeCall(const String& number);
     bool answerCall();
     bool hangupCall();
@@ -68,6 +72,9 @@ private:
     SystemMonitor monitor;
     
     bool initialized;
+    TaskHandle_t signaling_task_handle;
+    
+    static void signalingTask(void* pvParameters);
     
     // Запрет копирования
     ALINASIPPhone(const ALINASIPPhone&) = delete;
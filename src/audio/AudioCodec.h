@@ -0,0 +1,82 @@
+/*
+ * AudioCodec.h - Интерфейс подключаемого аудио кодека
+ *
+ * Кодек работает с линейным PCM 16 бит на своей частоте дискретизации и
+ * хранит состояние одного направления вызова (кодер + декодер). Экземпляры
+ * создаются CodecManager заранее - по одному на вызов для каждого кодека
+ * из реестра (CodecRegistry.h).
+ */
+
+#ifndef AUDIO_CODEC_H
+#define AUDIO_CODEC_H
+
+#include <Arduino.h>
+
+#define PLC_HISTORY_SAMPLES 160     // Фрагмент для повтора при потере пакета
+#define PLC_MAX_LOSSES 5            // После стольких потерь подряд - тишина
+
+class AudioCodec {
+public:
+    virtual ~AudioCodec() {}
+
+    // Выделение ресурсов (вызывается при старте, не в потоке медиа)
+    virtual bool init() { return true; }
+    // Подготовка к новому вызову при его установке (поток сигнализации, не медиа):
+    // кодеки, которые не умеют сбрасывать состояние на месте, пересоздают его здесь
+    virtual bool prepare() { return true; }
+    // Сброс состояния перед новым вызовом (поток медиа, без выделения памяти)
+    virtual void reset() = 0;
+
+    // PCM -> RTP payload. Возвращает длину payload, 0 - нечего отправлять
+    // (кодек собирает пакет из нескольких фреймов или передает тишину).
+    virtual int encode(const int16_t* pcm, int samples, uint8_t* out) = 0;
+    // RTP payload -> PCM. Возвращает число отсчетов.
+    virtual int decode(const uint8_t* in, int len, int16_t* pcm) = 0;
+    // Маскирование потерянного пакета: samples отсчетов в pcm
+    virtual int plc(int16_t* pcm, int samples) = 0;
+
+    // Смещение (в отсчетах) начала последнего пакета относительно начала
+    // последнего входного буфера encode(). Не 0 только у кодеков со сборкой пакетов.
+    virtual int32_t getPacketOffset() const { return 0; }
+    virtual void setFramesPerPacket(int frames) { (void)frames; }
+    virtual void setVAD(bool enable) { (void)enable; }
+};
+
+// Простое маскирование потерь повтором последнего фрагмента с затуханием
+class PLCHistory {
+private:
+    int16_t history[PLC_HISTORY_SAMPLES];
+    int length;
+    int losses;
+
+public:
+    PLCHistory() { reset(); }
+
+    void reset() {
+        memset(history, 0, sizeof(history));
+        length = 0;
+        losses = 0;
+    }
+
+    void save(const int16_t* pcm, int samples) {
+        int n = samples < PLC_HISTORY_SAMPLES ? samples : PLC_HISTORY_SAMPLES;
+        memcpy(history, pcm + samples - n, n * sizeof(int16_t));
+        length = n;
+        losses = 0;
+    }
+
+    int conceal(int16_t* pcm, int samples) {
+        losses++;
+        if (length == 0 || losses > PLC_MAX_LOSSES) {
+            memset(pcm, 0, samples * sizeof(int16_t));
+            return samples;
+        }
+        // Каждая следующая потеря подряд вдвое тише
+        for (int i = 0; i < samples; i++) {
+            pcm[i] = history[i % length] >> losses;
+        }
+        return samples;
+    }
+};
+
+#endif
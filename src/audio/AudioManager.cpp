@@ -1,21 +1,45 @@
 #include "AudioManager.h"
 #include "ConfigManager.h"
 #include "RTPManager.h"
+#include "CallRecorder.h"
+#include "Metrics.h"
+#include "LatencyTracer.h"
+#include "TaskPlan.h"
 
 AudioManager audioManager;
 
+// Вызовы, не допущенные по полосе канала UART
+static int metric_link_rejects = METRIC_NONE;
+// Такт медиа
+static int metric_rx_deadline_misses = METRIC_NONE;
+static int metric_tx_deadline_misses = METRIC_NONE;
+static int metric_tick_overruns = METRIC_NONE;
+// Очередь приема RTP
+static int metric_rx_queue_drops = METRIC_NONE;
+
 AudioManager::AudioManager() : 
     rtp_manager(nullptr),
     config_manager(nullptr),
     uart_rx_queue(nullptr),
     uart_tx_queue(nullptr),
-    uart_rx_buffer(nullptr),
-    uart_tx_buffer(nullptr),
-    uart_packet_counter(0),
-    uart_task_handle(nullptr),
-    audio_process_task_handle(nullptr),
+    link_count(0),
+    rx_transcode_buffer(nullptr),
+    tx_transcode_buffer(nullptr),
+    rx_resample_buffer(nullptr),
+    tx_resample_buffer(nullptr),
+    rx_adpcm_buffer(nullptr),
+    tx_adpcm_pcm(nullptr),
+    media_task_handle(nullptr),
     tasks_running(false),
+    rx_slots(nullptr),
+    rx_free(nullptr),
+    rx_ready(nullptr),
     call_states(nullptr),
+    conference_anchor(-1),
+    conf_transcode_buffer(nullptr),
+    conf_resample_buffer(nullptr),
+    conf_timestamp(0),
+    conf_sequence(0),
     global_sequence_number(0),
     jitter_buffers(nullptr) {
 }
@@ -29,9 +53,6 @@ void AudioManager::init(RTPManager* rtpMgr, ConfigManager* cfgMgr) {
         return;
     }
 
-    // Инициализация глобального clock
-    global_clock.init();
-
     // Выделение памяти для состояний вызовов
     int max_calls = config_manager->getMaxCalls();
     call_states = new CallState[max_calls];
@@ -39,36 +60,96 @@ void AudioManager::init(RTPManager* rtpMgr, ConfigManager* cfgMgr) {
     
     for (int i = 0; i < max_calls; i++) {
         call_states[i].is_active = false;
-        call_states[i].active_codec = config_manager->getPrimaryCodec();
+        call_states[i].in_conference = false;
+        applyCallCodec(i, config_manager->getPrimaryCodec());
         call_states[i].last_activity = 0;
         call_states[i].last_sequence = 0;
         call_states[i].base_timestamp = 0;
         call_states[i].timestamp_initialized = false;
+        call_states[i].clock.init();
+        call_states[i].last_drift_log = 0;
+        call_states[i].ptime = config_manager->getAudioPacketTime();
+        call_states[i].reframe_buffer = nullptr;
+        call_states[i].reframe_len = 0;
+        ImaAdpcm::reset(&call_states[i].adpcm);
+        call_states[i].adpcm_refused = false;
+        call_states[i].link = 0;
+        call_states[i].link_reserved = false;
+        call_states[i].link_codec = call_states[i].uart_codec;
+        call_states[i].rx_deadline.init();
+        call_states[i].tx_deadline.init();
     }
     
-    // Настройка UART
-    uart_config_t uart_config = {
-        .baud_rate = config_manager->getUARTBaudRate(),
-        .data_bits = UART_DATA_8_BITS,
-        .parity = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .rx_flow_ctrl_thresh = 122,
-        .source_clk = UART_SCLK_APB,
-    };
+    // Состояния кодеков для каждого вызова
+    codec_manager.init(max_calls);
+    codec_manager.setPacketTime(config_manager->getAudioPacketTime());
     
-    uart_param_config(UART_PORT, &uart_config);
-    uart_set_pin(UART_PORT, UART_TX_PIN, UART_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-    uart_driver_install(UART_PORT, UART_BUFFER_SIZE * 4, UART_BUFFER_SIZE * 4, 0, NULL, 0);
+    // Каналы AudioKit: первый на UART2, второй (если включен) на UART1
+    if (!openLink(0, UART_PORT, config_manager->getUARTBaudRate(), UART_TX_PIN, UART_RX_PIN)) {
+        return;
+    }
+    if (config_manager->getUARTLinkCount() > 1 &&
+        !openLink(1, UART_LINK2_PORT, config_manager->getUARTLink2BaudRate(),
+                  config_manager->getUARTLink2TxPin(), config_manager->getUARTLink2RxPin())) {
+        Serial.println("AudioManager: Второй канал AudioKit недоступен, работаем с одним");
+    }
     
-    // Выделение буферов
-    uart_rx_buffer = (uint8_t*)heap_caps_malloc(UART_BUFFER_SIZE, MALLOC_CAP_DMA);
-    uart_tx_buffer = (uint8_t*)heap_caps_malloc(UART_BUFFER_SIZE, MALLOC_CAP_DMA);
+    rx_transcode_buffer = (uint8_t*)malloc(UART_MAX_PACKET_SIZE);
+    tx_transcode_buffer = (uint8_t*)malloc(UART_MAX_PACKET_SIZE);
+    // +1 отсчет для вставки при компенсации дрейфа
+    rx_resample_buffer = (int16_t*)malloc((RESAMPLER_MAX_BLOCK + 1) * sizeof(int16_t));
+    tx_resample_buffer = (int16_t*)malloc(TX_RESAMPLE_SAMPLES * sizeof(int16_t));
+    // Блок ADPCM: до полного кадра PCM, 4 бита на отсчет
+    rx_adpcm_buffer = (uint8_t*)malloc(UART_MAX_PACKET_SIZE);
+    tx_adpcm_pcm = (int16_t*)malloc((UART_MAX_PACKET_SIZE - UART_PACKET_HEADER_SIZE) * 2 * sizeof(int16_t));
     
-    if (!uart_rx_buffer || !uart_tx_buffer) {
-        Serial.println("Ошибка выделения буферов UART");
+    if (!rx_transcode_buffer || !tx_transcode_buffer || !rx_resample_buffer || !tx_resample_buffer ||
+        !rx_adpcm_buffer || !tx_adpcm_pcm) {
+        Serial.println("Ошибка выделения буферов транскодирования");
+        return;
+    }
+    
+    // Неполные RTP пакеты потоковых кодеков (по одному на вызов)
+    uint8_t* reframe_pool = (uint8_t*)malloc(max_calls * REFRAME_BUFFER_SIZE);
+    if (!reframe_pool) {
+        Serial.println("Ошибка выделения буферов пакетизации");
+        return;
+    }
+    for (int i = 0; i < max_calls; i++) {
+        call_states[i].reframe_buffer = reframe_pool + i * REFRAME_BUFFER_SIZE;
+    }
+    
+    // Конференция: все вызовы плюс AudioKit
+    conf_transcode_buffer = (uint8_t*)malloc(UART_MAX_PACKET_SIZE);
+    conf_resample_buffer = (int16_t*)malloc(TX_RESAMPLE_SAMPLES * sizeof(int16_t));
+    if (!conf_transcode_buffer || !conf_resample_buffer || !conference.init(max_calls + 1)) {
+        Serial.println("Ошибка выделения буферов конференции");
+        return;
+    }
+    
+    // Запись вызовов во flash (файловая система монтируется всегда: записи доступны для загрузки)
+    callRecorder.init();
+    latencyTracer.init(max_calls);
+    
+    if (metric_link_rejects == METRIC_NONE) {
+        metric_link_rejects = metrics.counter("alina_uart_link_rejects_total", "Calls refused because the AudioKit link bandwidth is exhausted");
+        metric_rx_deadline_misses = metrics.counter("alina_media_rx_deadline_misses_total", "20 ms frames towards AudioKit that missed their media tick", true);
+        metric_tx_deadline_misses = metrics.counter("alina_media_tx_deadline_misses_total", "20 ms frames towards the network that missed their media tick", true);
+        metric_tick_overruns = metrics.counter("alina_media_tick_overruns_total", "Media ticks started a whole period or more behind schedule");
+        metric_rx_queue_drops = metrics.counter("alina_media_rx_queue_drops_total", "RTP packets dropped because the media receive queue was full or the payload too long", true);
+    }
+    
+    // Очередь приема RTP: ячейки и номера - до открытия сокетов
+    rx_slots = (media_rx_slot_t*)malloc(MEDIA_RX_SLOTS * sizeof(media_rx_slot_t));
+    rx_free = xQueueCreate(MEDIA_RX_SLOTS, sizeof(uint8_t));
+    rx_ready = xQueueCreate(MEDIA_RX_SLOTS, sizeof(uint8_t));
+    if (!rx_slots || !rx_free || !rx_ready) {
+        Serial.println("Ошибка выделения очереди приема RTP");
         return;
     }
+    for (uint8_t i = 0; i < MEDIA_RX_SLOTS; i++) {
+        xQueueSend(rx_free, &i, 0);
+    }
     
     // Создание очередей
     uart_rx_queue = xQueueCreate(20, sizeof(audio_packet_t));
@@ -77,6 +158,47 @@ void AudioManager::init(RTPManager* rtpMgr, ConfigManager* cfgMgr) {
     Serial.printf("AudioManager: Инициализирован для %d вызовов\n", max_calls);
 }
 
+bool AudioManager::openLink(int index, int port, int baud_rate, int tx_pin, int rx_pin) {
+    AudioLink& audio_link = links[index];
+    audio_link.owner = this;
+    audio_link.index = index;
+    audio_link.port = port;
+    audio_link.baud_rate = baud_rate;
+    audio_link.transport = nullptr;
+    audio_link.task_handle = nullptr;
+    
+    // Транспорт UART: DMA UHCI0 (сборка с ALINA_UART_DMA, только первый канал) или драйвер IDF
+#if ALINA_UART_DMA
+    if (index == 0) {
+        UARTDMATransport* dma_transport = new UARTDMATransport();
+        if (dma_transport->begin(port, baud_rate, tx_pin, rx_pin, UART_V2_MAX_FRAME)) {
+            audio_link.transport = dma_transport;
+        } else {
+            delete dma_transport;
+        }
+    }
+#endif
+    if (!audio_link.transport) {
+        DriverUARTTransport* driver_transport = new DriverUARTTransport();
+        if (!driver_transport->begin(port, baud_rate, tx_pin, rx_pin, UART_BUFFER_SIZE)) {
+            delete driver_transport;
+            Serial.printf("Ошибка инициализации UART%d\n", port);
+            return false;
+        }
+        audio_link.transport = driver_transport;
+    }
+    
+    // Буфер приема транспорта объявляется AudioKit для кредитов v2
+    if (!audio_link.link.init(audio_link.transport, config_manager->isUARTLinkV2Enabled(), onUARTAudio, &audio_link)) {
+        Serial.println("Ошибка выделения буферов UART");
+        return false;
+    }
+    link_count = index + 1;
+    Serial.printf("AudioManager: Канал AudioKit %d - UART%d, %d бод, TX %d, RX %d\n",
+                 index + 1, port, baud_rate, tx_pin, rx_pin);
+    return true;
+}
+
 uint16_t AudioManager::getNextSequence(int call_id) {
     if (call_id >= 0 && call_id < config_manager->getMaxCalls()) {
         // УВЕЛИЧИВАЕМ НА 1 КАЖДЫЙ РАЗ
@@ -88,12 +210,354 @@ uint16_t AudioManager::getNextSequence(int call_id) {
     return global_sequence_number++;
 }
 
-uint32_t AudioManager::getOutgoingTimestamp(int call_id) {
-    // Используем единый clock для всех вызовов для синхронизации
-    return global_clock.getOutgoingTimestamp();
+uint32_t AudioManager::getOutgoingTimestamp(int call_id, uint32_t rtp_units) {
+    // У каждого вызова свой clock: частоты RTP часов вызовов могут различаться
+    if (call_id >= 0 && call_id < config_manager->getMaxCalls()) {
+        return call_states[call_id].clock.getOutgoingTimestamp(rtp_units);
+    }
+    return 0;
+}
+
+int AudioManager::getLinkSampleRate(uint8_t codec_type) {
+    int codec_rate = codec_manager.getSampleRate(codec_type);
+    int audiokit_rate = config_manager ? config_manager->getAudioSampleRate() : 0;
+    
+    // 0 - AudioKit работает на частоте кодека вызова
+    if (!Resampler::isSupportedRate(audiokit_rate) || !Resampler::isSupportedRate(codec_rate)) {
+        return codec_rate;
+    }
+    return audiokit_rate;
 }
 
-// Обработка входящего RTP пакета от SIP -> отправка в UART
+uint8_t AudioManager::getUARTCodec(uint8_t codec_type) {
+    if (!codec_manager.isCodecAvailable(codec_type)) {
+        return codec_type;
+    }
+    
+    int link_rate = getLinkSampleRate(codec_type);
+    if (link_rate == 8000 && (codec_type == CODEC_PCMU || codec_type == CODEC_PCMA)) {
+        // G.711 передается в AudioKit без перекодирования
+        return codec_type;
+    }
+    
+    if (config_manager && config_manager->isUARTLinkADPCMEnabled()) {
+        switch (link_rate) {
+            case 16000: return UART_CODEC_ADPCM_16K;
+            case 48000: return UART_CODEC_ADPCM_48K;
+            default: return UART_CODEC_ADPCM_8K;
+        }
+    }
+    return getLinearUARTCodec(link_rate);
+}
+
+uint8_t AudioManager::getLinearUARTCodec(int rate) {
+    switch (rate) {
+        case 16000: return UART_CODEC_L16_16K;
+        case 48000: return UART_CODEC_L16_48K;
+        default: return UART_CODEC_L16_8K;
+    }
+}
+
+bool AudioManager::isLinearUARTCodec(uint8_t uart_codec) {
+    return uart_codec == UART_CODEC_L16_8K || uart_codec == UART_CODEC_L16_16K ||
+           uart_codec == UART_CODEC_L16_48K;
+}
+
+bool AudioManager::isADPCMUARTCodec(uint8_t uart_codec) {
+    return uart_codec == UART_CODEC_ADPCM_8K || uart_codec == UART_CODEC_ADPCM_16K ||
+           uart_codec == UART_CODEC_ADPCM_48K;
+}
+
+int AudioManager::getUARTSampleRate(uint8_t uart_codec) {
+    switch (uart_codec) {
+        case UART_CODEC_L16_16K:
+        case UART_CODEC_ADPCM_16K: return 16000;
+        case UART_CODEC_L16_48K:
+        case UART_CODEC_ADPCM_48K: return 48000;
+        default: return 8000;
+    }
+}
+
+uint32_t AudioManager::getLinkBytesPerSecond(int link, uint8_t uart_codec) {
+    uint32_t payload;
+    if (isADPCMUARTCodec(uart_codec)) {
+        payload = getUARTSampleRate(uart_codec) / 2 + ADPCM_HEADER_SIZE * UART_LINK_FRAMES_PER_SECOND;
+    } else if (isLinearUARTCodec(uart_codec)) {
+        payload = getUARTSampleRate(uart_codec) * 2;
+    } else {
+        payload = 8000; // G.711: байт на отсчет 8 кГц
+    }
+    // v2: запись в общем кадре такта (+1 байт выравнивания), v1: заголовок на каждый фрейм
+    uint32_t header = links[link].link.getVersion() >= UART_V2_VERSION ? UART_V2_RECORD_HEADER_SIZE + 1
+                                                                       : UART_PACKET_HEADER_SIZE;
+    return payload + header * UART_LINK_FRAMES_PER_SECOND;
+}
+
+uint32_t AudioManager::getLinkBudget(int link) const {
+    if (link < 0 || link >= link_count) {
+        return 0;
+    }
+    // 10 бит на байт (старт, 8 данных, стоп)
+    uint32_t budget = (uint32_t)links[link].baud_rate / 10 * UART_LINK_BUDGET_PERCENT / 100;
+    // Заголовок и CRC общего кадра v2 на каждый такт
+    uint32_t frame_overhead = (UART_V2_HEADER_SIZE + UART_V2_CRC_SIZE) * UART_LINK_FRAMES_PER_SECOND;
+    return budget > frame_overhead ? budget - frame_overhead : 0;
+}
+
+uint32_t AudioManager::getLinkUsage(int link, int exclude_call) {
+    if (!config_manager || link < 0 || link >= link_count) {
+        return 0;
+    }
+    uint32_t usage = 0;
+    for (int i = 0; i < config_manager->getMaxCalls(); i++) {
+        if (i == exclude_call || call_states[i].link != link || !call_states[i].link_reserved) {
+            continue;
+        }
+        const CallState& call = call_states[i];
+        if (call.in_conference) {
+            // Участники конференции делят один поток микса по каналу первого
+            if (i == conference_anchor) {
+                usage += getLinkBytesPerSecond(link, UART_CODEC_CONFERENCE);
+            }
+        } else if (call.is_active) {
+            usage += getLinkBytesPerSecond(link, call.uart_codec);
+        } else {
+            // Вызов допущен, первый RTP пакет еще не пришел
+            usage += getLinkBytesPerSecond(link, call.link_codec);
+        }
+    }
+    return usage;
+}
+
+int AudioManager::pickLink(const uint32_t* load, const uint32_t* budget, int count) {
+    int best = -1;
+    for (int i = 0; i < count; i++) {
+        if (load[i] > budget[i]) {
+            continue;
+        }
+        if (best < 0 || budget[i] - load[i] > budget[best] - load[best]) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+bool AudioManager::admitCall(int call_id, uint8_t codec_type) {
+    if (!config_manager || link_count == 0 || call_id < 0 || call_id >= config_manager->getMaxCalls()) {
+        return true;
+    }
+    uint8_t uart_codec = getUARTCodec(codec_type);
+    uint32_t load[AUDIO_LINKS_MAX];
+    uint32_t budget[AUDIO_LINKS_MAX];
+    for (int i = 0; i < link_count; i++) {
+        // Поток вызова с заголовками версии протокола этого канала
+        load[i] = getLinkUsage(i, call_id) + getLinkBytesPerSecond(i, uart_codec);
+        budget[i] = getLinkBudget(i);
+    }
+    int link = pickLink(load, budget, link_count);
+    if (link < 0) {
+        // В журнал - канал, которому не хватило меньше всего
+        int best = 0;
+        for (int i = 1; i < link_count; i++) {
+            if (load[i] - budget[i] < load[best] - budget[best]) {
+                best = i;
+            }
+        }
+        Serial.printf("AudioManager: Call %d отклонен - канал UART %d: нужно %lu > %lu байт/с\n",
+                     call_id, best + 1, (unsigned long)load[best], (unsigned long)budget[best]);
+        metrics.inc(metric_link_rejects);
+        return false;
+    }
+    call_states[call_id].link = link;
+    call_states[call_id].link_reserved = true;
+    call_states[call_id].link_codec = uart_codec;
+    if (link_count > 1) {
+        Serial.printf("AudioManager: Call %d -> канал AudioKit %d (%lu/%lu байт/с)\n", call_id, link + 1,
+                     (unsigned long)load[link], (unsigned long)budget[link]);
+    }
+    return true;
+}
+
+void AudioManager::releaseCall(int call_id) {
+    if (config_manager && call_states && call_id >= 0 && call_id < config_manager->getMaxCalls()) {
+        call_states[call_id].link_reserved = false;
+    }
+}
+
+int AudioManager::getCallLink(int call_id) const {
+    if (!config_manager || call_id < 0 || call_id >= config_manager->getMaxCalls()) {
+        return -1;
+    }
+    return call_states[call_id].link;
+}
+
+UARTLink* AudioManager::getLinkFor(int call_id) {
+    int link = getCallLink(call_id);
+    return link >= 0 && link < link_count ? &links[link].link : nullptr;
+}
+
+void AudioManager::selfCheckLinkAllocation() {
+    struct {
+        const char* name;
+        uint32_t load[AUDIO_LINKS_MAX];   // С потоком нового вызова
+        uint32_t budget[AUDIO_LINKS_MAX];
+        int count;
+        int expected;
+    } cases[] = {
+        { "один канал, есть место", { 133400, 0 }, { 169000, 0 }, 1, 0 },
+        { "один канал, переполнение", { 183400, 0 }, { 169000, 0 }, 1, -1 },
+        { "наименее загруженный", { 133400, 66800 }, { 169000, 169000 }, 2, 1 },
+        { "разная скорость", { 33400, 33400 }, { 169000, 84000 }, 2, 0 },
+        { "место только во втором", { 169001, 159000 }, { 169000, 169000 }, 2, 1 },
+        { "оба заняты", { 193400, 193400 }, { 169000, 169000 }, 2, -1 },
+    };
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int link = pickLink(cases[i].load, cases[i].budget, cases[i].count);
+        bool ok = link == cases[i].expected;
+        if (!ok) failed++;
+        Serial.printf("LINKS: %-28s -> %2d (ожидался %2d) %s\n", cases[i].name, link, cases[i].expected,
+                     ok ? "OK" : "FAIL");
+    }
+    Serial.printf("LINKS: %s\n", failed ? "есть ошибки" : "все проверки пройдены");
+}
+
+void AudioManager::applyCallCodec(int call_id, uint8_t codec_type) {
+    CallState& call = call_states[call_id];
+    int codec_rate = codec_manager.getSampleRate(codec_type);
+    
+    call.active_codec = codec_type;
+    call.uart_codec = getUARTCodec(codec_type);
+    if (call.adpcm_refused && isADPCMUARTCodec(call.uart_codec)) {
+        call.uart_codec = getLinearUARTCodec(getUARTSampleRate(call.uart_codec));
+    }
+    call.link_rate = isPCMUARTCodec(call.uart_codec) ? getUARTSampleRate(call.uart_codec) : codec_rate;
+    ImaAdpcm::reset(&call.adpcm);
+    
+    // Узкополосный вызов в широкополосный AudioKit и наоборот.
+    // Участник конференции передискретизируется в частоту микшера.
+    call.rx_resampler.configure(codec_rate, call.in_conference ? CONF_SAMPLE_RATE : call.link_rate);
+    call.tx_resampler.configure(call.link_rate, codec_rate);
+    call.drift.reset(codec_manager.getRTPClockRate(codec_type), call.link_rate);
+}
+
+bool AudioManager::spliceSample(uint8_t uart_codec, uint8_t* data, size_t* data_len, size_t capacity, int slip) {
+    size_t width = isPCMUARTCodec(uart_codec) ? 2 : 1;
+    size_t samples = *data_len / width;
+    if (samples < 2 || (slip > 0 && *data_len + width > capacity)) {
+        return false;
+    }
+    
+    // Самый тихий отсчет: пропуск или повтор в нем наименее заметен
+    size_t best = 0;
+    int best_level = 65536;
+    for (size_t i = 0; i < samples; i++) {
+        int16_t sample;
+        if (width == 2) {
+            sample = (int16_t)(data[i * 2] | (data[i * 2 + 1] << 8));
+        } else if (uart_codec == CODEC_PCMA) {
+            sample = G711Codec::alawToLinear(data[i]);
+        } else {
+            sample = G711Codec::ulawToLinear(data[i]);
+        }
+        int level = abs(sample);
+        if (level < best_level) {
+            best_level = level;
+            best = i;
+        }
+    }
+    
+    uint8_t* pos = data + best * width;
+    size_t tail = *data_len - best * width;
+    if (slip < 0) {
+        memmove(pos, pos + width, tail - width);
+        *data_len -= width;
+    } else {
+        memmove(pos + width, pos, tail);
+        *data_len += width;
+    }
+    return true;
+}
+
+void AudioManager::applyDriftSlip(int call_id, uint8_t* data, size_t* data_len, size_t capacity) {
+    CallState& call = call_states[call_id];
+    size_t width = isPCMUARTCodec(call.uart_codec) ? 2 : 1;
+    int slip = call.drift.takeSlip(*data_len / width);
+    if (slip != 0) {
+        spliceSample(call.uart_codec, data, data_len, capacity, slip);
+    }
+}
+
+bool AudioManager::getCallDriftStats(int call_id, drift_stats_t* stats) const {
+    if (!config_manager || !stats || call_id < 0 || call_id >= config_manager->getMaxCalls()) {
+        return false;
+    }
+    call_states[call_id].drift.getStats(stats);
+    return true;
+}
+
+bool AudioManager::getDeadlineMisses(int call_id, uint32_t* rx_misses, uint32_t* tx_misses) const {
+    if (!config_manager || call_id < 0 || call_id >= config_manager->getMaxCalls()) {
+        return false;
+    }
+    *rx_misses = call_states[call_id].rx_deadline.misses;
+    *tx_misses = call_states[call_id].tx_deadline.misses;
+    return true;
+}
+
+void AudioManager::sendAudioToUART(int call_id, uint8_t uart_codec, const uint8_t* data, size_t data_len,
+                                   uint32_t timestamp, uint16_t sequence) {
+    if (isADPCMUARTCodec(uart_codec)) {
+        // PCM сжимается в блок перед отправкой (только прием RTP в такте медиа: микс конференции - L16)
+        data_len = ImaAdpcm::encodeBlock(&call_states[call_id].adpcm, (const int16_t*)data, data_len / 2,
+                                         rx_adpcm_buffer);
+        data = rx_adpcm_buffer;
+    }
+    // Кадр v1 или запись в собираемый кадр v2 (timestamp из RTP пакета для обратной связи)
+    UARTLink* link = getLinkFor(call_id);
+    if (link) {
+        link->sendAudio(call_id, uart_codec, timestamp, sequence, data, data_len);
+    }
+}
+
+// Поток tcpip: только копия, без блокировок и выделения памяти
+bool AudioManager::queueIncomingRTP(int call_id, const uint8_t* rtp_data, size_t data_len,
+                                    uint32_t timestamp, uint16_t sequence, uint8_t payload_type) {
+    if (!rx_ready || data_len == 0) {
+        return false;
+    }
+    uint8_t index;
+    if (data_len > MEDIA_RX_SLOT_SIZE || xQueueReceive(rx_free, &index, 0) != pdTRUE) {
+        metrics.inc(metric_rx_queue_drops, call_id);
+        return false;
+    }
+    media_rx_slot_t* slot = &rx_slots[index];
+    slot->call_id = call_id;
+    slot->payload_type = payload_type;
+    slot->sequence = sequence;
+    slot->timestamp = timestamp;
+    slot->len = data_len;
+    memcpy(slot->data, rtp_data, data_len);
+    xQueueSend(rx_ready, &index, 0);
+    return true;
+}
+
+void AudioManager::drainIncomingRTP(TickType_t timeout) {
+    if (!rx_ready) {
+        vTaskDelay(timeout);
+        return;
+    }
+    uint8_t index;
+    while (xQueueReceive(rx_ready, &index, timeout) == pdTRUE) {
+        media_rx_slot_t* slot = &rx_slots[index];
+        processIncomingRTP(slot->call_id, slot->data, slot->len, slot->timestamp,
+                           slot->sequence, slot->payload_type);
+        xQueueSend(rx_free, &index, 0);
+        timeout = 0;
+    }
+}
+
+// Обработка входящего RTP пакета от SIP -> отправка в UART (задача такта медиа)
 void AudioManager::processIncomingRTP(int call_id, uint8_t* rtp_data, size_t data_len, 
                                      uint32_t timestamp, uint16_t sequence, uint8_t payload_type) {
     if (!config_manager || call_id < 0 || call_id >= config_manager->getMaxCalls() || 
@@ -101,51 +565,139 @@ void AudioManager::processIncomingRTP(int call_id, uint8_t* rtp_data, size_t dat
     
     // Автоматическая активация вызова при получении RTP
     if (!isCallActive(call_id)) {
+        // Кодек, согласованный в SDP при настройке RTP канала
+        uint8_t codec = rtp_manager ? rtp_manager->getPayloadType(call_id) : payload_type;
+        if (!codec_manager.isCodecAvailable(codec)) {
+            codec = config_manager->getPrimaryCodec();
+        }
         setCallActive(call_id, true);
-        configureCall(call_id, config_manager->getPrimaryCodec(), 8000);
+        configureCall(call_id, codec, codec_manager.getSampleRate(codec));
         Serial.printf("AudioManager: AUTO-ACTIVATED Call%d on first RTP packet\n", call_id);
     }
     
     // Синхронизация clock с входящим RTP
-    //global_clock.syncWithRTP(timestamp);
-    
-    // Формирование UART пакета
-    size_t packet_size = UART_PACKET_HEADER_SIZE + data_len;
-    uint8_t* uart_packet = (uint8_t*)malloc(packet_size);
-    if (!uart_packet) return;
-    
-    // Заполнение заголовка
-    uart_packet[0] = 0x55;
-    uart_packet[1] = 0xAA;
-    uart_packet[2] = (uart_packet_counter >> 8) & 0xFF;
-    uart_packet[3] = uart_packet_counter & 0xFF;
-    uart_packet[4] = (data_len >> 8) & 0xFF;
-    uart_packet[5] = data_len & 0xFF;
-    uart_packet[6] = getActiveCodec(call_id);
+    //call_states[call_id].clock.syncWithRTP(timestamp);
     
-    // Используем timestamp из RTP пакета для обратной связи
-    uart_packet[7] = (timestamp >> 24) & 0xFF;
-    uart_packet[8] = (timestamp >> 16) & 0xFF;
-    uart_packet[9] = (timestamp >> 8) & 0xFF;
-    uart_packet[10] = timestamp & 0xFF;
+    CallState& call = call_states[call_id];
     
-    uart_packet[11] = (sequence >> 8) & 0xFF;
-    uart_packet[12] = sequence & 0xFF;
-    uart_packet[13] = call_id;
-    
-    memcpy(uart_packet + UART_PACKET_HEADER_SIZE, rtp_data, data_len);
+    // Пакет длиннее кадра UART (ptime 30-60 мс) делится на кадры по 20 мс:
+    // AudioKit и буферы декодирования рассчитаны на длительность кадра канала.
+    // Номер кадра - sequence * частей + часть: по модулю 2^16 номера идут подряд,
+    // потерянный пакет - пропуск в номерах, как и без деления
+    size_t frame_bytes = UART_FRAME_MS * STREAM_BYTES_PER_MS;
+    if (data_len > frame_bytes && payload_type == call.active_codec && isStreamCodec(payload_type)) {
+        uint16_t parts = (data_len + frame_bytes - 1) / frame_bytes;
+        uint16_t part = 0;
+        for (size_t pos = 0; pos < data_len; pos += frame_bytes, part++) {
+            size_t n = (data_len - pos < frame_bytes) ? data_len - pos : frame_bytes;
+            processIncomingRTP(call_id, rtp_data + pos, n, timestamp + pos,
+                               (uint16_t)(sequence * parts + part), payload_type);
+        }
+        return;
+    }
+    if (call.in_conference) {
+        // Участник конференции: PCM частоты микшера вместо отправки в UART
+        if (payload_type != call.active_codec) {
+            return;
+        }
+        size_t pcm_len = UART_MAX_PACKET_SIZE - UART_PACKET_HEADER_SIZE;
+        if (!codec_manager.decode(rtp_data, data_len, rx_transcode_buffer, &pcm_len,
+                                  payload_type, call_id)) {
+            return;
+        }
+        const int16_t* pcm = (const int16_t*)rx_transcode_buffer;
+        size_t samples = pcm_len / 2;
+        call.rx_deadline.deliver(codec_manager.getTimestampUnits(payload_type, samples));
+        callRecorder.recordPCM(call_id, REC_TYPE_RX, timestamp, pcm, samples,
+                               codec_manager.getSampleRate(payload_type));
+        if (call.rx_resampler.isActive()) {
+            size_t block = call.rx_resampler.getInputRate() / 100;
+            for (size_t pos = 0; pos < samples; pos += block) {
+                size_t n = (samples - pos < block) ? samples - pos : block;
+                int produced = call.rx_resampler.process(pcm + pos, n, rx_resample_buffer);
+                conference.pushAudio(call_id, rx_resample_buffer, produced);
+            }
+        } else {
+            conference.pushAudio(call_id, pcm, samples);
+        }
+        call.last_activity = millis();
+        return;
+    }
     
-    // Отправка по UART
-    uart_write_bytes(UART_PORT, (const char*)uart_packet, packet_size);
+    // Декодирование в линейный PCM, если AudioKit работает в режиме L16/ADPCM
+    uint8_t uart_codec = call.uart_codec;
+    if (isPCMUARTCodec(uart_codec)) {
+        if (payload_type != call.active_codec) {
+            return; // Пакет другого кодека (например, telephone-event)
+        }
+        size_t pcm_len = UART_MAX_PACKET_SIZE - UART_PACKET_HEADER_SIZE;
+        if (!codec_manager.decode(rtp_data, data_len, rx_transcode_buffer, &pcm_len,
+                                  payload_type, call_id)) {
+            return;
+        }
+        
+        uint32_t rtp_units = codec_manager.getTimestampUnits(payload_type, pcm_len / 2);
+        call.drift.onIncoming(timestamp, rtp_units, millis());
+        call.rx_deadline.deliver(rtp_units);
+        callRecorder.recordPCM(call_id, REC_TYPE_RX, timestamp, (const int16_t*)rx_transcode_buffer, pcm_len / 2,
+                               codec_manager.getSampleRate(payload_type));
+        
+        if (call.rx_resampler.isActive()) {
+            // Передискретизация блоками по 10 мс: каждый блок - отдельный UART пакет
+            // со своим номером (как у частей длинного пакета)
+            const int16_t* pcm = (const int16_t*)rx_transcode_buffer;
+            size_t samples = pcm_len / 2;
+            size_t block = call.rx_resampler.getInputRate() / 100;
+            uint16_t blocks = (samples + block - 1) / block;
+            uint16_t block_index = 0;
+            for (size_t pos = 0; pos < samples; pos += block, block_index++) {
+                size_t n = (samples - pos < block) ? samples - pos : block;
+                size_t out_len = call.rx_resampler.process(pcm + pos, n, rx_resample_buffer) * 2;
+                applyDriftSlip(call_id, (uint8_t*)rx_resample_buffer, &out_len,
+                               (RESAMPLER_MAX_BLOCK + 1) * sizeof(int16_t));
+                latencyTracer.mark(call_id, LAT_DIR_RX);
+                sendAudioToUART(call_id, uart_codec, (const uint8_t*)rx_resample_buffer, out_len,
+                                timestamp + codec_manager.getTimestampUnits(payload_type, pos),
+                                (uint16_t)(sequence * blocks + block_index));
+            }
+        } else {
+            applyDriftSlip(call_id, rx_transcode_buffer, &pcm_len, UART_MAX_PACKET_SIZE - UART_PACKET_HEADER_SIZE);
+            latencyTracer.mark(call_id, LAT_DIR_RX);
+            sendAudioToUART(call_id, uart_codec, rx_transcode_buffer, pcm_len, timestamp, sequence);
+        }
+        data_len = pcm_len;
+    } else {
+        // G.711 без перекодирования: один байт на отсчет 8 кГц
+        call.drift.onIncoming(timestamp, data_len, millis());
+        call.rx_deadline.deliver(data_len);
+        callRecorder.recordG711(call_id, REC_TYPE_RX, timestamp, rtp_data, data_len,
+                                uart_codec == CODEC_PCMU ? REC_LAW_ULAW : REC_LAW_ALAW);
+        if (data_len < UART_MAX_PACKET_SIZE - UART_PACKET_HEADER_SIZE) {
+            memcpy(rx_transcode_buffer, rtp_data, data_len);
+            applyDriftSlip(call_id, rx_transcode_buffer, &data_len, UART_MAX_PACKET_SIZE - UART_PACKET_HEADER_SIZE);
+            latencyTracer.mark(call_id, LAT_DIR_RX);
+            sendAudioToUART(call_id, uart_codec, rx_transcode_buffer, data_len, timestamp, sequence);
+        } else {
+            latencyTracer.mark(call_id, LAT_DIR_RX);
+            sendAudioToUART(call_id, uart_codec, rtp_data, data_len, timestamp, sequence);
+        }
+    }
+    latencyTracer.end(call_id, LAT_DIR_RX);
     
-    free(uart_packet);
+    // Периодический отчет о расхождении часов
+    if (call.drift.isLocked() && millis() - call.last_drift_log > 60000) {
+        drift_stats_t drift;
+        call.drift.getStats(&drift);
+        Serial.printf("DRIFT: Call%d, %.1f ppm, коррекция %.1f ppm, заполнение %ld, пропущено %lu, вставлено %lu\n",
+                     call_id, drift.ppm, drift.correction_ppm, (long)drift.fill,
+                     (unsigned long)drift.dropped, (unsigned long)drift.inserted);
+        call.last_drift_log = millis();
+    }
     
     // Обновление активности
     call_states[call_id].last_activity = millis();
     call_states[call_id].is_active = true;
     
-    uart_packet_counter++;
-    
     // Логирование
     static uint32_t last_log = 0;
     if (millis() - last_log > 1000) {
@@ -158,17 +710,175 @@ void AudioManager::processIncomingRTP(int call_id, uint8_t* rtp_data, size_t dat
 // Обработка исходящих данных от UART -> отправка в RTP
 void AudioManager::processOutgoingAudio(int call_id, uint8_t* audio_data, size_t data_len, 
                                        uint8_t codec_type, uint32_t uart_timestamp) {
-    if (!isCallActive(call_id)) return;
+    if (!isCallActive(call_id)) {
+        latencyTracer.cancel(call_id, LAT_DIR_TX);
+        return;
+    }
+    
+    CallState& call = call_states[call_id];
+    if (isADPCMUARTCodec(call.uart_codec) && isLinearUARTCodec(codec_type) && !call.in_conference) {
+        // Ответ L16 на предложение ADPCM: AudioKit его не поддерживает
+        call.adpcm_refused = true;
+        call.uart_codec = codec_type;
+        sendCallSettingsToAudioKit(call_id, call.uart_codec, call.link_rate);
+        Serial.printf("AudioManager: Call %d - AudioKit без ADPCM, канал L16\n", call_id);
+    }
+    if (isADPCMUARTCodec(codec_type)) {
+        // Блок ADPCM -> PCM той же частоты, дальше как L16
+        int samples = ImaAdpcm::decodeBlock(audio_data, data_len, tx_adpcm_pcm,
+                                            (UART_MAX_PACKET_SIZE - UART_PACKET_HEADER_SIZE) * 2);
+        if (samples == 0) {
+            latencyTracer.cancel(call_id, LAT_DIR_TX);
+            return;
+        }
+        audio_data = (uint8_t*)tx_adpcm_pcm;
+        data_len = samples * sizeof(int16_t);
+        codec_type = getLinearUARTCodec(getUARTSampleRate(codec_type));
+    }
+    
+    if (call_states[call_id].in_conference) {
+        // Голос AudioKit принимается только по каналу микса, в формате микшера
+        if (call_id == conference_anchor && codec_type == UART_CODEC_CONFERENCE) {
+            conference.pushAudio(CONF_LOCAL_ID, (const int16_t*)audio_data, data_len / 2);
+        }
+        call_states[call_id].last_activity = millis();
+        latencyTracer.cancel(call_id, LAT_DIR_TX);
+        return;
+    }
 
     // ИГНОРИРУЕМ uart_timestamp от AudioKit (он всегда 0)
     // Генерируем свои последовательные timestamp и sequence
+    encodeAndSendRTP(call_id, audio_data, data_len, codec_type, tx_transcode_buffer, tx_resample_buffer);
+    // Кадр без отправки пакета (сборка 30/40 мс, DTX) не трассируется
+    latencyTracer.cancel(call_id, LAT_DIR_TX);
+}
+
+void AudioManager::encodeAndSendRTP(int call_id, uint8_t* audio_data, size_t data_len, uint8_t codec_type,
+                                    uint8_t* transcode_buffer, int16_t* resample_buffer) {
+    uint32_t rtp_units;
+    int32_t packet_offset = 0;
+    const int16_t* record_pcm = nullptr;   // PCM частоты кодека для записи вызова
+    size_t record_samples = 0;
+    if (isLinearUARTCodec(codec_type)) {
+        // Линейный PCM от AudioKit: кодируем в согласованный кодек вызова
+        CallState& call = call_states[call_id];
+        uint8_t rtp_codec = call.active_codec;
+        uint8_t* pcm = audio_data;
+        size_t samples = data_len / 2;
+        
+        // Частота берется из заголовка пакета - AudioKit мог не применить настройки
+        int link_rate = getUARTSampleRate(codec_type);
+        if (call.tx_resampler.getInputRate() != link_rate) {
+            call.tx_resampler.configure(link_rate, codec_manager.getSampleRate(rtp_codec));
+        }
+        if (call.tx_resampler.isActive()) {
+            if (call.tx_resampler.getOutputSamples(samples) > TX_RESAMPLE_SAMPLES) {
+                return;
+            }
+            samples = call.tx_resampler.process((const int16_t*)audio_data, samples, resample_buffer);
+            pcm = (uint8_t*)resample_buffer;
+        }
+        
+        size_t encoded_len = UART_MAX_PACKET_SIZE;
+        if (!codec_manager.encode(pcm, samples * 2, transcode_buffer, &encoded_len,
+                                  rtp_codec, call_id)) {
+            return;
+        }
+        rtp_units = codec_manager.getTimestampUnits(rtp_codec, samples);
+        record_pcm = (const int16_t*)pcm;
+        record_samples = samples;
+        // Начало пакета может быть в предыдущем фрейме (сборка 30/40 мс пакетов)
+        packet_offset = codec_manager.getTimestampOffset(rtp_codec, codec_manager.getPacketOffset(call_id));
+        audio_data = transcode_buffer;
+        data_len = encoded_len;
+        codec_type = rtp_codec;
+    } else {
+        // G.711: один байт на отсчет 8 кГц
+        rtp_units = data_len;
+    }
+    
+    // Часы идут по каждому фрейму от AudioKit, даже если пакет не отправляется
+    call_states[call_id].drift.onOutgoing(rtp_units);
+    call_states[call_id].tx_deadline.deliver(rtp_units);
+    uint32_t timestamp = getOutgoingTimestamp(call_id, rtp_units);
+    
+    if (record_pcm) {
+        callRecorder.recordPCM(call_id, REC_TYPE_TX, timestamp, record_pcm, record_samples,
+                               codec_manager.getSampleRate(codec_type));
+    } else {
+        callRecorder.recordG711(call_id, REC_TYPE_TX, timestamp, audio_data, data_len,
+                                codec_type == CODEC_PCMU ? REC_LAW_ULAW : REC_LAW_ALAW);
+    }
+    
+    if (data_len == 0) {
+        // Кодек еще собирает пакет из фреймов или передает тишину (DTX)
+        call_states[call_id].last_activity = millis();
+        return;
+    }
+    
+    timestamp += packet_offset;
+    if (isStreamCodec(codec_type) && call_states[call_id].reframe_buffer) {
+        sendReframed(call_id, audio_data, data_len, timestamp, codec_type);
+    } else {
+        sendRTPPacket(call_id, audio_data, data_len, timestamp, codec_type);
+    }
+
+    call_states[call_id].last_activity = millis();
+}
+
+bool AudioManager::isStreamCodec(uint8_t codec_type) {
+    return codec_type == CODEC_PCMU || codec_type == CODEC_PCMA || codec_type == CODEC_G722;
+}
+
+// Целые пакеты отправляются прямо из кадра UART, в буфер вызова попадает
+// только остаток (сборка 30/40/60 мс или кадр, не кратный ptime)
+void AudioManager::sendReframed(int call_id, const uint8_t* data, size_t data_len, uint32_t timestamp,
+                                uint8_t codec_type) {
+    CallState& call = call_states[call_id];
+    size_t packet_bytes = call.ptime * STREAM_BYTES_PER_MS;
+    
+    if (call.reframe_len > 0) {
+        if (timestamp != call.reframe_timestamp + call.reframe_len) {
+            call.reframe_len = 0; // Разрыв потока: неполный пакет устарел
+        } else {
+            size_t n = packet_bytes - call.reframe_len;
+            if (n > data_len) n = data_len;
+            memcpy(call.reframe_buffer + call.reframe_len, data, n);
+            call.reframe_len += n;
+            data += n;
+            data_len -= n;
+            timestamp += n;
+            if (call.reframe_len < packet_bytes) {
+                return;
+            }
+            sendRTPPacket(call_id, call.reframe_buffer, packet_bytes, call.reframe_timestamp, codec_type);
+            call.reframe_len = 0;
+        }
+    }
+    
+    while (data_len >= packet_bytes) {
+        sendRTPPacket(call_id, data, packet_bytes, timestamp, codec_type);
+        data += packet_bytes;
+        data_len -= packet_bytes;
+        timestamp += packet_bytes;
+    }
     
+    if (data_len > 0) {
+        memcpy(call.reframe_buffer, data, data_len);
+        call.reframe_len = data_len;
+        call.reframe_timestamp = timestamp;
+    }
+}
+
+void AudioManager::sendRTPPacket(int call_id, const uint8_t* data, size_t data_len, uint32_t timestamp,
+                                 uint8_t codec_type) {
     uint16_t sequence = getNextSequence(call_id);
-    uint32_t timestamp = getOutgoingTimestamp(call_id);
 
     // Отправка в RTP
-    rtp_manager->sendAudioData(call_id, audio_data, data_len,
+    latencyTracer.mark(call_id, LAT_DIR_TX);
+    rtp_manager->sendAudioData(call_id, (uint8_t*)data, data_len,
                               timestamp, sequence, codec_type);
+    latencyTracer.end(call_id, LAT_DIR_TX);
 
     // Логирование
     static uint32_t last_log = 0;
@@ -177,148 +887,71 @@ void AudioManager::processOutgoingAudio(int call_id, uint8_t* audio_data, size_t
                      call_id, timestamp, sequence, data_len);
         last_log = millis();
     }
-
-    call_states[call_id].last_activity = millis();
 }
 
-bool AudioManager::parseUARTPacket(uint8_t* data, size_t len, audio_packet_t* packet) {
-    if (len < UART_PACKET_HEADER_SIZE) return false;
-    
-    if (data[0] != 0x55 || data[1] != 0xAA) {
-        return false;
-    }
-    
-    uint16_t data_length = (data[4] << 8) | data[5];
-    
-    if (data_length > (len - UART_PACKET_HEADER_SIZE)) {
-        Serial.printf("AudioManager: Неверная длина данных %d > %d\n", 
-                     data_length, (len - UART_PACKET_HEADER_SIZE));
-        return false;
-    }
-    
-    packet->call_id = data[13];
-    packet->timestamp = (data[7] << 24) | (data[8] << 16) | (data[9] << 8) | data[10];
-    packet->sequence = (data[11] << 8) | data[12];
-    packet->codec_type = data[6];
-    packet->data_length = data_length;
-    
-    if (packet->data_length > 0) {
-        packet->data = (uint8_t*)malloc(packet->data_length);
-        if (!packet->data) return false;
-        memcpy(packet->data, data + UART_PACKET_HEADER_SIZE, packet->data_length);
+// Аудио фрейм AudioKit (v1 или запись кадра v2); data указывает в буфер приема UARTLink
+void AudioManager::onUARTAudio(const audio_packet_t* packet, void* ctx) {
+    AudioLink* audio_link = (AudioLink*)ctx;
+    AudioManager* audioMgr = audio_link->owner;
+    // Фрейм вызова, назначенного другому каналу (AudioKit еще не получил стоп)
+    if (audioMgr->getCallLink(packet->call_id) != audio_link->index) {
+        return;
     }
-    
-    return true;
+    // Кадр собран: начало трассировки UART -> RTP
+    latencyTracer.begin(packet->call_id, LAT_DIR_TX);
+    audioMgr->processOutgoingAudio(packet->call_id, packet->data, packet->data_length,
+                                   packet->codec_type, packet->timestamp);
 }
 
 void AudioManager::uartTask(void* pvParameters) {
-    AudioManager* audioMgr = (AudioManager*)pvParameters;
-    uint8_t rx_buffer[UART_MAX_PACKET_SIZE];
-    size_t rx_index = 0;
-    bool in_packet = false;
-    uint16_t expected_length = 0;
+    AudioLink* audio_link = (AudioLink*)pvParameters;
     
-    Serial.println("AudioManager: Задача UART запущена");
+    Serial.printf("AudioManager: Задача UART канала %d запущена\n", audio_link->index + 1);
     
     while (1) {
-        int len = uart_read_bytes(UART_PORT, audioMgr->uart_rx_buffer, 
-                                 UART_BUFFER_SIZE, 20 / portTICK_PERIOD_MS);
+        // Короткий таймаут: сборка кадров v2 по сроку и возврат кредитов без входящих байтов
+        size_t len = 0;
+        const uint8_t* data = audio_link->transport->receive(&len, UART_LINK_POLL_MS);
         
-        if (len > 0) {
-            for (int i = 0; i < len; i++) {
-                uint8_t byte = audioMgr->uart_rx_buffer[i];
-                
-                if (!in_packet) {
-                    if (rx_index == 0 && byte == 0x55) {
-                        rx_buffer[rx_index++] = byte;
-                    } else if (rx_index == 1 && byte == 0xAA) {
-                        rx_buffer[rx_index++] = byte;
-                        in_packet = true;
-                        expected_length = 0;
-                    } else {
-                        rx_index = 0;
-                    }
-                } else {
-                    if (rx_index < UART_MAX_PACKET_SIZE) {
-                        rx_buffer[rx_index++] = byte;
-                        
-                        if (rx_index == 6 && expected_length == 0) {
-                            uint16_t data_length = (rx_buffer[4] << 8) | rx_buffer[5];
-                            expected_length = UART_PACKET_HEADER_SIZE + data_length;
-                            
-                            if (expected_length > UART_MAX_PACKET_SIZE || expected_length < UART_PACKET_HEADER_SIZE) {
-                                rx_index = 0;
-                                in_packet = false;
-                                expected_length = 0;
-                                continue;
-                            }
-                        }
-                        
-                        if (expected_length > 0 && rx_index == expected_length) {
-                            audio_packet_t audio_packet;
-                            if (audioMgr->parseUARTPacket(rx_buffer, rx_index, &audio_packet)) {
-                                // Обработка исходящего аудио
-                                audioMgr->processOutgoingAudio(audio_packet.call_id,
-                                                              audio_packet.data,
-                                                              audio_packet.data_length,
-                                                              audio_packet.codec_type,
-                                                              audio_packet.timestamp);
-                                
-                                if (audio_packet.data) {
-                                    free(audio_packet.data);
-                                }
-                            }
-                            
-                            rx_index = 0;
-                            in_packet = false;
-                            expected_length = 0;
-                        }
-                    } else {
-                        rx_index = 0;
-                        in_packet = false;
-                        expected_length = 0;
-                    }
-                }
-            }
+        if (data) {
+            audio_link->link.feed(data, len);
         }
+        audio_link->link.poll();
         
         vTaskDelay(1 / portTICK_PERIOD_MS);
     }
 }
 
-void AudioManager::audioProcessTask(void* pvParameters) {
-    AudioManager* audioMgr = (AudioManager*)pvParameters;
-    
-    Serial.println("AudioManager: Задача обработки аудио запущена");
-    
-    while (1) {
-        // Обработка аудио для всех активных вызовов
-        if (audioMgr->config_manager) {
-            for (int i = 0; i < audioMgr->config_manager->getMaxCalls(); i++) {
-                if (audioMgr->call_states[i].is_active) {
-                    // Очистка неактивных вызовов (таймаут 30 секунд)
-                    if (millis() - audioMgr->call_states[i].last_activity > 30000) {
-                        audioMgr->call_states[i].is_active = false;
-                        Serial.printf("AudioManager: Вызов %d деактивирован по таймауту\n", i);
-                    }
-                }
-            }
-        }
-        
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-    }
-}
-
 void AudioManager::setCallActive(int call_id, bool active) {
     if (config_manager && call_id >= 0 && call_id < config_manager->getMaxCalls()) {
+        if (!active) {
+            leaveConference(call_id);
+        }
         call_states[call_id].is_active = active;
         call_states[call_id].last_activity = millis();
         
         if (active) {
-            // Сброс sequence и timestamp при активации
+            // Сброс sequence, timestamp и состояния кодека при активации
             call_states[call_id].last_sequence = 0;
             call_states[call_id].timestamp_initialized = false;
-            global_clock.reset();
+            call_states[call_id].clock.reset();
+            call_states[call_id].rx_resampler.reset();
+            call_states[call_id].tx_resampler.reset();
+            call_states[call_id].drift.reset(codec_manager.getRTPClockRate(call_states[call_id].active_codec),
+                                             call_states[call_id].link_rate);
+            call_states[call_id].rx_deadline.reset();
+            call_states[call_id].tx_deadline.reset();
+            call_states[call_id].last_drift_log = millis();
+            call_states[call_id].reframe_len = 0;
+            codec_manager.setCallPacketTime(call_id, call_states[call_id].ptime);
+            codec_manager.resetCallState(call_id);
+            
+            if (config_manager->isCallRecordingEnabled()) {
+                callRecorder.start(call_id, call_states[call_id].active_codec == CODEC_PCMU ?
+                                   REC_LAW_ULAW : REC_LAW_ALAW);
+            }
+        } else {
+            callRecorder.stop(call_id);
         }
         
         sendCallStatusToAudioKit(call_id, active);
@@ -339,20 +972,25 @@ void AudioManager::configureCall(int call_id, uint8_t codec_type, uint16_t clock
     }
     
     // Сохраняем настройки в структуре вызова
-    call_states[call_id].active_codec = codec_type;
+    applyCallCodec(call_id, codec_type);
     call_states[call_id].is_active = true;
     call_states[call_id].last_activity = millis();
     
-    // Отправляем настройки на AudioKit
-    sendCallSettingsToAudioKit(call_id, codec_type, clock_rate);
+    // Отправляем настройки на AudioKit: формат канала UART и частоту PCM в канале
+    // (для G.722 это 16000, хотя часы RTP идут на 8000)
+    if (!call_states[call_id].in_conference) {
+        sendCallSettingsToAudioKit(call_id, call_states[call_id].uart_codec, call_states[call_id].link_rate);
+    } else if (call_id == conference_anchor) {
+        sendConferenceSettings(call_id);
+    }
     
-    Serial.printf("AudioManager: Call %d configured - Codec: %d, Clock: %dHz\n", 
-                 call_id, codec_type, clock_rate);
+    Serial.printf("AudioManager: Call %d configured - Codec: %d, Clock: %dHz, AudioKit: %dHz\n", 
+                 call_id, codec_type, clock_rate, call_states[call_id].link_rate);
 }
 
 void AudioManager::setActiveCodec(int call_id, uint8_t codec_type) {
     if (config_manager && call_id >= 0 && call_id < config_manager->getMaxCalls()) {
-        call_states[call_id].active_codec = codec_type;
+        applyCallCodec(call_id, codec_type);
         call_states[call_id].last_activity = millis();
     }
 }
@@ -366,18 +1004,225 @@ uint8_t AudioManager::getActiveCodec(int call_id) {
 
 void AudioManager::resetCallAudio(int call_id) {
     if (config_manager && call_id >= 0 && call_id < config_manager->getMaxCalls()) {
+        leaveConference(call_id);
+        callRecorder.stop(call_id);
         call_states[call_id].is_active = false;
         call_states[call_id].last_activity = 0;
         call_states[call_id].last_sequence = 0;
         call_states[call_id].timestamp_initialized = false;
+        call_states[call_id].rx_resampler.reset();
+        call_states[call_id].tx_resampler.reset();
+        call_states[call_id].ptime = config_manager->getAudioPacketTime();
+        call_states[call_id].reframe_len = 0;
+        call_states[call_id].adpcm_refused = false;
+        call_states[call_id].rx_deadline.reset();
+        call_states[call_id].tx_deadline.reset();
+        codec_manager.resetCallState(call_id);
+    }
+}
+
+void AudioManager::setCallPacketTime(int call_id, int ms) {
+    if (config_manager && call_id >= 0 && call_id < config_manager->getMaxCalls()) {
+        call_states[call_id].ptime = ConfigManager::isSupportedPacketTime(ms) ? ms : config_manager->getAudioPacketTime();
+    }
+}
+
+int AudioManager::getCallPacketTime(int call_id) const {
+    if (config_manager && call_id >= 0 && call_id < config_manager->getMaxCalls()) {
+        return call_states[call_id].ptime;
+    }
+    return 0;
+}
+
+bool AudioManager::isInConference(int call_id) const {
+    if (config_manager && call_id >= 0 && call_id < config_manager->getMaxCalls()) {
+        return call_states[call_id].in_conference;
+    }
+    return false;
+}
+
+void AudioManager::sendConferenceSettings(int call_id) {
+    // Канал микса всегда L16 на частоте микшера, независимо от кодека вызова
+    sendCallSettingsToAudioKit(call_id, UART_CODEC_CONFERENCE, CONF_SAMPLE_RATE);
+}
+
+bool AudioManager::joinConference(int call_id) {
+    if (!config_manager || call_id < 0 || call_id >= config_manager->getMaxCalls()) {
+        return false;
+    }
+    CallState& call = call_states[call_id];
+    if (call.in_conference) {
+        return true;
+    }
+    if (!call.is_active || !codec_manager.isCodecAvailable(call.active_codec)) {
+        Serial.printf("AudioManager: Call %d не может войти в конференцию\n", call_id);
+        return false;
+    }
+    if (!conference.addParticipant(call_id)) {
+        return false;
+    }
+    
+    bool first = conference_anchor < 0;
+    if (first && !conference.addParticipant(CONF_LOCAL_ID)) {
+        conference.removeParticipant(call_id);
+        return false;
+    }
+    
+    call.in_conference = true;
+    applyCallCodec(call_id, call.active_codec);
+    if (first) {
+        conf_timestamp = 0;
+        conf_sequence = 0;
+        conference_anchor = call_id;
+        sendConferenceSettings(call_id);
+    }
+    
+    Serial.printf("AudioManager: Call %d в конференции, участников %d, канал AudioKit Call%d\n",
+                 call_id, conference.getParticipantCount(), conference_anchor);
+    return true;
+}
+
+void AudioManager::leaveConference(int call_id) {
+    if (!isInConference(call_id)) {
+        return;
+    }
+    CallState& call = call_states[call_id];
+    call.in_conference = false;
+    conference.removeParticipant(call_id);
+    applyCallCodec(call_id, call.active_codec);
+    
+    if (call_id == conference_anchor) {
+        // Канал микса переходит к следующему участнику
+        int next = -1;
+        for (int i = 0; i < config_manager->getMaxCalls(); i++) {
+            if (call_states[i].in_conference) {
+                next = i;
+                break;
+            }
+        }
+        conference_anchor = next;
+        if (next >= 0) {
+            sendConferenceSettings(next);
+        } else {
+            conference.removeParticipant(CONF_LOCAL_ID);
+        }
+        if (call.is_active) {
+            sendCallSettingsToAudioKit(call_id, call.uart_codec, call.link_rate);
+        }
+    }
+    
+    Serial.printf("AudioManager: Call %d покинул конференцию\n", call_id);
+}
+
+void AudioManager::processConferenceTick() {
+    int anchor = conference_anchor;
+    if (anchor < 0) {
+        return;
+    }
+    conference.mix();
+    
+    // Каждому вызову - свой микс без его голоса, в кодеке вызова
+    for (int i = 0; i < config_manager->getMaxCalls(); i++) {
+        if (!call_states[i].in_conference || !call_states[i].is_active) {
+            continue;
+        }
+        const int16_t* mix = conference.getMix(i);
+        if (mix) {
+            encodeAndSendRTP(i, (uint8_t*)mix, CONF_FRAME_SAMPLES * sizeof(int16_t), UART_CODEC_CONFERENCE,
+                             conf_transcode_buffer, conf_resample_buffer);
+        }
+    }
+    
+    // AudioKit получает один поток по каналу первого участника
+    const int16_t* local = conference.getMix(CONF_LOCAL_ID);
+    if (local) {
+        sendAudioToUART(anchor, UART_CODEC_CONFERENCE, (const uint8_t*)local,
+                        CONF_FRAME_SAMPLES * sizeof(int16_t), conf_timestamp, conf_sequence++);
+        conf_timestamp += CONF_FRAME_SAMPLES;
+    }
+}
+
+// Пропуски: поток вызова не дал аудио на такт (счет после первого кадра потока)
+void AudioManager::checkDeadlines() {
+    for (int i = 0; i < config_manager->getMaxCalls(); i++) {
+        CallState& call = call_states[i];
+        if (!call.is_active) {
+            continue;
+        }
+        uint32_t tick_units = codec_manager.getRTPClockRate(call.active_codec) / 1000 * MEDIA_TICK_MS;
+        uint32_t missed = call.rx_deadline.tick(tick_units);
+        if (missed) {
+            metrics.inc(metric_rx_deadline_misses, i, missed);
+        }
+        missed = call.tx_deadline.tick(tick_units);
+        if (missed) {
+            metrics.inc(metric_tx_deadline_misses, i, missed);
+        }
+    }
+}
+
+void AudioManager::checkCallTimeouts() {
+    for (int i = 0; i < config_manager->getMaxCalls(); i++) {
+        if (call_states[i].is_active) {
+            // Очистка неактивных вызовов (таймаут 30 секунд)
+            if (millis() - call_states[i].last_activity > CALL_INACTIVE_TIMEOUT_MS) {
+                call_states[i].is_active = false;
+                callRecorder.stop(i);
+                Serial.printf("AudioManager: Вызов %d деактивирован по таймауту\n", i);
+            }
+        }
+    }
+}
+
+// Порядок сроков такта: микс конференции (выбор очередей участников, RTP и
+// UART), кадры UART, собранные за такт, затем учет пропусков
+void AudioManager::processMediaTick(uint32_t tick) {
+    processConferenceTick();
+    for (int i = 0; i < link_count; i++) {
+        links[i].link.flush();
+    }
+    checkDeadlines();
+    if (tick % MEDIA_TIMEOUT_CHECK_TICKS == 0) {
+        checkCallTimeouts();
+    }
+}
+
+void AudioManager::mediaTickTask(void* pvParameters) {
+    AudioManager* audioMgr = (AudioManager*)pvParameters;
+    
+    Serial.printf("AudioManager: Такт медиа запущен (ядро %d)\n", xPortGetCoreID());
+    
+    // Такт по абсолютному времени: длительность обработки не накапливает сдвиг.
+    // До начала такта задача обрабатывает принятые RTP пакеты по мере прихода
+    const TickType_t period = MEDIA_TICK_MS / portTICK_PERIOD_MS;
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t tick = 0;
+    while (1) {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t next_wake = last_wake + period;
+        if ((int32_t)(next_wake - now) > 0) {
+            audioMgr->drainIncomingRTP(next_wake - now);
+            continue;
+        }
+        last_wake = next_wake;
+        // Опоздание на период и больше: предыдущий такт не уложился в срок
+        if (now - last_wake >= period) {
+            metrics.inc(metric_tick_overruns);
+        }
+        if (audioMgr->config_manager) {
+            audioMgr->processMediaTick(tick++);
+        }
     }
 }
 
 void AudioManager::startTasks() {
     if (tasks_running) return;
     
-    xTaskCreate(uartTask, "UART_Task", 4096, this, 12, &uart_task_handle);
-    xTaskCreate(audioProcessTask, "Audio_Process", 4096, this, 10, &audio_process_task_handle);
+    // Задача приема на каждый канал AudioKit
+    for (int i = 0; i < link_count; i++) {
+        taskPlan.create(i == 0 ? TASK_UART : TASK_UART2, uartTask, &links[i], &links[i].task_handle);
+    }
+    taskPlan.create(TASK_MEDIA_TICK, mediaTickTask, this, &media_task_handle);
     
     tasks_running = true;
     Serial.println("AudioManager: Задачи запущены");
@@ -386,13 +1231,15 @@ void AudioManager::startTasks() {
 void AudioManager::stopTasks() {
     if (!tasks_running) return;
     
-    if (uart_task_handle) {
-        vTaskDelete(uart_task_handle);
-        uart_task_handle = nullptr;
+    for (int i = 0; i < link_count; i++) {
+        if (links[i].task_handle) {
+            vTaskDelete(links[i].task_handle);
+            links[i].task_handle = nullptr;
+        }
     }
-    if (audio_process_task_handle) {
-        vTaskDelete(audio_process_task_handle);
-        audio_process_task_handle = nullptr;
+    if (media_task_handle) {
+        vTaskDelete(media_task_handle);
+        media_task_handle = nullptr;
     }
     
     tasks_running = false;
@@ -409,7 +1256,11 @@ void AudioManager::sendCallStatusToAudioKit(int call_id, bool active) {
     command_packet[4] = active ? 0x01 : 0x00;
     command_packet[5] = 0x00;
     
-    uart_write_bytes(UART_PORT, (const char*)command_packet, sizeof(command_packet));
+    UARTLink* link = getLinkFor(call_id);
+    if (!link) {
+        return;
+    }
+    link->sendControl(command_packet, sizeof(command_packet));
     
     Serial.printf("AudioManager: Sent call status to AudioKit - Call%d: %s\n",
                  call_id, active ? "ACTIVE" : "INACTIVE");
@@ -433,7 +1284,11 @@ void AudioManager::sendCallSettingsToAudioKit(int call_id, uint8_t codec_type, u
     settings_packet[8] = 0x00;
     settings_packet[9] = 0x00;
     
-    uart_write_bytes(UART_PORT, (const char*)settings_packet, sizeof(settings_packet));
+    UARTLink* link = getLinkFor(call_id);
+    if (!link) {
+        return;
+    }
+    link->sendControl(settings_packet, sizeof(settings_packet));
     
     Serial.printf("AudioManager: Sent call settings to AudioKit - Call%d: Codec=%d, Clock=%dHz\n",
                  call_id, codec_type, clock_rate);
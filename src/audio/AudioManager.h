@@ -6,29 +6,77 @@
 #include <freertos/queue.h>
 #include <driver/uart.h>
 #include "ConfigManager.h"
+#include "CodecManager.h"
+#include "Resampler.h"
+#include "DriftCompensator.h"
+#include "ConferenceMixer.h"
+#include "UARTLink.h"
+#include "UARTDMATransport.h"
+#include "ImaAdpcm.h"
 
 class RTPManager;
 
-// Структура UART пакета
-typedef struct {
-    int call_id;
-    uint32_t timestamp;
-    uint16_t sequence;
-    uint8_t codec_type;
-    uint16_t data_length;
-    uint8_t* data;
-} audio_packet_t;
+// Форматы аудио в канале UART (байт codec_type заголовка).
+// Значения 0-127 - payload type G.711, передаваемый как есть.
+// Значения >= 0xF0 - PCM, кодек выполняется на ESP32: линейный 16 бит little-endian
+// или блок IMA ADPCM (ImaAdpcm.h) той же частоты.
+// Формат предлагается AudioKit командой настроек 0x5A 0xA5 0x02. AudioKit отвечает
+// фреймами в принятом формате; L16 в ответ на ADPCM - ADPCM не поддерживается,
+// вызов переходит на L16.
+#define UART_CODEC_L16_8K 0xF0   // PCM 16 бит, 8 кГц
+#define UART_CODEC_L16_16K 0xF1  // PCM 16 бит, 16 кГц (широкополосные вызовы G.722)
+#define UART_CODEC_L16_48K 0xF2  // PCM 16 бит, 48 кГц
+#define UART_CODEC_ADPCM_8K 0xF3  // IMA ADPCM, 8 кГц (32 кбит/с)
+#define UART_CODEC_ADPCM_16K 0xF4 // IMA ADPCM, 16 кГц (64 кбит/с)
+#define UART_CODEC_ADPCM_48K 0xF5 // IMA ADPCM, 48 кГц
+#define UART_CODEC_CONFERENCE UART_CODEC_L16_16K  // Микс конференции (CONF_SAMPLE_RATE)
+
+// Полоса канала UART: вызов допускается, если сумма потоков вызовов канала в одну
+// сторону (фреймы по 10 мс с заголовками) не превышает доли его скорости.
+// Каналов AudioKit может быть несколько (AUDIO_LINKS_MAX, у каждого свой UART):
+// вызов назначается каналу с наибольшим запасом полосы
+#define UART_LINK_BUDGET_PERCENT 85  // Остаток - служебные кадры и неравномерность
+#define UART_LINK_FRAMES_PER_SECOND 100
+
+// Пакетизация: канал UART несет кадры по 20 мс, RTP - пакеты ptime вызова.
+// Потоковые кодеки (G.711, G.722: 8 байт на мс, байт = единица часов RTP)
+// делятся и собираются по байтам, G.729 собирает пакет сам
+#define UART_FRAME_MS 20
+#define PTIME_MAX_MS 60
+#define STREAM_BYTES_PER_MS 8
+#define REFRAME_BUFFER_SIZE (PTIME_MAX_MS * STREAM_BYTES_PER_MS)
 
-#define UART_PORT UART_NUM_2
-#define UART_BAUD_RATE 2000000
-#define UART_BUFFER_SIZE 2048
-#define UART_TX_PIN 17
-#define UART_RX_PIN 5
+// Буфер PCM частоты кодека после передискретизации входа AudioKit (512 отсчетов x2)
+#define TX_RESAMPLE_SAMPLES (UART_MAX_PACKET_SIZE - UART_PACKET_HEADER_SIZE)
 
-#define UART_PACKET_HEADER_SIZE 14
-#define UART_MAX_PACKET_SIZE (UART_PACKET_HEADER_SIZE + 1024)
+// Такт медиа: задача на ядре медиа (TaskPlan.h) раз в кадр канала
+// UART выбирает очереди конференции, отправляет микс в RTP и UART, закрывает
+// собираемые кадры UART и проверяет сроки. Каждый вызов в каждую сторону должен
+// дать за такт 20 мс аудио: нехватка - кадр пропустил свой срок, и получатель
+// (AudioKit или удаленная сторона) доигрывает его маскированием потерь
+#define MEDIA_TICK_MS UART_FRAME_MS   // Равен CONF_TICK_MS: такт задает темп микшера
+#define MEDIA_BACKLOG_MAX_TICKS (PTIME_MAX_MS / MEDIA_TICK_MS + 1)  // Пакет 60 мс плюс запас такта
+#define MEDIA_IDLE_TICKS 10          // Поток молчит дольше - DTX или удержание, не пропуски
+#define MEDIA_TIMEOUT_CHECK_TICKS 5  // Проверка неактивных вызовов (100 мс)
+#define CALL_INACTIVE_TIMEOUT_MS 30000
+
+// Прием RTP: обработчик сокета в потоке tcpip проверяет пакет и только копирует
+// payload в свободную ячейку очереди. Декодирование, активация вызова, запись и
+// передача в UART (блокировки, память, Serial) - в задаче такта медиа, которая
+// между тактами ждет эту очередь. Нет ячейки - пакет отбрасывается, стек lwIP не ждет
+#define MEDIA_RX_SLOTS 16
+#define MEDIA_RX_SLOT_SIZE REFRAME_BUFFER_SIZE  // Пакет 60 мс потокового кодека
+
+typedef struct {
+    uint8_t call_id;
+    uint8_t payload_type;
+    uint16_t sequence;
+    uint32_t timestamp;
+    uint16_t len;
+    uint8_t data[MEDIA_RX_SLOT_SIZE];
+} media_rx_slot_t;
 
-// Единый clock для синхронизации timestamp
+// Clock RTP timestamp исходящего потока (по одному на вызов)
 class UnifiedClock {
 private:
     uint32_t base_timestamp;
@@ -42,10 +90,12 @@ public:
         samples_accumulated = 0;
     }
     
-    // Получить timestamp для исходящего пакета (20ms = 160 samples)
-    uint32_t getOutgoingTimestamp() {
+    // Получить timestamp для исходящего пакета и продвинуть clock.
+    // rtp_units - длительность пакета в единицах часов RTP (20ms при 8kHz = 160),
+    // для G.722 это тоже 160, хотя фрейм содержит 320 отсчетов (RFC 3551)
+    uint32_t getOutgoingTimestamp(uint32_t rtp_units = 160) {
         uint32_t current_ts = base_timestamp + samples_accumulated;
-        samples_accumulated += 160; // 20ms при 8kHz
+        samples_accumulated += rtp_units;
         return current_ts;
     }
     
@@ -67,6 +117,76 @@ public:
     }
 };
 
+// Сроки потока вызова в одну сторону. Обработанное аудио (в единицах часов RTP)
+// копится как в буфере воспроизведения, такт забирает по кадру; первый кадр
+// потока - запас на такт, поэтому джиттер до 20 мс не считается пропуском
+class MediaDeadline {
+private:
+    volatile uint32_t delivered; // Пишет поток медиа этого направления
+    uint32_t seen;
+    uint32_t backlog;
+    uint16_t idle_ticks;
+    uint16_t pending_misses;     // Пропуски текущей паузы: засчитываются, если поток вернулся
+    bool running;
+    
+public:
+    uint32_t misses;
+    
+    void init() {
+        delivered = 0;
+        misses = 0;
+        reset();
+    }
+    
+    void reset() {
+        seen = delivered;
+        backlog = 0;
+        idle_ticks = 0;
+        pending_misses = 0;
+        running = false;
+    }
+    
+    // Фрейм обработан и отправлен дальше
+    void deliver(uint32_t units) { delivered += units; }
+    
+    // Такт: возвращает число кадров, пропустивших срок
+    uint32_t tick(uint32_t tick_units) {
+        uint32_t now = delivered;
+        uint32_t got = now - seen;
+        seen = now;
+        if (!running) {
+            if (got > 0) {
+                running = true;
+                backlog = got;
+            }
+            return 0;
+        }
+        uint32_t missed = 0;
+        backlog += got;
+        if (backlog > tick_units * MEDIA_BACKLOG_MAX_TICKS) {
+            backlog = tick_units * MEDIA_BACKLOG_MAX_TICKS;
+        }
+        if (got > 0) {
+            idle_ticks = 0;
+            missed = pending_misses;
+            pending_misses = 0;
+        }
+        if (backlog >= tick_units) {
+            backlog -= tick_units;
+        } else if (got > 0) {
+            backlog = 0;
+            missed++;
+        } else if (++idle_ticks >= MEDIA_IDLE_TICKS) {
+            running = false;
+            pending_misses = 0;
+        } else {
+            pending_misses++;
+        }
+        misses += missed;
+        return missed;
+    }
+};
+
 class AudioManager {
 public:
     AudioManager();
@@ -77,8 +197,14 @@ public:
     void setCallActive(int call_id, bool active);
     bool isCallActive(int call_id) const;
     void configureCall(int call_id, uint8_t codec_type, uint16_t clock_rate = 8000);
+    // Длительность исходящего RTP пакета (из SDP a=ptime), применяется при активации вызова
+    void setCallPacketTime(int call_id, int ms);
+    int getCallPacketTime(int call_id) const;
     
     // Основные аудио методы
+    // Поток tcpip: копия payload в очередь такта медиа (false - очередь полна)
+    bool queueIncomingRTP(int call_id, const uint8_t* rtp_data, size_t data_len,
+                          uint32_t timestamp, uint16_t sequence, uint8_t payload_type);
     void processIncomingRTP(int call_id, uint8_t* rtp_data, size_t data_len, 
                            uint32_t timestamp, uint16_t sequence, uint8_t payload_type);
     
@@ -94,6 +220,36 @@ public:
     void startTasks();
     void stopTasks();
     
+    CodecManager& getCodecManager() { return codec_manager; }
+    
+    // Назначение вызова каналу AudioKit по полосе для кодека вызова (false - все каналы переполнятся).
+    // Полоса резервируется сразу: следующий INVITE до настройки RTP ее уже не получит
+    bool admitCall(int call_id, uint8_t codec_type);
+    // Снятие резерва при завершении вызова SIP
+    void releaseCall(int call_id);
+    // Байт/с в одну сторону по каналу: занято вызовами (кроме exclude_call) и доступно
+    uint32_t getLinkUsage(int link, int exclude_call = -1);
+    uint32_t getLinkBudget(int link) const;
+    int getLinkCount() const { return link_count; }
+    int getCallLink(int call_id) const;
+    // Канал с наибольшим запасом budget - load, где load - нагрузка вместе с новым вызовом
+    // (-1 - вызов не помещается ни в один канал)
+    static int pickLink(const uint32_t* load, const uint32_t* budget, int count);
+    // Проверка распределителя на заданных нагрузках (вывод в Serial)
+    static void selfCheckLinkAllocation();
+    // Расхождение часов AudioKit и удаленной стороны для вызова
+    bool getCallDriftStats(int call_id, drift_stats_t* stats) const;
+    // Кадры, пропустившие срок такта: к AudioKit (rx) и в RTP (tx)
+    bool getDeadlineMisses(int call_id, uint32_t* rx_misses, uint32_t* tx_misses) const;
+    
+    // Конференция: вызовы-участники и AudioKit микшируются, AudioKit получает
+    // один поток по UART каналу первого участника
+    bool joinConference(int call_id);
+    void leaveConference(int call_id);
+    bool isInConference(int call_id) const;
+    int getConferenceAnchor() const { return conference_anchor; }
+    ConferenceMixer& getConferenceMixer() { return conference; }
+    
 private:
     RTPManager* rtp_manager;
     ConfigManager* config_manager;
@@ -101,15 +257,38 @@ private:
     // UART
     QueueHandle_t uart_rx_queue;
     QueueHandle_t uart_tx_queue;
-    uint8_t* uart_rx_buffer;
-    uint8_t* uart_tx_buffer;
-    uint16_t uart_packet_counter;
+    
+    // Канал AudioKit: свой UART, транспорт, протокол (v1/v2) и задача приема
+    struct AudioLink {
+        AudioManager* owner;
+        int index;
+        int port;
+        int baud_rate;
+        UARTTransport* transport;
+        UARTLink link;
+        TaskHandle_t task_handle;
+    };
+    AudioLink links[AUDIO_LINKS_MAX];
+    int link_count;
+    
+    // Кодеки и буферы транскодирования (RTP->UART в задаче такта медиа, UART->RTP в задаче UART)
+    CodecManager codec_manager;
+    uint8_t* rx_transcode_buffer;
+    uint8_t* tx_transcode_buffer;
+    int16_t* rx_resample_buffer;   // 10 мс PCM частоты AudioKit
+    int16_t* tx_resample_buffer;   // PCM частоты кодека
+    uint8_t* rx_adpcm_buffer;      // Блок ADPCM для AudioKit (такт медиа)
+    int16_t* tx_adpcm_pcm;         // PCM блока ADPCM от AudioKit (задача UART)
     
     // Задачи
-    TaskHandle_t uart_task_handle;
-    TaskHandle_t audio_process_task_handle;
+    TaskHandle_t media_task_handle;
     bool tasks_running;
 
+    // Очередь приема RTP (ячейки выделяются один раз)
+    media_rx_slot_t* rx_slots;
+    QueueHandle_t rx_free;         // Номера свободных ячеек
+    QueueHandle_t rx_ready;        // Номера принятых пакетов по порядку прихода
+
     // Состояние вызовов
     struct CallState {
         bool is_active;
@@ -118,26 +297,90 @@ private:
         uint16_t last_sequence; // Последний sequence для этого вызова
         uint32_t base_timestamp; // Базовый timestamp для вызова
         bool timestamp_initialized;
+        uint8_t uart_codec;      // Формат аудио в канале UART для этого вызова
+        int link_rate;           // Частота PCM в канале UART
+        UnifiedClock clock;      // Clock исходящего RTP потока вызова
+        Resampler rx_resampler;  // Частота кодека -> частота AudioKit
+        Resampler tx_resampler;  // Частота AudioKit -> частота кодека
+        DriftCompensator drift;  // Компенсация расхождения часов
+        uint32_t last_drift_log;
+        bool in_conference;
+        int ptime;               // Длительность исходящего RTP пакета, мс
+        uint8_t* reframe_buffer; // Неполный пакет потокового кодека
+        size_t reframe_len;
+        uint32_t reframe_timestamp;
+        adpcm_state_t adpcm;     // Кодер ADPCM потока в AudioKit
+        bool adpcm_refused;      // AudioKit ответил L16 на предложение ADPCM
+        int link;                // Канал AudioKit вызова
+        bool link_reserved;      // Полоса канала занята вызовом (от admitCall до releaseCall)
+        uint8_t link_codec;      // Формат UART, под который зарезервирована полоса
+        MediaDeadline rx_deadline; // RTP -> AudioKit
+        MediaDeadline tx_deadline; // AudioKit -> RTP
     };
     CallState* call_states;
     
-    // Единые счетчики для исходящих RTP пакетов
+    // Конференция (буферы кодирования отдельные: задача конференции работает
+    // параллельно с задачей UART)
+    ConferenceMixer conference;
+    volatile int conference_anchor;      // Вызов, по каналу которого AudioKit получает микс
+    uint8_t* conf_transcode_buffer;
+    int16_t* conf_resample_buffer;
+    uint32_t conf_timestamp;
+    uint16_t conf_sequence;
+    
+    // Счетчик sequence для пакетов вне вызовов
     uint16_t global_sequence_number;
-    UnifiedClock global_clock;
 
     // Вспомогательные методы
-    bool parseUARTPacket(uint8_t* data, size_t len, audio_packet_t* packet);
+    bool openLink(int index, int port, int baud_rate, int tx_pin, int rx_pin);
+    UARTLink* getLinkFor(int call_id);
+    static void onUARTAudio(const audio_packet_t* packet, void* ctx);
     static void uartTask(void* pvParameters);
-    static void audioProcessTask(void* pvParameters);
+    static void mediaTickTask(void* pvParameters);
+    void processMediaTick(uint32_t tick);
+    // Пакеты RTP из очереди: первый ждет до timeout тиков, остальные - без ожидания
+    void drainIncomingRTP(TickType_t timeout);
+    void processConferenceTick();
+    void checkDeadlines();
+    void checkCallTimeouts();
+    void sendConferenceSettings(int call_id);
     
     void sendCallStatusToAudioKit(int call_id, bool active);
     void sendCallSettingsToAudioKit(int call_id, uint8_t codec_type, uint16_t clock_rate);
     
+    // Формат канала UART для RTP кодека
+    uint8_t getUARTCodec(uint8_t codec_type);
+    // Частота PCM в канале UART: настройка audio_sample_rate или частота кодека
+    int getLinkSampleRate(uint8_t codec_type);
+    static bool isLinearUARTCodec(uint8_t uart_codec);
+    static bool isADPCMUARTCodec(uint8_t uart_codec);
+    // Формат с PCM на стороне ESP32 (L16 или ADPCM)
+    static bool isPCMUARTCodec(uint8_t uart_codec) { return isLinearUARTCodec(uart_codec) || isADPCMUARTCodec(uart_codec); }
+    static uint8_t getLinearUARTCodec(int rate);
+    // Байт/с формата в одну сторону с заголовками кадров канала
+    uint32_t getLinkBytesPerSecond(int link, uint8_t uart_codec);
+    static int getUARTSampleRate(uint8_t uart_codec);
+    // Кодек вызова, формат канала и передискретизация
+    void applyCallCodec(int call_id, uint8_t codec_type);
+    // Пропуск (-1) или повтор (+1) самого тихого отсчета блока в формате канала UART
+    static bool spliceSample(uint8_t uart_codec, uint8_t* data, size_t* data_len, size_t capacity, int slip);
+    // Коррекция дрейфа для блока, готового к отправке в AudioKit
+    void applyDriftSlip(int call_id, uint8_t* data, size_t* data_len, size_t capacity);
+    // Кодирование PCM/G.711 канала UART в кодек вызова и отправка в RTP
+    void encodeAndSendRTP(int call_id, uint8_t* audio_data, size_t data_len, uint8_t codec_type,
+                          uint8_t* transcode_buffer, int16_t* resample_buffer);
+    // Деление потока кодека на пакеты ptime и отправка одного RTP пакета
+    static bool isStreamCodec(uint8_t codec_type);
+    void sendReframed(int call_id, const uint8_t* data, size_t data_len, uint32_t timestamp, uint8_t codec_type);
+    void sendRTPPacket(int call_id, const uint8_t* data, size_t data_len, uint32_t timestamp, uint8_t codec_type);
+    void sendAudioToUART(int call_id, uint8_t uart_codec, const uint8_t* data, size_t data_len,
+                         uint32_t timestamp, uint16_t sequence);
+    
     // Получить следующий sequence number для вызова
     uint16_t getNextSequence(int call_id);
     
     // Получить timestamp для исходящего пакета
-    uint32_t getOutgoingTimestamp(int call_id);
+    uint32_t getOutgoingTimestamp(int call_id, uint32_t rtp_units);
 
     // Джиттер буфер и синхронизация (для совместимости)
     struct JitterBuffer {
@@ -0,0 +1,629 @@
+/*
+ * CallRecorder.cpp - Запись вызовов в контейнер G.711 и экспорт в WAV
+ */
+
+#include "CallRecorder.h"
+#include "G711Codec.h"
+#include "TaskPlan.h"
+#include <LittleFS.h>
+#include <time.h>
+
+CallRecorder callRecorder;
+
+static inline void putLE32(uint8_t* p, uint32_t value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = (value >> 24) & 0xFF;
+}
+
+static inline uint32_t getLE32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint8_t encodeLaw(int16_t sample, uint8_t law) {
+    return law == REC_LAW_ALAW ? G711Codec::linearToAlaw(sample) : G711Codec::linearToUlaw(sample);
+}
+
+CallRecorder::CallRecorder() :
+    writer_task_handle(nullptr),
+    fs_ready(false),
+    file_serial(0) {
+    mux = portMUX_INITIALIZER_UNLOCKED;
+    for (int i = 0; i < REC_MAX_ACTIVE; i++) {
+        recordings[i].active = false;
+        recordings[i].buffers[0] = nullptr;
+        recordings[i].buffers[1] = nullptr;
+    }
+}
+
+bool CallRecorder::init() {
+    if (fs_ready) {
+        return true;
+    }
+    if (!LittleFS.begin(true)) {
+        Serial.println("CallRecorder: ОШИБКА монтирования LittleFS");
+        return false;
+    }
+    if (!LittleFS.exists(REC_DIR)) {
+        LittleFS.mkdir(REC_DIR);
+    }
+
+    // Номер следующего файла - после последнего существующего
+    File dir = LittleFS.open(REC_DIR);
+    if (dir) {
+        File entry = dir.openNextFile();
+        while (entry) {
+            uint32_t serial = strtoul(entry.name(), nullptr, 10);
+            if (serial >= file_serial) {
+                file_serial = serial + 1;
+            }
+            entry.close();
+            entry = dir.openNextFile();
+        }
+        dir.close();
+    }
+
+    taskPlan.create(TASK_REC_WRITER, writerTask, this, &writer_task_handle);
+    fs_ready = true;
+    Serial.printf("CallRecorder: LittleFS %u/%u КБ занято, следующий файл %lu\n",
+                  (unsigned)(LittleFS.usedBytes() / 1024), (unsigned)(LittleFS.totalBytes() / 1024),
+                  (unsigned long)file_serial);
+    return true;
+}
+
+int CallRecorder::findRecording(int call_id) const {
+    for (int i = 0; i < REC_MAX_ACTIVE; i++) {
+        if (recordings[i].active && !recordings[i].stopping && recordings[i].call_id == call_id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool CallRecorder::start(int call_id, uint8_t law) {
+    if (!fs_ready) return false;
+    if (findRecording(call_id) >= 0) return true;
+
+    int slot = -1;
+    for (int i = 0; i < REC_MAX_ACTIVE; i++) {
+        if (!recordings[i].active) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        Serial.printf("CallRecorder: нет свободного слота для Call%d\n", call_id);
+        return false;
+    }
+
+    recording_t& rec = recordings[slot];
+    rec.buffers[0] = (uint8_t*)malloc(REC_BUFFER_SIZE);
+    rec.buffers[1] = (uint8_t*)malloc(REC_BUFFER_SIZE);
+    if (!rec.buffers[0] || !rec.buffers[1]) {
+        free(rec.buffers[0]);
+        free(rec.buffers[1]);
+        rec.buffers[0] = rec.buffers[1] = nullptr;
+        Serial.println("CallRecorder: ОШИБКА выделения буферов");
+        return false;
+    }
+
+    rec.call_id = call_id;
+    rec.law = law;
+    snprintf(rec.path, sizeof(rec.path), REC_DIR "/%06lu_c%d.alr", (unsigned long)file_serial++, call_id);
+    rec.opened = false;
+    rec.stopping = false;
+    rec.fill[0] = rec.fill[1] = 0;
+    rec.write_buf = 0;
+    rec.pending[0] = rec.pending[1] = false;
+    rec.start_ms = millis();
+    rec.dir_started[0] = rec.dir_started[1] = false;
+    rec.dir_end[0] = rec.dir_end[1] = 0;
+    rec.next_index = REC_INDEX_INTERVAL;
+    rec.file_offset = REC_FILE_HEADER_SIZE;
+    rec.last_index_offset = 0;
+    rec.bytes_written = 0;
+    rec.dropped_bytes = 0;
+    rec.max_append_cycles = 0;
+
+    portENTER_CRITICAL(&mux);
+    rec.active = true;
+    portEXIT_CRITICAL(&mux);
+
+    // Файл создаст задача записи: открытие во flash не должно задерживать медиа-путь
+    if (writer_task_handle) {
+        xTaskNotifyGive(writer_task_handle);
+    }
+    Serial.printf("CallRecorder: Call%d -> %s (%s)\n", call_id, rec.path,
+                  law == REC_LAW_ALAW ? "A-law" : "μ-law");
+    return true;
+}
+
+void CallRecorder::stop(int call_id) {
+    portENTER_CRITICAL(&mux);
+    int slot = findRecording(call_id);
+    if (slot >= 0) {
+        // Под блокировкой: после этого медиа-путь не трогает буферы записи
+        recordings[slot].stopping = true;
+    }
+    portEXIT_CRITICAL(&mux);
+    if (slot < 0) return;
+    if (writer_task_handle) {
+        xTaskNotifyGive(writer_task_handle);
+    }
+}
+
+uint32_t CallRecorder::getPosition(recording_t& rec, int dir, uint32_t rtp_timestamp) {
+    if (!rec.dir_started[dir]) {
+        // Начало направления привязано ко времени от старта записи
+        rec.dir_started[dir] = true;
+        rec.dir_first_ts[dir] = rtp_timestamp;
+        rec.dir_base[dir] = (millis() - rec.start_ms) * (REC_SAMPLE_RATE / 1000);
+    }
+    int32_t delta = (int32_t)(rtp_timestamp - rec.dir_first_ts[dir]);
+    int32_t end = (int32_t)(rec.dir_end[dir] - rec.dir_base[dir]);
+    if (delta < 0 || delta > end + REC_SAMPLE_RATE * 10) {
+        // Разрыв timestamp (смена SSRC, переполнение): продолжаем с конца направления
+        rec.dir_first_ts[dir] = rtp_timestamp;
+        rec.dir_base[dir] = rec.dir_end[dir];
+        delta = 0;
+    }
+    return rec.dir_base[dir] + delta;
+}
+
+bool CallRecorder::append(recording_t& rec, uint8_t type, uint32_t position, const uint8_t* data, size_t len) {
+    bool ready = false;
+    size_t need = REC_RECORD_HEADER_SIZE + len;
+    int w = rec.write_buf;
+    if (rec.fill[w] + need > REC_BUFFER_SIZE) {
+        int other = 1 - w;
+        if (rec.pending[other]) {
+            // Flash не успевает: данные теряются, медиа-путь не ждет
+            rec.dropped_bytes += len;
+            return false;
+        }
+        rec.pending[w] = true;
+        rec.write_buf = w = other;
+        rec.fill[w] = 0;
+        ready = true;
+    }
+
+    uint8_t* p = rec.buffers[w] + rec.fill[w];
+    p[0] = type;
+    p[1] = 0;
+    p[2] = len & 0xFF;
+    p[3] = (len >> 8) & 0xFF;
+    putLE32(p + 4, position);
+    memcpy(p + REC_RECORD_HEADER_SIZE, data, len);
+    rec.fill[w] += need;
+    rec.file_offset += need;
+    return ready;
+}
+
+bool CallRecorder::appendAudio(int call_id, uint8_t dir, uint32_t rtp_timestamp, const uint8_t* data, size_t len) {
+    bool ready = false;
+    uint32_t start = ESP.getCycleCount();
+
+    portENTER_CRITICAL(&mux);
+    int slot = findRecording(call_id);
+    if (slot >= 0) {
+        recording_t& rec = recordings[slot];
+        int d = dir == REC_TYPE_RX ? 0 : 1;
+        uint32_t position = getPosition(rec, d, rtp_timestamp);
+        ready = append(rec, dir, position, data, len);
+        if (position + len > rec.dir_end[d]) {
+            rec.dir_end[d] = position + len;
+        }
+
+        if (rec.dir_end[d] >= rec.next_index) {
+            // Индекс: позиции обоих направлений и ссылка на предыдущий индекс
+            uint8_t index[12];
+            putLE32(index, rec.dir_end[0]);
+            putLE32(index + 4, rec.dir_end[1]);
+            putLE32(index + 8, rec.last_index_offset);
+            uint32_t offset = rec.file_offset;
+            ready |= append(rec, REC_TYPE_INDEX, rec.next_index, index, sizeof(index));
+            rec.last_index_offset = offset;
+            rec.next_index += REC_INDEX_INTERVAL;
+        }
+
+        uint32_t cycles = ESP.getCycleCount() - start;
+        if (cycles > rec.max_append_cycles) {
+            rec.max_append_cycles = cycles;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+
+    if (ready && writer_task_handle) {
+        xTaskNotifyGive(writer_task_handle);
+    }
+    return slot >= 0;
+}
+
+void CallRecorder::recordG711(int call_id, uint8_t dir, uint32_t rtp_timestamp, const uint8_t* data, size_t len, uint8_t law) {
+    if (!fs_ready || !data) return;
+    int slot = findRecording(call_id);
+    if (slot < 0) return;
+
+    uint8_t rec_law = recordings[slot].law;
+    uint8_t chunk[REC_MAX_CHUNK];
+    for (size_t pos = 0; pos < len; pos += REC_MAX_CHUNK) {
+        size_t n = len - pos < REC_MAX_CHUNK ? len - pos : REC_MAX_CHUNK;
+        const uint8_t* src = data + pos;
+        if (law != rec_law) {
+            // Вызов сменил закон G.711 во время записи
+            for (size_t i = 0; i < n; i++) {
+                int16_t sample = law == REC_LAW_ALAW ? G711Codec::alawToLinear(src[i]) : G711Codec::ulawToLinear(src[i]);
+                chunk[i] = encodeLaw(sample, rec_law);
+            }
+            src = chunk;
+        }
+        appendAudio(call_id, dir, rtp_timestamp + pos, src, n);
+    }
+}
+
+void CallRecorder::recordPCM(int call_id, uint8_t dir, uint32_t rtp_timestamp, const int16_t* pcm, size_t samples, int sample_rate) {
+    if (!fs_ready || !pcm) return;
+    int slot = findRecording(call_id);
+    if (slot < 0) return;
+
+    uint8_t rec_law = recordings[slot].law;
+    int decimation = sample_rate > REC_SAMPLE_RATE ? sample_rate / REC_SAMPLE_RATE : 1;
+    size_t out_samples = samples / decimation;
+    uint8_t chunk[REC_MAX_CHUNK];
+    for (size_t pos = 0; pos < out_samples; pos += REC_MAX_CHUNK) {
+        size_t n = out_samples - pos < REC_MAX_CHUNK ? out_samples - pos : REC_MAX_CHUNK;
+        for (size_t i = 0; i < n; i++) {
+            // Широкополосный вызов: усреднение соседних отсчетов до 8 кГц
+            const int16_t* src = pcm + (pos + i) * decimation;
+            int32_t sum = 0;
+            for (int j = 0; j < decimation; j++) {
+                sum += src[j];
+            }
+            chunk[i] = encodeLaw((int16_t)(sum / decimation), rec_law);
+        }
+        appendAudio(call_id, dir, rtp_timestamp + pos, chunk, n);
+    }
+}
+
+bool CallRecorder::freeSpace() {
+    // Старые записи удаляются, пока не освободится REC_MIN_FREE
+    while (LittleFS.totalBytes() - LittleFS.usedBytes() < REC_MIN_FREE) {
+        String oldest;
+        File dir = LittleFS.open(REC_DIR);
+        if (!dir) return false;
+        File entry = dir.openNextFile();
+        while (entry) {
+            String name = entry.name();
+            bool in_use = false;
+            for (int i = 0; i < REC_MAX_ACTIVE; i++) {
+                if (recordings[i].active && name.length() > 0 &&
+                    strstr(recordings[i].path, name.c_str()) != nullptr) {
+                    in_use = true;
+                }
+            }
+            if (!in_use && (oldest.length() == 0 || strcmp(name.c_str(), oldest.c_str()) < 0)) {
+                oldest = name;
+            }
+            entry.close();
+            entry = dir.openNextFile();
+        }
+        dir.close();
+        if (oldest.length() == 0) {
+            return false;
+        }
+        Serial.printf("CallRecorder: удаление старой записи %s\n", oldest.c_str());
+        LittleFS.remove(String(REC_DIR "/") + oldest);
+    }
+    return true;
+}
+
+bool CallRecorder::openFile(recording_t& rec) {
+    if (!freeSpace()) {
+        Serial.println("CallRecorder: недостаточно места во flash");
+        return false;
+    }
+    rec.file = LittleFS.open(rec.path, FILE_WRITE);
+    if (!rec.file) {
+        Serial.printf("CallRecorder: ОШИБКА создания %s\n", rec.path);
+        return false;
+    }
+
+    uint8_t header[REC_FILE_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, REC_MAGIC, 4);
+    header[4] = REC_VERSION;
+    header[5] = rec.law;
+    header[6] = (uint8_t)rec.call_id;
+    putLE32(header + 8, REC_SAMPLE_RATE);
+    putLE32(header + 12, rec.start_ms);
+    putLE32(header + 16, (uint32_t)time(nullptr));
+    // header[20..23] - число кадров, заполняется при завершении
+    rec.file.write(header, sizeof(header));
+    rec.bytes_written += sizeof(header);
+    rec.opened = true;
+    return true;
+}
+
+void CallRecorder::writeBuffers(recording_t& rec, bool flush) {
+    // Сначала заполненный буфер (более старые данные), затем текущий при завершении
+    portENTER_CRITICAL(&mux);
+    int full = 1 - rec.write_buf;
+    bool has_full = rec.pending[full];
+    portEXIT_CRITICAL(&mux);
+
+    if (has_full) {
+        rec.bytes_written += rec.file.write(rec.buffers[full], rec.fill[full]);
+        portENTER_CRITICAL(&mux);
+        rec.pending[full] = false;
+        portEXIT_CRITICAL(&mux);
+    }
+
+    if (flush) {
+        // stopping уже установлен: медиа-путь больше не пишет в буферы
+        int current = rec.write_buf;
+        rec.bytes_written += rec.file.write(rec.buffers[current], rec.fill[current]);
+        rec.fill[current] = 0;
+    }
+}
+
+void CallRecorder::finish(recording_t& rec) {
+    uint32_t frames = rec.dir_end[0] > rec.dir_end[1] ? rec.dir_end[0] : rec.dir_end[1];
+    if (rec.opened) {
+        writeBuffers(rec, true);
+        uint8_t tail[8];
+        putLE32(tail, frames);
+        putLE32(tail + 4, rec.last_index_offset);
+        rec.file.seek(20);
+        rec.file.write(tail, sizeof(tail));
+        rec.file.close();
+    }
+
+    Serial.printf("CallRecorder: Call%d записан %s, %lu с, %lu байт, потеряно %lu байт, макс. %lu тактов\n",
+                  rec.call_id, rec.path, (unsigned long)(frames / REC_SAMPLE_RATE),
+                  (unsigned long)rec.bytes_written, (unsigned long)rec.dropped_bytes,
+                  (unsigned long)rec.max_append_cycles);
+
+    portENTER_CRITICAL(&mux);
+    rec.active = false;
+    portEXIT_CRITICAL(&mux);
+    free(rec.buffers[0]);
+    free(rec.buffers[1]);
+    rec.buffers[0] = rec.buffers[1] = nullptr;
+}
+
+void CallRecorder::writerTask(void* pvParameters) {
+    CallRecorder* recorder = (CallRecorder*)pvParameters;
+
+    Serial.println("CallRecorder: Задача записи запущена");
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, 500 / portTICK_PERIOD_MS);
+
+        for (int i = 0; i < REC_MAX_ACTIVE; i++) {
+            recording_t& rec = recorder->recordings[i];
+            if (!rec.active) continue;
+
+            if (!rec.opened && !recorder->openFile(rec)) {
+                rec.stopping = true;
+                rec.opened = false;
+            }
+            if (rec.stopping) {
+                recorder->finish(rec);
+            } else {
+                recorder->writeBuffers(rec, false);
+            }
+        }
+    }
+}
+
+int CallRecorder::getActiveRecordings(recording_info_t* info, int max_count) {
+    int count = 0;
+    for (int i = 0; i < REC_MAX_ACTIVE && count < max_count; i++) {
+        const recording_t& rec = recordings[i];
+        if (!rec.active) continue;
+        info[count].call_id = rec.call_id;
+        strncpy(info[count].path, rec.path, sizeof(info[count].path));
+        info[count].seconds = (millis() - rec.start_ms) / 1000;
+        info[count].bytes_written = rec.bytes_written;
+        info[count].dropped_bytes = rec.dropped_bytes;
+        count++;
+    }
+    return count;
+}
+
+bool CallRecorder::isValidName(const String& name) {
+    if (name.length() == 0 || name.length() > 24 || !name.endsWith(".alr")) {
+        return false;
+    }
+    for (size_t i = 0; i < name.length(); i++) {
+        char c = name[i];
+        if (!isalnum(c) && c != '_' && c != '.') {
+            return false;
+        }
+    }
+    return name.indexOf("..") < 0;
+}
+
+uint32_t CallRecorder::getFrameCount(File& file) {
+    uint8_t header[REC_FILE_HEADER_SIZE];
+    file.seek(0);
+    if (file.read(header, sizeof(header)) != sizeof(header) || memcmp(header, REC_MAGIC, 4) != 0) {
+        return 0;
+    }
+    uint32_t frames = getLE32(header + 20);
+    if (frames > 0) {
+        return frames;
+    }
+
+    // Запись не была завершена (сбой питания): длительность по заголовкам записей
+    uint8_t record[REC_RECORD_HEADER_SIZE];
+    size_t offset = REC_FILE_HEADER_SIZE;
+    while (file.read(record, sizeof(record)) == sizeof(record)) {
+        uint16_t len = record[2] | (record[3] << 8);
+        uint32_t position = getLE32(record + 4);
+        if ((record[0] == REC_TYPE_RX || record[0] == REC_TYPE_TX) && position + len > frames) {
+            frames = position + len;
+        }
+        offset += sizeof(record) + len;
+        if (offset > file.size() || !file.seek(offset)) {
+            break;
+        }
+    }
+    return frames;
+}
+
+bool CallRecorder::exportWAV(File& file, void (*sink)(const uint8_t* data, size_t len, void* ctx), void* ctx) {
+    uint32_t frames = getFrameCount(file);
+    if (frames == 0) {
+        return false;
+    }
+    uint8_t header[REC_FILE_HEADER_SIZE];
+    file.seek(0);
+    file.read(header, sizeof(header));
+    uint8_t law = header[5];
+    uint8_t silence = law == REC_LAW_ALAW ? 0xD5 : 0xFF;
+
+    // WAVE_FORMAT_ALAW (6) / WAVE_FORMAT_MULAW (7), 2 канала по 8 бит
+    uint8_t wav[58];
+    uint32_t data_size = frames * 2;
+    memcpy(wav, "RIFF", 4);
+    putLE32(wav + 4, getWAVSize(frames) - 8);
+    memcpy(wav + 8, "WAVEfmt ", 8);
+    putLE32(wav + 16, 18);
+    wav[20] = law == REC_LAW_ALAW ? 6 : 7;
+    wav[21] = 0;
+    wav[22] = 2;
+    wav[23] = 0;
+    putLE32(wav + 24, REC_SAMPLE_RATE);
+    putLE32(wav + 28, REC_SAMPLE_RATE * 2);
+    wav[32] = 2;
+    wav[33] = 0;
+    wav[34] = 8;
+    wav[35] = 0;
+    wav[36] = 0;
+    wav[37] = 0;
+    memcpy(wav + 38, "fact", 4);
+    putLE32(wav + 42, 4);
+    putLE32(wav + 46, frames);
+    memcpy(wav + 50, "data", 4);
+    putLE32(wav + 54, data_size);
+    sink(wav, sizeof(wav), ctx);
+
+    // Окно кадров: записи направлений слегка перемешаны во времени, поэтому
+    // выдается только первая половина окна, вторая остается для опоздавших записей
+    uint8_t* window = (uint8_t*)malloc(REC_WAV_WINDOW * 2);
+    uint8_t* payload = (uint8_t*)malloc(REC_MAX_CHUNK * 4);
+    if (!window || !payload) {
+        free(window);
+        free(payload);
+        return false;
+    }
+    memset(window, silence, REC_WAV_WINDOW * 2);
+    uint32_t window_start = 0;
+    const uint32_t half = REC_WAV_WINDOW / 2;
+
+    uint8_t record[REC_RECORD_HEADER_SIZE];
+    file.seek(REC_FILE_HEADER_SIZE);
+    while (file.read(record, sizeof(record)) == sizeof(record)) {
+        uint16_t len = record[2] | (record[3] << 8);
+        uint32_t position = getLE32(record + 4);
+        if (len > REC_MAX_CHUNK * 4 || file.read(payload, len) != len) {
+            break;
+        }
+        if (record[0] != REC_TYPE_RX && record[0] != REC_TYPE_TX) {
+            continue;
+        }
+        int channel = record[0] == REC_TYPE_RX ? 0 : 1;
+
+        while (position + len > window_start + REC_WAV_WINDOW && window_start < frames) {
+            uint32_t out = frames - window_start < half ? frames - window_start : half;
+            sink(window, out * 2, ctx);
+            memmove(window, window + half * 2, half * 2);
+            memset(window + half * 2, silence, half * 2);
+            window_start += half;
+        }
+        for (uint16_t i = 0; i < len; i++) {
+            uint32_t frame = position + i;
+            if (frame >= window_start && frame < window_start + REC_WAV_WINDOW && frame < frames) {
+                window[(frame - window_start) * 2 + channel] = payload[i];
+            }
+        }
+    }
+
+    // Остаток окна до заявленной длины
+    while (window_start < frames) {
+        uint32_t out = frames - window_start < REC_WAV_WINDOW ? frames - window_start : REC_WAV_WINDOW;
+        sink(window, out * 2, ctx);
+        memset(window, silence, REC_WAV_WINDOW * 2);
+        window_start += out;
+    }
+
+    free(window);
+    free(payload);
+    return true;
+}
+
+void CallRecorder::benchmark(int seconds) {
+    const int bench_call = 0xFE;
+    if (!fs_ready) {
+        Serial.println("REC BENCHMARK: LittleFS не готова");
+        return;
+    }
+    if (!start(bench_call, REC_LAW_ALAW)) {
+        return;
+    }
+    int slot = findRecording(bench_call);
+    char path[32];
+    strncpy(path, recordings[slot].path, sizeof(path));
+
+    Serial.println("=== CALL RECORDER BENCHMARK ===");
+    Serial.printf("Синтетический вызов %d с (оба направления, 20 мс), CPU %d МГц\n", seconds, ESP.getCpuFreqMHz());
+
+    static int16_t pcm[160];
+    uint32_t frames = seconds * 50;
+    uint32_t retries = 0;
+    uint64_t append_cycles = 0;
+    uint32_t max_cycles = 0;
+    uint32_t start_ms = millis();
+    for (uint32_t f = 0; f < frames; f++) {
+        for (int i = 0; i < 160; i++) {
+            pcm[i] = (int16_t)(8000.0f * sinf(2.0f * PI * 440.0f * (f * 160 + i) / REC_SAMPLE_RATE));
+        }
+        for (uint8_t dir = REC_TYPE_RX; dir <= REC_TYPE_TX; dir++) {
+            // Быстрее реального времени: при занятых буферах ждем задачу записи
+            // (в реальном вызове эти данные были бы потеряны)
+            while (true) {
+                uint32_t dropped = recordings[slot].dropped_bytes;
+                uint32_t t0 = ESP.getCycleCount();
+                recordPCM(bench_call, dir, f * 160, pcm, 160, REC_SAMPLE_RATE);
+                uint32_t cycles = ESP.getCycleCount() - t0;
+                append_cycles += cycles;
+                if (cycles > max_cycles) max_cycles = cycles;
+                if (recordings[slot].dropped_bytes == dropped) break;
+                retries++;
+                vTaskDelay(1);
+            }
+        }
+    }
+    stop(bench_call);
+    while (recordings[slot].active) {
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+    uint32_t elapsed = millis() - start_ms;
+
+    File file = LittleFS.open(path);
+    size_t size = file ? file.size() : 0;
+    if (file) file.close();
+    LittleFS.remove(path);
+
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    Serial.printf("Файл %u байт за %lu мс: %.1f КБ/с (нужно %.1f КБ/с в реальном времени)\n",
+                  (unsigned)size, (unsigned long)elapsed,
+                  elapsed > 0 ? size / 1.024f / elapsed : 0.0f,
+                  2 * (160 + REC_RECORD_HEADER_SIZE) * 50 / 1024.0f);
+    Serial.printf("Медиа-путь: среднее %lu тактов, максимум %lu тактов (%.1f мкс), ожиданий буфера %lu\n",
+                  (unsigned long)(append_cycles / (frames * 2 + retries)), (unsigned long)max_cycles,
+                  mhz > 0 ? (float)max_cycles / mhz : 0.0f, (unsigned long)retries);
+    Serial.println("===============================");
+}
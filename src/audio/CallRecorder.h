@@ -0,0 +1,131 @@
+/*
+ * CallRecorder.h - Запись вызовов во flash (LittleFS)
+ *
+ * Оба направления вызова пишутся как G.711 8 кГц в компактный контейнер:
+ * заголовок файла и записи [тип, длина, позиция в отсчетах] с данными.
+ * Каждые 10 секунд добавляется индексная запись с позициями направлений.
+ * Медиа-путь только копирует данные в один из двух буферов записи
+ * (без ожидания), во flash их сбрасывает отдельная задача. Для загрузки
+ * контейнер преобразуется в стерео WAV G.711 (слева - удаленная сторона,
+ * справа - AudioKit).
+ */
+
+#ifndef CALL_RECORDER_H
+#define CALL_RECORDER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define REC_DIR "/rec"
+#define REC_MAX_ACTIVE 2                // Одновременных записей
+#define REC_BUFFER_SIZE 8192            // Размер каждого из двух буферов записи (~0.5 с)
+#define REC_SAMPLE_RATE 8000
+#define REC_INDEX_INTERVAL (REC_SAMPLE_RATE * 10)
+#define REC_MAX_CHUNK 320               // Отсчетов в одной записи
+#define REC_MIN_FREE (128 * 1024)       // Свободное место перед началом записи
+#define REC_WAV_WINDOW 8192             // Окно сборки стерео WAV (кадров, 1 с)
+
+#define REC_MAGIC "ALRC"
+#define REC_VERSION 1
+#define REC_FILE_HEADER_SIZE 32
+#define REC_RECORD_HEADER_SIZE 8
+
+// Типы записей контейнера
+#define REC_TYPE_RX 1       // RTP -> AudioKit (удаленная сторона)
+#define REC_TYPE_TX 2       // AudioKit -> RTP
+#define REC_TYPE_INDEX 3
+
+// Закон G.711 записи
+#define REC_LAW_ULAW 0
+#define REC_LAW_ALAW 1
+
+typedef struct {
+    bool active;
+    bool opened;                // Файл создается задачей записи, не медиа-путем
+    volatile bool stopping;
+    int call_id;
+    uint8_t law;
+    char path[32];
+    File file;                  // Используется только задачей записи
+
+    // Двойной буфер: медиа-путь заполняет buffers[write_buf], задача пишет другой
+    uint8_t* buffers[2];
+    size_t fill[2];
+    int write_buf;
+    volatile bool pending[2];
+
+    // Позиции направлений в отсчетах 8 кГц от начала записи
+    uint32_t start_ms;
+    bool dir_started[2];
+    uint32_t dir_first_ts[2];
+    uint32_t dir_base[2];
+    uint32_t dir_end[2];
+    uint32_t next_index;
+    uint32_t file_offset;       // Смещение следующей записи в файле
+    uint32_t last_index_offset;
+
+    // Статистика
+    uint32_t bytes_written;
+    uint32_t dropped_bytes;
+    uint32_t max_append_cycles;
+} recording_t;
+
+typedef struct {
+    int call_id;
+    char path[32];
+    uint32_t seconds;
+    uint32_t bytes_written;
+    uint32_t dropped_bytes;
+} recording_info_t;
+
+class CallRecorder {
+private:
+    recording_t recordings[REC_MAX_ACTIVE];
+    portMUX_TYPE mux;
+    TaskHandle_t writer_task_handle;
+    bool fs_ready;
+    uint32_t file_serial;       // Номер следующего файла (имена упорядочены по времени)
+
+    int findRecording(int call_id) const;
+    bool append(recording_t& rec, uint8_t type, uint32_t position, const uint8_t* data, size_t len);
+    bool appendAudio(int call_id, uint8_t dir, uint32_t rtp_timestamp, const uint8_t* data, size_t len);
+    uint32_t getPosition(recording_t& rec, int dir, uint32_t rtp_timestamp);
+    bool freeSpace();
+    bool openFile(recording_t& rec);
+    void writeBuffers(recording_t& rec, bool flush);
+    void finish(recording_t& rec);
+    static void writerTask(void* pvParameters);
+
+public:
+    CallRecorder();
+
+    bool init();
+    bool isReady() const { return fs_ready; }
+
+    bool start(int call_id, uint8_t law);
+    void stop(int call_id);
+    bool isRecording(int call_id) const { return findRecording(call_id) >= 0; }
+
+    // Медиа-путь (не блокирует): dir - REC_TYPE_RX/REC_TYPE_TX, rtp_timestamp - часы RTP 8 кГц
+    void recordG711(int call_id, uint8_t dir, uint32_t rtp_timestamp, const uint8_t* data, size_t len, uint8_t law);
+    void recordPCM(int call_id, uint8_t dir, uint32_t rtp_timestamp, const int16_t* pcm, size_t samples, int sample_rate);
+
+    int getActiveRecordings(recording_info_t* info, int max_count);
+
+    // Имя файла без пути: только файлы каталога записей
+    static bool isValidName(const String& name);
+    // Длительность записи в кадрах (по заголовку или сканированием)
+    static uint32_t getFrameCount(File& file);
+    // Стерео WAV G.711: заголовок и данные через callback по частям
+    static bool exportWAV(File& file, void (*sink)(const uint8_t* data, size_t len, void* ctx), void* ctx);
+    static size_t getWAVSize(uint32_t frames) { return 58 + frames * 2; }
+
+    // Запись синтетического вызова: пропускная способность и максимальная задержка медиа-пути
+    void benchmark(int seconds = 60);
+};
+
+extern CallRecorder callRecorder;
+
+#endif
@@ -4,52 +4,123 @@
 
 #include "CodecManager.h"
 
-CodecManager::CodecManager() : active_codec(CODEC_PCMU) {
-    // Инициализация поддерживаемых кодеков
-    supported_codecs[0] = {CODEC_PCMU, "PCMU", 8000, 160, 64000};
-    supported_codecs[1] = {CODEC_PCMA, "PCMA", 8000, 160, 64000};
-    supported_codecs[2] = {CODEC_G729, "G729", 8000, 10, 8000};
-    supported_codecs[3] = {CODEC_OPUS, "OPUS", 48000, 960, 64000};
+#define BENCH_MAX_SAMPLES 320   // 20 мс при 16 кГц
+
+CodecManager::CodecManager() :
+    active_codec(CODEC_PCMU),
+    call_codecs(nullptr),
+    packet_offsets(nullptr),
+    max_calls(0) {
+    // Таблица payload type -> индекс в реестре
+    memset(codec_index, -1, sizeof(codec_index));
+    for (int i = 0; i < CODEC_COUNT; i++) {
+        codec_index[codec_registry[i].type] = i;
+    }
 }
 
-void CodecManager::init() {
-    Serial.println("Менеджер кодеков инициализирован");
+CodecManager::~CodecManager() {
+    freeCallCodecs();
 }
 
-uint8_t CodecManager::getCodecType(const char* codec_name) {
-    for (int i = 0; i < 4; i++) {
-        if (strcmp(supported_codecs[i].name, codec_name) == 0) {
-            return supported_codecs[i].type;
+void CodecManager::freeCallCodecs() {
+    if (call_codecs) {
+        for (int i = 0; i < max_calls * CODEC_COUNT; i++) {
+            delete call_codecs[i];
         }
+        delete[] call_codecs;
+        call_codecs = nullptr;
+    }
+    if (packet_offsets) {
+        delete[] packet_offsets;
+        packet_offsets = nullptr;
     }
-    return 0xFF; // Неизвестный кодек
 }
 
-const char* CodecManager::getCodecName(uint8_t codec_type) {
-    for (int i = 0; i < 4; i++) {
-        if (supported_codecs[i].type == codec_type) {
-            return supported_codecs[i].name;
+void CodecManager::init(int max_calls) {
+    freeCallCodecs();
+    
+    this->max_calls = max_calls > 0 ? max_calls : 1;
+    call_codecs = new AudioCodec*[this->max_calls * CODEC_COUNT];
+    packet_offsets = new int32_t[this->max_calls];
+    
+    // Экземпляры создаются заранее (кодеки вроде bcg729 выделяют память из кучи),
+    // а не при ответе на вызов
+    int instances = 0;
+    for (int call = 0; call < this->max_calls; call++) {
+        packet_offsets[call] = 0;
+        for (int i = 0; i < CODEC_COUNT; i++) {
+            AudioCodec* codec = nullptr;
+            if (codec_registry[i].create) {
+                codec = codec_registry[i].create();
+                if (codec && !codec->init()) {
+                    Serial.printf("CodecManager: Ошибка инициализации %s для вызова %d\n",
+                                  codec_registry[i].name, call);
+                    delete codec;
+                    codec = nullptr;
+                }
+            }
+            call_codecs[call * CODEC_COUNT + i] = codec;
+            if (codec) instances++;
         }
     }
-    return "UNKNOWN";
+    
+    Serial.printf("Менеджер кодеков инициализирован (%d вызовов, %d экземпляров)\n",
+                  this->max_calls, instances);
+    Serial.printf("G.729: %s\n", ALINA_G729_ENABLED ? "bcg729" : "недоступен (нет bcg729)");
 }
 
-int CodecManager::getSampleRate(uint8_t codec_type) {
-    for (int i = 0; i < 4; i++) {
-        if (supported_codecs[i].type == codec_type) {
-            return supported_codecs[i].sample_rate;
+const codec_info_t* CodecManager::getCodecInfo(uint8_t codec_type) const {
+    if (codec_type >= CODEC_MAX_PAYLOAD_TYPE || codec_index[codec_type] < 0) {
+        return nullptr;
+    }
+    return &codec_registry[codec_index[codec_type]];
+}
+
+uint8_t CodecManager::getCodecType(const char* codec_name) {
+    for (int i = 0; i < CODEC_COUNT; i++) {
+        if (strcmp(codec_registry[i].name, codec_name) == 0) {
+            return codec_registry[i].type;
         }
     }
-    return 8000; // Значение по умолчанию
+    return 0xFF; // Неизвестный кодек
+}
+
+const char* CodecManager::getCodecName(uint8_t codec_type) {
+    const codec_info_t* info = getCodecInfo(codec_type);
+    return info ? info->name : "UNKNOWN";
+}
+
+int CodecManager::getSampleRate(uint8_t codec_type) {
+    const codec_info_t* info = getCodecInfo(codec_type);
+    return info ? info->sample_rate : 8000; // Значение по умолчанию
 }
 
 int CodecManager::getFrameSize(uint8_t codec_type) {
-    for (int i = 0; i < 4; i++) {
-        if (supported_codecs[i].type == codec_type) {
-            return supported_codecs[i].frame_size;
-        }
+    const codec_info_t* info = getCodecInfo(codec_type);
+    return info ? info->frame_size : 160; // Значение по умолчанию
+}
+
+int CodecManager::getRTPClockRate(uint8_t codec_type) {
+    const codec_info_t* info = getCodecInfo(codec_type);
+    return info ? info->rtp_clock_rate : 8000; // Значение по умолчанию
+}
+
+uint32_t CodecManager::getTimestampUnits(uint8_t codec_type, size_t pcm_samples) {
+    int sample_rate = getSampleRate(codec_type);
+    int clock_rate = getRTPClockRate(codec_type);
+    if (sample_rate == clock_rate) {
+        return pcm_samples;
     }
-    return 160; // Значение по умолчанию
+    return (uint32_t)((uint64_t)pcm_samples * clock_rate / sample_rate);
+}
+
+int32_t CodecManager::getTimestampOffset(uint8_t codec_type, int32_t pcm_samples) {
+    int sample_rate = getSampleRate(codec_type);
+    int clock_rate = getRTPClockRate(codec_type);
+    if (sample_rate == clock_rate) {
+        return pcm_samples;
+    }
+    return (int32_t)((int64_t)pcm_samples * clock_rate / sample_rate);
 }
 
 bool CodecManager::convertCodec(uint8_t* input, size_t input_len, uint8_t* output, size_t* output_len, 
@@ -84,50 +155,135 @@ bool CodecManager::convertCodec(uint8_t* input, size_t input_len, uint8_t* outpu
     return false;
 }
 
-bool CodecManager::encode(uint8_t* raw_data, size_t raw_len, uint8_t* encoded_data, size_t* encoded_len, uint8_t codec_type) {
-    switch (codec_type) {
-        case CODEC_PCMU:
-            // Простая копия для G.711 μ-law (уже закодировано)
-            if (raw_len <= *encoded_len) {
-                memcpy(encoded_data, raw_data, raw_len);
-                *encoded_len = raw_len;
-                return true;
-            }
-            break;
-            
-        case CODEC_PCMA:
-            // Простая копия для G.711 A-law (уже закодировано)
-            if (raw_len <= *encoded_len) {
-                memcpy(encoded_data, raw_data, raw_len);
-                *encoded_len = raw_len;
-                return true;
-            }
-            break;
-            
-        default:
-            // Для других кодеков нужно реализовать кодирование
-            break;
+AudioCodec* CodecManager::getCallCodec(int call_id, uint8_t codec_type) {
+    if (!call_codecs || call_id < 0 || call_id >= max_calls ||
+        codec_type >= CODEC_MAX_PAYLOAD_TYPE || codec_index[codec_type] < 0) {
+        return nullptr;
+    }
+    return call_codecs[call_id * CODEC_COUNT + codec_index[codec_type]];
+}
+
+bool CodecManager::encode(uint8_t* raw_data, size_t raw_len, uint8_t* encoded_data, size_t* encoded_len, uint8_t codec_type, int call_id) {
+    const codec_info_t* info = getCodecInfo(codec_type);
+    AudioCodec* codec = getCallCodec(call_id, codec_type);
+    if (!info || !codec) {
+        return false;
+    }
+    
+    // Выходной буфер должен вместить как поток отсчетов, так и собранный пакет
+    size_t samples = raw_len / 2;
+    size_t needed = (size_t)((uint64_t)samples * info->bitrate / (8 * info->sample_rate));
+    if (needed < (size_t)info->max_payload) {
+        needed = info->max_payload;
+    }
+    if (*encoded_len < needed) {
+        return false;
+    }
+    
+    *encoded_len = codec->encode((const int16_t*)raw_data, samples, encoded_data);
+    packet_offsets[call_id] = codec->getPacketOffset();
+    return true;
+}
+
+bool CodecManager::decode(uint8_t* encoded_data, size_t encoded_len, uint8_t* raw_data, size_t* raw_len, uint8_t codec_type, int call_id) {
+    const codec_info_t* info = getCodecInfo(codec_type);
+    AudioCodec* codec = getCallCodec(call_id, codec_type);
+    if (!info || !codec) {
+        return false;
+    }
+    
+    // Оценка сверху: битрейт кодека с округлением до целых фреймов (SID и т.п.)
+    size_t samples = (size_t)((uint64_t)encoded_len * 8 * info->sample_rate / info->bitrate);
+    samples = (samples + info->frame_size - 1) / info->frame_size * info->frame_size;
+    if (samples * 2 > *raw_len) {
+        return false;
+    }
+    
+    *raw_len = codec->decode(encoded_data, encoded_len, (int16_t*)raw_data) * 2;
+    return *raw_len > 0;
+}
+
+bool CodecManager::conceal(uint8_t* raw_data, size_t samples, size_t* raw_len, uint8_t codec_type, int call_id) {
+    AudioCodec* codec = getCallCodec(call_id, codec_type);
+    if (!codec || samples * 2 > *raw_len) {
+        return false;
+    }
+    
+    *raw_len = codec->plc((int16_t*)raw_data, samples) * 2;
+    return *raw_len > 0;
+}
+
+void CodecManager::prepareCall(int call_id) {
+    if (!call_codecs || call_id < 0 || call_id >= max_calls) {
+        return;
+    }
+    for (int i = 0; i < CODEC_COUNT; i++) {
+        AudioCodec* codec = call_codecs[call_id * CODEC_COUNT + i];
+        if (codec && !codec->prepare()) {
+            Serial.printf("CodecManager: Ошибка подготовки %s для вызова %d\n",
+                          codec_registry[i].name, call_id);
+        }
     }
-    return false;
 }
 
-bool CodecManager::decode(uint8_t* encoded_data, size_t encoded_len, uint8_t* raw_data, size_t* raw_len, uint8_t codec_type) {
-    switch (codec_type) {
-        case CODEC_PCMU:
-        case CODEC_PCMA:
-            // Простая копия для G.711 (данные уже в нужном формате)
-            if (encoded_len <= *raw_len) {
-                memcpy(raw_data, encoded_data, encoded_len);
-                *raw_len = encoded_len;
-                return true;
+void CodecManager::resetCallState(int call_id) {
+    if (!call_codecs || call_id < 0 || call_id >= max_calls) {
+        return;
+    }
+    for (int i = 0; i < CODEC_COUNT; i++) {
+        AudioCodec* codec = call_codecs[call_id * CODEC_COUNT + i];
+        if (codec) {
+            codec->reset();
+        }
+    }
+    packet_offsets[call_id] = 0;
+}
+
+void CodecManager::setPacketTime(int ms) {
+    if (!call_codecs) {
+        return;
+    }
+    for (int call = 0; call < max_calls; call++) {
+        for (int i = 0; i < CODEC_COUNT; i++) {
+            AudioCodec* codec = call_codecs[call * CODEC_COUNT + i];
+            if (codec) {
+                codec->setFramesPerPacket(ms / codec_registry[i].frame_ms);
             }
-            break;
-            
-        default:
-            // Для других кодеков нужно реализовать декодирование
-            break;
+        }
     }
-    return false;
+}
+
+// Сборка пакета внутри кодека (G.729); потоковые кодеки делит на пакеты AudioManager
+void CodecManager::setCallPacketTime(int call_id, int ms) {
+    if (!call_codecs || call_id < 0 || call_id >= max_calls) {
+        return;
+    }
+    for (int i = 0; i < CODEC_COUNT; i++) {
+        AudioCodec* codec = call_codecs[call_id * CODEC_COUNT + i];
+        if (codec) {
+            codec->setFramesPerPacket(ms / codec_registry[i].frame_ms);
+        }
+    }
+}
+
+void CodecManager::setCallVAD(int call_id, bool enable) {
+    if (!call_codecs || call_id < 0 || call_id >= max_calls) {
+        return;
+    }
+    // Режим VAD применяется при подготовке вызова в prepareCall()
+    for (int i = 0; i < CODEC_COUNT; i++) {
+        AudioCodec* codec = call_codecs[call_id * CODEC_COUNT + i];
+        if (codec) {
+            codec->setVAD(enable);
+        }
+    }
+}
+
+int32_t CodecManager::getPacketOffset(int call_id) {
+    if (packet_offsets && call_id >= 0 && call_id < max_calls) {
+        return packet_offsets[call_id];
+    }
+    return 0;
 }
 
 void CodecManager::setActiveCodec(uint8_t codec_type) {
@@ -141,12 +297,113 @@ uint8_t CodecManager::getActiveCodec() {
 }
 
 bool CodecManager::isCodecSupported(uint8_t codec_type) {
-    for (int i = 0; i < 4; i++) {
-        if (supported_codecs[i].type == codec_type) {
-            return true;
+    return getCodecInfo(codec_type) != nullptr;
+}
+
+bool CodecManager::isCodecAvailable(uint8_t codec_type) {
+    const codec_info_t* info = getCodecInfo(codec_type);
+    return info && info->create;
+}
+
+// Эталонный сигнал 16 кГц: три тона с огибающей слогов и слабый шум.
+// n - номер отсчета от начала замера, чтобы все кодеки получали одинаковый сигнал.
+static void benchmarkReference(int16_t* pcm, int samples, uint32_t n, uint32_t* noise) {
+    for (int i = 0; i < samples; i++, n++) {
+        float t = (float)n / 16000.0f;
+        float envelope = 0.55f + 0.45f * sinf(2.0f * PI * 3.0f * t);
+        float voice = 5000.0f * sinf(2.0f * PI * 220.0f * t) +
+                      3000.0f * sinf(2.0f * PI * 1250.0f * t) +
+                      1500.0f * sinf(2.0f * PI * 5300.0f * t);
+        *noise = *noise * 1103515245u + 12345u;
+        int16_t hiss = (int16_t)((*noise >> 16) & 0x1FF) - 256;
+        pcm[i] = (int16_t)(envelope * voice) + hiss;
+    }
+}
+
+int CodecManager::benchmarkCodec(uint8_t codec_type, int frames) {
+    static int16_t reference[BENCH_MAX_SAMPLES];
+    static int16_t pcm[BENCH_MAX_SAMPLES];
+    static int16_t decoded[BENCH_MAX_SAMPLES + G729_FRAME_SAMPLES];
+    
+    const codec_info_t* info = getCodecInfo(codec_type);
+    if (!info || !info->create) {
+        Serial.printf("CODEC BENCHMARK: кодек %d не реализован\n", codec_type);
+        return 0;
+    }
+    int samples = info->sample_rate / 50;  // 20 мс
+    int decimation = 16000 / info->sample_rate;
+    if (samples > BENCH_MAX_SAMPLES || decimation < 1) {
+        Serial.printf("CODEC BENCHMARK: %s - частота %d не поддерживается\n", info->name, info->sample_rate);
+        return 0;
+    }
+    
+    AudioCodec* codec = info->create();
+    uint8_t* encoded = new uint8_t[info->max_payload];
+    // Кодируется каждый фрейм: без VAD, один пакет на 20 мс
+    codec->setVAD(false);
+    if (!codec->init()) {
+        Serial.printf("CODEC BENCHMARK: %s - ошибка инициализации\n", info->name);
+        delete[] encoded;
+        delete codec;
+        return 0;
+    }
+    codec->setFramesPerPacket(20 / info->frame_ms);
+    
+    uint32_t noise = 1;
+    uint64_t encode_cycles = 0;
+    uint64_t decode_cycles = 0;
+    uint32_t payload_bytes = 0;
+    for (int f = 0; f < frames; f++) {
+        benchmarkReference(reference, samples * decimation, (uint32_t)f * samples * decimation, &noise);
+        for (int i = 0; i < samples; i++) {
+            int32_t sum = 0;
+            for (int j = 0; j < decimation; j++) {
+                sum += reference[i * decimation + j];
+            }
+            pcm[i] = (int16_t)(sum / decimation);
+        }
+        
+        uint32_t start = ESP.getCycleCount();
+        int len = codec->encode(pcm, samples, encoded);
+        encode_cycles += ESP.getCycleCount() - start;
+        payload_bytes += len;
+        
+        start = ESP.getCycleCount();
+        if (len > 0) {
+            codec->decode(encoded, len, decoded);
         }
+        decode_cycles += ESP.getCycleCount() - start;
     }
-    return false;
+    
+    delete[] encoded;
+    delete codec;
+    
+    uint32_t enc = (uint32_t)(encode_cycles / frames);
+    uint32_t dec = (uint32_t)(decode_cycles / frames);
+    // Бюджет на 20 мс при текущей частоте CPU, запас 30% на остальную систему
+    uint32_t budget = ESP.getCpuFreqMHz() * 20000;
+    int channels = (enc + dec) > 0 ? (int)((uint64_t)budget * 7 / 10 / (enc + dec)) : 0;
+    
+    Serial.printf("%-5s %5d Гц | кодер %7u | декодер %7u | %5.2f%% ядра | %4u байт | каналов %d\n",
+                  info->name, info->sample_rate, enc, dec,
+                  budget > 0 ? 100.0f * (enc + dec) / budget : 0.0f,
+                  payload_bytes / frames, channels);
+    
+    return channels;
+}
+
+void CodecManager::benchmarkCodecs(int frames) {
+    Serial.println("=== CODEC BENCHMARK ===");
+    Serial.printf("Фреймов: %d по 20 мс, CPU %d МГц, такты на фрейм 20 мс\n", frames, ESP.getCpuFreqMHz());
+    for (int i = 0; i < CODEC_COUNT; i++) {
+        if (codec_registry[i].create) {
+            benchmarkCodec(codec_registry[i].type, frames);
+        } else {
+            Serial.printf("%-5s не реализован\n", codec_registry[i].name);
+        }
+    }
+    Serial.println("Каналы указаны на одно ядро с запасом 30%");
+    Serial.println("=======================");
 }
 
 // Вспомогательные функции конвертации
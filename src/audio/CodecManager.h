@@ -6,49 +6,81 @@
 #define CODEC_MANAGER_H
 
 #include <Arduino.h>
-
-#define CODEC_PCMU 0    // μ-law
-#define CODEC_PCMA 8    // A-law
-#define CODEC_G729 18   // G.729
-#define CODEC_OPUS 111  // Opus
-
-typedef struct {
-    uint8_t type;       // Тип кодека
-    const char* name;   // Имя кодека
-    int sample_rate;    // Частота дискретизации
-    int frame_size;     // Размер фрейма
-    int bitrate;        // Битрейт
-} codec_info_t;
+#include "CodecRegistry.h"
 
 class CodecManager {
 private:
-    codec_info_t supported_codecs[4];
     uint8_t active_codec;
-    
+
+    // Индекс в codec_registry по payload type (-1 - неизвестный кодек)
+    int8_t codec_index[CODEC_MAX_PAYLOAD_TYPE];
+
+    // Пул экземпляров кодеков: [call_id * CODEC_COUNT + индекс в реестре]
+    AudioCodec** call_codecs;
+    int32_t* packet_offsets;   // Смещение начала последнего пакета в отсчетах
+    int max_calls;
+
+    void freeCallCodecs();
+
 public:
     CodecManager();
-    
-    void init();
+    ~CodecManager();
+
+    void init(int max_calls = 1);
+    const codec_info_t* getCodecInfo(uint8_t codec_type) const;
     uint8_t getCodecType(const char* codec_name);
     const char* getCodecName(uint8_t codec_type);
     int getSampleRate(uint8_t codec_type);
     int getFrameSize(uint8_t codec_type);
-    
+    int getRTPClockRate(uint8_t codec_type);
+
+    // Приращение RTP timestamp для заданного числа отсчетов PCM
+    uint32_t getTimestampUnits(uint8_t codec_type, size_t pcm_samples);
+    // То же для смещения со знаком (начало пакета до или после начала фрейма)
+    int32_t getTimestampOffset(uint8_t codec_type, int32_t pcm_samples);
+
     // Конвертация между кодеками
-    bool convertCodec(uint8_t* input, size_t input_len, uint8_t* output, size_t* output_len, 
+    bool convertCodec(uint8_t* input, size_t input_len, uint8_t* output, size_t* output_len,
                      uint8_t input_type, uint8_t output_type);
-    
-    // Кодирование/декодирование
-    bool encode(uint8_t* raw_data, size_t raw_len, uint8_t* encoded_data, size_t* encoded_len, uint8_t codec_type);
-    bool decode(uint8_t* encoded_data, size_t encoded_len, uint8_t* raw_data, size_t* raw_len, uint8_t codec_type);
+
+    // Экземпляр кодека вызова из пула (nullptr - кодек не реализован)
+    AudioCodec* getCallCodec(int call_id, uint8_t codec_type);
+
+    // Кодирование/декодирование: raw_data - PCM 16 бит (little-endian) на частоте кодека.
+    // call_id выбирает экземпляр кодека с состоянием. *encoded_len может быть 0,
+    // если кодек еще собирает пакет.
+    bool encode(uint8_t* raw_data, size_t raw_len, uint8_t* encoded_data, size_t* encoded_len, uint8_t codec_type, int call_id = 0);
+    bool decode(uint8_t* encoded_data, size_t encoded_len, uint8_t* raw_data, size_t* raw_len, uint8_t codec_type, int call_id = 0);
+    // Маскирование потерянного пакета длительностью samples отсчетов
+    bool conceal(uint8_t* raw_data, size_t samples, size_t* raw_len, uint8_t codec_type, int call_id = 0);
+    // Подготовка экземпляров вызова при его установке (SIP, вне потока медиа)
+    void prepareCall(int call_id);
+    void resetCallState(int call_id);
+
+    // Длительность RTP пакета и режим VAD для кодеков, которые их поддерживают
+    void setPacketTime(int ms);
+    void setCallPacketTime(int call_id, int ms);
+    void setCallVAD(int call_id, bool enable);
+    int32_t getPacketOffset(int call_id);
+
     uint8_t ulaw_to_alaw(uint8_t ulaw);
     uint8_t alaw_to_ulaw(uint8_t alaw);
     // Установка активного кодека
     void setActiveCodec(uint8_t codec_type);
     uint8_t getActiveCodec();
-    
+
     // Проверка поддержки кодека
     bool isCodecSupported(uint8_t codec_type);
+    // Кодек реализован и может быть согласован в SDP
+    bool isCodecAvailable(uint8_t codec_type);
+
+    // Замер кодека на общем эталонном сигнале (такты CPU на 20 мс),
+    // возвращает число каналов на ядро с запасом 30%
+    int benchmarkCodec(uint8_t codec_type, int frames = 250);
+    // Замер всех реализованных кодеков реестра
+    void benchmarkCodecs(int frames = 250);
+    int benchmarkG722(int frames = 500) { return benchmarkCodec(CODEC_G722, frames); }
+    int benchmarkG729(int frames = 500) { return benchmarkCodec(CODEC_G729, frames); }
 };
 
-#endif
\ No newline at end of file
+#endif
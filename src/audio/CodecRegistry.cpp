@@ -0,0 +1,21 @@
+/*
+ * CodecRegistry.cpp - Фабрики экземпляров кодеков из реестра
+ */
+
+#include "CodecRegistry.h"
+
+AudioCodec* createPCMUCodec() {
+    return new G711Codec(false);
+}
+
+AudioCodec* createPCMACodec() {
+    return new G711Codec(true);
+}
+
+AudioCodec* createG722Codec() {
+    return new G722Codec();
+}
+
+AudioCodec* createG729Codec() {
+    return new G729Codec();
+}
@@ -0,0 +1,75 @@
+/*
+ * CodecRegistry.h - Реестр аудио кодеков (на этапе компиляции)
+ *
+ * Новый кодек добавляется одной строкой в codec_registry: параметры и
+ * фабрика экземпляров AudioCodec. Кодек без фабрики объявлен, но не
+ * реализован и не предлагается в SDP.
+ */
+
+#ifndef CODEC_REGISTRY_H
+#define CODEC_REGISTRY_H
+
+#include "AudioCodec.h"
+#include "G711Codec.h"
+#include "G722Codec.h"
+#include "G729Codec.h"
+
+#define CODEC_PCMU 0    // μ-law
+#define CODEC_PCMA 8    // A-law
+#define CODEC_G722 9    // G.722
+#define CODEC_G729 18   // G.729
+#define CODEC_OPUS 111  // Opus
+
+#define CODEC_MAX_PAYLOAD_TYPE 128
+
+typedef AudioCodec* (*codec_factory_t)();
+
+typedef struct {
+    uint8_t type;       // Тип кодека (RTP payload type)
+    const char* name;   // Имя кодека
+    int sample_rate;    // Частота дискретизации
+    int frame_size;     // Размер фрейма
+    int bitrate;        // Битрейт
+    int rtp_clock_rate; // Частота часов RTP (для G.722 отличается от sample_rate)
+    int frame_ms;       // Длительность фрейма кодека
+    int max_payload;    // Максимальный RTP payload (байт)
+    codec_factory_t create; // Фабрика экземпляра, nullptr - не реализован
+} codec_info_t;
+
+AudioCodec* createPCMUCodec();
+AudioCodec* createPCMACodec();
+AudioCodec* createG722Codec();
+AudioCodec* createG729Codec();
+
+// Максимальный payload G.711/G.722 - 60 мс
+static constexpr codec_info_t codec_registry[] = {
+    {CODEC_PCMU, "PCMU", 8000, 160, 64000, 8000, 20, 480, createPCMUCodec},
+    {CODEC_PCMA, "PCMA", 8000, 160, 64000, 8000, 20, 480, createPCMACodec},
+    // RFC 3551: G.722 дискретизируется на 16 кГц, но часы RTP идут на 8000 Гц
+    {CODEC_G722, "G722", G722_SAMPLE_RATE, G722_FRAME_SAMPLES, 64000, G722_RTP_CLOCK_RATE, 20, 480, createG722Codec},
+    {CODEC_G729, "G729", G729_SAMPLE_RATE, G729_FRAME_SAMPLES, 8000, 8000, 10, G729_MAX_PACKET_BYTES,
+        ALINA_G729_ENABLED ? createG729Codec : nullptr},
+    {CODEC_OPUS, "OPUS", 48000, 960, 64000, 48000, 20, 1275, nullptr},
+};
+
+#define CODEC_COUNT ((int)(sizeof(codec_registry) / sizeof(codec_registry[0])))
+
+// Индекс кодека в реестре по payload type, -1 - нет такого кодека
+constexpr int codecRegistryIndex(uint8_t type, int i = 0) {
+    return i >= CODEC_COUNT ? -1 :
+           (codec_registry[i].type == type ? i : codecRegistryIndex(type, i + 1));
+}
+
+// Payload type не должны повторяться (иначе поиск найдет только первый)
+constexpr bool codecRegistryUnique(int i = 0) {
+    return i >= CODEC_COUNT ? true :
+           (codecRegistryIndex(codec_registry[i].type) == i &&
+            codec_registry[i].type < CODEC_MAX_PAYLOAD_TYPE &&
+            codecRegistryUnique(i + 1));
+}
+
+static_assert(codecRegistryUnique(), "codec_registry: повтор или неверный payload type");
+static_assert(codecRegistryIndex(CODEC_PCMU) >= 0 && codecRegistryIndex(CODEC_PCMA) >= 0,
+              "codec_registry: G.711 обязателен");
+
+#endif
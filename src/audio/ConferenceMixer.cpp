@@ -0,0 +1,344 @@
+/*
+ * ConferenceMixer.cpp - Реализация микшера конференции
+ */
+
+#include "ConferenceMixer.h"
+
+static inline int16_t saturate16(int32_t value) {
+    if (value > 32767) return 32767;
+    if (value < -32768) return -32768;
+    return (int16_t)value;
+}
+
+ConferenceMixer::ConferenceMixer() :
+    participants(nullptr),
+    max_participants(0),
+    sum(nullptr),
+    mutex(nullptr),
+    ticks(0),
+    last_tick_cycles(0) {
+}
+
+ConferenceMixer::~ConferenceMixer() {
+    delete[] participants;
+    delete[] sum;
+    if (mutex) {
+        vSemaphoreDelete(mutex);
+    }
+}
+
+bool ConferenceMixer::init(int max_count) {
+    if (participants) {
+        return true;
+    }
+    max_participants = max_count < CONF_MAX_PARTICIPANTS ? max_count : CONF_MAX_PARTICIPANTS;
+    if (max_participants < 2) {
+        max_participants = 2;
+    }
+
+    participants = new conf_participant_t[max_participants];
+    sum = new int32_t[CONF_FRAME_SAMPLES];
+    mutex = xSemaphoreCreateMutex();
+    if (!participants || !sum || !mutex) {
+        Serial.println("ConferenceMixer: ОШИБКА выделения памяти");
+        return false;
+    }
+    for (int i = 0; i < max_participants; i++) {
+        participants[i].active = false;
+    }
+
+    Serial.printf("ConferenceMixer: до %d участников, %d Гц, %d говорящих\n",
+                  max_participants, CONF_SAMPLE_RATE, CONF_MAX_SPEAKERS);
+    return true;
+}
+
+int ConferenceMixer::findParticipant(int id) const {
+    for (int i = 0; i < max_participants; i++) {
+        if (participants[i].active && participants[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int ConferenceMixer::getParticipantCount() const {
+    int count = 0;
+    for (int i = 0; i < max_participants; i++) {
+        if (participants[i].active) count++;
+    }
+    return count;
+}
+
+bool ConferenceMixer::addParticipant(int id) {
+    if (!participants) return false;
+    if (findParticipant(id) >= 0) return true;
+
+    if (xSemaphoreTake(mutex, 10 / portTICK_PERIOD_MS) != pdTRUE) {
+        return false;
+    }
+    int slot = -1;
+    for (int i = 0; i < max_participants; i++) {
+        if (!participants[i].active) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot >= 0) {
+        conf_participant_t& p = participants[slot];
+        p.id = id;
+        p.fifo_read = 0;
+        p.fifo_count = 0;
+        p.primed = false;
+        p.has_frame = false;
+        p.speaking = false;
+        p.level = 0;
+        p.underruns = 0;
+        p.overruns = 0;
+        memset(p.mix, 0, sizeof(p.mix));
+        p.active = true;
+    }
+    xSemaphoreGive(mutex);
+
+    if (slot < 0) {
+        Serial.printf("ConferenceMixer: нет места для участника %d\n", id);
+        return false;
+    }
+    Serial.printf("ConferenceMixer: участник %d добавлен\n", id);
+    return true;
+}
+
+void ConferenceMixer::removeParticipant(int id) {
+    if (!participants) return;
+    if (xSemaphoreTake(mutex, 10 / portTICK_PERIOD_MS) == pdTRUE) {
+        int slot = findParticipant(id);
+        if (slot >= 0) {
+            participants[slot].active = false;
+            Serial.printf("ConferenceMixer: участник %d удален\n", id);
+        }
+        xSemaphoreGive(mutex);
+    }
+}
+
+void ConferenceMixer::pushAudio(int id, const int16_t* pcm, int samples) {
+    if (!participants || !pcm || samples <= 0) return;
+    if (xSemaphoreTake(mutex, 10 / portTICK_PERIOD_MS) != pdTRUE) {
+        return;
+    }
+
+    int slot = findParticipant(id);
+    if (slot >= 0) {
+        conf_participant_t& p = participants[slot];
+        const int capacity = CONF_FIFO_FRAMES * CONF_FRAME_SAMPLES;
+        if (p.fifo_count + samples > capacity) {
+            // Участник опережает такт микшера: отбрасываем самые старые отсчеты
+            int excess = p.fifo_count + samples - capacity;
+            if (excess > p.fifo_count) excess = p.fifo_count;
+            p.fifo_read = (p.fifo_read + excess) % capacity;
+            p.fifo_count -= excess;
+            p.overruns++;
+        }
+        if (samples > capacity) {
+            pcm += samples - capacity;
+            samples = capacity;
+        }
+        int write = (p.fifo_read + p.fifo_count) % capacity;
+        for (int i = 0; i < samples; i++) {
+            p.fifo[write] = pcm[i];
+            if (++write == capacity) write = 0;
+        }
+        p.fifo_count += samples;
+        if (p.fifo_count >= capacity / 2) {
+            p.primed = true;
+        }
+    }
+
+    xSemaphoreGive(mutex);
+}
+
+void ConferenceMixer::pullFrame(conf_participant_t& p) {
+    const int capacity = CONF_FIFO_FRAMES * CONF_FRAME_SAMPLES;
+
+    // После опустошения ждем половину очереди, чтобы не дробить речь
+    if (!p.primed || p.fifo_count < CONF_FRAME_SAMPLES) {
+        if (p.primed) {
+            p.underruns++;
+            p.primed = false;
+        }
+        p.has_frame = false;
+        p.level = p.level * 3 / 4;
+        return;
+    }
+
+    uint32_t amplitude = 0;
+    int read = p.fifo_read;
+    for (int i = 0; i < CONF_FRAME_SAMPLES; i++) {
+        int16_t sample = p.fifo[read];
+        p.frame[i] = sample;
+        amplitude += sample < 0 ? -sample : sample;
+        if (++read == capacity) read = 0;
+    }
+    p.fifo_read = read;
+    p.fifo_count -= CONF_FRAME_SAMPLES;
+    p.has_frame = true;
+
+    // Сглаживание уровня: быстрая атака, медленный спад
+    uint32_t frame_level = amplitude / CONF_FRAME_SAMPLES;
+    if (frame_level > p.level) {
+        p.level = (p.level + frame_level) / 2;
+    } else {
+        p.level = (p.level * 7 + frame_level) / 8;
+    }
+}
+
+void ConferenceMixer::selectSpeakers(int* speakers, int* speaker_count) {
+    uint32_t scores[CONF_MAX_SPEAKERS];
+    int count = 0;
+    for (int i = 0; i < max_participants; i++) {
+        conf_participant_t& p = participants[i];
+        if (!p.active || !p.has_frame || p.level < CONF_SPEECH_LEVEL) {
+            continue;
+        }
+
+        // Текущие говорящие получают запас 25%, чтобы выбор не переключался на каждом такте
+        uint32_t score = p.speaking ? p.level + p.level / 4 : p.level;
+        int pos = count;
+        while (pos > 0 && scores[pos - 1] < score) {
+            pos--;
+        }
+        if (pos >= CONF_MAX_SPEAKERS) {
+            continue;
+        }
+        if (count < CONF_MAX_SPEAKERS) {
+            count++;
+        }
+        // Самый тихий из выбранных вытесняется
+        for (int j = count - 1; j > pos; j--) {
+            speakers[j] = speakers[j - 1];
+            scores[j] = scores[j - 1];
+        }
+        speakers[pos] = i;
+        scores[pos] = score;
+    }
+
+    for (int i = 0; i < max_participants; i++) {
+        participants[i].speaking = false;
+    }
+    for (int i = 0; i < count; i++) {
+        participants[speakers[i]].speaking = true;
+    }
+    *speaker_count = count;
+}
+
+void ConferenceMixer::mix() {
+    if (!participants) return;
+    if (xSemaphoreTake(mutex, 10 / portTICK_PERIOD_MS) != pdTRUE) {
+        return;
+    }
+    uint32_t start = ESP.getCycleCount();
+
+    for (int i = 0; i < max_participants; i++) {
+        if (participants[i].active) {
+            pullFrame(participants[i]);
+        }
+    }
+
+    int speakers[CONF_MAX_SPEAKERS];
+    int speaker_count = 0;
+    selectSpeakers(speakers, &speaker_count);
+
+    // Сумма говорящих (32 бит, без переполнения до насыщения)
+    memset(sum, 0, CONF_FRAME_SAMPLES * sizeof(int32_t));
+    for (int s = 0; s < speaker_count; s++) {
+        const int16_t* frame = participants[speakers[s]].frame;
+        for (int i = 0; i < CONF_FRAME_SAMPLES; i++) {
+            sum[i] += frame[i];
+        }
+    }
+
+    // Каждому участнику - сумма без собственного голоса
+    for (int i = 0; i < max_participants; i++) {
+        conf_participant_t& p = participants[i];
+        if (!p.active) continue;
+        if (p.speaking) {
+            for (int j = 0; j < CONF_FRAME_SAMPLES; j++) {
+                p.mix[j] = saturate16(sum[j] - p.frame[j]);
+            }
+        } else {
+            for (int j = 0; j < CONF_FRAME_SAMPLES; j++) {
+                p.mix[j] = saturate16(sum[j]);
+            }
+        }
+    }
+
+    last_tick_cycles = ESP.getCycleCount() - start;
+    ticks++;
+    xSemaphoreGive(mutex);
+}
+
+const int16_t* ConferenceMixer::getMix(int id) const {
+    if (!participants) return nullptr;
+    int slot = findParticipant(id);
+    return slot >= 0 ? participants[slot].mix : nullptr;
+}
+
+int ConferenceMixer::getParticipants(conf_participant_info_t* info, int max_count) {
+    if (!participants || !info) return 0;
+    int count = 0;
+    if (xSemaphoreTake(mutex, 10 / portTICK_PERIOD_MS) == pdTRUE) {
+        for (int i = 0; i < max_participants && count < max_count; i++) {
+            const conf_participant_t& p = participants[i];
+            if (!p.active) continue;
+            info[count].id = p.id;
+            info[count].level = p.level;
+            info[count].speaking = p.speaking;
+            info[count].underruns = p.underruns;
+            info[count].overruns = p.overruns;
+            count++;
+        }
+        xSemaphoreGive(mutex);
+    }
+    return count;
+}
+
+void ConferenceMixer::benchmark(int ticks) {
+    static int16_t frame[CONF_FRAME_SAMPLES];
+    ConferenceMixer mixer;
+    if (!mixer.init(CONF_MAX_PARTICIPANTS)) {
+        return;
+    }
+
+    Serial.println("=== CONFERENCE MIXER BENCHMARK ===");
+    Serial.printf("Такт %d мс, %d Гц, %d тактов, CPU %d МГц\n",
+                  CONF_TICK_MS, CONF_SAMPLE_RATE, ticks, ESP.getCpuFreqMHz());
+    uint32_t budget = ESP.getCpuFreqMHz() * 1000 * CONF_TICK_MS;
+
+    for (int n = 2; n <= CONF_MAX_PARTICIPANTS; n++) {
+        for (int i = 0; i < n; i++) {
+            mixer.addParticipant(i);
+        }
+
+        // Все участники говорят: худший случай выбора говорящих и насыщения
+        uint64_t cycles = 0;
+        for (int t = 0; t < ticks; t++) {
+            for (int i = 0; i < n; i++) {
+                float freq = 300.0f + 150.0f * i;
+                for (int j = 0; j < CONF_FRAME_SAMPLES; j++) {
+                    int k = t * CONF_FRAME_SAMPLES + j;
+                    frame[j] = (int16_t)(12000.0f * sinf(2.0f * PI * freq * k / CONF_SAMPLE_RATE));
+                }
+                mixer.pushAudio(i, frame, CONF_FRAME_SAMPLES);
+            }
+            mixer.mix();
+            cycles += mixer.getTickCycles();
+        }
+
+        uint32_t per_tick = (uint32_t)(cycles / ticks);
+        Serial.printf("%d участников: %7u тактов/такт (%.3f%% ядра)\n",
+                      n, per_tick, budget > 0 ? 100.0f * per_tick / budget : 0.0f);
+
+        for (int i = 0; i < n; i++) {
+            mixer.removeParticipant(i);
+        }
+    }
+    Serial.println("==================================");
+}
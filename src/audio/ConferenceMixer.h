@@ -0,0 +1,92 @@
+/*
+ * ConferenceMixer.h - Микшер конференции на N участников
+ *
+ * Участники - удаленные вызовы и локальный AudioKit. Каждый участник
+ * складывает декодированный PCM частоты микшера в свою очередь, задача
+ * конференции раз в 20 мс забирает по фрейму от каждого, выбирает
+ * до CONF_MAX_SPEAKERS самых громких и формирует для каждого участника
+ * сумму говорящих без его собственного голоса (с насыщением).
+ */
+
+#ifndef CONFERENCE_MIXER_H
+#define CONFERENCE_MIXER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#define CONF_SAMPLE_RATE 16000      // Частота микшера (широкополосные участники без потерь)
+#define CONF_TICK_MS 20
+#define CONF_FRAME_SAMPLES (CONF_SAMPLE_RATE / 1000 * CONF_TICK_MS)
+#define CONF_MAX_PARTICIPANTS 8
+#define CONF_MAX_SPEAKERS 3         // Ограничение стоимости микширования
+#define CONF_FIFO_FRAMES 4          // Очередь участника (80 мс)
+#define CONF_SPEECH_LEVEL 80        // Порог средней амплитуды речи
+#define CONF_LOCAL_ID -1            // Идентификатор участника AudioKit
+
+typedef struct {
+    bool active;
+    int id;                     // call_id или CONF_LOCAL_ID
+    int16_t fifo[CONF_FIFO_FRAMES * CONF_FRAME_SAMPLES];
+    int fifo_read;
+    int fifo_count;
+    bool primed;                // Очередь заполнена до половины после опустошения
+    int16_t frame[CONF_FRAME_SAMPLES];   // Фрейм текущего такта
+    int16_t mix[CONF_FRAME_SAMPLES];     // Микс для участника
+    bool has_frame;
+    bool speaking;
+    uint32_t level;             // Сглаженная средняя амплитуда
+    uint32_t underruns;
+    uint32_t overruns;
+} conf_participant_t;
+
+typedef struct {
+    int id;
+    uint32_t level;
+    bool speaking;
+    uint32_t underruns;
+    uint32_t overruns;
+} conf_participant_info_t;
+
+class ConferenceMixer {
+private:
+    conf_participant_t* participants;
+    int max_participants;
+    int32_t* sum;               // Сумма говорящих за такт
+    SemaphoreHandle_t mutex;
+    uint32_t ticks;
+    uint32_t last_tick_cycles;
+
+    int findParticipant(int id) const;
+    void pullFrame(conf_participant_t& p);
+    void selectSpeakers(int* speakers, int* speaker_count);
+
+public:
+    ConferenceMixer();
+    ~ConferenceMixer();
+
+    // Выделение памяти под max_count участников (не больше CONF_MAX_PARTICIPANTS)
+    bool init(int max_count);
+
+    bool addParticipant(int id);
+    void removeParticipant(int id);
+    bool hasParticipant(int id) const { return findParticipant(id) >= 0; }
+    int getParticipantCount() const;
+
+    // PCM 16 бит на частоте CONF_SAMPLE_RATE, любое число отсчетов
+    void pushAudio(int id, const int16_t* pcm, int samples);
+
+    // Один такт: забрать фреймы, выбрать говорящих, сформировать миксы
+    void mix();
+    // Микс участника текущего такта (CONF_FRAME_SAMPLES отсчетов), nullptr - нет участника
+    const int16_t* getMix(int id) const;
+
+    int getParticipants(conf_participant_info_t* info, int max_count);
+    uint32_t getTickCycles() const { return last_tick_cycles; }
+
+    // Замер тактов CPU на такт в зависимости от числа участников (на устройстве:
+    // такты ESP.getCycleCount и доля ядра на текущей частоте CPU)
+    static void benchmark(int ticks = 250);
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * DriftCompensator.cpp - Оценка дрейфа часов и политика пропуска/вставки отсчетов
+ */
+
+#include "DriftCompensator.h"
+
+DriftCompensator::DriftCompensator() {
+    reset(8000, 8000);
+}
+
+void DriftCompensator::reset(int rtp_clock_rate, int link_sample_rate) {
+    clock_rate = rtp_clock_rate > 0 ? rtp_clock_rate : 8000;
+    link_rate = link_sample_rate > 0 ? link_sample_rate : clock_rate;
+    rx_started = false;
+    rx_last_end = 0;
+    rx_progress = 0;
+    tx_progress = 0;
+    start_ms = 0;
+    interval_start_ms = 0;
+    interval_tx_start = 0;
+    interval_max_fill = INT32_MIN;
+    interval_has_rx = false;
+    restartRegression();
+    locked = false;
+    ppm = 0.0f;
+    correction_ppm = 0.0f;
+    slip_acc = 0.0f;
+    dropped = 0;
+    inserted = 0;
+}
+
+void DriftCompensator::restartRegression() {
+    s0 = st = sy = stt = sty = 0.0;
+    points = 0;
+    ref_set = false;
+}
+
+// Итог коррекции в единицах RTP (пропуск уменьшает заполнение, вставка увеличивает)
+int32_t DriftCompensator::slipUnits() const {
+    return (int32_t)(((int64_t)inserted - (int64_t)dropped) * clock_rate / link_rate);
+}
+
+void DriftCompensator::onIncoming(uint32_t rtp_timestamp, uint32_t rtp_units, uint32_t now_ms) {
+    uint32_t end = rtp_timestamp + rtp_units;
+    if (!rx_started) {
+        rx_started = true;
+        rx_last_end = end;
+        rx_progress = tx_progress;  // Начальное заполнение считаем нулевым
+        start_ms = now_ms;
+        interval_start_ms = now_ms;
+        interval_tx_start = tx_progress;
+        return;
+    }
+
+    // Прогресс по timestamp, а не по числу пакетов: потери и переупорядочивание
+    // не искажают оценку, старые пакеты игнорируются
+    int32_t advance = (int32_t)(end - rx_last_end);
+    if (advance > 0) {
+        rx_progress += advance;
+        rx_last_end = end;
+    }
+
+    // Максимум заполнения за интервал: задержки сети его только уменьшают
+    int32_t fill = (int32_t)(rx_progress - tx_progress);
+    if (fill > interval_max_fill) {
+        interval_max_fill = fill;
+    }
+    interval_has_rx = true;
+
+    if (now_ms - interval_start_ms >= DRIFT_INTERVAL_MS) {
+        // Интервалы без одного из потоков (удержание, обрыв UART) не учитываются
+        if (interval_has_rx && tx_progress != interval_tx_start) {
+            addPoint((now_ms - start_ms) / 1000.0, interval_max_fill);
+        }
+        interval_start_ms = now_ms;
+        interval_tx_start = tx_progress;
+        interval_max_fill = INT32_MIN;
+        interval_has_rx = false;
+    }
+}
+
+void DriftCompensator::addPoint(double t, int32_t fill) {
+    // Скачок заполнения больше 0.5 с (пауза передачи, сброс AudioKit) -
+    // регрессия перезапускается, последняя оценка ppm сохраняется
+    if (points >= DRIFT_LOCK_POINTS) {
+        double slope = (s0 * sty - st * sy) / (s0 * stt - st * st);
+        double fitted = (sy + slope * (s0 * t - st)) / s0;
+        if (fabs(fill - fitted) > clock_rate / 2) {
+            Serial.printf("DRIFT: скачок заполнения %d -> %d, перезапуск оценки\n", (int)fitted, fill);
+            restartRegression();
+        }
+    }
+
+    const double lambda = 1.0 - 1.0 / DRIFT_WINDOW;
+    s0 = lambda * s0 + 1.0;
+    st = lambda * st + t;
+    sy = lambda * sy + fill;
+    stt = lambda * stt + t * t;
+    sty = lambda * sty + t * fill;
+    points++;
+
+    if (points < DRIFT_LOCK_POINTS) {
+        return;
+    }
+
+    double denom = s0 * stt - st * st;
+    if (denom <= 0.0) {
+        return;
+    }
+    double slope = (s0 * sty - st * sy) / denom;  // единиц RTP в секунду
+    double fitted = (sy + slope * (s0 * t - st)) / s0;
+    ppm = (float)(slope / clock_rate * 1e6);
+    locked = true;
+
+    // Заполнение с учетом уже выполненной коррекции
+    int32_t corrected = (int32_t)fitted + slipUnits();
+    if (!ref_set) {
+        ref_fill = corrected;
+        ref_set = true;
+    }
+    float error_ppm = (float)(corrected - ref_fill) / (clock_rate * DRIFT_RECOVERY_S) * 1e6f;
+
+    correction_ppm = ppm + error_ppm;
+    if (correction_ppm > DRIFT_MAX_PPM) correction_ppm = DRIFT_MAX_PPM;
+    if (correction_ppm < -DRIFT_MAX_PPM) correction_ppm = -DRIFT_MAX_PPM;
+}
+
+int DriftCompensator::takeSlip(int samples) {
+    if (!locked || samples <= 1) {
+        return 0;
+    }
+
+    slip_acc += samples * correction_ppm * 1e-6f;
+    if (slip_acc >= 1.0f) {
+        // Удаленная сторона быстрее - буфер AudioKit растет, отсчет пропускается
+        slip_acc -= 1.0f;
+        dropped++;
+        return -1;
+    }
+    if (slip_acc <= -1.0f) {
+        slip_acc += 1.0f;
+        inserted++;
+        return 1;
+    }
+    return 0;
+}
+
+void DriftCompensator::getStats(drift_stats_t* stats) const {
+    stats->ppm = ppm;
+    stats->correction_ppm = correction_ppm;
+    stats->fill = (int32_t)(rx_progress - tx_progress) + slipUnits();
+    stats->dropped = dropped;
+    stats->inserted = inserted;
+    stats->locked = locked;
+}
@@ -0,0 +1,86 @@
+/*
+ * DriftCompensator.h - Компенсация расхождения часов AudioKit и удаленной стороны
+ *
+ * AudioKit воспроизводит и записывает от одного кварца, поэтому разность
+ * "отправлено в AudioKit" - "получено от AudioKit" (в единицах часов RTP)
+ * равна заполнению его буфера воспроизведения. Наклон этой величины во
+ * времени (взвешенная линейная регрессия по секундным точкам) дает
+ * расхождение часов в ppm. Коррекция - пропуск или повтор одного отсчета
+ * в тихом месте фрейма, когда накопится целый отсчет расхождения.
+ */
+
+#ifndef DRIFT_COMPENSATOR_H
+#define DRIFT_COMPENSATOR_H
+
+#include <Arduino.h>
+
+#define DRIFT_INTERVAL_MS 1000      // Одна точка регрессии в секунду
+#define DRIFT_WINDOW 300            // Постоянная времени регрессии (точек, ~5 минут)
+#define DRIFT_LOCK_POINTS 30        // Минимум точек до начала коррекции
+#define DRIFT_MAX_PPM 500.0f        // Ограничение коррекции
+#define DRIFT_RECOVERY_S 60.0f      // Возврат заполнения к исходному за ~минуту
+
+typedef struct {
+    float ppm;              // Измеренное расхождение (+ удаленная сторона быстрее)
+    float correction_ppm;   // Применяемая коррекция
+    int32_t fill;           // Заполнение буфера AudioKit с учетом коррекции (единицы RTP)
+    uint32_t dropped;       // Пропущено отсчетов
+    uint32_t inserted;      // Вставлено отсчетов
+    bool locked;            // Оценка готова, коррекция включена
+} drift_stats_t;
+
+class DriftCompensator {
+private:
+    int clock_rate;      // Часы RTP
+    int link_rate;       // Частота PCM в канале UART (пропуски считаются в ее отсчетах)
+
+    // Прогресс потоков в единицах часов RTP (32 бит, разность устойчива к переполнению)
+    bool rx_started;
+    uint32_t rx_last_end;
+    uint32_t rx_progress;
+    volatile uint32_t tx_progress;   // Пишется из задачи UART
+
+    // Текущий интервал
+    uint32_t start_ms;
+    uint32_t interval_start_ms;
+    uint32_t interval_tx_start;
+    int32_t interval_max_fill;
+    bool interval_has_rx;
+
+    // Взвешенная регрессия fill(t)
+    double s0, st, sy, stt, sty;
+    int points;
+    bool locked;
+
+    float ppm;
+    float correction_ppm;
+    float slip_acc;
+    int32_t ref_fill;
+    bool ref_set;
+    uint32_t dropped;
+    uint32_t inserted;
+
+    int32_t slipUnits() const;
+    void addPoint(double t, int32_t fill);
+    void restartRegression();
+
+public:
+    DriftCompensator();
+
+    void reset(int rtp_clock_rate, int link_sample_rate);
+
+    // Пакет от удаленной стороны отправлен в AudioKit (timestamp и длительность в единицах RTP)
+    void onIncoming(uint32_t rtp_timestamp, uint32_t rtp_units, uint32_t now_ms);
+    // Фрейм от AudioKit (длительность в единицах RTP)
+    void onOutgoing(uint32_t rtp_units) { tx_progress += rtp_units; }
+
+    // Политика коррекции для блока из samples отсчетов:
+    // -1 - пропустить один отсчет, +1 - повторить один отсчет, 0 - без изменений
+    int takeSlip(int samples);
+
+    void getStats(drift_stats_t* stats) const;
+    float getPPM() const { return ppm; }
+    bool isLocked() const { return locked; }
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * G711Codec.cpp - Реализация G.711 μ-law / A-law
+ */
+
+#include "G711Codec.h"
+
+#define ULAW_BIAS 0x84
+#define ULAW_CLIP 32635
+
+G711Codec::G711Codec(bool alaw) : alaw(alaw) {
+}
+
+void G711Codec::reset() {
+    plc_history.reset();
+}
+
+int G711Codec::encode(const int16_t* pcm, int samples, uint8_t* out) {
+    if (alaw) {
+        for (int i = 0; i < samples; i++) {
+            out[i] = linearToAlaw(pcm[i]);
+        }
+    } else {
+        for (int i = 0; i < samples; i++) {
+            out[i] = linearToUlaw(pcm[i]);
+        }
+    }
+    return samples;
+}
+
+int G711Codec::decode(const uint8_t* in, int len, int16_t* pcm) {
+    if (alaw) {
+        for (int i = 0; i < len; i++) {
+            pcm[i] = alawToLinear(in[i]);
+        }
+    } else {
+        for (int i = 0; i < len; i++) {
+            pcm[i] = ulawToLinear(in[i]);
+        }
+    }
+    plc_history.save(pcm, len);
+    return len;
+}
+
+int G711Codec::plc(int16_t* pcm, int samples) {
+    return plc_history.conceal(pcm, samples);
+}
+
+uint8_t G711Codec::linearToUlaw(int16_t sample) {
+    int pcm = sample;
+    uint8_t sign = 0;
+    if (pcm < 0) {
+        pcm = -pcm;
+        sign = 0x80;
+    }
+    if (pcm > ULAW_CLIP) pcm = ULAW_CLIP;
+    pcm += ULAW_BIAS;
+
+    // Номер сегмента - позиция старшей единицы выше бита 7
+    int exponent = 7;
+    for (int mask = 0x4000; (pcm & mask) == 0 && exponent > 0; mask >>= 1) {
+        exponent--;
+    }
+    int mantissa = (pcm >> (exponent + 3)) & 0x0F;
+    return ~(sign | (exponent << 4) | mantissa);
+}
+
+int16_t G711Codec::ulawToLinear(uint8_t ulaw) {
+    ulaw = ~ulaw;
+    int exponent = (ulaw >> 4) & 0x07;
+    int mantissa = ulaw & 0x0F;
+    int pcm = (((mantissa << 3) + ULAW_BIAS) << exponent) - ULAW_BIAS;
+    return (ulaw & 0x80) ? -pcm : pcm;
+}
+
+uint8_t G711Codec::linearToAlaw(int16_t sample) {
+    int pcm = sample >> 3;  // A-law работает с 13 битами
+    uint8_t mask;
+    if (pcm >= 0) {
+        mask = 0xD5;
+    } else {
+        mask = 0x55;
+        pcm = -pcm - 1;
+    }
+
+    int segment = 0;
+    for (int limit = 0x1F; pcm > limit && segment < 8; limit = (limit << 1) | 1) {
+        segment++;
+    }
+    if (segment >= 8) {
+        return 0x7F ^ mask;
+    }
+
+    uint8_t code = segment << 4;
+    code |= (segment < 2) ? ((pcm >> 1) & 0x0F) : ((pcm >> segment) & 0x0F);
+    return code ^ mask;
+}
+
+int16_t G711Codec::alawToLinear(uint8_t alaw) {
+    alaw ^= 0x55;
+    int segment = (alaw >> 4) & 0x07;
+    int pcm = (alaw & 0x0F) << 4;
+    if (segment == 0) {
+        pcm += 8;
+    } else {
+        pcm += 0x108;
+        if (segment > 1) {
+            pcm <<= segment - 1;
+        }
+    }
+    return (alaw & 0x80) ? pcm : -pcm;
+}
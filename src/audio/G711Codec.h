@@ -0,0 +1,32 @@
+/*
+ * G711Codec.h - Кодек G.711 (μ-law / A-law, ITU-T G.711)
+ *
+ * Один байт на отсчет 8 кГц, без состояния. Используется, когда AudioKit
+ * передает линейный PCM, а также для перекодирования и замеров.
+ */
+
+#ifndef G711_CODEC_H
+#define G711_CODEC_H
+
+#include "AudioCodec.h"
+
+class G711Codec : public AudioCodec {
+private:
+    bool alaw;
+    PLCHistory plc_history;
+
+public:
+    explicit G711Codec(bool alaw);
+
+    void reset() override;
+    int encode(const int16_t* pcm, int samples, uint8_t* out) override;
+    int decode(const uint8_t* in, int len, int16_t* pcm) override;
+    int plc(int16_t* pcm, int samples) override;
+
+    static uint8_t linearToUlaw(int16_t sample);
+    static int16_t ulawToLinear(uint8_t ulaw);
+    static uint8_t linearToAlaw(int16_t sample);
+    static int16_t alawToLinear(uint8_t alaw);
+};
+
+#endif
@@ -0,0 +1,286 @@
+/*
+ * G722Codec.cpp - Реализация кодека G.722 (ITU-T G.722, режим 1, 64 кбит/с)
+ */
+
+#include "G722Codec.h"
+
+// Коэффициенты QMF фильтров
+static const int qmf_coeffs[12] = {
+    3, -11, 12, 32, -210, 951, 3876, -805, 362, -156, 53, -11
+};
+
+// Таблицы нижней подполосы (6 бит)
+static const int q6[32] = {
+    0, 35, 72, 110, 150, 190, 233, 276, 323, 370, 422, 473, 530, 587, 650, 714,
+    786, 858, 940, 1023, 1121, 1219, 1339, 1458, 1612, 1765, 1980, 2195, 2557, 2919, 0, 0
+};
+static const int iln[32] = {
+    0, 63, 62, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19,
+    18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 0
+};
+static const int ilp[32] = {
+    0, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48, 47,
+    46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 32, 0
+};
+static const int qm6[64] = {
+    -136, -136, -136, -136, -24808, -21904, -19008, -16704,
+    -14984, -13512, -12280, -11192, -10232, -9360, -8576, -7856,
+    -7192, -6576, -6000, -5456, -4944, -4464, -4008, -3576,
+    -3168, -2776, -2400, -2032, -1688, -1360, -1040, -728,
+    24808, 21904, 19008, 16704, 14984, 13512, 12280, 11192,
+    10232, 9360, 8576, 7856, 7192, 6576, 6000, 5456,
+    4944, 4464, 4008, 3576, 3168, 2776, 2400, 2032,
+    1688, 1360, 1040, 728, 432, 136, -432, -136
+};
+static const int qm4[16] = {
+    0, -20456, -12896, -8968, -6288, -4240, -2584, -1200,
+    20456, 12896, 8968, 6288, 4240, 2584, 1200, 0
+};
+static const int wl[8] = { -60, -30, 58, 172, 334, 538, 1198, 3042 };
+static const int rl42[16] = { 0, 7, 6, 5, 4, 3, 2, 1, 7, 6, 5, 4, 3, 2, 1, 0 };
+static const int ilb[32] = {
+    2048, 2093, 2139, 2186, 2233, 2282, 2332, 2383, 2435, 2489, 2543, 2599, 2656, 2714, 2774, 2834,
+    2896, 2960, 3025, 3091, 3158, 3228, 3298, 3371, 3444, 3520, 3597, 3676, 3756, 3838, 3922, 4008
+};
+
+// Таблицы верхней подполосы (2 бита)
+static const int qm2[4] = { -7408, -1616, 7408, 1616 };
+static const int ihn[3] = { 0, 1, 0 };
+static const int ihp[3] = { 0, 3, 2 };
+static const int wh[3] = { 0, -214, 798 };
+static const int rh2[4] = { 2, 1, 2, 1 };
+
+static inline int saturate16(int amp) {
+    if (amp > 32767) return 32767;
+    if (amp < -32768) return -32768;
+    return amp;
+}
+
+// Пересчет логарифмического множителя в шаг квантования (блоки 3L/3H SCALE)
+static inline int scaleDet(int nb, int shift_base) {
+    int wd1 = (nb >> 6) & 31;
+    int wd2 = shift_base - (nb >> 11);
+    int wd3 = (wd2 < 0) ? (ilb[wd1] << -wd2) : (ilb[wd1] >> wd2);
+    return wd3 << 2;
+}
+
+G722Codec::G722Codec() {
+    reset();
+}
+
+void G722Codec::resetBand(g722_band_t* band, int det) {
+    memset(band, 0, sizeof(g722_band_t));
+    band->det = det;
+}
+
+void G722Codec::reset() {
+    resetEncoder();
+    resetDecoder();
+}
+
+void G722Codec::resetEncoder() {
+    memset(enc_x, 0, sizeof(enc_x));
+    resetBand(&enc_band[0], 32);
+    resetBand(&enc_band[1], 8);
+}
+
+void G722Codec::resetDecoder() {
+    memset(dec_x, 0, sizeof(dec_x));
+    resetBand(&dec_band[0], 32);
+    resetBand(&dec_band[1], 8);
+    plc_history.reset();
+}
+
+// Блок 4: адаптивный предсказатель (общий для обеих подполос)
+void G722Codec::block4(g722_band_t* s, int d) {
+    int wd1, wd2, wd3;
+
+    // RECONS / PARREC
+    s->d[0] = d;
+    s->r[0] = saturate16(s->s + d);
+    s->p[0] = saturate16(s->sz + d);
+
+    // UPPOL2
+    for (int i = 0; i < 3; i++) {
+        s->sg[i] = s->p[i] >> 15;
+    }
+    wd1 = saturate16(s->a[1] << 2);
+    wd2 = (s->sg[0] == s->sg[1]) ? -wd1 : wd1;
+    if (wd2 > 32767) wd2 = 32767;
+    wd3 = (s->sg[0] == s->sg[2]) ? 128 : -128;
+    wd3 += (wd2 >> 7);
+    wd3 += (s->a[2] * 32512) >> 15;
+    if (wd3 > 12288) wd3 = 12288;
+    else if (wd3 < -12288) wd3 = -12288;
+    s->ap[2] = wd3;
+
+    // UPPOL1
+    s->sg[0] = s->p[0] >> 15;
+    s->sg[1] = s->p[1] >> 15;
+    wd1 = (s->sg[0] == s->sg[1]) ? 192 : -192;
+    wd2 = (s->a[1] * 32640) >> 15;
+    s->ap[1] = saturate16(wd1 + wd2);
+    wd3 = saturate16(15360 - s->ap[2]);
+    if (s->ap[1] > wd3) s->ap[1] = wd3;
+    else if (s->ap[1] < -wd3) s->ap[1] = -wd3;
+
+    // UPZERO
+    wd1 = (d == 0) ? 0 : 128;
+    s->sg[0] = d >> 15;
+    for (int i = 1; i < 7; i++) {
+        s->sg[i] = s->d[i] >> 15;
+        wd2 = (s->sg[i] == s->sg[0]) ? wd1 : -wd1;
+        wd3 = (s->b[i] * 32640) >> 15;
+        s->bp[i] = saturate16(wd2 + wd3);
+    }
+
+    // DELAYA
+    for (int i = 6; i > 0; i--) {
+        s->d[i] = s->d[i - 1];
+        s->b[i] = s->bp[i];
+    }
+    for (int i = 2; i > 0; i--) {
+        s->r[i] = s->r[i - 1];
+        s->p[i] = s->p[i - 1];
+        s->a[i] = s->ap[i];
+    }
+
+    // FILTEP
+    wd1 = saturate16(s->r[1] + s->r[1]);
+    wd1 = (s->a[1] * wd1) >> 15;
+    wd2 = saturate16(s->r[2] + s->r[2]);
+    wd2 = (s->a[2] * wd2) >> 15;
+    s->sp = saturate16(wd1 + wd2);
+
+    // FILTEZ
+    s->sz = 0;
+    for (int i = 6; i > 0; i--) {
+        wd1 = saturate16(s->d[i] + s->d[i]);
+        s->sz += (s->b[i] * wd1) >> 15;
+    }
+    s->sz = saturate16(s->sz);
+
+    // PREDIC
+    s->s = saturate16(s->sp + s->sz);
+}
+
+int G722Codec::encode(const int16_t* pcm, int samples, uint8_t* out) {
+    int out_len = 0;
+
+    for (int j = 0; j + 1 < samples; j += 2) {
+        // QMF анализ: сдвиг линии задержки на два отсчета
+        memmove(enc_x, enc_x + 2, 22 * sizeof(int));
+        enc_x[22] = pcm[j];
+        enc_x[23] = pcm[j + 1];
+
+        int sumeven = 0;
+        int sumodd = 0;
+        for (int i = 0; i < 12; i++) {
+            sumodd += enc_x[2 * i] * qmf_coeffs[i];
+            sumeven += enc_x[2 * i + 1] * qmf_coeffs[11 - i];
+        }
+        int xlow = (sumeven + sumodd) >> 14;
+        int xhigh = (sumeven - sumodd) >> 14;
+
+        // --- Нижняя подполоса ---
+        g722_band_t* lo = &enc_band[0];
+        int el = saturate16(xlow - lo->s);
+        int wd = (el >= 0) ? el : -(el + 1);
+        int i;
+        for (i = 1; i < 30; i++) {
+            if (wd < ((q6[i] * lo->det) >> 12)) break;
+        }
+        int ilow = (el < 0) ? iln[i] : ilp[i];
+
+        int ril = ilow >> 2;
+        int dlow = (lo->det * qm4[ril]) >> 15;
+
+        int nb = ((lo->nb * 127) >> 7) + wl[rl42[ril]];
+        if (nb < 0) nb = 0;
+        else if (nb > 18432) nb = 18432;
+        lo->nb = nb;
+        lo->det = scaleDet(nb, 8);
+        block4(lo, dlow);
+
+        // --- Верхняя подполоса ---
+        g722_band_t* hi = &enc_band[1];
+        int eh = saturate16(xhigh - hi->s);
+        wd = (eh >= 0) ? eh : -(eh + 1);
+        int mih = (wd >= ((564 * hi->det) >> 12)) ? 2 : 1;
+        int ihigh = (eh < 0) ? ihn[mih] : ihp[mih];
+
+        int dhigh = (hi->det * qm2[ihigh]) >> 15;
+
+        nb = ((hi->nb * 127) >> 7) + wh[rh2[ihigh]];
+        if (nb < 0) nb = 0;
+        else if (nb > 22528) nb = 22528;
+        hi->nb = nb;
+        hi->det = scaleDet(nb, 10);
+        block4(hi, dhigh);
+
+        out[out_len++] = (uint8_t)((ihigh << 6) | ilow);
+    }
+
+    return out_len;
+}
+
+int G722Codec::decode(const uint8_t* in, int len, int16_t* pcm) {
+    int out_len = 0;
+
+    for (int j = 0; j < len; j++) {
+        int code = in[j];
+        int ilow = code & 0x3F;
+        int ihigh = (code >> 6) & 0x03;
+
+        // --- Нижняя подполоса ---
+        g722_band_t* lo = &dec_band[0];
+        int rlow = lo->s + ((lo->det * qm6[ilow]) >> 15);
+        if (rlow > 16383) rlow = 16383;
+        else if (rlow < -16384) rlow = -16384;
+
+        int ril = ilow >> 2;
+        int dlow = (lo->det * qm4[ril]) >> 15;
+
+        int nb = ((lo->nb * 127) >> 7) + wl[rl42[ril]];
+        if (nb < 0) nb = 0;
+        else if (nb > 18432) nb = 18432;
+        lo->nb = nb;
+        lo->det = scaleDet(nb, 8);
+        block4(lo, dlow);
+
+        // --- Верхняя подполоса ---
+        g722_band_t* hi = &dec_band[1];
+        int dhigh = (hi->det * qm2[ihigh]) >> 15;
+        int rhigh = dhigh + hi->s;
+        if (rhigh > 16383) rhigh = 16383;
+        else if (rhigh < -16384) rhigh = -16384;
+
+        nb = ((hi->nb * 127) >> 7) + wh[rh2[ihigh]];
+        if (nb < 0) nb = 0;
+        else if (nb > 22528) nb = 22528;
+        hi->nb = nb;
+        hi->det = scaleDet(nb, 10);
+        block4(hi, dhigh);
+
+        // QMF синтез
+        memmove(dec_x, dec_x + 2, 22 * sizeof(int));
+        dec_x[22] = rlow + rhigh;
+        dec_x[23] = rlow - rhigh;
+
+        int xout1 = 0;
+        int xout2 = 0;
+        for (int i = 0; i < 12; i++) {
+            xout2 += dec_x[2 * i] * qmf_coeffs[i];
+            xout1 += dec_x[2 * i + 1] * qmf_coeffs[11 - i];
+        }
+        pcm[out_len++] = (int16_t)saturate16(xout1 >> 11);
+        pcm[out_len++] = (int16_t)saturate16(xout2 >> 11);
+    }
+
+    plc_history.save(pcm, out_len);
+    return out_len;
+}
+
+int G722Codec::plc(int16_t* pcm, int samples) {
+    return plc_history.conceal(pcm, samples);
+}
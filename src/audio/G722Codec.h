@@ -0,0 +1,68 @@
+/*
+ * G722Codec.h - Широкополосный кодек G.722 (64 кбит/с, SB-ADPCM)
+ *
+ * Вход/выход - линейный PCM 16 бит, 16 кГц. Один байт G.722 на каждые
+ * два отсчета: фрейм 20 мс = 320 отсчетов PCM = 160 байт G.722.
+ * Состояние кодера/декодера хранится отдельно для каждого вызова.
+ */
+
+#ifndef G722_CODEC_H
+#define G722_CODEC_H
+
+#include "AudioCodec.h"
+
+#define G722_SAMPLE_RATE 16000      // Частота дискретизации аудио
+#define G722_RTP_CLOCK_RATE 8000    // RFC 3551: часы RTP для G.722 идут на 8000 Гц
+#define G722_FRAME_SAMPLES 320      // 20 мс при 16 кГц
+#define G722_FRAME_BYTES 160        // 20 мс при 64 кбит/с
+
+// Состояние одной подполосы ADPCM (нижняя/верхняя)
+typedef struct {
+    int s;       // Оценка сигнала
+    int sp;      // Оценка полюсной части
+    int sz;      // Оценка нулевой части
+    int r[3];    // Восстановленный сигнал
+    int a[3];    // Коэффициенты полюсов
+    int ap[3];
+    int p[3];    // Частично восстановленный сигнал
+    int d[7];    // Квантованная разность
+    int b[7];    // Коэффициенты нулей
+    int bp[7];
+    int sg[7];   // Знаки
+    int nb;      // Логарифмический масштабный множитель
+    int det;     // Шаг квантования
+} g722_band_t;
+
+class G722Codec : public AudioCodec {
+private:
+    // Кодер
+    int enc_x[24];          // Линия задержки QMF анализа
+    g722_band_t enc_band[2];
+
+    // Декодер
+    int dec_x[24];          // Линия задержки QMF синтеза
+    g722_band_t dec_band[2];
+
+    PLCHistory plc_history;
+
+    static void resetBand(g722_band_t* band, int det);
+    static void block4(g722_band_t* band, int d);
+
+public:
+    G722Codec();
+
+    void reset() override;
+    void resetEncoder();
+    void resetDecoder();
+
+    // Кодирование: samples отсчетов PCM (четное число) -> samples/2 байт
+    int encode(const int16_t* pcm, int samples, uint8_t* out) override;
+
+    // Декодирование: len байт -> len*2 отсчетов PCM
+    int decode(const uint8_t* in, int len, int16_t* pcm) override;
+
+    // Повтор последних 10 мс с затуханием
+    int plc(int16_t* pcm, int samples) override;
+};
+
+#endif
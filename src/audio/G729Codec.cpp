@@ -0,0 +1,211 @@
+/*
+ * G729Codec.cpp - Обертка bcg729 с пакетизацией 10 мс фреймов
+ */
+
+#include "G729Codec.h"
+#include "Metrics.h"
+
+#if ALINA_G729_ENABLED
+extern "C" {
+#include <bcg729/encoder.h>
+#include <bcg729/decoder.h>
+}
+#endif
+
+// Готовые пакеты, не поместившиеся в очередь кодера
+static int metric_packet_drops = METRIC_NONE;
+
+G729Codec::G729Codec() :
+    encoder(nullptr),
+    decoder(nullptr),
+    vad_enabled(true),
+    context_vad(true),
+    context_used(false),
+    frames_per_packet(2),
+    packet_len(0),
+    packet_frames(0),
+    packet_start_sample(0),
+    encoded_samples(0),
+    ready_count(0),
+    last_offset(0) {
+}
+
+G729Codec::~G729Codec() {
+    close();
+}
+
+bool G729Codec::init() {
+    close();
+
+    if (metric_packet_drops == METRIC_NONE) {
+        metric_packet_drops = metrics.counter("alina_g729_packet_drops_total", "Encoded G.729 packets dropped because the encoder output queue was full");
+    }
+
+#if ALINA_G729_ENABLED
+    encoder = initBcg729EncoderChannel(vad_enabled ? 1 : 0);
+    decoder = initBcg729DecoderChannel();
+#endif
+    context_vad = vad_enabled;
+    context_used = false;
+
+    resetPacket();
+    return isReady();
+}
+
+bool G729Codec::prepare() {
+    if (isReady() && !context_used && context_vad == vad_enabled) {
+        return true;
+    }
+    return init();
+}
+
+void G729Codec::resetPacket() {
+    packet_len = 0;
+    packet_frames = 0;
+    packet_start_sample = 0;
+    encoded_samples = 0;
+    ready_count = 0;
+    last_offset = 0;
+}
+
+void G729Codec::close() {
+#if ALINA_G729_ENABLED
+    if (encoder) {
+        closeBcg729EncoderChannel(encoder);
+    }
+    if (decoder) {
+        closeBcg729DecoderChannel(decoder);
+    }
+#endif
+    encoder = nullptr;
+    decoder = nullptr;
+}
+
+void G729Codec::reset() {
+    // Контексты пересоздает prepare() при установке вызова. Без него декодер
+    // начинает с состояния прошлого вызова и сходится за несколько фреймов
+    resetPacket();
+}
+
+void G729Codec::setFramesPerPacket(int frames) {
+    if (frames < G729_MIN_FRAMES_PER_PACKET) frames = G729_MIN_FRAMES_PER_PACKET;
+    if (frames > G729_MAX_FRAMES_PER_PACKET) frames = G729_MAX_FRAMES_PER_PACKET;
+    frames_per_packet = frames;
+}
+
+void G729Codec::flushPacket() {
+    if (packet_len == 0) {
+        return;
+    }
+
+    if (ready_count < 2) {
+        memcpy(ready[ready_count], packet, packet_len);
+        ready_len[ready_count] = packet_len;
+        ready_start[ready_count] = packet_start_sample;
+        ready_count++;
+    } else {
+        metrics.inc(metric_packet_drops);
+    }
+
+    packet_len = 0;
+    packet_frames = 0;
+}
+
+int G729Codec::encode(const int16_t* pcm, int samples, uint8_t* out) {
+    if (!encoder) {
+        return 0;
+    }
+
+    context_used = true;
+    uint32_t frame_start = encoded_samples;
+
+    for (int i = 0; i + G729_FRAME_SAMPLES <= samples; i += G729_FRAME_SAMPLES) {
+        uint8_t bits[G729_FRAME_BYTES];
+        uint8_t bits_len = 0;
+
+#if ALINA_G729_ENABLED
+        bcg729Encoder(encoder, pcm + i, bits, &bits_len);
+#endif
+
+        uint32_t sub_start = encoded_samples;
+        encoded_samples += G729_FRAME_SAMPLES;
+
+        if (bits_len == 0) {
+            // DTX: фрейм не передается, пакет должен закончиться перед разрывом
+            flushPacket();
+            continue;
+        }
+
+        if (packet_len == 0) {
+            packet_start_sample = sub_start;
+        }
+        memcpy(packet + packet_len, bits, bits_len);
+        packet_len += bits_len;
+        packet_frames++;
+
+        // SID может быть только последним фреймом пакета (RFC 3551, 4.5.6)
+        if (bits_len == G729_SID_BYTES || packet_frames >= frames_per_packet) {
+            flushPacket();
+        }
+    }
+
+    if (ready_count == 0) {
+        return 0;
+    }
+
+    int len = ready_len[0];
+    memcpy(out, ready[0], len);
+    last_offset = (int32_t)(ready_start[0] - frame_start);
+
+    // Второй пакет уйдет со следующим фреймом
+    if (ready_count == 2) {
+        memcpy(ready[0], ready[1], ready_len[1]);
+        ready_len[0] = ready_len[1];
+        ready_start[0] = ready_start[1];
+    }
+    ready_count--;
+
+    return len;
+}
+
+int G729Codec::decode(const uint8_t* in, int len, int16_t* pcm) {
+    if (!decoder) {
+        return 0;
+    }
+
+    context_used = true;
+#if ALINA_G729_ENABLED
+    int out = 0;
+    int pos = 0;
+    while (len - pos >= G729_FRAME_BYTES && out < G729_MAX_FRAMES_PER_PACKET * G729_FRAME_SAMPLES) {
+        bcg729Decoder(decoder, in + pos, G729_FRAME_BYTES, 0, 0, 0, pcm + out);
+        pos += G729_FRAME_BYTES;
+        out += G729_FRAME_SAMPLES;
+    }
+    if (len - pos == G729_SID_BYTES && out < G729_MAX_FRAMES_PER_PACKET * G729_FRAME_SAMPLES) {
+        // Annex B SID: генерация комфортного шума
+        bcg729Decoder(decoder, in + pos, G729_SID_BYTES, 0, 1, 0, pcm + out);
+        out += G729_FRAME_SAMPLES;
+    }
+    return out;
+#else
+    return 0;
+#endif
+}
+
+int G729Codec::plc(int16_t* pcm, int samples) {
+    if (!decoder) {
+        memset(pcm, 0, samples * sizeof(int16_t));
+        return samples;
+    }
+
+    context_used = true;
+    int out = 0;
+#if ALINA_G729_ENABLED
+    static const uint8_t erased[G729_FRAME_BYTES] = {0};
+    for (; out + G729_FRAME_SAMPLES <= samples; out += G729_FRAME_SAMPLES) {
+        bcg729Decoder(decoder, erased, G729_FRAME_BYTES, 1, 0, 0, pcm + out);
+    }
+#endif
+    return out;
+}
@@ -0,0 +1,99 @@
+/*
+ * G729Codec.h - Кодек G.729A/B на базе bcg729 (fixed-point)
+ *
+ * Библиотека bcg729 (https://github.com/BelledonneCommunications/bcg729)
+ * подключается как внешняя зависимость. Если ее заголовки не найдены,
+ * кодек компилируется как заглушка и не предлагается в SDP.
+ *
+ * Фрейм G.729 - 10 мс (80 отсчетов 8 кГц, 10 байт). Кодер собирает фреймы
+ * в RTP пакеты по 20-60 мс. Annex B: фреймы тишины (SID, 2 байта)
+ * завершают пакет, непереданные фреймы (DTX) разрывают его.
+ */
+
+#ifndef G729_CODEC_H
+#define G729_CODEC_H
+
+#include "AudioCodec.h"
+
+#ifndef ALINA_G729_ENABLED
+#if defined(__has_include)
+#if __has_include(<bcg729/encoder.h>)
+#define ALINA_G729_ENABLED 1
+#endif
+#endif
+#endif
+
+#ifndef ALINA_G729_ENABLED
+#define ALINA_G729_ENABLED 0
+#endif
+
+#define G729_SAMPLE_RATE 8000
+#define G729_FRAME_SAMPLES 80       // 10 мс
+#define G729_FRAME_BYTES 10
+#define G729_SID_BYTES 2
+#define G729_MAX_FRAMES_PER_PACKET 6  // до 60 мс в пакете (PTIME_MAX_MS), вместе с SID
+// Кодер получает 20 мс за вызов encode() и отдает не больше одного пакета:
+// пакеты по 10 мс копились бы быстрее, чем уходят. ptime 10 для G.729 не принимается
+#define G729_MIN_PACKET_MS 20
+#define G729_MIN_FRAMES_PER_PACKET (G729_MIN_PACKET_MS / 10)
+#define G729_MAX_PACKET_BYTES (G729_MAX_FRAMES_PER_PACKET * G729_FRAME_BYTES + G729_SID_BYTES)
+
+struct bcg729EncoderChannelContextStruct_struct;
+struct bcg729DecoderChannelContextStruct_struct;
+
+class G729Codec : public AudioCodec {
+private:
+    bcg729EncoderChannelContextStruct_struct* encoder;
+    bcg729DecoderChannelContextStruct_struct* decoder;
+    bool vad_enabled;
+    bool context_vad;              // Режим VAD, с которым создан кодер
+    bool context_used;             // Контексты работали после создания
+
+    // Сборка RTP пакета из 10 мс фреймов
+    int frames_per_packet;
+    uint8_t packet[G729_MAX_PACKET_BYTES];
+    int packet_len;
+    int packet_frames;
+    uint32_t packet_start_sample;  // Номер первого отсчета пакета
+    uint32_t encoded_samples;      // Всего отсчетов подано в кодер
+
+    // Готовые пакеты (при SID/DTX за один вызов encode может завершиться два пакета;
+    // третий не помещается и считается в alina_g729_packet_drops_total)
+    uint8_t ready[2][G729_MAX_PACKET_BYTES];
+    int ready_len[2];
+    uint32_t ready_start[2];
+    int ready_count;
+    int32_t last_offset;           // Смещение начала последнего отданного пакета
+
+    void flushPacket();
+    void resetPacket();
+
+public:
+    G729Codec();
+    ~G729Codec();
+
+    // Создание контекстов bcg729 (вызывается при старте, не в потоке медиа)
+    bool init() override;
+    void close();
+    // Пересоздание контекстов, если они уже работали или сменился режим VAD
+    bool prepare() override;
+    // Только сборка пакетов: bcg729 не сбрасывает контекст на месте
+    void reset() override;
+    void setVAD(bool enable) override { vad_enabled = enable; }
+    void setFramesPerPacket(int frames) override;
+    bool isReady() const { return encoder && decoder; }
+
+    // Кодирование samples отсчетов (кратно 80). Возвращает длину готового пакета
+    // (0 - пакет еще собирается или тишина без передачи). Смещение начала
+    // пакета относительно начала pcm доступно через getPacketOffset().
+    int encode(const int16_t* pcm, int samples, uint8_t* out) override;
+    int32_t getPacketOffset() const override { return last_offset; }
+
+    // Декодирование RTP payload (N*10 байт [+ 2 байта SID], не больше
+    // G729_MAX_FRAMES_PER_PACKET фреймов). Возвращает число отсчетов.
+    int decode(const uint8_t* in, int len, int16_t* pcm) override;
+    // Маскирование потерь средствами декодера (frame erasure)
+    int plc(int16_t* pcm, int samples) override;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * ImaAdpcm.cpp - Кодер и декодер IMA ADPCM (блоки с заголовком состояния)
+ */
+
+#include "ImaAdpcm.h"
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// Общий шаг декодирования: кодер повторяет его, чтобы предсказания совпадали
+static inline void applyNibble(int* predictor, int* index, uint8_t nibble) {
+    int step = step_table[*index];
+    int diff = step >> 3;
+    if (nibble & 4) diff += step;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 1) diff += step >> 2;
+    *predictor += (nibble & 8) ? -diff : diff;
+    if (*predictor > 32767) *predictor = 32767;
+    if (*predictor < -32768) *predictor = -32768;
+    *index += index_table[nibble];
+    if (*index < 0) *index = 0;
+    if (*index > 88) *index = 88;
+}
+
+int ImaAdpcm::decodedSamples(const uint8_t* in, size_t len) {
+    if (len < ADPCM_HEADER_SIZE) {
+        return 0;
+    }
+    return (int)(len - ADPCM_HEADER_SIZE) * 2 - (in[3] & 0x01);
+}
+
+size_t ImaAdpcm::encodeBlock(adpcm_state_t* state, const int16_t* pcm, int samples, uint8_t* out) {
+    int predictor = state->predictor;
+    int index = state->index;
+
+    out[0] = predictor & 0xFF;
+    out[1] = (predictor >> 8) & 0xFF;
+    out[2] = index;
+    out[3] = samples & 1;
+
+    uint8_t* data = out + ADPCM_HEADER_SIZE;
+    for (int i = 0; i < samples; i++) {
+        int step = step_table[index];
+        int diff = pcm[i] - predictor;
+        uint8_t nibble = 0;
+        if (diff < 0) {
+            nibble = 8;
+            diff = -diff;
+        }
+        if (diff >= step) { nibble |= 4; diff -= step; }
+        step >>= 1;
+        if (diff >= step) { nibble |= 2; diff -= step; }
+        step >>= 1;
+        if (diff >= step) { nibble |= 1; }
+        applyNibble(&predictor, &index, nibble);
+
+        // Младший полубайт - первый отсчет
+        if (i & 1) {
+            data[i / 2] |= nibble << 4;
+        } else {
+            data[i / 2] = nibble;
+        }
+    }
+
+    state->predictor = predictor;
+    state->index = index;
+    return encodedSize(samples);
+}
+
+int ImaAdpcm::decodeBlock(const uint8_t* in, size_t len, int16_t* pcm, int max_samples) {
+    int samples = decodedSamples(in, len);
+    if (samples <= 0 || samples > max_samples || in[2] > 88) {
+        return 0;
+    }
+    int predictor = (int16_t)(in[0] | (in[1] << 8));
+    int index = in[2];
+
+    const uint8_t* data = in + ADPCM_HEADER_SIZE;
+    for (int i = 0; i < samples; i++) {
+        uint8_t nibble = (i & 1) ? data[i / 2] >> 4 : data[i / 2] & 0x0F;
+        applyNibble(&predictor, &index, nibble);
+        pcm[i] = predictor;
+    }
+    return samples;
+}
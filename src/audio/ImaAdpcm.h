@@ -0,0 +1,36 @@
+/*
+ * ImaAdpcm.h - IMA ADPCM 4 бит/отсчет для канала UART
+ *
+ * Сжатие PCM 16 бит в 4 раза: 16 кГц - 64 кбит/с, как G.711, но широкая
+ * полоса. Каждый фрейм канала - самостоятельный блок: заголовок хранит
+ * предсказание и индекс шага на начало блока, поэтому потерянный (или
+ * отброшенный по CRC) фрейм не сбивает декодер. Кодер переносит состояние
+ * между блоками - шаг не адаптируется заново на каждом фрейме.
+ */
+
+#ifndef IMA_ADPCM_H
+#define IMA_ADPCM_H
+
+#include <Arduino.h>
+
+// Заголовок блока: предсказание (int16 LE), индекс шага, флаги (бит 0 - нечетное число отсчетов)
+#define ADPCM_HEADER_SIZE 4
+
+typedef struct {
+    int16_t predictor;
+    uint8_t index;
+} adpcm_state_t;
+
+class ImaAdpcm {
+public:
+    static void reset(adpcm_state_t* state) { state->predictor = 0; state->index = 0; }
+    static size_t encodedSize(int samples) { return ADPCM_HEADER_SIZE + (samples + 1) / 2; }
+    static int decodedSamples(const uint8_t* in, size_t len);
+
+    // Блок из samples отсчетов; возвращает длину блока
+    static size_t encodeBlock(adpcm_state_t* state, const int16_t* pcm, int samples, uint8_t* out);
+    // Возвращает число отсчетов (0 - неверный блок или не хватает места)
+    static int decodeBlock(const uint8_t* in, size_t len, int16_t* pcm, int max_samples);
+};
+
+#endif
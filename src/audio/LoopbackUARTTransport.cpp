@@ -0,0 +1,114 @@
+/*
+ * LoopbackUARTTransport.cpp - Пара транспортов в памяти с битовыми ошибками
+ */
+
+#include "LoopbackUARTTransport.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+LoopbackUARTTransport::LoopbackUARTTransport() :
+    peer(nullptr),
+    ring(nullptr),
+    ring_size(0),
+    ring_head(0),
+    ring_count(0),
+    rx_linear(nullptr),
+    tx_buffer(nullptr),
+    wire_buffer(nullptr),
+    tx_size(0),
+    rx_overruns(0),
+    bit_error_rate(0),
+    bits_to_error(0),
+    rng(12345),
+    bit_errors(0),
+    wire_bytes(0) {
+}
+
+LoopbackUARTTransport::~LoopbackUARTTransport() {
+    free(ring);
+    free(rx_linear);
+    free(tx_buffer);
+    free(wire_buffer);
+}
+
+bool LoopbackUARTTransport::begin(size_t rx_ring_size, size_t max_frame) {
+    ring_size = rx_ring_size;
+    tx_size = max_frame;
+    ring = (uint8_t*)malloc(ring_size);
+    rx_linear = (uint8_t*)malloc(ring_size);
+    tx_buffer = (uint8_t*)malloc(tx_size);
+    wire_buffer = (uint8_t*)malloc(tx_size);
+    return ring && rx_linear && tx_buffer && wire_buffer;
+}
+
+void LoopbackUARTTransport::connect(LoopbackUARTTransport* a, LoopbackUARTTransport* b) {
+    a->peer = b;
+    b->peer = a;
+}
+
+void LoopbackUARTTransport::setBitErrorRate(float rate, uint32_t seed) {
+    bit_error_rate = rate;
+    rng = seed;
+    bits_to_error = rate > 0 ? nextErrorGap() : 0;
+}
+
+double LoopbackUARTTransport::nextErrorGap() {
+    rng = rng * 1103515245u + 12345u;
+    double u = ((rng >> 8) + 1) / 16777217.0;
+    return -log(u) / bit_error_rate;
+}
+
+void LoopbackUARTTransport::deliver(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (ring_count == ring_size) {
+            rx_overruns += len - i;
+            return;
+        }
+        ring[(ring_head + ring_count) % ring_size] = data[i];
+        ring_count++;
+    }
+}
+
+uint8_t* LoopbackUARTTransport::acquireTx(size_t max_len, uint32_t timeout_ms) {
+    return max_len <= tx_size ? tx_buffer : nullptr;
+}
+
+bool LoopbackUARTTransport::send(uint8_t* buffer, size_t len) {
+    if (!peer || len > tx_size) {
+        return false;
+    }
+    if (bit_error_rate > 0) {
+        // Ошибки накладываются на копию: buffer может быть чужим (write) или собираемым кадром
+        memcpy(wire_buffer, buffer, len);
+        buffer = wire_buffer;
+        double bits = len * 8.0;
+        while (bits_to_error < bits) {
+            size_t bit = (size_t)bits_to_error;
+            buffer[bit / 8] ^= 1 << (bit % 8);
+            bit_errors++;
+            bits_to_error += nextErrorGap();
+        }
+        bits_to_error -= bits;
+    }
+    wire_bytes += len;
+    peer->deliver(buffer, len);
+    return true;
+}
+
+bool LoopbackUARTTransport::write(const uint8_t* data, size_t len) {
+    return send((uint8_t*)data, len);
+}
+
+const uint8_t* LoopbackUARTTransport::receive(size_t* len, uint32_t timeout_ms) {
+    *len = ring_count;
+    if (ring_count == 0) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < ring_count; i++) {
+        rx_linear[i] = ring[(ring_head + i) % ring_size];
+    }
+    ring_head = (ring_head + ring_count) % ring_size;
+    ring_count = 0;
+    return rx_linear;
+}
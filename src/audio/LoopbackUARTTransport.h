@@ -0,0 +1,64 @@
+/*
+ * LoopbackUARTTransport.h - Пара транспортов UARTLink в памяти
+ *
+ * Без периферии и без Arduino/IDF: только стандартная библиотека C, чтобы
+ * петлю можно было собрать и вне прошивки. В прошивке на ней работает
+ * UARTLink::benchmarkLink (протокол, кредиты, битовые ошибки).
+ */
+
+#ifndef LOOPBACK_UART_TRANSPORT_H
+#define LOOPBACK_UART_TRANSPORT_H
+
+#include "UARTTransport.h"
+
+// Пара транспортов в памяти: send одного кладет байты в кольцо приема другого.
+// Кольцо фиксированного размера: байты сверх него теряются, как при
+// переполнении буфера драйвера
+class LoopbackUARTTransport : public UARTTransport {
+private:
+    LoopbackUARTTransport* peer;
+    uint8_t* ring;
+    size_t ring_size;
+    size_t ring_head;
+    size_t ring_count;
+    uint8_t* rx_linear;         // Выдача receive одним куском
+    uint8_t* tx_buffer;
+    uint8_t* wire_buffer;       // Копия кадра с ошибками
+    size_t tx_size;
+    uint32_t rx_overruns;
+
+    // Ошибки в линии этого направления (передача -> прием peer)
+    float bit_error_rate;
+    double bits_to_error;       // Бит до следующей ошибки (экспоненциальный интервал)
+    uint32_t rng;
+    uint32_t bit_errors;
+    uint32_t wire_bytes;
+
+    double nextErrorGap();
+    void deliver(const uint8_t* data, size_t len);
+
+public:
+    LoopbackUARTTransport();
+    ~LoopbackUARTTransport();
+
+    bool begin(size_t rx_ring_size, size_t max_frame);
+    // Соединение в обе стороны
+    static void connect(LoopbackUARTTransport* a, LoopbackUARTTransport* b);
+    // Вероятность инверсии каждого переданного бита (0 - без ошибок)
+    void setBitErrorRate(float rate, uint32_t seed = 12345);
+
+    uint8_t* acquireTx(size_t max_len, uint32_t timeout_ms);
+    bool send(uint8_t* buffer, size_t len);
+    void releaseTx(uint8_t* buffer) {}
+    bool write(const uint8_t* data, size_t len);
+    const uint8_t* receive(size_t* len, uint32_t timeout_ms);
+    size_t rxCapacity() const { return ring_size; }
+    uint32_t getRxOverruns() const { return rx_overruns; }
+    const char* name() const { return "loopback"; }
+
+    uint32_t getBitErrors() const { return bit_errors; }
+    uint32_t getWireBytes() const { return wire_bytes; }
+    void resetWireStats() { bit_errors = 0; wire_bytes = 0; }
+};
+
+#endif
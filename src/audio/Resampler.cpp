@@ -0,0 +1,230 @@
+/*
+ * Resampler.cpp - Реализация полифазного преобразователя частоты
+ */
+
+#include "Resampler.h"
+
+// Прототипы ФНЧ: окно Кайзера (beta = 6), срез 0.92 от частоты Найквиста
+// низкой стороны, сумма коэффициентов = 1.0 (Q15).
+// Неравномерность до 3.4 кГц (8 кГц) < 0.7 дБ, подавление зеркал > 66 дБ.
+static const int16_t resampler_taps_x2[2 * RESAMPLER_TAPS_PER_PHASE] = {
+    5, 1, -13, -6, 23, 20, -34, -44, 42, 83, -39, -136,
+    16, 201, 37, -272, -132, 336, 280, -377, -492, 370, 781, -280,
+    -1174, 45, 1736, 478, -2710, -1862, 5715, 13785, 13785, 5715, -1862, -2710,
+    478, 1736, 45, -1174, -280, 781, 370, -492, -377, 280, 336, -132,
+    -272, 37, 201, 16, -136, -39, 83, 42, -44, -34, 20, 23,
+    -6, -13, 1, 5,
+};
+static const int16_t resampler_taps_x3[3 * RESAMPLER_TAPS_PER_PHASE] = {
+    3, 3, -1, -8, -10, -1, 13, 20, 9, -17, -36, -24,
+    17, 55, 49, -8, -75, -87, -16, 90, 137, 61, -94, -195,
+    -132, 75, 258, 234, -21, -314, -371, -84, 349, 547, 263, -344,
+    -768, -553, 264, 1061, 1050, -32, -1522, -2103, -670, 2770, 6880, 9661,
+    9661, 6880, 2770, -670, -2103, -1522, -32, 1050, 1061, 264, -553, -768,
+    -344, 263, 547, 349, -84, -371, -314, -21, 234, 258, 75, -132,
+    -195, -94, 61, 137, 90, -16, -87, -75, -8, 49, 55, 17,
+    -24, -36, -17, 9, 20, 13, -1, -10, -8, -1, 3, 3,
+};
+static const int16_t resampler_taps_x6[6 * RESAMPLER_TAPS_PER_PHASE] = {
+    1, 2, 2, 1, 0, -1, -3, -5, -5, -4, -2, 1,
+    5, 8, 10, 10, 7, 2, -5, -12, -17, -19, -15, -8,
+    3, 15, 25, 30, 29, 20, 5, -13, -31, -43, -47, -39,
+    -20, 5, 33, 56, 69, 65, 46, 13, -27, -66, -92, -99,
+    -83, -45, 9, 66, 114, 139, 133, 94, 29, -51, -127, -180,
+    -196, -165, -92, 12, 124, 218, 270, 262, 189, 63, -94, -245,
+    -356, -393, -338, -195, 15, 250, 456, 580, 579, 436, 160, -206,
+    -590, -904, -1059, -979, -621, 17, 888, 1905, 2949, 3888, 4595, 4975,
+    4975, 4595, 3888, 2949, 1905, 888, 17, -621, -979, -1059, -904, -590,
+    -206, 160, 436, 579, 580, 456, 250, 15, -195, -338, -393, -356,
+    -245, -94, 63, 189, 262, 270, 218, 124, 12, -92, -165, -196,
+    -180, -127, -51, 29, 94, 133, 139, 114, 66, 9, -45, -83,
+    -99, -92, -66, -27, 13, 46, 65, 69, 56, 33, 5, -20,
+    -39, -47, -43, -31, -13, 5, 20, 29, 30, 25, 15, 3,
+    -8, -15, -19, -17, -12, -5, 2, 7, 10, 10, 8, 5,
+    1, -2, -4, -5, -5, -3, -1, 0, 1, 2, 2, 1,
+};
+
+static inline int16_t saturate16(int32_t amp) {
+    if (amp > 32767) return 32767;
+    if (amp < -32768) return -32768;
+    return (int16_t)amp;
+}
+
+Resampler::Resampler() :
+    in_rate(8000),
+    out_rate(8000),
+    up(1),
+    down(1),
+    taps(nullptr),
+    history_len(0) {
+    memset(work, 0, sizeof(work));
+}
+
+bool Resampler::isSupportedRate(int rate) {
+    return rate == 8000 || rate == 16000 || rate == 48000;
+}
+
+bool Resampler::configure(int in_rate, int out_rate) {
+    this->in_rate = in_rate;
+    this->out_rate = out_rate;
+    up = 1;
+    down = 1;
+    taps = nullptr;
+    history_len = 0;
+
+    if (!isSupportedRate(in_rate) || !isSupportedRate(out_rate)) {
+        this->out_rate = in_rate;
+        return false;
+    }
+
+    int factor;
+    if (out_rate > in_rate) {
+        factor = out_rate / in_rate;
+        up = factor;
+        history_len = RESAMPLER_TAPS_PER_PHASE - 1;
+    } else {
+        factor = in_rate / out_rate;
+        down = factor;
+        history_len = factor * RESAMPLER_TAPS_PER_PHASE - 1;
+    }
+
+    switch (factor) {
+        case 1: taps = nullptr; history_len = 0; break;
+        case 2: taps = resampler_taps_x2; break;
+        case 3: taps = resampler_taps_x3; break;
+        case 6: taps = resampler_taps_x6; break;
+    }
+
+    reset();
+    return true;
+}
+
+void Resampler::reset() {
+    memset(work, 0, sizeof(work));
+}
+
+// y[n*L + p] = L * sum(h[p + L*j] * x[n - j])
+int Resampler::interpolate(int samples, int16_t* out) {
+    int produced = 0;
+    for (int i = 0; i < samples; i++) {
+        const int16_t* x = work + history_len + i;
+        for (int p = 0; p < up; p++) {
+            const int16_t* h = taps + p;
+            int32_t acc = 0;
+            for (int j = 0; j < RESAMPLER_TAPS_PER_PHASE; j++) {
+                acc += (int32_t)h[j * up] * x[-j];
+            }
+            out[produced++] = saturate16((int32_t)(((int64_t)acc * up + (1 << 14)) >> 15));
+        }
+    }
+    return produced;
+}
+
+// y[k] = sum(h[t] * x[k*M + M - 1 - t]) - считаются только нужные отсчеты
+int Resampler::decimate(int samples, int16_t* out) {
+    int length = down * RESAMPLER_TAPS_PER_PHASE;
+    int produced = 0;
+    for (int k = down - 1; k < samples; k += down) {
+        const int16_t* x = work + history_len + k;
+        int32_t acc = 1 << 14;
+        for (int t = 0; t < length; t++) {
+            acc += (int32_t)taps[t] * x[-t];
+        }
+        out[produced++] = saturate16(acc >> 15);
+    }
+    return produced;
+}
+
+int Resampler::process(const int16_t* in, int samples, int16_t* out) {
+    if (!isActive()) {
+        memcpy(out, in, samples * sizeof(int16_t));
+        return samples;
+    }
+
+    samples -= samples % down;
+    int produced = 0;
+    while (samples > 0) {
+        int n = samples < RESAMPLER_CHUNK ? samples : RESAMPLER_CHUNK;
+        memcpy(work + history_len, in, n * sizeof(int16_t));
+
+        if (up > 1) {
+            produced += interpolate(n, out + produced);
+        } else {
+            produced += decimate(n, out + produced);
+        }
+
+        // Хвост входа становится историей для следующего куска
+        memmove(work, work + n, history_len * sizeof(int16_t));
+        in += n;
+        samples -= n;
+    }
+    return produced;
+}
+
+// Уровень тона на выходе относительно входа (дБ), первые 20 мс пропускаются
+static float measureTone(Resampler& rs, float freq, int16_t* in, int16_t* out) {
+    int in_rate = rs.getInputRate();
+    int block = in_rate / 100;
+    double in_energy = 0;
+    double out_energy = 0;
+    rs.reset();
+    for (int b = 0; b < 10; b++) {
+        for (int i = 0; i < block; i++) {
+            in[i] = (int16_t)(16000.0f * sinf(2.0f * PI * freq * (float)(b * block + i) / in_rate));
+        }
+        int produced = rs.process(in, block, out);
+        if (b < 2) continue;
+        for (int i = 0; i < block; i++) in_energy += (double)in[i] * in[i] / block;
+        for (int i = 0; i < produced; i++) out_energy += (double)out[i] * out[i] / produced;
+    }
+    if (in_energy <= 0 || out_energy <= 0) return -120.0f;
+    return 10.0f * log10f((float)(out_energy / in_energy));
+}
+
+void Resampler::benchmark(int frames) {
+    static const int rates[][2] = {
+        {8000, 16000}, {16000, 8000}, {16000, 48000}, {48000, 16000}, {8000, 48000}, {48000, 8000}
+    };
+    static int16_t in[RESAMPLER_MAX_BLOCK];
+    static int16_t out[RESAMPLER_MAX_BLOCK];
+    Resampler rs;
+
+    Serial.println("=== RESAMPLER BENCHMARK ===");
+    Serial.printf("Блок 10 мс, %d блоков, CPU %d МГц\n", frames, ESP.getCpuFreqMHz());
+    for (int r = 0; r < (int)(sizeof(rates) / sizeof(rates[0])); r++) {
+        rs.configure(rates[r][0], rates[r][1]);
+        int block = rates[r][0] / 100;
+        for (int i = 0; i < block; i++) {
+            in[i] = (int16_t)(8000.0f * sinf(2.0f * PI * 1000.0f * i / rates[r][0]));
+        }
+
+        uint64_t cycles = 0;
+        for (int f = 0; f < frames; f++) {
+            uint32_t start = ESP.getCycleCount();
+            rs.process(in, block, out);
+            cycles += ESP.getCycleCount() - start;
+        }
+        uint32_t per_block = (uint32_t)(cycles / frames);
+        uint32_t budget = ESP.getCpuFreqMHz() * 10000;
+
+        // АЧХ в полосе низкой стороны и подавление выше ее частоты Найквиста
+        int low = rates[r][0] < rates[r][1] ? rates[r][0] : rates[r][1];
+        float pass_lo = measureTone(rs, 300.0f, in, out);
+        float pass_hi = measureTone(rs, low * 0.425f, in, out);     // 3.4 кГц для 8 кГц
+        float stop = -120.0f;
+        if (rates[r][0] > low) {
+            // Децимация: тон выше новой частоты Найквиста не должен пройти (алиасинг)
+            stop = measureTone(rs, low * 0.6f, in, out);
+        }
+
+        Serial.printf("%5d -> %5d: %6u тактов/10 мс (%.2f%% ядра) | 300 Гц %.1f дБ | %d Гц %.1f дБ",
+                      rates[r][0], rates[r][1], per_block,
+                      budget > 0 ? 100.0f * per_block / budget : 0.0f,
+                      pass_lo, (int)(low * 0.425f), pass_hi);
+        if (stop > -120.0f) {
+            Serial.printf(" | алиасинг %d Гц %.1f дБ", (int)(low * 0.6f), stop);
+        }
+        Serial.println();
+    }
+    Serial.println("===========================");
+}
@@ -0,0 +1,60 @@
+/*
+ * Resampler.h - Полифазный преобразователь частоты дискретизации (8/16/48 кГц)
+ *
+ * Целочисленные коэффициенты Q15 (окно Кайзера, 32 отвода на фазу) заранее
+ * рассчитаны для коэффициентов 2, 3 и 6. Каждое направление вызова хранит
+ * свой экземпляр: история фильтра переносится между фреймами, поэтому
+ * блоки обрабатываются без разрывов на границах.
+ */
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <Arduino.h>
+
+#define RESAMPLER_TAPS_PER_PHASE 32
+#define RESAMPLER_MAX_FACTOR 6
+#define RESAMPLER_CHUNK 96          // Входных отсчетов за проход (кратно 2, 3 и 6)
+#define RESAMPLER_HISTORY (RESAMPLER_MAX_FACTOR * RESAMPLER_TAPS_PER_PHASE - 1)
+#define RESAMPLER_MAX_RATE 48000
+#define RESAMPLER_MAX_BLOCK (RESAMPLER_MAX_RATE / 100)  // 10 мс на максимальной частоте
+
+class Resampler {
+private:
+    int in_rate;
+    int out_rate;
+    int up;                 // Коэффициент интерполяции L
+    int down;               // Коэффициент децимации M
+    const int16_t* taps;    // Прототип ФНЧ длиной factor * RESAMPLER_TAPS_PER_PHASE
+    int history_len;
+
+    // [история фильтра][текущий кусок входа]
+    int16_t work[RESAMPLER_HISTORY + RESAMPLER_CHUNK];
+
+    int interpolate(int samples, int16_t* out);
+    int decimate(int samples, int16_t* out);
+
+public:
+    Resampler();
+
+    // Настройка пары частот (без выделения памяти). false - пара не поддерживается,
+    // экземпляр остается в режиме копирования.
+    bool configure(int in_rate, int out_rate);
+    void reset();
+
+    bool isActive() const { return up != down; }
+    int getInputRate() const { return in_rate; }
+    int getOutputRate() const { return out_rate; }
+    int getOutputSamples(int samples) const { return samples / down * up; }
+
+    // Обработка блока: samples должно быть кратно коэффициенту децимации.
+    // Возвращает число выходных отсчетов (samples * out_rate / in_rate).
+    int process(const int16_t* in, int samples, int16_t* out);
+
+    static bool isSupportedRate(int rate);
+
+    // Замер тактов CPU и АЧХ всех пар частот на текущем ядре
+    static void benchmark(int frames = 200);
+};
+
+#endif
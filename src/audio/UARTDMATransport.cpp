@@ -0,0 +1,309 @@
+/*
+ * UARTDMATransport.cpp - Транспорт канала AudioKit на DMA UHCI0
+ */
+
+#include "UARTDMATransport.h"
+#include <Arduino.h>
+#include <driver/uart.h>
+
+#if ALINA_UART_DMA
+#include <driver/periph_ctrl.h>
+#include <esp_intr_alloc.h>
+#include <hal/uart_ll.h>
+#include <soc/uhci_struct.h>
+#include <soc/uhci_reg.h>
+#include <rom/lldesc.h>
+
+#define UART_DMA_INTR_MASK (UHCI_OUT_TOTAL_EOF_INT_ENA | UHCI_IN_SUC_EOF_INT_ENA | \
+                            UHCI_IN_DONE_INT_ENA | UHCI_IN_DSCR_EMPTY_INT_ENA)
+#endif
+
+UARTDMATransport::UARTDMATransport() :
+    port(UART_NUM_2),
+    tx_size(0),
+    tx_desc(nullptr),
+    rx_desc(nullptr),
+    intr_handle(nullptr),
+    mux(portMUX_INITIALIZER_UNLOCKED),
+    tx_free_sem(nullptr),
+    tx_free_mask(0),
+    tx_queue_head(0),
+    tx_queue_count(0),
+    tx_active(false),
+    rx_ready(nullptr),
+    rx_next(0),
+    rx_held(-1),
+    rx_stalled(false),
+    rx_overruns(0) {
+    memset(tx_buffers, 0, sizeof(tx_buffers));
+    memset(tx_lengths, 0, sizeof(tx_lengths));
+    memset(rx_buffers, 0, sizeof(rx_buffers));
+}
+
+#if ALINA_UART_DMA
+
+UARTDMATransport::~UARTDMATransport() {
+    if (intr_handle) {
+        UHCI0.int_ena.val = 0;
+        esp_intr_free(intr_handle);
+    }
+    for (int i = 0; i < UART_DMA_TX_BUFFERS; i++) heap_caps_free(tx_buffers[i]);
+    for (int i = 0; i < UART_DMA_RX_BUFFERS; i++) heap_caps_free(rx_buffers[i]);
+    heap_caps_free(tx_desc);
+    heap_caps_free(rx_desc);
+    if (tx_free_sem) vSemaphoreDelete(tx_free_sem);
+    if (rx_ready) vQueueDelete(rx_ready);
+}
+
+bool UARTDMATransport::begin(int uart_port, int baud_rate, int tx_pin, int rx_pin, size_t max_frame) {
+    port = uart_port;
+    // Длина буфера DMA кратна 4
+    tx_size = (max_frame + 3) & ~3;
+
+    tx_desc = (lldesc_t*)heap_caps_calloc(UART_DMA_TX_BUFFERS, sizeof(lldesc_t), MALLOC_CAP_DMA);
+    rx_desc = (lldesc_t*)heap_caps_calloc(UART_DMA_RX_BUFFERS, sizeof(lldesc_t), MALLOC_CAP_DMA);
+    tx_free_sem = xSemaphoreCreateCounting(UART_DMA_TX_BUFFERS, UART_DMA_TX_BUFFERS);
+    rx_ready = xQueueCreate(UART_DMA_RX_BUFFERS, sizeof(int));
+    if (!tx_desc || !rx_desc || !tx_free_sem || !rx_ready) {
+        Serial.println("UARTDMATransport: ОШИБКА выделения памяти");
+        return false;
+    }
+    for (int i = 0; i < UART_DMA_TX_BUFFERS; i++) {
+        tx_buffers[i] = (uint8_t*)heap_caps_malloc(tx_size, MALLOC_CAP_DMA);
+        if (!tx_buffers[i]) return false;
+        tx_desc[i].buf = tx_buffers[i];
+        tx_desc[i].size = tx_size;
+        tx_desc[i].eof = 1;
+        tx_desc[i].qe.stqe_next = nullptr;
+        tx_free_mask |= 1u << i;
+    }
+    // Кольцо дескрипторов приема: DMA переходит к следующему без участия CPU
+    for (int i = 0; i < UART_DMA_RX_BUFFERS; i++) {
+        rx_buffers[i] = (uint8_t*)heap_caps_malloc(UART_DMA_RX_BUFFER_SIZE, MALLOC_CAP_DMA);
+        if (!rx_buffers[i]) return false;
+        rx_desc[i].buf = rx_buffers[i];
+        rx_desc[i].size = UART_DMA_RX_BUFFER_SIZE;
+        rx_desc[i].length = 0;
+        rx_desc[i].owner = 1;
+        rx_desc[i].qe.stqe_next = &rx_desc[(i + 1) % UART_DMA_RX_BUFFERS];
+    }
+
+    // UART без драйвера IDF: FIFO читает и заполняет UHCI
+    uart_config_t uart_config = {
+        .baud_rate = baud_rate,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = 122,
+        .source_clk = UART_SCLK_APB,
+    };
+    uart_param_config((uart_port_t)port, &uart_config);
+    uart_set_pin((uart_port_t)port, tx_pin, rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    UART_LL_GET_HW(port)->idle_conf.rx_idle_thrhd = UART_DMA_IDLE_BITS;
+
+    periph_module_enable(PERIPH_UHCI0_MODULE);
+    UHCI0.conf0.in_rst = 1;
+    UHCI0.conf0.in_rst = 0;
+    UHCI0.conf0.out_rst = 1;
+    UHCI0.conf0.out_rst = 0;
+    UHCI0.conf0.ahbm_fifo_rst = 1;
+    UHCI0.conf0.ahbm_fifo_rst = 0;
+    UHCI0.conf0.ahbm_rst = 1;
+    UHCI0.conf0.ahbm_rst = 0;
+
+    // Прозрачная передача: без SLIP-экранирования, заголовков и CRC UHCI
+    UHCI0.conf0.uart0_ce = port == 0;
+    UHCI0.conf0.uart1_ce = port == 1;
+    UHCI0.conf0.uart2_ce = port == 2;
+    UHCI0.conf0.seper_en = 0;
+    UHCI0.conf0.head_en = 0;
+    UHCI0.conf0.crc_rec_en = 0;
+    UHCI0.conf0.encode_crc_en = 0;
+    UHCI0.conf0.len_eof_en = 0;
+    UHCI0.conf0.uart_idle_eof_en = 1;
+    UHCI0.conf0.out_eof_mode = 1;
+    UHCI0.conf1.check_sum_en = 0;
+    UHCI0.conf1.check_seq_en = 0;
+    UHCI0.conf1.tx_check_sum_re = 0;
+    UHCI0.conf1.tx_ack_num_re = 0;
+    UHCI0.escape_conf.val = 0;
+
+    UHCI0.int_clr.val = 0xFFFFFFFF;
+    if (esp_intr_alloc(ETS_UHCI0_INTR_SOURCE, 0, isr, this, &intr_handle) != ESP_OK) {
+        Serial.println("UARTDMATransport: Ошибка выделения прерывания UHCI0");
+        return false;
+    }
+    UHCI0.int_ena.val = UART_DMA_INTR_MASK;
+
+    UHCI0.dma_in_link.addr = (uint32_t)&rx_desc[0] & 0xFFFFF;
+    UHCI0.dma_in_link.start = 1;
+
+    Serial.printf("UARTDMATransport: UART%d через UHCI0, %d буферов приема по %d байт\n",
+                  port, UART_DMA_RX_BUFFERS, UART_DMA_RX_BUFFER_SIZE);
+    return true;
+}
+
+int UARTDMATransport::indexOf(const uint8_t* buffer) const {
+    for (int i = 0; i < UART_DMA_TX_BUFFERS; i++) {
+        if (tx_buffers[i] == buffer) return i;
+    }
+    return -1;
+}
+
+uint8_t* UARTDMATransport::acquireTx(size_t max_len, uint32_t timeout_ms) {
+    if (max_len > tx_size || xSemaphoreTake(tx_free_sem, timeout_ms / portTICK_PERIOD_MS) != pdTRUE) {
+        return nullptr;
+    }
+    portENTER_CRITICAL(&mux);
+    int index = __builtin_ctz(tx_free_mask);
+    tx_free_mask &= ~(1u << index);
+    portEXIT_CRITICAL(&mux);
+    return tx_buffers[index];
+}
+
+void UARTDMATransport::releaseTx(uint8_t* buffer) {
+    int index = indexOf(buffer);
+    if (index < 0) return;
+    portENTER_CRITICAL(&mux);
+    tx_free_mask |= 1u << index;
+    portEXIT_CRITICAL(&mux);
+    xSemaphoreGive(tx_free_sem);
+}
+
+// Вызывается под mux
+void UARTDMATransport::startTx(int index) {
+    tx_desc[index].length = tx_lengths[index];
+    tx_desc[index].owner = 1;
+    UHCI0.dma_out_link.addr = (uint32_t)&tx_desc[index] & 0xFFFFF;
+    UHCI0.dma_out_link.start = 1;
+    tx_active = true;
+}
+
+bool UARTDMATransport::send(uint8_t* buffer, size_t len) {
+    int index = indexOf(buffer);
+    if (index < 0 || len > tx_size) {
+        return false;
+    }
+    tx_lengths[index] = len;
+    portENTER_CRITICAL(&mux);
+    tx_queue[(tx_queue_head + tx_queue_count) % UART_DMA_TX_BUFFERS] = index;
+    tx_queue_count++;
+    if (!tx_active) {
+        startTx(index);
+    }
+    portEXIT_CRITICAL(&mux);
+    return true;
+}
+
+void IRAM_ATTR UARTDMATransport::isr(void* arg) {
+    UARTDMATransport* t = (UARTDMATransport*)arg;
+    uint32_t status = UHCI0.int_st.val;
+    UHCI0.int_clr.val = status;
+    BaseType_t woken = pdFALSE;
+
+    if (status & UHCI_OUT_TOTAL_EOF_INT_ST) {
+        portENTER_CRITICAL_ISR(&t->mux);
+        // Кадр в начале очереди передан: буфер свободен, следующий - в DMA
+        int done = t->tx_queue[t->tx_queue_head];
+        t->tx_queue_head = (t->tx_queue_head + 1) % UART_DMA_TX_BUFFERS;
+        t->tx_queue_count--;
+        t->tx_free_mask |= 1u << done;
+        t->tx_active = false;
+        if (t->tx_queue_count > 0) {
+            t->startTx(t->tx_queue[t->tx_queue_head]);
+        }
+        portEXIT_CRITICAL_ISR(&t->mux);
+        xSemaphoreGiveFromISR(t->tx_free_sem, &woken);
+    }
+
+    if (status & (UHCI_IN_SUC_EOF_INT_ST | UHCI_IN_DONE_INT_ST)) {
+        // DMA сбрасывает owner закрытых дескрипторов (заполненных или по паузе)
+        while (!t->rx_desc[t->rx_next].owner) {
+            int index = t->rx_next;
+            if (xQueueSendFromISR(t->rx_ready, &index, &woken) != pdTRUE) {
+                break;
+            }
+            t->rx_next = (t->rx_next + 1) % UART_DMA_RX_BUFFERS;
+        }
+    }
+
+    if (status & UHCI_IN_DSCR_EMPTY_INT_ST) {
+        // Все буферы у задачи: байты остаются в FIFO UART до его переполнения
+        t->rx_stalled = true;
+        t->rx_overruns++;
+    }
+
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void UARTDMATransport::returnRx(int index) {
+    rx_desc[index].length = 0;
+    rx_desc[index].eof = 0;
+    rx_desc[index].owner = 1;
+    if (rx_stalled) {
+        rx_stalled = false;
+        UHCI0.dma_in_link.restart = 1;
+    }
+}
+
+const uint8_t* UARTDMATransport::receive(size_t* len, uint32_t timeout_ms) {
+    // Прочитанный в прошлый раз буфер возвращается DMA
+    if (rx_held >= 0) {
+        returnRx(rx_held);
+        rx_held = -1;
+    }
+    *len = 0;
+    int index;
+    if (xQueueReceive(rx_ready, &index, timeout_ms / portTICK_PERIOD_MS) != pdTRUE) {
+        return nullptr;
+    }
+    rx_held = index;
+    *len = rx_desc[index].length;
+    return rx_buffers[index];
+}
+
+#else
+
+// Сборка без ALINA_UART_DMA: транспорт недоступен, используется драйвер IDF
+
+UARTDMATransport::~UARTDMATransport() {
+}
+
+bool UARTDMATransport::begin(int uart_port, int baud_rate, int tx_pin, int rx_pin, size_t max_frame) {
+    Serial.println("UARTDMATransport: Собрано без ALINA_UART_DMA");
+    return false;
+}
+
+uint8_t* UARTDMATransport::acquireTx(size_t max_len, uint32_t timeout_ms) {
+    return nullptr;
+}
+
+bool UARTDMATransport::send(uint8_t* buffer, size_t len) {
+    return false;
+}
+
+void UARTDMATransport::releaseTx(uint8_t* buffer) {
+}
+
+const uint8_t* UARTDMATransport::receive(size_t* len, uint32_t timeout_ms) {
+    *len = 0;
+    return nullptr;
+}
+
+void UARTDMATransport::isr(void* arg) {
+}
+
+void UARTDMATransport::startTx(int index) {
+}
+
+void UARTDMATransport::returnRx(int index) {
+}
+
+int UARTDMATransport::indexOf(const uint8_t* buffer) const {
+    return -1;
+}
+
+#endif
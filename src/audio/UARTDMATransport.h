@@ -0,0 +1,86 @@
+/*
+ * UARTDMATransport.h - Канал AudioKit через DMA контроллера UHCI0 (ESP32)
+ *
+ * Передача: кадр собирается UARTLink прямо в DMA-буфере (acquireTx), send
+ * ставит его дескриптор в очередь out-link без копирования; прерывание
+ * конца передачи возвращает буфер и запускает следующий.
+ * Прием: кольцо буферов с дескрипторами in-link. Буфер закрывается при
+ * заполнении или паузе в линии (uart_idle_eof), receive отдает его целиком
+ * и возвращает DMA при следующем вызове. FIFO UART обслуживается DMA - нет
+ * прерывания на каждые 120 байт и копий через кольца драйвера.
+ *
+ * Выбирается при сборке: -DALINA_UART_DMA=1. Без флага класс - заглушка,
+ * begin возвращает false.
+ */
+
+#ifndef UART_DMA_TRANSPORT_H
+#define UART_DMA_TRANSPORT_H
+
+#include "UARTTransport.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#ifndef ALINA_UART_DMA
+#define ALINA_UART_DMA 0
+#endif
+
+#define UART_DMA_TX_BUFFERS 3       // Собираемый кадр, кадр в передаче, служебный кадр
+// Буфер, закрытый паузой, занят целиком, пока задача его не прочитает: 8 коротких
+// буферов (5 мс при 2 Мбод) вместо двух длинных, объем как у драйвера (8 КБ)
+#define UART_DMA_RX_BUFFERS 8
+#define UART_DMA_RX_BUFFER_SIZE 1024 // Кратно 4 (требование in-link)
+#define UART_DMA_IDLE_BITS 20       // Пауза в линии (бит), закрывающая буфер приема
+
+struct lldesc_s;
+typedef struct intr_handle_data_t* intr_handle_t;
+
+class UARTDMATransport : public UARTTransport {
+private:
+    int port;
+    size_t tx_size;
+    uint8_t* tx_buffers[UART_DMA_TX_BUFFERS];
+    size_t tx_lengths[UART_DMA_TX_BUFFERS];
+    uint8_t* rx_buffers[UART_DMA_RX_BUFFERS];
+    struct lldesc_s* tx_desc;
+    struct lldesc_s* rx_desc;
+    intr_handle_t intr_handle;
+    portMUX_TYPE mux;
+
+    // Передача: свободные буферы (маска + счетный семафор) и очередь на отправку
+    SemaphoreHandle_t tx_free_sem;
+    uint32_t tx_free_mask;
+    uint8_t tx_queue[UART_DMA_TX_BUFFERS];
+    uint8_t tx_queue_head;
+    uint8_t tx_queue_count;
+    bool tx_active;
+
+    // Прием: закрытые DMA буферы по порядку, буфер у задачи до следующего receive
+    QueueHandle_t rx_ready;
+    int rx_next;                // Следующий дескриптор, который закроет DMA
+    int rx_held;
+    volatile bool rx_stalled;   // DMA без свободных дескрипторов
+    volatile uint32_t rx_overruns;
+
+    static void isr(void* arg);
+    void startTx(int index);
+    void returnRx(int index);
+    int indexOf(const uint8_t* buffer) const;
+
+public:
+    UARTDMATransport();
+    ~UARTDMATransport();
+
+    // Настройка UART (без драйвера IDF) и UHCI0; max_frame - наибольший кадр передачи
+    bool begin(int uart_port, int baud_rate, int tx_pin, int rx_pin, size_t max_frame);
+
+    uint8_t* acquireTx(size_t max_len, uint32_t timeout_ms);
+    bool send(uint8_t* buffer, size_t len);
+    void releaseTx(uint8_t* buffer);
+    const uint8_t* receive(size_t* len, uint32_t timeout_ms);
+    size_t rxCapacity() const { return UART_DMA_RX_BUFFERS * UART_DMA_RX_BUFFER_SIZE; }
+    uint32_t getRxOverruns() const { return rx_overruns; }
+    const char* name() const { return "uhci-dma"; }
+};
+
+#endif
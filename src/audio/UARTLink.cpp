@@ -0,0 +1,753 @@
+/*
+ * UARTLink.cpp - Реализация протокола канала UART с AudioKit
+ */
+
+#include "UARTLink.h"
+#include "LoopbackUARTTransport.h"
+#include "Metrics.h"
+
+// Метрики UART канала AudioKit (номера в реестре metrics)
+static int metric_uart_rx_frames = METRIC_NONE;
+static int metric_uart_tx_frames = METRIC_NONE;
+static int metric_uart_tx_bytes = METRIC_NONE;
+static int metric_uart_frame_errors = METRIC_NONE;
+static int metric_uart_resync_bytes = METRIC_NONE;
+static int metric_uart_crc_errors = METRIC_NONE;
+static int metric_uart_lost_frames = METRIC_NONE;
+static int metric_uart_credit_drops = METRIC_NONE;
+static int metric_uart_tx_credits = METRIC_NONE;
+static int metric_uart_tx_stalls = METRIC_NONE;
+
+// CRC-16/CCITT-FALSE (полином 0x1021), таблица строится при первой инициализации
+static uint16_t crc16_table[256];
+static bool crc16_ready = false;
+
+static void buildCRC16Table() {
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc = i << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+        crc16_table[i] = crc;
+    }
+    crc16_ready = true;
+}
+
+uint16_t UARTLink::crc16(const uint8_t* data, size_t len, uint16_t crc) {
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc << 8) ^ crc16_table[((crc >> 8) ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+// CRC-8 (полином 0x07) заголовка: 7 байт, таблица не нужна
+uint8_t UARTLink::crc8(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+UARTLink::UARTLink() :
+    transport(nullptr),
+    v2_enabled(false),
+    rx_capacity(0),
+    handler(nullptr),
+    handler_ctx(nullptr),
+    report(false),
+    mux(portMUX_INITIALIZER_UNLOCKED),
+    tx_lock(nullptr),
+    tx_frame(nullptr),
+    batch_len(0),
+    batch_mask(0),
+    batch_records(0),
+    batch_start(0),
+    v1_counter(0),
+    tx_seq(0),
+    version(1),
+    tx_credits(0),
+    last_hello(0),
+    rx_frame(nullptr),
+    rx_len(0),
+    rx_header_ok(false),
+    rx_expected_seq(0),
+    rx_seq_valid(false),
+    rx_consumed(0),
+    grant_sent(0),
+    last_tx_ms(0),
+    peer_grant(0),
+    hello_reply(false),
+    peer_v2(false),
+    v1_streak(0) {
+    memset(call_last_ms, 0, sizeof(call_last_ms));
+    memset(&stats, 0, sizeof(stats));
+}
+
+UARTLink::~UARTLink() {
+    if (tx_frame) {
+        transport->releaseTx(tx_frame);
+    }
+    free(rx_frame);
+    if (tx_lock) {
+        vSemaphoreDelete(tx_lock);
+    }
+}
+
+bool UARTLink::init(UARTTransport* link_transport, bool enable_v2,
+                    uart_audio_handler_t audio_handler, void* ctx) {
+    if (!crc16_ready) {
+        buildCRC16Table();
+    }
+    if (!link_transport) {
+        return false;
+    }
+    transport = link_transport;
+    v2_enabled = enable_v2;
+    // Объявляется в HELLO 16 битами
+    rx_capacity = transport->rxCapacity() > 0xFFFF ? 0xFFFF : transport->rxCapacity();
+    handler = audio_handler;
+    handler_ctx = ctx;
+
+    rx_frame = (uint8_t*)malloc(UART_V2_MAX_FRAME);
+    tx_lock = xSemaphoreCreateMutex();
+    if (!rx_frame || !tx_lock) {
+        Serial.println("UARTLink: ОШИБКА выделения памяти");
+        return false;
+    }
+
+    // Один набор метрик на все каналы
+    report = true;
+    if (metric_uart_rx_frames == METRIC_NONE) {
+        metric_uart_rx_frames = metrics.counter("alina_uart_rx_frames_total", "Audio frames received from AudioKit");
+        metric_uart_tx_frames = metrics.counter("alina_uart_tx_frames_total", "Audio frames sent to AudioKit");
+        metric_uart_tx_bytes = metrics.counter("alina_uart_tx_bytes_total", "Audio bytes sent to AudioKit including header");
+        metric_uart_frame_errors = metrics.counter("alina_uart_frame_errors_total", "UART frames dropped for bad length or overflow");
+        metric_uart_resync_bytes = metrics.counter("alina_uart_resync_bytes_total", "UART bytes skipped while searching for frame sync");
+        metric_uart_crc_errors = metrics.counter("alina_uart_crc_errors_total", "UART v2 frames dropped for header or frame CRC mismatch");
+        metric_uart_lost_frames = metrics.counter("alina_uart_lost_frames_total", "UART v2 frames missing by link sequence number");
+        metric_uart_credit_drops = metrics.counter("alina_uart_credit_drops_total", "Audio frames not sent to AudioKit for lack of link credits");
+        metric_uart_tx_credits = metrics.gauge("alina_uart_tx_credits_bytes", "Bytes AudioKit can still accept on the v2 link");
+        metric_uart_tx_stalls = metrics.counter("alina_uart_tx_stalls_total", "Audio frames not sent to AudioKit because no transport buffer was free");
+    }
+
+    // Первый HELLO - при первом опросе
+    last_hello = millis() - UART_V2_HELLO_MS;
+    Serial.printf("UARTLink: Транспорт %s, протокол v2 %s\n", transport->name(), v2_enabled ? "по согласованию" : "выключен");
+    return true;
+}
+
+uint8_t UARTLink::takeGrant() {
+    portENTER_CRITICAL(&mux);
+    grant_sent = rx_consumed;
+    portEXIT_CRITICAL(&mux);
+    return (uint8_t)(grant_sent / UART_V2_CREDIT_UNIT);
+}
+
+size_t UARTLink::sealFrame(uint8_t* frame, uint8_t type, size_t payload_len) {
+    frame[0] = UART_V2_SYNC0;
+    frame[1] = UART_V2_SYNC1;
+    frame[2] = type;
+    frame[3] = tx_seq++;
+    frame[4] = (payload_len >> 8) & 0xFF;
+    frame[5] = payload_len & 0xFF;
+    frame[6] = takeGrant();
+    frame[7] = crc8(frame, 7);
+    size_t len = UART_V2_HEADER_SIZE + payload_len;
+    uint16_t crc = crc16(frame, len);
+    frame[len++] = crc >> 8;
+    frame[len++] = crc & 0xFF;
+
+    portENTER_CRITICAL(&mux);
+    tx_credits -= len;
+    int32_t credits = tx_credits;
+    portEXIT_CRITICAL(&mux);
+    last_tx_ms = millis();
+    if (report) {
+        metrics.inc(metric_uart_tx_bytes, -1, len);
+        metrics.set(metric_uart_tx_credits, credits);
+    }
+    return len;
+}
+
+void UARTLink::countStall(uint16_t frames) {
+    stats.tx_stalls += frames;
+    if (report) metrics.inc(metric_uart_tx_stalls, -1, frames);
+}
+
+void UARTLink::flushBatch() {
+    if (batch_len == 0) {
+        return;
+    }
+    size_t frame_len = UART_V2_HEADER_SIZE + batch_len + UART_V2_CRC_SIZE;
+    portENTER_CRITICAL(&mux);
+    bool allowed = tx_credits >= (int32_t)frame_len;
+    portEXIT_CRITICAL(&mux);
+
+    if (allowed) {
+        // Кадр собран в буфере транспорта - передается без копирования
+        size_t len = sealFrame(tx_frame, UART_V2_TYPE_AUDIO, batch_len);
+        transport->send(tx_frame, len);
+        tx_frame = nullptr;
+        if (report) metrics.inc(metric_uart_tx_frames, -1, batch_records);
+    } else {
+        // Аудио не ждет кредитов: устаревший фрейм хуже пропущенного
+        stats.credit_drops += batch_records;
+        if (report) metrics.inc(metric_uart_credit_drops, -1, batch_records);
+    }
+    batch_len = 0;
+    batch_mask = 0;
+    batch_records = 0;
+}
+
+void UARTLink::sendHello(bool reply) {
+    uint8_t frame[UART_V2_HEADER_SIZE + 4 + UART_V2_CRC_SIZE];
+    uint8_t* payload = frame + UART_V2_HEADER_SIZE;
+    payload[0] = UART_V2_VERSION;
+    payload[1] = (rx_capacity >> 8) & 0xFF;
+    payload[2] = rx_capacity & 0xFF;
+    payload[3] = reply ? 0x01 : 0x00;
+    // Получатель HELLO начинает с полного буфера и нового счетчика
+    portENTER_CRITICAL(&mux);
+    rx_consumed = 0;
+    portEXIT_CRITICAL(&mux);
+    transport->write(frame, sealFrame(frame, UART_V2_TYPE_HELLO, 4));
+    last_hello = millis();
+}
+
+bool UARTLink::sendAudio(int call_id, uint8_t codec_type, uint32_t timestamp, uint16_t sequence,
+                         const uint8_t* data, size_t len) {
+    if (!transport || call_id < 0 || call_id >= UART_LINK_MAX_CALLS) {
+        return false;
+    }
+    xSemaphoreTake(tx_lock, portMAX_DELAY);
+
+    if (version < UART_V2_VERSION) {
+        if (len > UART_MAX_PACKET_SIZE - UART_PACKET_HEADER_SIZE) {
+            xSemaphoreGive(tx_lock);
+            return false;
+        }
+        // Возврат к v1 с недособранным кадром v2: AudioKit его не поймет
+        if (tx_frame) {
+            transport->releaseTx(tx_frame);
+            tx_frame = nullptr;
+            batch_len = 0;
+            batch_mask = 0;
+            batch_records = 0;
+        }
+        // Такт медиа не ждет буфера: фрейм без буфера пропускается
+        uint8_t* packet = transport->acquireTx(UART_PACKET_HEADER_SIZE + len, 0);
+        if (!packet) {
+            countStall(1);
+            xSemaphoreGive(tx_lock);
+            return false;
+        }
+        packet[0] = 0x55;
+        packet[1] = 0xAA;
+        packet[2] = (v1_counter >> 8) & 0xFF;
+        packet[3] = v1_counter & 0xFF;
+        packet[4] = (len >> 8) & 0xFF;
+        packet[5] = len & 0xFF;
+        packet[6] = codec_type;
+        // Используем timestamp из RTP пакета для обратной связи
+        packet[7] = (timestamp >> 24) & 0xFF;
+        packet[8] = (timestamp >> 16) & 0xFF;
+        packet[9] = (timestamp >> 8) & 0xFF;
+        packet[10] = timestamp & 0xFF;
+        packet[11] = (sequence >> 8) & 0xFF;
+        packet[12] = sequence & 0xFF;
+        packet[13] = call_id;
+        memcpy(packet + UART_PACKET_HEADER_SIZE, data, len);
+        transport->send(packet, UART_PACKET_HEADER_SIZE + len);
+        v1_counter++;
+        if (report) {
+            metrics.inc(metric_uart_tx_frames);
+            metrics.inc(metric_uart_tx_bytes, -1, UART_PACKET_HEADER_SIZE + len);
+        }
+        xSemaphoreGive(tx_lock);
+        return true;
+    }
+
+    // Запись выравнивается на 2 байта: данные L16 читаются как int16_t
+    size_t record_len = UART_V2_RECORD_HEADER_SIZE + len + (len & 1);
+    if (record_len > UART_V2_MAX_PAYLOAD) {
+        xSemaphoreGive(tx_lock);
+        return false;
+    }
+    uint32_t now = millis();
+    uint32_t bit = 1u << call_id;
+    call_last_ms[call_id] = now;
+
+    // Второй фрейм того же вызова - начало следующего такта
+    if (batch_len > 0 && (batch_len + record_len > UART_V2_MAX_PAYLOAD || (batch_mask & bit))) {
+        flushBatch();
+    }
+    if (batch_len == 0) {
+        batch_start = now;
+    }
+    if (!tx_frame) {
+        tx_frame = transport->acquireTx(UART_V2_MAX_FRAME, 0);
+        if (!tx_frame) {
+            countStall(1);
+            xSemaphoreGive(tx_lock);
+            return false;
+        }
+    }
+    uint8_t* record = tx_frame + UART_V2_HEADER_SIZE + batch_len;
+    record[0] = call_id;
+    record[1] = codec_type;
+    record[2] = (sequence >> 8) & 0xFF;
+    record[3] = sequence & 0xFF;
+    record[4] = (timestamp >> 24) & 0xFF;
+    record[5] = (timestamp >> 16) & 0xFF;
+    record[6] = (timestamp >> 8) & 0xFF;
+    record[7] = timestamp & 0xFF;
+    record[8] = (len >> 8) & 0xFF;
+    record[9] = len & 0xFF;
+    memcpy(record + UART_V2_RECORD_HEADER_SIZE, data, len);
+    if (len & 1) {
+        record[UART_V2_RECORD_HEADER_SIZE + len] = 0;
+    }
+    batch_len += record_len;
+    batch_mask |= bit;
+    batch_records++;
+
+    // Кадр уходит, как только в нем есть все вызовы, передававшие недавно
+    uint32_t live = 0;
+    for (int i = 0; i < UART_LINK_MAX_CALLS; i++) {
+        if (call_last_ms[i] && now - call_last_ms[i] < UART_V2_ACTIVE_MS) {
+            live |= 1u << i;
+        }
+    }
+    if ((batch_mask & live) == live) {
+        flushBatch();
+    }
+
+    xSemaphoreGive(tx_lock);
+    return true;
+}
+
+void UARTLink::sendControl(const uint8_t* command, size_t len) {
+    if (!transport || len > 32) {
+        return;
+    }
+    xSemaphoreTake(tx_lock, portMAX_DELAY);
+    if (version < UART_V2_VERSION) {
+        transport->write(command, len);
+    } else {
+        // Команда после уже собранных фреймов - порядок сохраняется
+        flushBatch();
+        uint8_t frame[UART_V2_HEADER_SIZE + 32 + UART_V2_CRC_SIZE];
+        memcpy(frame + UART_V2_HEADER_SIZE, command, len);
+        transport->write(frame, sealFrame(frame, UART_V2_TYPE_CONTROL, len));
+    }
+    xSemaphoreGive(tx_lock);
+}
+
+void UARTLink::poll() {
+    if (!v2_enabled || !transport) {
+        return;
+    }
+    uint32_t now = millis();
+    xSemaphoreTake(tx_lock, portMAX_DELAY);
+    if (batch_len > 0 && now - batch_start >= UART_V2_BATCH_MS) {
+        flushBatch();
+    }
+    if (hello_reply) {
+        hello_reply = false;
+        sendHello(true);
+    } else if (version < UART_V2_VERSION && now - last_hello >= UART_V2_HELLO_MS) {
+        sendHello(false);
+    } else if (version == UART_V2_VERSION &&
+               (rx_consumed - grant_sent >= UART_V2_CREDIT_FLUSH || now - last_tx_ms >= UART_V2_CREDIT_IDLE_MS)) {
+        // Повтор по таймеру: последний возврат молчащего направления мог не дойти
+        uint8_t frame[UART_V2_HEADER_SIZE + UART_V2_CRC_SIZE];
+        transport->write(frame, sealFrame(frame, UART_V2_TYPE_CREDIT, 0));
+    }
+    xSemaphoreGive(tx_lock);
+}
+
+void UARTLink::flush() {
+    if (!v2_enabled || !transport) {
+        return;
+    }
+    xSemaphoreTake(tx_lock, portMAX_DELAY);
+    if (batch_len > 0) {
+        flushBatch();
+    }
+    xSemaphoreGive(tx_lock);
+}
+
+// Возвращает длину готового кадра, 0 - нужны еще байты, -1 - не кадр
+int UARTLink::checkFrame() {
+    if (rx_frame[0] == 0x55) {
+        if (rx_len >= 2 && rx_frame[1] != 0xAA) return -1;
+        if (rx_len < 6) return 0;
+        size_t total = UART_PACKET_HEADER_SIZE + ((rx_frame[4] << 8) | rx_frame[5]);
+        if (total > UART_MAX_PACKET_SIZE) {
+            if (report) metrics.inc(metric_uart_frame_errors);
+            return -1;
+        }
+        return rx_len >= total ? (int)total : 0;
+    }
+    if (rx_frame[0] == UART_V2_SYNC0) {
+        if (rx_len >= 2 && rx_frame[1] != UART_V2_SYNC1) return -1;
+        if (rx_len < UART_V2_HEADER_SIZE) return 0;
+        size_t payload_len = (rx_frame[4] << 8) | rx_frame[5];
+        if (!rx_header_ok) {
+            if (crc8(rx_frame, 7) != rx_frame[7]) {
+                stats.crc_errors++;
+                if (report) metrics.inc(metric_uart_crc_errors);
+                return -1;
+            }
+            if (payload_len > UART_V2_MAX_PAYLOAD) {
+                if (report) metrics.inc(metric_uart_frame_errors);
+                return -1;
+            }
+            rx_header_ok = true;
+        }
+        size_t total = UART_V2_HEADER_SIZE + payload_len + UART_V2_CRC_SIZE;
+        if (rx_len < total) return 0;
+        uint16_t crc = (rx_frame[total - 2] << 8) | rx_frame[total - 1];
+        if (crc16(rx_frame, total - UART_V2_CRC_SIZE) != crc) {
+            stats.crc_errors++;
+            if (report) metrics.inc(metric_uart_crc_errors);
+            return -1;
+        }
+        return (int)total;
+    }
+    return -1;
+}
+
+void UARTLink::feed(const uint8_t* data, size_t len) {
+    if (!rx_frame) return;
+    // Байты покинули буфер драйвера - их можно вернуть отправителю
+    portENTER_CRITICAL(&mux);
+    rx_consumed += len;
+    portEXIT_CRITICAL(&mux);
+
+    uint32_t skipped = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = data[i];
+        if (rx_len == 0 && byte != 0x55 && byte != UART_V2_SYNC0) {
+            skipped++;
+            continue;
+        }
+        rx_frame[rx_len++] = byte;
+        processFrames();
+    }
+    if (skipped) {
+        stats.resync_bytes += skipped;
+        if (report) metrics.inc(metric_uart_resync_bytes, -1, skipped);
+    }
+}
+
+// Разбор накопленных байтов. При ошибке отбрасывается только первый байт:
+// кадр мог начаться внутри поврежденного
+void UARTLink::processFrames() {
+    while (rx_len > 0) {
+        int result = checkFrame();
+        if (result == 0) {
+            return;
+        }
+        size_t consumed;
+        if (result > 0) {
+            dispatchFrame(result);
+            consumed = result;
+        } else {
+            consumed = 1;
+            while (consumed < rx_len && rx_frame[consumed] != 0x55 && rx_frame[consumed] != UART_V2_SYNC0) {
+                consumed++;
+            }
+            stats.resync_bytes += consumed;
+            if (report) metrics.inc(metric_uart_resync_bytes, -1, consumed);
+        }
+        rx_len -= consumed;
+        rx_header_ok = false;
+        if (rx_len > 0) {
+            memmove(rx_frame, rx_frame + consumed, rx_len);
+        }
+    }
+}
+
+void UARTLink::dispatchFrame(size_t len) {
+    uint8_t* frame = rx_frame;
+
+    if (frame[0] == 0x55) {
+        if (version == UART_V2_VERSION) {
+            // Одиночный кадр v1 не проверен CRC - пропускается как мусор. Серия
+            // без кадров v2 между ними: AudioKit перезапущен с протоколом v1
+            if (++v1_streak < UART_V1_FALLBACK_FRAMES) {
+                stats.resync_bytes += len;
+                if (report) metrics.inc(metric_uart_resync_bytes, -1, len);
+                return;
+            }
+            version = 1;
+            peer_v2 = false;
+            Serial.println("UARTLink: AudioKit передает v1, возврат к протоколу v1");
+        }
+        v1_streak = 0;
+        audio_packet_t packet;
+        packet.call_id = frame[13];
+        packet.timestamp = ((uint32_t)frame[7] << 24) | ((uint32_t)frame[8] << 16) | (frame[9] << 8) | frame[10];
+        packet.sequence = (frame[11] << 8) | frame[12];
+        packet.codec_type = frame[6];
+        packet.data_length = len - UART_PACKET_HEADER_SIZE;
+        packet.data = frame + UART_PACKET_HEADER_SIZE;
+        if (report) metrics.inc(metric_uart_rx_frames);
+        if (handler) {
+            handler(&packet, handler_ctx);
+        }
+        return;
+    }
+
+    uint8_t type = frame[2];
+    uint8_t seq = frame[3];
+    v1_streak = 0;
+    size_t payload_len = len - UART_V2_HEADER_SIZE - UART_V2_CRC_SIZE;
+    uint8_t* payload = frame + UART_V2_HEADER_SIZE;
+
+    if (type == UART_V2_TYPE_HELLO) {
+        if (payload_len < 4 || payload[0] < UART_V2_VERSION) {
+            return;
+        }
+        // Новый сеанс: кредиты - весь буфер AudioKit за вычетом запаса под служебные
+        // кадры (не больше окна счетчика), счетчик отправителя с нуля
+        int32_t capacity = ((payload[1] << 8) | payload[2]) - UART_V2_CREDIT_RESERVE;
+        int32_t window = capacity < UART_V2_CREDIT_WINDOW ? capacity : UART_V2_CREDIT_WINDOW;
+        portENTER_CRITICAL(&mux);
+        tx_credits = window > 0 ? window : 0;
+        portEXIT_CRITICAL(&mux);
+        peer_grant = 0;
+        rx_seq_valid = false;
+        peer_v2 = true;
+        if (!(payload[3] & 0x01)) {
+            hello_reply = true;
+        }
+        if (v2_enabled && version != UART_V2_VERSION) {
+            version = UART_V2_VERSION;
+            Serial.printf("UARTLink: Протокол v2, буфер AudioKit %d байт\n", capacity + UART_V2_CREDIT_RESERVE);
+        }
+    }
+
+    if (rx_seq_valid && seq != rx_expected_seq) {
+        uint8_t lost = seq - rx_expected_seq;
+        stats.lost_frames += lost;
+        if (report) metrics.inc(metric_uart_lost_frames, -1, lost);
+    }
+    rx_expected_seq = seq + 1;
+    rx_seq_valid = true;
+
+    // Разность счетчиков включает возврат из потерянных кадров
+    uint8_t granted = frame[6] - peer_grant;
+    if (type != UART_V2_TYPE_HELLO && granted) {
+        peer_grant = frame[6];
+        portENTER_CRITICAL(&mux);
+        tx_credits += granted * UART_V2_CREDIT_UNIT;
+        portEXIT_CRITICAL(&mux);
+    }
+
+    if (type == UART_V2_TYPE_AUDIO) {
+        handleRecords(payload, payload_len);
+    }
+    // CONTROL от AudioKit пока не определены, CREDIT несет только возврат
+}
+
+void UARTLink::handleRecords(uint8_t* payload, size_t len) {
+    size_t pos = 0;
+    while (pos + UART_V2_RECORD_HEADER_SIZE <= len) {
+        uint8_t* record = payload + pos;
+        size_t data_len = (record[8] << 8) | record[9];
+        size_t record_len = UART_V2_RECORD_HEADER_SIZE + data_len + (data_len & 1);
+        if (pos + record_len > len) {
+            if (report) metrics.inc(metric_uart_frame_errors);
+            return;
+        }
+        audio_packet_t packet;
+        packet.call_id = record[0];
+        packet.codec_type = record[1];
+        packet.sequence = (record[2] << 8) | record[3];
+        packet.timestamp = ((uint32_t)record[4] << 24) | ((uint32_t)record[5] << 16) | (record[6] << 8) | record[7];
+        packet.data_length = data_len;
+        packet.data = record + UART_V2_RECORD_HEADER_SIZE;
+        if (report) metrics.inc(metric_uart_rx_frames);
+        if (handler) {
+            handler(&packet, handler_ctx);
+        }
+        pos += record_len;
+    }
+}
+
+void UARTLink::getStats(uart_link_stats_t* out) const {
+    if (!out) return;
+    *out = stats;
+    out->version = version;
+    portENTER_CRITICAL(&mux);
+    out->tx_credits = tx_credits;
+    portEXIT_CRITICAL(&mux);
+}
+
+// --- Проверка в петле ---
+
+typedef struct {
+    uint32_t delivered;
+    uint32_t delivered_bytes;
+    uint32_t corrupted;         // Доставлен фрейм с неверными данными
+    int calls;
+} link_bench_t;
+
+static uint8_t benchPattern(uint16_t sequence, int call_id, size_t i) {
+    return (uint8_t)(sequence * 7 + call_id * 31 + i);
+}
+
+static void benchHandler(const audio_packet_t* packet, void* ctx) {
+    link_bench_t* b = (link_bench_t*)ctx;
+    bool ok = packet->call_id < b->calls && packet->data_length == 160;
+    for (size_t i = 0; ok && i < packet->data_length; i++) {
+        ok = packet->data[i] == benchPattern(packet->sequence, packet->call_id, i);
+    }
+    if (ok) {
+        b->delivered++;
+        b->delivered_bytes += packet->data_length;
+    } else {
+        b->corrupted++;
+    }
+}
+
+// Как uartTask: все принятое транспортом - в канал
+static void benchPump(UARTLink* link, LoopbackUARTTransport* transport) {
+    size_t len;
+    const uint8_t* data = transport->receive(&len, 0);
+    if (data) {
+        link->feed(data, len);
+    }
+}
+
+void UARTLink::benchmarkLink(float bit_error_rate, int ticks, int calls) {
+    if (calls < 1) calls = 1;
+    if (calls > 8) calls = 8;
+    Serial.println("=== UART LINK SELF-CHECK ===");
+    Serial.printf("BER %.1e, %d тактов по 20 мс, %d вызовов G.711\n", bit_error_rate, ticks, calls);
+
+    uint8_t frame[160];
+    int failed = 0;
+    for (int v = 1; v <= UART_V2_VERSION; v++) {
+        link_bench_t b;
+        memset(&b, 0, sizeof(b));
+        b.calls = calls;
+        // Ошибки в обоих направлениях: обратное несет возврат кредитов
+        LoopbackUARTTransport* tx_wire = new LoopbackUARTTransport();
+        LoopbackUARTTransport* rx_wire = new LoopbackUARTTransport();
+        UARTLink* tx = new UARTLink();
+        UARTLink* rx = new UARTLink();
+        bool ready = tx_wire->begin(UART_BUFFER_SIZE * 4, UART_V2_MAX_FRAME) &&
+                     rx_wire->begin(UART_BUFFER_SIZE * 4, UART_V2_MAX_FRAME);
+        if (ready) {
+            LoopbackUARTTransport::connect(tx_wire, rx_wire);
+            ready = tx->init(tx_wire, v == UART_V2_VERSION, nullptr, nullptr) &&
+                    rx->init(rx_wire, v == UART_V2_VERSION, benchHandler, &b);
+        }
+        if (!ready) {
+            Serial.println("UART LINK SELF-CHECK: нет памяти");
+            delete tx;
+            delete rx;
+            delete tx_wire;
+            delete rx_wire;
+            return;
+        }
+        tx->report = false;
+        rx->report = false;
+
+        // Согласование без ошибок: HELLO -> ответ HELLO
+        tx->poll();
+        benchPump(rx, rx_wire);
+        rx->poll();
+        benchPump(tx, tx_wire);
+        if (v == UART_V2_VERSION && (tx->getVersion() != UART_V2_VERSION || rx->getVersion() != UART_V2_VERSION)) {
+            Serial.println("v2: согласование не состоялось - FAIL");
+            failed++;
+        }
+        uart_link_stats_t start_stats;
+        tx->getStats(&start_stats);
+        tx_wire->setBitErrorRate(bit_error_rate);
+        rx_wire->setBitErrorRate(bit_error_rate, 54321);
+        tx_wire->resetWireStats();
+
+        uint32_t start = ESP.getCycleCount();
+        uint64_t cycles = 0;
+        uint32_t sent = 0;
+        for (int t = 0; t < ticks; t++) {
+            for (int c = 0; c < calls; c++) {
+                for (size_t i = 0; i < sizeof(frame); i++) {
+                    frame[i] = benchPattern(t, c, i);
+                }
+                tx->sendAudio(c, 8, t * 160, t, frame, sizeof(frame));
+                sent++;
+            }
+            benchPump(rx, rx_wire);
+            rx->poll();
+            benchPump(tx, tx_wire);
+            tx->poll();
+            uint32_t now = ESP.getCycleCount();
+            cycles += now - start;
+            start = now;
+        }
+        // Остаток без ошибок: последний возврат кредитов доходит до отправителя
+        tx_wire->setBitErrorRate(0);
+        rx_wire->setBitErrorRate(0);
+        tx->flushBatch();
+        benchPump(rx, rx_wire);
+        uint8_t credit[UART_V2_HEADER_SIZE + UART_V2_CRC_SIZE];
+        if (v == UART_V2_VERSION) {
+            rx->transport->write(credit, rx->sealFrame(credit, UART_V2_TYPE_CREDIT, 0));
+        }
+        benchPump(tx, tx_wire);
+
+        uart_link_stats_t rx_stats, tx_stats;
+        rx->getStats(&rx_stats);
+        tx->getStats(&tx_stats);
+        uint32_t wire_bytes = tx_wire->getWireBytes();
+        uint32_t bit_errors = tx_wire->getBitErrors();
+        // Время в линии при UART_BAUD_RATE (10 бит на байт)
+        float wire_s = wire_bytes * 10.0f / UART_BAUD_RATE;
+        float goodput_kbps = wire_s > 0 ? b.delivered_bytes * 8.0f / wire_s / 1000.0f : 0;
+        float resync_bytes = (float)rx_stats.resync_bytes / (bit_errors ? bit_errors : 1);
+
+        Serial.printf("v%d: доставлено %lu/%lu, искажено %lu, полезная скорость %.0f кбит/с (%.1f%% линии)\n",
+                      v, (unsigned long)b.delivered, (unsigned long)sent, (unsigned long)b.corrupted,
+                      goodput_kbps, wire_bytes ? 100.0f * b.delivered_bytes / wire_bytes : 0.0f);
+        Serial.printf("    битовых ошибок %lu, CRC %lu, потеряно кадров %lu, без кредитов %lu, переполнений %lu\n",
+                      (unsigned long)bit_errors, (unsigned long)rx_stats.crc_errors,
+                      (unsigned long)rx_stats.lost_frames, (unsigned long)tx_stats.credit_drops,
+                      (unsigned long)rx_wire->getRxOverruns());
+        Serial.printf("    кредиты в начале %ld, в конце %ld, ошибок в обратном направлении %lu\n",
+                      (long)start_stats.tx_credits, (long)tx_stats.tx_credits,
+                      (unsigned long)rx_wire->getBitErrors());
+        Serial.printf("    ресинхронизация %.1f байт на ошибку (%.0f мкс), CPU %.1f мкс/такт\n",
+                      resync_bytes, resync_bytes * 10.0f * 1000000.0f / UART_BAUD_RATE,
+                      ticks > 0 ? (float)cycles / ESP.getCpuFreqMHz() / ticks : 0.0f);
+
+        // v2 не должен доставлять искаженные фреймы и терять их без ошибок в линии
+        if (v == UART_V2_VERSION && (b.corrupted > 0 || (bit_errors == 0 && b.delivered != sent))) {
+            failed++;
+        }
+        // Кредиты не должны уходить из-за потерянных возвратов: после доставки
+        // последнего возврата остаток равен начальному (с учетом неполной единицы)
+        if (v == UART_V2_VERSION && (tx_stats.credit_drops > 0 ||
+                                     tx_stats.tx_credits + UART_V2_CREDIT_UNIT < start_stats.tx_credits)) {
+            Serial.println("v2: кредиты теряются - FAIL");
+            failed++;
+        }
+
+        // Каналы освобождают буферы транспортов
+        delete tx;
+        delete rx;
+        delete tx_wire;
+        delete rx_wire;
+    }
+    Serial.printf("Итог: %s\n", failed ? "FAIL" : "PASS");
+    Serial.println("============================");
+}
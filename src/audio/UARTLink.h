@@ -0,0 +1,176 @@
+/*
+ * UARTLink.h - Протокол канала UART с AudioKit (v1 и v2)
+ *
+ * v1: кадр 0x55 0xAA с заголовком 14 байт на каждый аудио фрейм, команды
+ * 0x5A 0xA5, без контрольной суммы - ошибка в длине сбивает разбор до
+ * следующей случайной синхропары.
+ * v2: заголовок 8 байт под CRC-8 (ошибка в длине отбрасывается сразу, поиск
+ * синхронизации продолжается со следующего байта), CRC-16 на весь кадр.
+ * Фреймы нескольких вызовов собираются в один кадр за такт, номер кадра
+ * выявляет потери. Кредиты: получатель сообщает (в каждом заголовке или
+ * кадром CREDIT) счетчик прочитанных из буфера драйвера байт с начала сеанса,
+ * отправитель прибавляет к остатку разность с прошлым значением и не передает
+ * аудио сверх остатка - буфер 8 КБ другой стороны не переполняется. Счетчик
+ * накопительный: кадр, потерянный по CRC, не уносит кредиты - следующий кадр
+ * несет их снова.
+ * v2 включается после обмена HELLO; до ответа AudioKit канал работает по v1.
+ * Прием понимает обе версии, но после согласования v2 кадры v1 (без CRC, их
+ * может сложить шум) пропускаются: возврат к v1 - только после
+ * UART_V1_FALLBACK_FRAMES кадров v1 подряд без кадров v2 (AudioKit перезапущен
+ * со старой прошивкой) или по новому HELLO.
+ */
+
+#ifndef UART_LINK_H
+#define UART_LINK_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <driver/uart.h>
+#include "UARTTransport.h"
+
+#define UART_PORT UART_NUM_2
+#define UART_BAUD_RATE 2000000
+#define UART_BUFFER_SIZE 2048
+#define UART_TX_PIN 17
+#define UART_RX_PIN 5
+#define UART_LINK2_PORT UART_NUM_1  // Второй канал AudioKit (выводы и скорость - в настройках)
+
+// v1
+#define UART_PACKET_HEADER_SIZE 14
+#define UART_MAX_PACKET_SIZE (UART_PACKET_HEADER_SIZE + 1024)
+
+// v2
+#define UART_V2_SYNC0 0xA5
+#define UART_V2_SYNC1 0xC3
+#define UART_V2_VERSION 2
+#define UART_V2_HEADER_SIZE 8
+#define UART_V2_CRC_SIZE 2
+#define UART_V2_RECORD_HEADER_SIZE 10   // Вызов, формат, sequence, timestamp, длина
+#define UART_V2_MAX_PAYLOAD 2048
+#define UART_V2_MAX_FRAME (UART_V2_HEADER_SIZE + UART_V2_MAX_PAYLOAD + UART_V2_CRC_SIZE)
+#define UART_V2_CREDIT_UNIT 32          // Байт на единицу счетчика в заголовке (по модулю 256)
+// Остаток кредитов не больше 255 единиц: прочитанное между двумя принятыми
+// заголовками меньше оборота счетчика
+#define UART_V2_CREDIT_WINDOW (255 * UART_V2_CREDIT_UNIT)
+#define UART_V2_CREDIT_RESERVE 512      // Запас буфера под служебные кадры (без кредитов)
+#define UART_V2_CREDIT_FLUSH 1024       // Накопленный возврат, при котором шлется CREDIT
+#define UART_V2_CREDIT_IDLE_MS 200      // CREDIT без повода, если направление молчит
+#define UART_V2_BATCH_MS 20             // Максимальное ожидание сборки кадра
+#define UART_V2_ACTIVE_MS 60            // Вызов без фреймов дольше - не ждем его в сборке
+#define UART_V2_HELLO_MS 1000
+#define UART_V1_FALLBACK_FRAMES 10      // Кадров v1 подряд для возврата с v2 на v1
+
+#define UART_V2_TYPE_HELLO 1
+#define UART_V2_TYPE_AUDIO 2
+#define UART_V2_TYPE_CONTROL 3
+#define UART_V2_TYPE_CREDIT 4
+
+#define UART_LINK_POLL_MS 5             // Таймаут чтения: срок сборки и возврата кредитов
+#define UART_LINK_MAX_CALLS 32          // Маска вызовов в сборке
+
+// Аудио фрейм канала UART (data указывает в буфер приема, действителен в обработчике)
+typedef struct {
+    int call_id;
+    uint32_t timestamp;
+    uint16_t sequence;
+    uint8_t codec_type;
+    uint16_t data_length;
+    uint8_t* data;
+} audio_packet_t;
+
+typedef void (*uart_audio_handler_t)(const audio_packet_t* packet, void* ctx);
+
+typedef struct {
+    uint8_t version;            // Текущая версия передачи
+    int32_t tx_credits;
+    uint32_t crc_errors;
+    uint32_t lost_frames;
+    uint32_t credit_drops;
+    uint32_t resync_bytes;
+    uint32_t tx_stalls;         // Нет свободного буфера транспорта
+} uart_link_stats_t;
+
+class UARTLink {
+private:
+    UARTTransport* transport;
+    bool v2_enabled;
+    uint16_t rx_capacity;       // Буфер приема транспорта, объявляемый в HELLO
+    uart_audio_handler_t handler;
+    void* handler_ctx;
+    bool report;                // Счетчики в реестре metrics (не для петли проверки)
+    mutable portMUX_TYPE mux;   // Кредиты и возврат: меняются приемом и передачей
+
+    // Передача (вызовы из задачи такта медиа - прием RTP и микс конференции - и SIP)
+    SemaphoreHandle_t tx_lock;
+    uint8_t* tx_frame;          // Собираемый кадр v2 (буфер транспорта)
+    size_t batch_len;           // Записи в tx_frame после заголовка v2
+    uint32_t batch_mask;        // Вызовы в собираемом кадре
+    uint16_t batch_records;
+    uint32_t batch_start;
+    uint32_t call_last_ms[UART_LINK_MAX_CALLS];
+    uint16_t v1_counter;
+    uint8_t tx_seq;
+    volatile uint8_t version;
+    volatile int32_t tx_credits;
+    uint32_t last_hello;
+
+    // Прием (одна задача UART)
+    uint8_t* rx_frame;
+    size_t rx_len;
+    bool rx_header_ok;
+    uint8_t rx_expected_seq;
+    bool rx_seq_valid;
+    volatile uint32_t rx_consumed;     // Прочитано с начала сеанса (HELLO)
+    uint32_t grant_sent;               // rx_consumed в последнем отправленном заголовке
+    uint32_t last_tx_ms;               // Последний отправленный кадр v2
+    uint8_t peer_grant;                // Последний принятый счетчик отправителя
+    volatile bool hello_reply;
+    bool peer_v2;
+    uint8_t v1_streak;                 // Кадры v1 подряд при согласованном v2
+
+    uart_link_stats_t stats;
+
+    static uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF);
+    static uint8_t crc8(const uint8_t* data, size_t len);
+
+    int checkFrame();
+    void processFrames();
+    void dispatchFrame(size_t len);
+    void handleRecords(uint8_t* payload, size_t len);
+    uint8_t takeGrant();
+    // payload уже лежит в frame после заголовка v2; возвращает длину кадра
+    size_t sealFrame(uint8_t* frame, uint8_t type, size_t payload_len);
+    void countStall(uint16_t frames);
+    void flushBatch();
+    void sendHello(bool reply);
+
+public:
+    UARTLink();
+    ~UARTLink();
+
+    // Транспорт принадлежит вызывающему и должен жить дольше канала
+    bool init(UARTTransport* link_transport, bool enable_v2,
+              uart_audio_handler_t audio_handler, void* ctx);
+
+    // Передача: аудио фрейм вызова и команда (payload кадра 0x5A 0xA5 v1)
+    bool sendAudio(int call_id, uint8_t codec_type, uint32_t timestamp, uint16_t sequence,
+                   const uint8_t* data, size_t len);
+    void sendControl(const uint8_t* command, size_t len);
+
+    // Прием байтов из транспорта; аудио фреймы - в обработчик
+    void feed(const uint8_t* data, size_t len);
+    // Сборка по сроку, возврат кредитов, HELLO
+    void poll();
+    // Отправка собираемого кадра v2 без ожидания срока (граница такта медиа)
+    void flush();
+
+    uint8_t getVersion() const { return version; }
+    void getStats(uart_link_stats_t* out) const;
+
+    // Петля в памяти: кадры v1 и v2 с битовыми ошибками, полезная скорость,
+    // потери и длина ресинхронизации
+    static void benchmarkLink(float bit_error_rate = 1e-5f, int ticks = 2000, int calls = 4);
+};
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * UARTTransport.cpp - Транспорт драйвера IDF
+ */
+
+#include "UARTTransport.h"
+#include <Arduino.h>
+#include <driver/uart.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Драйвер IDF ---
+
+DriverUARTTransport::DriverUARTTransport() :
+    port(UART_NUM_2),
+    buffer_size(0),
+    tx_buffer(nullptr),
+    rx_buffer(nullptr) {
+}
+
+DriverUARTTransport::~DriverUARTTransport() {
+    free(tx_buffer);
+    free(rx_buffer);
+}
+
+bool DriverUARTTransport::begin(int uart_port, int baud_rate, int tx_pin, int rx_pin, size_t size) {
+    port = uart_port;
+    buffer_size = size;
+
+    uart_config_t uart_config = {
+        .baud_rate = baud_rate,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = 122,
+        .source_clk = UART_SCLK_APB,
+    };
+
+    uart_param_config((uart_port_t)port, &uart_config);
+    uart_set_pin((uart_port_t)port, tx_pin, rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    if (uart_driver_install((uart_port_t)port, buffer_size * 4, buffer_size * 4, 0, NULL, 0) != ESP_OK) {
+        Serial.println("UARTTransport: Ошибка установки драйвера UART");
+        return false;
+    }
+
+    tx_buffer = (uint8_t*)malloc(buffer_size + 16);
+    rx_buffer = (uint8_t*)heap_caps_malloc(buffer_size, MALLOC_CAP_DMA);
+    return tx_buffer && rx_buffer;
+}
+
+uint8_t* DriverUARTTransport::acquireTx(size_t max_len, uint32_t timeout_ms) {
+    // Один буфер: драйвер копирует кадр в свое кольцо до возврата из send
+    return max_len <= buffer_size + 16 ? tx_buffer : nullptr;
+}
+
+bool DriverUARTTransport::send(uint8_t* buffer, size_t len) {
+    return uart_write_bytes((uart_port_t)port, (const char*)buffer, len) == (int)len;
+}
+
+bool DriverUARTTransport::write(const uint8_t* data, size_t len) {
+    return uart_write_bytes((uart_port_t)port, (const char*)data, len) == (int)len;
+}
+
+const uint8_t* DriverUARTTransport::receive(size_t* len, uint32_t timeout_ms) {
+    int read = uart_read_bytes((uart_port_t)port, rx_buffer, buffer_size, timeout_ms / portTICK_PERIOD_MS);
+    *len = read > 0 ? read : 0;
+    return *len ? rx_buffer : nullptr;
+}
@@ -0,0 +1,82 @@
+/*
+ * UARTTransport.h - Передача байтов канала AudioKit под протоколом UARTLink
+ *
+ * Протокол (кадры, CRC, кредиты) не зависит от того, как байты попадают в линию.
+ * Транспорт выдает буфер, в котором кадр собирается на месте (acquireTx), и
+ * передает его целиком (send); прием возвращает указатель в свой буфер.
+ *
+ * Реализации:
+ *  - DriverUARTTransport - драйвер IDF (uart_write_bytes/uart_read_bytes,
+ *    кольцевые буферы и обслуживание FIFO прерываниями);
+ *  - UARTDMATransport (UARTDMATransport.h) - DMA через UHCI, выбирается при
+ *    сборке: ALINA_UART_DMA=1;
+ *  - LoopbackUARTTransport (LoopbackUARTTransport.h) - пара в памяти без
+ *    периферии с битовыми ошибками (проверка протокола и пропускной способности).
+ */
+
+#ifndef UART_TRANSPORT_H
+#define UART_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define UART_TRANSPORT_TX_WAIT_MS 20    // Ожидание буфера служебным кадром (write)
+
+class UARTTransport {
+public:
+    virtual ~UARTTransport() {}
+
+    // Буфер под кадр до max_len байт (nullptr - все буферы в передаче дольше timeout_ms).
+    // Вызовы передачи сериализует UARTLink
+    virtual uint8_t* acquireTx(size_t max_len, uint32_t timeout_ms) = 0;
+    // Передача буфера из acquireTx; буфер возвращается транспорту
+    virtual bool send(uint8_t* buffer, size_t len) = 0;
+    // Отказ от буфера без передачи
+    virtual void releaseTx(uint8_t* buffer) = 0;
+    // Короткий кадр из чужого буфера (копия; ждет буфер до UART_TRANSPORT_TX_WAIT_MS)
+    virtual bool write(const uint8_t* data, size_t len) {
+        uint8_t* buffer = acquireTx(len, UART_TRANSPORT_TX_WAIT_MS);
+        if (!buffer) {
+            return false;
+        }
+        memcpy(buffer, data, len);
+        return send(buffer, len);
+    }
+
+    // Принятые байты: указатель действителен до следующего receive (nullptr - нет данных)
+    virtual const uint8_t* receive(size_t* len, uint32_t timeout_ms) = 0;
+    // Байт, которые транспорт примет без потерь, пока их не прочитали (кредиты v2)
+    virtual size_t rxCapacity() const = 0;
+    // Потерянные при приеме байты (переполнение буфера)
+    virtual uint32_t getRxOverruns() const = 0;
+    virtual const char* name() const = 0;
+};
+
+// Драйвер IDF: кадр копируется в кольцевой буфер передачи драйвера
+class DriverUARTTransport : public UARTTransport {
+private:
+    int port;
+    size_t buffer_size;
+    uint8_t* tx_buffer;
+    uint8_t* rx_buffer;
+
+public:
+    DriverUARTTransport();
+    ~DriverUARTTransport();
+
+    // Настройка UART и установка драйвера (буферы драйвера по buffer_size*4)
+    bool begin(int uart_port, int baud_rate, int tx_pin, int rx_pin, size_t buffer_size);
+
+    uint8_t* acquireTx(size_t max_len, uint32_t timeout_ms);
+    bool send(uint8_t* buffer, size_t len);
+    void releaseTx(uint8_t* buffer) {}
+    bool write(const uint8_t* data, size_t len);
+    const uint8_t* receive(size_t* len, uint32_t timeout_ms);
+    size_t rxCapacity() const { return buffer_size * 4; }
+    // Драйвер без очереди событий не сообщает о переполнении
+    uint32_t getRxOverruns() const { return 0; }
+    const char* name() const { return "driver"; }
+};
+
+#endif
@@ -25,6 +25,8 @@ void ConfigManager::loadDefaults() {
     strcpy(current_config.subnet, "255.255.255.0");
     strcpy(current_config.dns, "8.8.8.8");
     current_config.dhcp_enabled = true;
+    current_config.rtp_dscp = DSCP_EF;
+    current_config.sip_dscp = DSCP_CS3;
     
     // SIP настройки по умолчанию
     strcpy(current_config.sip_server, "192.168.1.50");
@@ -39,13 +41,22 @@ void ConfigManager::loadDefaults() {
     current_config.sip_qop_enabled = false; 
 
     // Аудио настройки по умолчанию
-    current_config.audio_sample_rate = 8000;
+    current_config.audio_sample_rate = 0;     // AudioKit на частоте кодека вызова
     current_config.audio_frame_size = 160;
     current_config.audio_packet_time = 20;
     current_config.uart_baud_rate = 2000000;
+    current_config.uart_link_v2 = true;
+    current_config.uart_link_adpcm = false;
+    current_config.uart_link_count = 1;
+    current_config.uart_link2_baud_rate = 2000000;
+    current_config.uart_link2_tx_pin = UART_LINK2_TX_PIN;
+    current_config.uart_link2_rx_pin = UART_LINK2_RX_PIN;
     current_config.primary_codec = AUDIO_CODEC_PCMA;      // G.711 μ-law по умолчанию
     current_config.secondary_codec = AUDIO_CODEC_PCMU;   // G.711 A-law как резерв
     current_config.enable_dtmf_rfc2833 = true;
+    current_config.g729_annexb = true;
+    current_config.call_recording = false;
+    current_config.red_loss_threshold = 1;
     
     // Устройство по умолчанию
     strcpy(current_config.device_name, "ALINA IP Client");
@@ -54,6 +65,7 @@ void ConfigManager::loadDefaults() {
     // Расширенные настройки по умолчанию
     current_config.max_calls = 5;
     current_config.rtp_base_port = 7000;
+    current_config.rtp_shared_socket = false;
     current_config.keepalive_interval = 60000;
     current_config.auto_answer = false;
     
@@ -94,6 +106,9 @@ bool ConfigManager::loadConfig() {
     preferences.getString("subnet", current_config.subnet, sizeof(current_config.subnet));
     preferences.getString("dns", current_config.dns, sizeof(current_config.dns));
     current_config.dhcp_enabled = preferences.getBool("dhcp", current_config.dhcp_enabled);
+    // Через сеттеры: значение вне 0..63 испортило бы байт TOS
+    setRTPDSCP(preferences.getUChar("rtp_dscp", current_config.rtp_dscp));
+    setSIPDSCP(preferences.getUChar("sip_dscp", current_config.sip_dscp));
     
     // Загрузка SIP настроек
     preferences.getString("sip_server", current_config.sip_server, sizeof(current_config.sip_server));
@@ -110,11 +125,20 @@ bool ConfigManager::loadConfig() {
     // Загрузка аудио настроек
     current_config.audio_sample_rate = preferences.getInt("audio_rate", current_config.audio_sample_rate);
     current_config.audio_frame_size = preferences.getInt("audio_frame", current_config.audio_frame_size);
-    current_config.audio_packet_time = preferences.getInt("audio_pkt", current_config.audio_packet_time);
+    setAudioPacketTime(preferences.getInt("audio_pkt", current_config.audio_packet_time));
     current_config.uart_baud_rate = preferences.getInt("uart_baud", current_config.uart_baud_rate);
+    current_config.uart_link_v2 = preferences.getBool("uart_v2", current_config.uart_link_v2);
+    current_config.uart_link_adpcm = preferences.getBool("uart_adpcm", current_config.uart_link_adpcm);
+    current_config.uart_link_count = preferences.getInt("uart_links", current_config.uart_link_count);
+    current_config.uart_link2_baud_rate = preferences.getInt("uart2_baud", current_config.uart_link2_baud_rate);
+    current_config.uart_link2_tx_pin = preferences.getInt("uart2_tx", current_config.uart_link2_tx_pin);
+    current_config.uart_link2_rx_pin = preferences.getInt("uart2_rx", current_config.uart_link2_rx_pin);
     current_config.primary_codec = (uint8_t)preferences.getInt("primary_codec", current_config.primary_codec);
     current_config.secondary_codec = (uint8_t)preferences.getInt("secondary_codec", current_config.secondary_codec);
     current_config.enable_dtmf_rfc2833 = preferences.getBool("dtmf_enabled", current_config.enable_dtmf_rfc2833);
+    current_config.g729_annexb = preferences.getBool("g729_annexb", current_config.g729_annexb);
+    current_config.call_recording = preferences.getBool("call_rec", current_config.call_recording);
+    current_config.red_loss_threshold = preferences.getUChar("red_loss", current_config.red_loss_threshold);
     
     // Загрузка настроек устройства
     preferences.getString("device_name", current_config.device_name, sizeof(current_config.device_name));
@@ -123,6 +147,7 @@ bool ConfigManager::loadConfig() {
     // Загрузка расширенных настроек
     current_config.max_calls = preferences.getInt("max_calls", current_config.max_calls);
     current_config.rtp_base_port = preferences.getInt("rtp_port", current_config.rtp_base_port);
+    current_config.rtp_shared_socket = preferences.getBool("rtp_shared", current_config.rtp_shared_socket);
     current_config.keepalive_interval = preferences.getInt("keepalive", current_config.keepalive_interval);
     current_config.auto_answer = preferences.getBool("auto_answer", current_config.auto_answer);
     
@@ -144,6 +169,8 @@ bool ConfigManager::saveConfig() {
     preferences.putString("subnet", current_config.subnet);
     preferences.putString("dns", current_config.dns);
     preferences.putBool("dhcp", current_config.dhcp_enabled);
+    preferences.putUChar("rtp_dscp", current_config.rtp_dscp);
+    preferences.putUChar("sip_dscp", current_config.sip_dscp);
     
     // Сохранение SIP настроек
     preferences.putString("sip_server", current_config.sip_server);
@@ -162,9 +189,18 @@ bool ConfigManager::saveConfig() {
     preferences.putInt("audio_frame", current_config.audio_frame_size);
     preferences.putInt("audio_pkt", current_config.audio_packet_time);
     preferences.putInt("uart_baud", current_config.uart_baud_rate);
+    preferences.putBool("uart_v2", current_config.uart_link_v2);
+    preferences.putBool("uart_adpcm", current_config.uart_link_adpcm);
+    preferences.putInt("uart_links", current_config.uart_link_count);
+    preferences.putInt("uart2_baud", current_config.uart_link2_baud_rate);
+    preferences.putInt("uart2_tx", current_config.uart_link2_tx_pin);
+    preferences.putInt("uart2_rx", current_config.uart_link2_rx_pin);
     preferences.putInt("primary_codec", current_config.primary_codec);
     preferences.putInt("secondary_codec", current_config.secondary_codec);
     preferences.putBool("dtmf_enabled", current_config.enable_dtmf_rfc2833);
+    preferences.putBool("g729_annexb", current_config.g729_annexb);
+    preferences.putBool("call_rec", current_config.call_recording);
+    preferences.putUChar("red_loss", current_config.red_loss_threshold);
     
     // Сохранение настроек устройства
     preferences.putString("device_name", current_config.device_name);
@@ -173,6 +209,7 @@ bool ConfigManager::saveConfig() {
     // Сохранение расширенных настроек
     preferences.putInt("max_calls", current_config.max_calls);
     preferences.putInt("rtp_port", current_config.rtp_base_port);
+    preferences.putBool("rtp_shared", current_config.rtp_shared_socket);
     preferences.putInt("keepalive", current_config.keepalive_interval);
     preferences.putBool("auto_answer", current_config.auto_answer);
     
@@ -235,6 +272,14 @@ bool ConfigManager::isDHCPServer() const {
     return current_config.dhcp_enabled;
 }
 
+uint8_t ConfigManager::getRTPDSCP() const {
+    return current_config.rtp_dscp;
+}
+
+uint8_t ConfigManager::getSIPDSCP() const {
+    return current_config.sip_dscp;
+}
+
 const char* ConfigManager::getSIPServer() const {
     return current_config.sip_server;
 }
@@ -279,6 +324,30 @@ int ConfigManager::getUARTBaudRate() const {
     return current_config.uart_baud_rate;
 }
 
+bool ConfigManager::isUARTLinkV2Enabled() const {
+    return current_config.uart_link_v2;
+}
+
+bool ConfigManager::isUARTLinkADPCMEnabled() const {
+    return current_config.uart_link_adpcm;
+}
+
+int ConfigManager::getUARTLinkCount() const {
+    return current_config.uart_link_count;
+}
+
+int ConfigManager::getUARTLink2BaudRate() const {
+    return current_config.uart_link2_baud_rate;
+}
+
+int ConfigManager::getUARTLink2TxPin() const {
+    return current_config.uart_link2_tx_pin;
+}
+
+int ConfigManager::getUARTLink2RxPin() const {
+    return current_config.uart_link2_rx_pin;
+}
+
 uint8_t ConfigManager::getPrimaryCodec() const {  // Возвращаем uint8_t
     return current_config.primary_codec;
 }
@@ -291,6 +360,18 @@ bool ConfigManager::isDTMFEnabled() const {
     return current_config.enable_dtmf_rfc2833;
 }
 
+bool ConfigManager::isG729AnnexBEnabled() const {
+    return current_config.g729_annexb;
+}
+
+bool ConfigManager::isCallRecordingEnabled() const {
+    return current_config.call_recording;
+}
+
+uint8_t ConfigManager::getRedLossThreshold() const {
+    return current_config.red_loss_threshold;
+}
+
 const char* ConfigManager::getDeviceName() const {
     return current_config.device_name;
 }
@@ -317,6 +398,10 @@ int ConfigManager::getRTPBasePort() const {
     return current_config.rtp_base_port;
 }
 
+bool ConfigManager::isRTPSharedSocket() const {
+    return current_config.rtp_shared_socket;
+}
+
 int ConfigManager::getKeepaliveInterval() const {
     return current_config.keepalive_interval;
 }
@@ -360,6 +445,14 @@ void ConfigManager::setDHCPServer(bool dhcp) {
     current_config.dhcp_enabled = dhcp;
 }
 
+void ConfigManager::setRTPDSCP(int dscp) {
+    current_config.rtp_dscp = dscp >= 0 && dscp < 64 ? dscp : DSCP_EF;
+}
+
+void ConfigManager::setSIPDSCP(int dscp) {
+    current_config.sip_dscp = dscp >= 0 && dscp < 64 ? dscp : DSCP_CS3;
+}
+
 void ConfigManager::setSIPServer(const char* server) {
     strncpy(current_config.sip_server, server, sizeof(current_config.sip_server) - 1);
     current_config.sip_server[sizeof(current_config.sip_server) - 1] = '\0';
@@ -406,13 +499,40 @@ void ConfigManager::setAudioFrameSize(int size) {
 }
 
 void ConfigManager::setAudioPacketTime(int time) {
-    current_config.audio_packet_time = time;
+    current_config.audio_packet_time = isSupportedPacketTime(time) ? time : 20;
+}
+
+bool ConfigManager::isSupportedPacketTime(int ms) {
+    return ms == 10 || ms == 20 || ms == 30 || ms == 40 || ms == 60;
 }
 
 void ConfigManager::setUARTBaudRate(int baud) {
     current_config.uart_baud_rate = baud;
 }
 
+void ConfigManager::setUARTLinkV2Enabled(bool enabled) {
+    current_config.uart_link_v2 = enabled;
+}
+
+void ConfigManager::setUARTLinkADPCMEnabled(bool enabled) {
+    current_config.uart_link_adpcm = enabled;
+}
+
+void ConfigManager::setUARTLinkCount(int count) {
+    if (count >= 1 && count <= AUDIO_LINKS_MAX) {
+        current_config.uart_link_count = count;
+    }
+}
+
+void ConfigManager::setUARTLink2BaudRate(int baud) {
+    current_config.uart_link2_baud_rate = baud;
+}
+
+void ConfigManager::setUARTLink2Pins(int tx_pin, int rx_pin) {
+    current_config.uart_link2_tx_pin = tx_pin;
+    current_config.uart_link2_rx_pin = rx_pin;
+}
+
 void ConfigManager::setPrimaryCodec(uint8_t codec) {  // Принимаем uint8_t
     current_config.primary_codec = codec;
 }
@@ -425,6 +545,18 @@ void ConfigManager::setDTMFEnabled(bool enabled) {
     current_config.enable_dtmf_rfc2833 = enabled;
 }
 
+void ConfigManager::setG729AnnexBEnabled(bool enabled) {
+    current_config.g729_annexb = enabled;
+}
+
+void ConfigManager::setCallRecordingEnabled(bool enabled) {
+    current_config.call_recording = enabled;
+}
+
+void ConfigManager::setRedLossThreshold(int percent) {
+    current_config.red_loss_threshold = percent >= 0 && percent <= 50 ? percent : 1;
+}
+
 void ConfigManager::setDeviceName(const char* name) {
     strncpy(current_config.device_name, name, sizeof(current_config.device_name) - 1);
     current_config.device_name[sizeof(current_config.device_name) - 1] = '\0';
@@ -458,6 +590,10 @@ void ConfigManager::setRTPBasePort(int port) {
     current_config.rtp_base_port = port > 1024 && port < 65535 ? port : 7000;
 }
 
+void ConfigManager::setRTPSharedSocket(bool shared) {
+    current_config.rtp_shared_socket = shared;
+}
+
 void ConfigManager::setKeepaliveInterval(int interval) {
     current_config.keepalive_interval = interval > 10000 ? interval : 60000;
 }
@@ -479,6 +615,7 @@ void ConfigManager::printConfig() const {
     Serial.printf("Subnet: %s\n", current_config.subnet);
     Serial.printf("DNS: %s\n", current_config.dns);
     Serial.printf("DHCP: %s\n", current_config.dhcp_enabled ? "ВКЛ" : "ВЫКЛ");
+    Serial.printf("DSCP RTP/SIP: %d/%d\n", current_config.rtp_dscp, current_config.sip_dscp);
     
     Serial.println("\n--- SIP настройки ---");
     Serial.printf("SIP Server: %s\n", current_config.sip_server);
@@ -491,13 +628,27 @@ void ConfigManager::printConfig() const {
     Serial.printf("QOP Enabled: %s\n", current_config.sip_qop_enabled ? "ВКЛ" : "ВЫКЛ");
 
     Serial.println("\n--- Аудио настройки ---");
-    Serial.printf("Sample Rate: %d Hz\n", current_config.audio_sample_rate);
+    if (current_config.audio_sample_rate > 0) {
+        Serial.printf("Sample Rate: %d Hz\n", current_config.audio_sample_rate);
+    } else {
+        Serial.println("Sample Rate: по кодеку вызова");
+    }
     Serial.printf("Frame Size: %d bytes\n", current_config.audio_frame_size);
     Serial.printf("Packet Time: %d ms\n", current_config.audio_packet_time);
     Serial.printf("UART Baud Rate: %d\n", current_config.uart_baud_rate);
+    Serial.printf("UART протокол v2: %s\n", current_config.uart_link_v2 ? "ВКЛ" : "ВЫКЛ");
+    Serial.printf("UART ADPCM: %s\n", current_config.uart_link_adpcm ? "ВКЛ" : "ВЫКЛ");
+    Serial.printf("Каналы AudioKit: %d\n", current_config.uart_link_count);
+    if (current_config.uart_link_count > 1) {
+        Serial.printf("UART канал 2: %d бод, TX %d, RX %d\n", current_config.uart_link2_baud_rate,
+                     current_config.uart_link2_tx_pin, current_config.uart_link2_rx_pin);
+    }
     Serial.printf("Primary Codec: %d\n", current_config.primary_codec);
     Serial.printf("Secondary Codec: %d\n", current_config.secondary_codec);
     Serial.printf("DTMF RFC2833: %s\n", current_config.enable_dtmf_rfc2833 ? "ВКЛ" : "ВЫКЛ");
+    Serial.printf("G.729 Annex B: %s\n", current_config.g729_annexb ? "ВКЛ" : "ВЫКЛ");
+    Serial.printf("Запись вызовов: %s\n", current_config.call_recording ? "ВКЛ" : "ВЫКЛ");
+    Serial.printf("Порог избыточности RFC 2198: %d%%\n", current_config.red_loss_threshold);
     
     Serial.println("\n--- Устройство ---");
     Serial.printf("Device Name: %s\n", current_config.device_name);
@@ -508,6 +659,7 @@ void ConfigManager::printConfig() const {
     Serial.println("\n--- Расширенные настройки ---");
     Serial.printf("Max Calls: %d\n", current_config.max_calls);
     Serial.printf("RTP Base Port: %d\n", current_config.rtp_base_port);
+    Serial.printf("Общий RTP сокет: %s\n", current_config.rtp_shared_socket ? "ВКЛ" : "ВЫКЛ");
     Serial.printf("Keepalive Interval: %d ms\n", current_config.keepalive_interval);
     Serial.printf("Auto Answer: %s\n", current_config.auto_answer ? "ВКЛ" : "ВЫКЛ");
     
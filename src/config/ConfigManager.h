@@ -11,9 +11,19 @@
 // Типы аудио кодеков
 #define AUDIO_CODEC_PCMU 0    // G.711 μ-law
 #define AUDIO_CODEC_PCMA 8    // G.711 A-law
-//#define AUDIO_CODEC_G729 18   // G.729
+#define AUDIO_CODEC_G722 9    // G.722 (wideband)
+#define AUDIO_CODEC_G729 18   // G.729 (bcg729)
+
+// Классы DSCP по умолчанию (RFC 4594)
+#define DSCP_EF 46            // Expedited Forwarding - голос
+#define DSCP_CS3 24           // Сигнализация
 //#define AUDIO_CODEC_OPUS 111  // Opus
 
+// Каналы AudioKit: первый - UART2 (UARTLink.h), второй - UART1 на этих выводах по умолчанию
+#define AUDIO_LINKS_MAX 2
+#define UART_LINK2_TX_PIN 33
+#define UART_LINK2_RX_PIN 34
+
 // Структура конфигурации SIP
 typedef struct {
     // Сетевые настройки
@@ -24,6 +34,8 @@ typedef struct {
     char subnet[16];
     char dns[16];
     bool dhcp_enabled;
+    uint8_t rtp_dscp;          // DSCP для RTP (46 - EF)
+    uint8_t sip_dscp;          // DSCP для SIP (24 - CS3)
     
     // SIP настройки
     char sip_server[64];
@@ -37,13 +49,22 @@ typedef struct {
     bool sip_qop_enabled;      // Включить QOP аутентификацию <-- ДОБАВИТЬ
     
     // Аудио настройки
-    int audio_sample_rate;
+    int audio_sample_rate;     // Частота PCM AudioKit (8000/16000/48000, 0 - частота кодека)
     int audio_frame_size;
-    int audio_packet_time;
+    int audio_packet_time;     // Длительность RTP пакета, мс (10/20/30/40/60)
     int uart_baud_rate;
+    bool uart_link_v2;         // Протокол v2 канала AudioKit (CRC, сборка, кредиты) после HELLO
+    bool uart_link_adpcm;      // PCM в канале AudioKit сжимается IMA ADPCM (4 бит/отсчет)
+    int uart_link_count;       // Каналы AudioKit (второй - на отдельном UART, после перезагрузки)
+    int uart_link2_baud_rate;
+    int uart_link2_tx_pin;
+    int uart_link2_rx_pin;
     uint8_t primary_codec;     // Основной кодек (используем uint8_t)
     uint8_t secondary_codec;   // Резервный кодек (используем uint8_t)
     bool enable_dtmf_rfc2833;
+    bool g729_annexb;          // G.729 Annex B (VAD/CNG)
+    bool call_recording;       // Запись всех вызовов во flash
+    uint8_t red_loss_threshold; // Потери (%), с которых включается избыточность RFC 2198 (0 - выкл)
     
     // Устройство
     char device_name[32];
@@ -53,6 +74,7 @@ typedef struct {
     // Расширенные настройки
     int max_calls;
     int rtp_base_port;
+    bool rtp_shared_socket;    // Один RTP порт на все вызовы (разделение по адресу/SSRC)
     int keepalive_interval;
     bool auto_answer;
     
@@ -90,6 +112,8 @@ public:
     const char* getSubnet() const;
     const char* getDNS() const;
     bool isDHCPServer() const;
+    uint8_t getRTPDSCP() const;
+    uint8_t getSIPDSCP() const;
     
     // SIP настройки
     const char* getSIPServer() const;
@@ -106,9 +130,18 @@ public:
     int getAudioFrameSize() const;
     int getAudioPacketTime() const;
     int getUARTBaudRate() const;
+    bool isUARTLinkV2Enabled() const;
+    bool isUARTLinkADPCMEnabled() const;
+    int getUARTLinkCount() const;
+    int getUARTLink2BaudRate() const;
+    int getUARTLink2TxPin() const;
+    int getUARTLink2RxPin() const;
     uint8_t getPrimaryCodec() const;      // Возвращаем uint8_t
     uint8_t getSecondaryCodec() const;    // Возвращаем uint8_t
     bool isDTMFEnabled() const;
+    bool isG729AnnexBEnabled() const;
+    bool isCallRecordingEnabled() const;
+    uint8_t getRedLossThreshold() const;
     
     // Устройство
     const char* getDeviceName() const;
@@ -118,6 +151,7 @@ public:
     // Расширенные настройки
     int getMaxCalls() const;
     int getRTPBasePort() const;
+    bool isRTPSharedSocket() const;
     int getKeepaliveInterval() const;
     bool isAutoAnswer() const;
     
@@ -129,6 +163,8 @@ public:
     void setSubnet(const char* subnet);
     void setDNS(const char* dns);
     void setDHCPServer(bool dhcp);
+    void setRTPDSCP(int dscp);
+    void setSIPDSCP(int dscp);
     
     void setSIPServer(const char* server);
     void setSIPPort(int port);
@@ -144,10 +180,19 @@ public:
     void setAudioSampleRate(int rate);
     void setAudioFrameSize(int size);
     void setAudioPacketTime(int time);
+    static bool isSupportedPacketTime(int ms);
     void setUARTBaudRate(int baud);
+    void setUARTLinkV2Enabled(bool enabled);
+    void setUARTLinkADPCMEnabled(bool enabled);
+    void setUARTLinkCount(int count);
+    void setUARTLink2BaudRate(int baud);
+    void setUARTLink2Pins(int tx_pin, int rx_pin);
     void setPrimaryCodec(uint8_t codec);      // Принимаем uint8_t
     void setSecondaryCodec(uint8_t codec);    // Принимаем uint8_t
     void setDTMFEnabled(bool enabled);
+    void setG729AnnexBEnabled(bool enabled);
+    void setCallRecordingEnabled(bool enabled);
+    void setRedLossThreshold(int percent);
     
     void setDeviceName(const char* name);
     bool setMACAddress(const uint8_t* mac);
@@ -155,6 +200,7 @@ public:
     
     void setMaxCalls(int max_calls);
     void setRTPBasePort(int port);
+    void setRTPSharedSocket(bool shared);
     void setKeepaliveInterval(int interval);
     void setAutoAnswer(bool auto_answer);
     
@@ -1,6 +1,7 @@
 /** EnhancedNetworkManager.cpp - Реализация улучшенного сетевого менеджера*/
 #include "EnhancedNetworkManager.h"
 #include "SystemMonitor.h" // Для системного мониторинга и watchdog
+#include "TaskPlan.h"
 #include <ETH.h> // Основная библиотека Ethernet
 #include <AsyncUDP.h> // Для UDP
 
@@ -44,7 +45,7 @@ bool EnhancedNetworkManager::init() {
     Serial.println("Ethernet инициализирован, ожидание подключения...");
 
     // Запуск задачи мониторинга сети
-    xTaskCreate(networkMonitorTask, "NetworkMonitor", 2048, this, 3, &networkMonitorTaskHandle);
+    taskPlan.create(TASK_NETWORK_MONITOR, networkMonitorTask, this, &networkMonitorTaskHandle);
     systemMonitor.reportTask(networkMonitorTaskHandle, "NetworkMonitor");
 
     // Ожидание подключения с таймаутом
@@ -13,6 +13,13 @@
 #define NETWORK_RECONNECT_TIMEOUT 30000 // 30 секунд
 #define NETWORK_MAX_RECONNECT_ATTEMPTS 5
 
+// AsyncUDP с установкой TOS своего PCB (DSCP сигнализации)
+class SIPUDP : public AsyncUDP {
+public:
+    void setTOS(uint8_t tos) { if (_pcb) _pcb->tos = tos; }
+    uint8_t getTOS() const { return _pcb ? _pcb->tos : 0; }
+};
+
 class EnhancedNetworkManager {
 private:
     char localIP[16];
@@ -39,7 +46,7 @@ public:
     void printNetworkStatus();
     bool isEthConnected() const { return ethConnected; } // Добавляем геттер
     
-    AsyncUDP udp;
+    SIPUDP udp;
 };
 
 extern EnhancedNetworkManager networkManager;
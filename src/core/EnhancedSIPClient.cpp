@@ -6,6 +6,8 @@
 #include "EnhancedSIPClient.h"
 #include "WebInterface.h"
 #include "ConfigManager.h"
+#include "PacketCapture.h"
+#include "Metrics.h"
 #include <esp_random.h>
 #include <mbedtls/md5.h>
 #include <WiFi.h>          // Для esp_random()
@@ -17,12 +19,24 @@
 
 EnhancedSIPClient sipClient;
 
+// Метрики SIP (номера в реестре metrics)
+static int metric_rx_requests = METRIC_NONE;
+static int metric_rx_responses = METRIC_NONE;
+static int metric_rx_error_responses = METRIC_NONE;
+static int metric_tx_requests = METRIC_NONE;
+static int metric_tx_responses = METRIC_NONE;
+static int metric_send_errors = METRIC_NONE;
+static int metric_dscp_marked = METRIC_NONE;
+static int metric_rx_drops = METRIC_NONE;
+
 EnhancedSIPClient::EnhancedSIPClient() 
     : networkManager(nullptr), audioManager(nullptr), rtpManager(nullptr),
       webInterface(nullptr), configManager(nullptr),
       sip_state(SIP_STATE_INITIALIZING), sip_registered(false),
       last_register_success(0), register_expires(3600), require_auth(false),
-      active_calls(0), sip_cseq(1), max_calls(0), calls(nullptr) {
+      active_calls(0), sip_cseq(1), max_calls(0), calls(nullptr),
+      rx_slots(nullptr), rx_free(nullptr), rx_ready(nullptr), rx_backlog(false),
+      cmd_queue(nullptr) {
     
     // Инициализация массивов
     memset(sip_user, 0, sizeof(sip_user));
@@ -111,10 +125,45 @@ void EnhancedSIPClient::init(EnhancedNetworkManager* netMgr, AudioManager* audio
         sip_state = SIP_STATE_ERROR;
         return;
     }
+    networkManager->udp.setTOS(configManager->getSIPDSCP() << 2);
     
-    // Обработчик входящих пакетов
-      networkManager->udp.onPacket([this](AsyncUDPPacket& packet) { // <-- Изменено: принимает &
-        this->handleIncomingPacket(packet); // <-- Изменено: вызывает handleIncomingPacket
+    if (metric_rx_requests == METRIC_NONE) {
+        metric_rx_requests = metrics.counter("alina_sip_rx_requests_total", "SIP requests received");
+        metric_rx_responses = metrics.counter("alina_sip_rx_responses_total", "SIP responses received");
+        metric_rx_error_responses = metrics.counter("alina_sip_rx_error_responses_total", "SIP 4xx-6xx responses received");
+        metric_tx_requests = metrics.counter("alina_sip_tx_requests_total", "SIP requests sent");
+        metric_tx_responses = metrics.counter("alina_sip_tx_responses_total", "SIP responses sent");
+        metric_send_errors = metrics.counter("alina_sip_send_errors_total", "SIP messages that failed to send");
+        metric_dscp_marked = metrics.counter("alina_sip_dscp_marked_total", "SIP messages sent with a non-zero DSCP");
+        metric_rx_drops = metrics.counter("alina_sip_rx_drops_total", "SIP datagrams dropped because the receive queue was full");
+    }
+
+    // Очередь приема: ячейки выделяются один раз, повторный init их сохраняет
+    if (!rx_slots) {
+        rx_slots = (sip_rx_slot_t*)malloc(SIP_RX_SLOTS * sizeof(sip_rx_slot_t));
+        rx_free = xQueueCreate(SIP_RX_SLOTS, sizeof(uint8_t));
+        rx_ready = xQueueCreate(SIP_RX_SLOTS, sizeof(uint8_t));
+        if (!rx_slots || !rx_free || !rx_ready) {
+            Serial.println("SIP: ОШИБКА - нет памяти для очереди приема");
+            sip_state = SIP_STATE_ERROR;
+            return;
+        }
+        for (uint8_t i = 0; i < SIP_RX_SLOTS; i++) {
+            xQueueSend(rx_free, &i, 0);
+        }
+    }
+    if (!cmd_queue) {
+        cmd_queue = xQueueCreate(SIP_CMD_SLOTS, sizeof(sip_cmd_t));
+        if (!cmd_queue) {
+            Serial.println("SIP: ОШИБКА - нет памяти для очереди команд");
+            sip_state = SIP_STATE_ERROR;
+            return;
+        }
+    }
+
+    // Обработчик входящих пакетов: только копия в очередь, разбор - в process()
+    networkManager->udp.onPacket([this](AsyncUDPPacket& packet) {
+        this->enqueuePacket(packet);
     });
 
     Serial.printf("SIP: Успешно инициализирован на порту %d\n", SIP_PORT);
@@ -129,6 +178,9 @@ void EnhancedSIPClient::init(EnhancedNetworkManager* netMgr, AudioManager* audio
 // EnhancedSIPClient.cpp (внутри класса)
 
 void EnhancedSIPClient::process() {
+    drainCommands();
+    drainPackets();
+
     // Serial.printf("SIP: Process called. networkManager ptr: 0x%p, Network connected (via ptr): %s, SIP State: %d\n",
     //               (void*)networkManager,
     //               networkManager && networkManager->isConnected() ? "YES" : "NO",
@@ -274,12 +326,118 @@ void EnhancedSIPClient::process() {
 
 // EnhancedSIPClient.cpp (внутри класса)
 
-void EnhancedSIPClient::handleIncomingPacket(AsyncUDPPacket& packet) {
+// Поток AsyncUDP: ни одного поля вызовов и регистрации, только копия в ячейку
+void EnhancedSIPClient::enqueuePacket(AsyncUDPPacket& packet) {
     if (packet.length() == 0) return;
 
+    packetCapture.capture(PCAP_KIND_SIP, PCAP_DIR_RX, PCAP_ANY_CALL, (uint32_t)packet.remoteIP(),
+                          packet.remotePort(), SIP_PORT, packet.data(), packet.length());
+
+    uint8_t index;
+    if (xQueueReceive(rx_free, &index, 0) != pdTRUE) {
+        metrics.inc(metric_rx_drops);
+        return;
+    }
+    sip_rx_slot_t* slot = &rx_slots[index];
+    size_t len = packet.length();
+    slot->truncated = len >= SIP_RX_SLOT_SIZE;
+    if (slot->truncated) {
+        len = SIP_RX_SLOT_SIZE - 1;
+    }
+    memcpy(slot->data, packet.data(), len);
+    slot->data[len] = '\0';
+    slot->len = len;
+    slot->remote_ip = (uint32_t)packet.remoteIP();
+    slot->remote_port = packet.remotePort();
+    xQueueSend(rx_ready, &index, 0);
+}
+
+void EnhancedSIPClient::drainPackets() {
+    if (!rx_ready) return;
+
+    int handled = 0;
+    uint8_t index;
+    while (handled < SIP_RX_BATCH && xQueueReceive(rx_ready, &index, 0) == pdTRUE) {
+        handleIncomingPacket(&rx_slots[index]);
+        xQueueSend(rx_free, &index, 0);
+        handled++;
+    }
+    rx_backlog = handled == SIP_RX_BATCH;
+}
+
+// Любая задача: calls[] не трогаем, команду выполнит process()
+bool EnhancedSIPClient::makeCall(const char* to_uri) {
+    if (!cmd_queue || !to_uri || strlen(to_uri) >= URI_LEN) {
+        Serial.println("SIP: makeCall: команда не принята");
+        return false;
+    }
+    sip_cmd_t cmd;
+    cmd.type = SIP_CMD_MAKE_CALL;
+    cmd.call_id = -1;
+    strncpy(cmd.to_uri, to_uri, URI_LEN - 1);
+    cmd.to_uri[URI_LEN - 1] = '\0';
+    if (xQueueSend(cmd_queue, &cmd, 0) != pdTRUE) {
+        Serial.println("SIP: makeCall: очередь команд полна");
+        return false;
+    }
+    return true;
+}
+
+bool EnhancedSIPClient::hangupCall(int call_id) {
+    if (!cmd_queue) {
+        Serial.println("SIP: hangupCall: команда не принята");
+        return false;
+    }
+    sip_cmd_t cmd;
+    cmd.type = SIP_CMD_HANGUP;
+    cmd.call_id = call_id;
+    cmd.to_uri[0] = '\0';
+    if (xQueueSend(cmd_queue, &cmd, 0) != pdTRUE) {
+        Serial.println("SIP: hangupCall: очередь команд полна");
+        return false;
+    }
+    return true;
+}
+
+void EnhancedSIPClient::drainCommands() {
+    if (!cmd_queue) return;
+
+    sip_cmd_t cmd;
+    while (xQueueReceive(cmd_queue, &cmd, 0) == pdTRUE) {
+        if (cmd.type == SIP_CMD_MAKE_CALL) {
+            startCall(cmd.to_uri);
+        } else {
+            endCall(cmd.call_id < 0 ? getFirstActiveCallId() : cmd.call_id);
+        }
+    }
+}
+
+bool EnhancedSIPClient::waitForPacket(uint32_t timeout_ms) {
+    if (!rx_ready) {
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        return false;
+    }
+    if (rx_backlog) {
+        // Остальное - после паузы: под наплывом SIP не больше пачки за тик
+        vTaskDelay(1);
+        return true;
+    }
+    uint8_t index;
+    return xQueuePeek(rx_ready, &index, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+void EnhancedSIPClient::handleIncomingPacket(sip_rx_slot_t* slot) {
     // Получаем IP и порт отправителя
-    IPAddress remoteIP = packet.remoteIP();
-    uint16_t remotePort = packet.remotePort();
+    IPAddress remoteIP(slot->remote_ip);
+    uint16_t remotePort = slot->remote_port;
+    if (slot->len >= 12 && memcmp(slot->data, "SIP/2.0 ", 8) == 0) {
+        metrics.inc(metric_rx_responses);
+        if (slot->data[8] >= '4') {
+            metrics.inc(metric_rx_error_responses);
+        }
+    } else {
+        metrics.inc(metric_rx_requests);
+    }
     
     // Проверяем валидность IP
     if (remoteIP == INADDR_NONE) {
@@ -296,14 +454,11 @@ void EnhancedSIPClient::handleIncomingPacket(AsyncUDPPacket& packet) {
         return;
     }
 
-    char buffer[1024];
-    size_t len = packet.length();
-    if (len >= sizeof(buffer)) {
-        len = sizeof(buffer) - 1;
+    char* buffer = slot->data;
+    size_t len = slot->len;
+    if (slot->truncated) {
         Serial.println("SIP: Warning: Packet too long, truncated.\n");
     }
-    memcpy(buffer, packet.data(), len);
-    buffer[len] = '\0';
 
     // +++ ДЕТАЛЬНАЯ ОТЛАДКА +++
     Serial.println("==========================================");
@@ -858,7 +1013,9 @@ void EnhancedSIPClient::handleIncomingINVITE(const char* data, size_t len, const
                     
                     // КРИТИЧЕСКИ ВАЖНО: используем СУЩЕСТВУЮЩИЙ To-tag, не генерируем новый!
                     sendResponse(200, "OK", calls[i].remote_ip, calls[i].remote_sip_port, 
-                                data, calls[i].to_tag, true, calls[i].local_rtp_port);
+                                data, calls[i].to_tag, true, calls[i].local_rtp_port,
+                                calls[i].payload_type, calls[i].g729_annexb, calls[i].red_pt,
+                                calls[i].ptime);
                     
                     Serial.println("SIP: 200 OK отправлен повторно для ретрансляции");
                 } else if (calls[i].state == CALL_STATE_ACTIVE) {
@@ -961,11 +1118,37 @@ void EnhancedSIPClient::handleIncomingINVITE(const char* data, size_t len, const
     const char* sdp_start = strstr(data, "\r\n\r\n");
     char temp_remote_rtp_ip[16] = {0};
     uint16_t temp_remote_rtp_port = 0;
+    call->payload_type = AUDIO_CODEC_PCMA;
+    call->g729_annexb = configManager->isG729AnnexBEnabled();
+    call->red_pt = 0;
+    call->ptime = configManager->getAudioPacketTime();
 
     if (sdp_start) {
         sdp_start += 4;
         Serial.printf("SIP DEBUG: SDP Body:\n%s\n", sdp_start);
 
+        // Выбор кодека из предложения
+        call->payload_type = negotiatePayloadType(sdp_start);
+        Serial.printf("SIP: Согласован кодек PT=%d\n", call->payload_type);
+        if (call->payload_type == AUDIO_CODEC_G729) {
+            call->g729_annexb = negotiateG729AnnexB(sdp_start);
+            Serial.printf("SIP: G.729 Annex B: %s\n", call->g729_annexb ? "yes" : "no");
+        }
+        call->red_pt = negotiateRedundancy(sdp_start, call->payload_type);
+        if (call->red_pt) {
+            Serial.printf("SIP: Избыточность RFC 2198: PT=%d\n", call->red_pt);
+        }
+        call->ptime = negotiatePacketTime(sdp_start, call->payload_type);
+        Serial.printf("SIP: ptime %d мс\n", call->ptime);
+
+        // Хватит ли полосы канала UART до AudioKit на еще один вызов
+        if (audioManager && !audioManager->admitCall(slot, call->payload_type)) {
+            Serial.println("SIP: Канал AudioKit занят, отклоняем INVITE");
+            sendResponse(503, "Service Unavailable", remote_ip, remote_port, data, nullptr, false, 0);
+            resetCall(call);
+            return;
+        }
+
         // Извлечение IP из строки c=IN IP4 ...
         const char* c_line = strstr(sdp_start, "c=IN IP4 ");
         if (c_line) {
@@ -1031,18 +1214,25 @@ void EnhancedSIPClient::handleIncomingINVITE(const char* data, size_t len, const
     Serial.println("SIP DEBUG: Finished extracting headers and SDP");
 
     // --- НАЗНАЧЕНИЕ ЛОКАЛЬНОГО RTP ПОРТА и SSRC ---
-    call->local_rtp_port = configManager->getRTPBasePort() + (slot * 2);
+    call->local_rtp_port = rtpManager->getLocalPort(slot); // Сокет пула (общий или свой порт)
     call->ssrc = esp_random();
     Serial.printf("SIP DEBUG: Assigned local RTP port: %d, SSRC: %u\n", call->local_rtp_port, call->ssrc);
 
     // --- НАСТРОЙКА RTP КАНАЛА ---
-    uint8_t payload_type = 8;
+    uint8_t payload_type = call->payload_type;
+    if (audioManager) {
+        // Контексты кодеков пересоздаются здесь, а не при активации в потоке RTP
+        audioManager->getCodecManager().setCallVAD(slot, call->g729_annexb);
+        audioManager->getCodecManager().prepareCall(slot);
+        audioManager->setCallPacketTime(slot, call->ptime);
+    }
     if (!rtpManager->setupChannel(slot, temp_remote_rtp_ip, temp_remote_rtp_port, call->local_rtp_port, call->ssrc, payload_type)) {
         Serial.printf("SIP: Ошибка: Не удалось настроить RTP канал %d\n", slot);
         sendResponse(500, "Internal Server Error", remote_ip, remote_port, data, nullptr, false, 0);
         resetCall(call);
         return;
     }
+    rtpManager->setRedundancy(slot, call->red_pt);
     Serial.printf("SIP DEBUG: RTP channel %d setup completed.\n", slot);
 
     // --- ОПРЕДЕЛЕНИЕ АДРЕСА ОТПРАВКИ ОТВЕТА (200 OK) ---
@@ -1148,7 +1338,8 @@ void EnhancedSIPClient::handleIncomingINVITE(const char* data, size_t len, const
     // --- ОТПРАВКА 200 OK ---
     Serial.println("ОТПРАВКА 200 OK");
     // Используем тот же To-tag, что и в Ringing!
-    sendResponse(200, "OK", target_ip, target_port, data, initial_to_tag, true, call->local_rtp_port);
+    sendResponse(200, "OK", target_ip, target_port, data, initial_to_tag, true, call->local_rtp_port,
+                 call->payload_type, call->g729_annexb, call->red_pt, call->ptime);
 
     // Устанавливаем состояние ОЖИДАНИЯ ACK
     call->state = CALL_STATE_WAITING_FOR_ACK;
@@ -1300,7 +1491,7 @@ void EnhancedSIPClient::handleIncomingCANCEL(const char* data, size_t len, const
 
 // EnhancedSIPClient.cpp (внутри класса)
 
-void EnhancedSIPClient::makeCall(const char* to_uri) {
+void EnhancedSIPClient::startCall(const char* to_uri) {
     if (!networkManager || !networkManager->isConnected()) {
         Serial.println("SIP: makeCall: Сеть не подключена\n");
         return;
@@ -1314,10 +1505,13 @@ void EnhancedSIPClient::makeCall(const char* to_uri) {
         Serial.println("SIP: Ошибка: Нет свободных слотов для вызова\n");
         return;
     }
-
     call_t* call = &calls[slot];
     resetCall(call);
     call->id = slot;
+    if (audioManager && !audioManager->admitCall(slot, configManager->getPrimaryCodec())) {
+        Serial.println("SIP: Ошибка: Канал AudioKit занят, вызов не создан");
+        return;
+    }
     call->state = CALL_STATE_OUTGOING; // <-- Изменено
     strncpy(call->call_id, call_id, sizeof(call->call_id) - 1);
     call->call_id[sizeof(call->call_id) - 1] = '\0';
@@ -1331,8 +1525,8 @@ void EnhancedSIPClient::makeCall(const char* to_uri) {
     // Извлечение IP и порта из to_uri (предполагается формат sip:user@ip:port)
     parseContactURI(to_uri, call->remote_ip, &call->remote_sip_port);
 
-    // Генерация локального RTP порта (проверка на занятость опциональна)
-    call->local_rtp_port = configManager->getRTPBasePort() + (slot * 2);
+    // Локальный RTP порт - сокет пула, открытый при загрузке
+    call->local_rtp_port = rtpManager->getLocalPort(slot);
     call->ssrc = esp_random(); // Генерация SSRC для RTP
 
     // Формирование INVITE сообщения
@@ -1365,7 +1559,8 @@ void EnhancedSIPClient::makeCall(const char* to_uri) {
                        "a=rtpmap:8 PCMA/8000\r\n"
                        "a=rtpmap:9 G722/8000\r\n"
                        "a=rtpmap:101 telephone-event/8000\r\n"
-                       "a=fmtp:101 0-15\r\n",
+                       "a=fmtp:101 0-15\r\n"
+                       "a=ptime:%d\r\n",
                        to_uri, // Request-URI
                        local_ip, SIP_PORT, branch, // <-- Вот тут будет правильный IP
                        call->from_uri, esp_random(), // From URI, tag
@@ -1376,7 +1571,8 @@ void EnhancedSIPClient::makeCall(const char* to_uri) {
                        120, // Примерная длина SDP, рассчитывается точно
                        esp_random(), esp_random(), local_ip, // o= line
                        local_ip, // c= line
-                       call->local_rtp_port); // m= line port
+                       call->local_rtp_port, // m= line port
+                       configManager->getAudioPacketTime()); // a=ptime
 
     if (len < 0 || len >= (int)sizeof(invite)) {
         Serial.println("SIP: Ошибка: INVITE сообщение слишком длинное\n");
@@ -1390,7 +1586,7 @@ void EnhancedSIPClient::makeCall(const char* to_uri) {
     webInterface->addCallToHistory(to_uri, "outgoing", 0); // Добавляем в историю
 }
 
-void EnhancedSIPClient::hangupCall(int call_id) {
+void EnhancedSIPClient::endCall(int call_id) {
     if (call_id < 0 || call_id >= max_calls || calls[call_id].state == CALL_STATE_IDLE) {
         Serial.printf("SIP: Попытка завершить несуществующий вызов %d\n", call_id);
         return;
@@ -1467,7 +1663,8 @@ void EnhancedSIPClient::hangupCall(int call_id) {
 // --- ОТПРАВКА ОТВЕТА НА ЗАПРОС ---
 // --- ОТПРАВКА ОТВЕТА НА ЗАПРОС ---
 void EnhancedSIPClient::sendResponse(int code, const char* reason, const char* dst_ip, uint16_t dst_port,
-                                     const char* request, const char* to_tag, bool with_sdp, uint16_t local_rtp_port) {
+                                     const char* request, const char* to_tag, bool with_sdp, uint16_t local_rtp_port,
+                                     uint8_t payload_type, bool g729_annexb, uint8_t red_pt, uint8_t ptime) {
     
     Serial.printf("=== sendResponse ENTER === code: %d\n", code);
     Serial.printf("Stack free: %d\n", esp_get_free_heap_size());
@@ -1620,7 +1817,7 @@ void EnhancedSIPClient::sendResponse(int code, const char* reason, const char* d
     if (with_sdp) {
         Serial.println("Generating SDP...");
         char sdp_body[512];
-        generateSDPBody(sdp_body, sizeof(sdp_body), local_ip, local_rtp_port);
+        generateSDPBody(sdp_body, sizeof(sdp_body), local_ip, local_rtp_port, payload_type, g729_annexb, red_pt, ptime);
         Serial.printf("SDP generated, length: %d\n", strlen(sdp_body));
         
         len = snprintf(msg, 2048,
@@ -1699,7 +1896,8 @@ void EnhancedSIPClient::sendResponse(int code, const char* reason, const char* d
     Serial.println("=== sendResponse EXIT ===");
 }
 
-void EnhancedSIPClient::generateSDPBody(char* buffer, size_t buffer_size, const char* local_ip, uint16_t local_rtp_port) {
+void EnhancedSIPClient::generateSDPBody(char* buffer, size_t buffer_size, const char* local_ip, uint16_t local_rtp_port,
+                                        uint8_t payload_type, bool g729_annexb, uint8_t red_pt, uint8_t ptime) {
     Serial.printf("generateSDPBody: buffer_size=%d, local_ip=%s, local_rtp_port=%d\n", 
                   buffer_size, local_ip, local_rtp_port);
     
@@ -1711,20 +1909,56 @@ void EnhancedSIPClient::generateSDPBody(char* buffer, size_t buffer_size, const
     uint32_t session_id = esp_random();
     uint32_t version = esp_random();
     
+    // Имя и частота часов RTP для a=rtpmap (G.722 объявляется как G722/8000 по RFC 3551)
+    const char* codec_name = "PCMA";
+    int clock_rate = 8000;
+    if (audioManager) {
+        CodecManager& codecs = audioManager->getCodecManager();
+        if (codecs.isCodecAvailable(payload_type)) {
+            codec_name = codecs.getCodecName(payload_type);
+            clock_rate = codecs.getRTPClockRate(payload_type);
+        } else {
+            payload_type = AUDIO_CODEC_PCMA;
+        }
+    }
+    
+    // red/8000 после основного кодека: избыточность используется только при потерях
+    char red_pt_str[6] = "";
+    if (red_pt) {
+        snprintf(red_pt_str, sizeof(red_pt_str), " %d", red_pt);
+    }
+    
     int len = snprintf(buffer, buffer_size,
         "v=0\r\n"
         "o=- %lu %lu IN IP4 %s\r\n"
         "s=ALINA SIP Client\r\n"
         "c=IN IP4 %s\r\n"
         "t=0 0\r\n"
-        "m=audio %d RTP/AVP 8 101\r\n"
-        "a=rtpmap:8 PCMA/8000\r\n"
+        "m=audio %d RTP/AVP %d 101%s\r\n"
+        "a=rtpmap:%d %s/%d\r\n"
         "a=rtpmap:101 telephone-event/8000\r\n"
-        "a=fmtp:101 0-16\r\n"
-        "a=sendrecv\r\n",
+        "a=fmtp:101 0-16\r\n",
         session_id, version, local_ip,
         local_ip,
-        local_rtp_port);
+        local_rtp_port, payload_type, red_pt_str,
+        payload_type, codec_name, clock_rate);
+    
+    if (red_pt && len > 0 && len < (int)buffer_size) {
+        len += snprintf(buffer + len, buffer_size - len, "a=rtpmap:%d red/8000\r\na=fmtp:%d %d/%d/%d\r\n",
+                        red_pt, red_pt, payload_type, payload_type, payload_type);
+    }
+    if (ptime && len > 0 && len < (int)buffer_size) {
+        len += snprintf(buffer + len, buffer_size - len, "a=ptime:%d\r\n", ptime);
+    }
+    if (len > 0 && len < (int)buffer_size) {
+        len += snprintf(buffer + len, buffer_size - len, "a=sendrecv\r\n");
+    }
+    
+    // RFC 3555: без annexb=no считается, что Annex B включен
+    if (payload_type == AUDIO_CODEC_G729 && len > 0 && len < (int)buffer_size) {
+        len += snprintf(buffer + len, buffer_size - len, "a=fmtp:%d annexb=%s\r\n",
+                        payload_type, g729_annexb ? "yes" : "no");
+    }
     
     Serial.printf("SDP generated, length: %d\n", len);
     
@@ -1734,6 +1968,137 @@ void EnhancedSIPClient::generateSDPBody(char* buffer, size_t buffer_size, const
     }
 }
 
+// Выбор аудио кодека из SDP предложения: основной, затем резервный,
+// затем первый поддерживаемый в порядке предложения
+uint8_t EnhancedSIPClient::negotiatePayloadType(const char* sdp) {
+    const char* m_line = sdp ? strstr(sdp, "m=audio ") : nullptr;
+    if (!m_line) {
+        return AUDIO_CODEC_PCMA;
+    }
+    
+    // Пропускаем "m=audio <port> <proto>"
+    const char* p = m_line + 8;
+    for (int field = 0; field < 2 && *p; field++) {
+        while (*p && *p != ' ' && *p != '\r' && *p != '\n') p++;
+        while (*p == ' ') p++;
+    }
+    
+    uint8_t offered[16];
+    int offered_count = 0;
+    while (*p && *p != '\r' && *p != '\n' && offered_count < 16) {
+        int pt = atoi(p);
+        if (pt >= 0 && pt < 128) {
+            offered[offered_count++] = (uint8_t)pt;
+        }
+        while (*p && *p != ' ' && *p != '\r' && *p != '\n') p++;
+        while (*p == ' ') p++;
+    }
+    
+    auto isAvailable = [this](uint8_t pt) {
+        if (audioManager) {
+            return audioManager->getCodecManager().isCodecAvailable(pt);
+        }
+        return pt == AUDIO_CODEC_PCMU || pt == AUDIO_CODEC_PCMA;
+    };
+    auto isOffered = [&](uint8_t pt) {
+        for (int i = 0; i < offered_count; i++) {
+            if (offered[i] == pt) return true;
+        }
+        return false;
+    };
+    
+    if (configManager) {
+        uint8_t preferred[2] = { configManager->getPrimaryCodec(), configManager->getSecondaryCodec() };
+        for (int i = 0; i < 2; i++) {
+            if (isOffered(preferred[i]) && isAvailable(preferred[i])) {
+                return preferred[i];
+            }
+        }
+    }
+    
+    for (int i = 0; i < offered_count; i++) {
+        if (isAvailable(offered[i])) {
+            return offered[i];
+        }
+    }
+    
+    Serial.println("SIP: Warning: нет общего кодека в SDP, используем PCMA");
+    return AUDIO_CODEC_PCMA;
+}
+
+// Режим G.729 Annex B: включен, если разрешен в настройках и не отключен
+// собеседником через a=fmtp:18 annexb=no
+bool EnhancedSIPClient::negotiateG729AnnexB(const char* sdp) {
+    bool enabled = configManager ? configManager->isG729AnnexBEnabled() : true;
+    const char* fmtp = sdp ? strstr(sdp, "a=fmtp:18 ") : nullptr;
+    if (fmtp) {
+        const char* end = strchr(fmtp, '\n');
+        const char* annexb = strstr(fmtp, "annexb=no");
+        if (annexb && (!end || annexb < end)) {
+            enabled = false;
+        }
+    }
+    return enabled;
+}
+
+// Избыточность RFC 2198: только если собеседник предложил red/8000 в m=audio,
+// кодек вызова G.711 (кадры переносятся без перекодирования) и порог включен
+uint8_t EnhancedSIPClient::negotiateRedundancy(const char* sdp, uint8_t payload_type) {
+    if (!sdp || !configManager || configManager->getRedLossThreshold() == 0 ||
+        (payload_type != AUDIO_CODEC_PCMU && payload_type != AUDIO_CODEC_PCMA)) {
+        return 0;
+    }
+    
+    const char* rtpmap = sdp;
+    while ((rtpmap = strstr(rtpmap, "a=rtpmap:")) != nullptr) {
+        rtpmap += 9;
+        int pt = atoi(rtpmap);
+        const char* name = strchr(rtpmap, ' ');
+        const char* end = strchr(rtpmap, '\n');
+        if (!name || (end && name > end) || strncasecmp(name + 1, "red/8000", 8) != 0) {
+            continue;
+        }
+        if (pt < 96 || pt > 127) {
+            return 0;
+        }
+        
+        // Payload type должен быть в списке m=audio
+        const char* m_line = strstr(sdp, "m=audio ");
+        const char* m_end = m_line ? strchr(m_line, '\n') : nullptr;
+        char pt_str[6];
+        snprintf(pt_str, sizeof(pt_str), " %d", pt);
+        for (const char* p = m_line; p && (p = strstr(p, pt_str)) != nullptr && (!m_end || p < m_end); p++) {
+            char next = p[strlen(pt_str)];
+            if (next == ' ' || next == '\r' || next == '\n' || next == '\0') {
+                return (uint8_t)pt;
+            }
+        }
+        return 0;
+    }
+    return 0;
+}
+
+// Длительность пакета: a=ptime собеседника, если она поддерживается
+// (10/20/30/40/60 мс), иначе из настроек. Ответ объявляет ту же величину,
+// поэтому пакеты в обе стороны одной длительности. G.729 - не короче 20 мс
+uint8_t EnhancedSIPClient::negotiatePacketTime(const char* sdp, uint8_t payload_type) {
+    int ptime = configManager ? configManager->getAudioPacketTime() : 20;
+    const char* attr = sdp ? strstr(sdp, "a=ptime:") : nullptr;
+    if (attr) {
+        int offered = atoi(attr + 8);
+        if (ConfigManager::isSupportedPacketTime(offered)) {
+            ptime = offered;
+        } else {
+            Serial.printf("SIP: ptime %d мс не поддерживается, используем %d\n", offered, ptime);
+        }
+    }
+    if (payload_type == AUDIO_CODEC_G729 && ptime < G729_MIN_PACKET_MS) {
+        Serial.printf("SIP: ptime %d мс для G.729 не поддерживается, используем %d\n", ptime, G729_MIN_PACKET_MS);
+        ptime = G729_MIN_PACKET_MS;
+    }
+    return (uint8_t)ptime;
+}
+
 bool EnhancedSIPClient::extractFirstViaHeader(const char* data, size_t len, char* output, size_t out_size) {
     Serial.printf("extractFirstViaHeader: data=%p, len=%d, out_size=%d\n", data, len, out_size);
     
@@ -2073,6 +2438,10 @@ void EnhancedSIPClient::resetCall(call_t* call) {
         Serial.println("SIP DEBUG: resetCall called with nullptr!");
         return;
     }
+    // Слот свободен - полоса канала AudioKit тоже
+    if (audioManager && calls && call >= calls && call < calls + max_calls) {
+        audioManager->releaseCall(call - calls);
+    }
     // ВАЖНО: Обнуляем всю структуру
     memset(call, 0, sizeof(call_t));
     // Устанавливаем начальное состояние
@@ -2107,9 +2476,16 @@ void EnhancedSIPClient::sendSIPMessage(const char* ip, uint16_t port, const char
     IPAddress addr;
     if (addr.fromString(ip)) {
         bool success = networkManager->udp.writeTo((uint8_t*)msg, strlen(msg), addr, port);
+        packetCapture.capture(PCAP_KIND_SIP, PCAP_DIR_TX, PCAP_ANY_CALL, (uint32_t)addr, port,
+                              SIP_PORT, (const uint8_t*)msg, strlen(msg));
         if (!success) {
+            metrics.inc(metric_send_errors);
             Serial.printf("SIP: Ошибка отправки SIP сообщения на %s:%d\n", ip, port);
         } else {
+            metrics.inc(strncmp(msg, "SIP/2.0 ", 8) == 0 ? metric_tx_responses : metric_tx_requests);
+            if (networkManager->udp.getTOS()) {
+                metrics.inc(metric_dscp_marked);
+            }
             Serial.printf("SIP: Сообщение отправлено на %s:%d\n", ip, port);
         }
     } else {
@@ -5,6 +5,8 @@
 
 #include "Arduino.h"
 #include "AsyncUDP.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 #include "AudioManager.h" // Убедитесь, что этот файл существует
 #include "RTPManager.h"   // Убедитесь, что этот файл существует
 #include "EnhancedNetworkManager.h" // Убедитесь, что этот файл существует
@@ -47,6 +49,40 @@ enum call_state_t {
 #define MAX_QOP_VALUE_LEN 16 // <-- Добавлено, если нужно для auth_info_t
 // ---
 
+// Прием SIP: обработчик AsyncUDP (поток сети) только копирует датаграмму в
+// свободную ячейку и ставит ее номер в очередь. Разбор, диалоги, регистрация и
+// аутентификация - в process() владельца (задача Signaling или loop()), других
+// потоков у calls[], auth_info и sip_state нет. Очередь ограничена: при всплеске
+// лишние датаграммы отбрасываются (UDP, отправитель повторит), за один
+// process() разбирается не больше SIP_RX_BATCH
+#define SIP_RX_SLOTS 8
+#define SIP_RX_SLOT_SIZE 1024        // Длиннее - усекается
+#define SIP_RX_BATCH 4
+
+// Команды (makeCall/hangupCall) из любой задачи - loop() скетча на ядре медиа,
+// веб-обработчики - тоже только ставятся в очередь и выполняются в process()
+// владельца перед разбором датаграмм
+#define SIP_CMD_SLOTS 4
+
+enum sip_cmd_type_t {
+    SIP_CMD_MAKE_CALL,
+    SIP_CMD_HANGUP
+};
+
+typedef struct {
+    uint32_t remote_ip;
+    uint16_t remote_port;
+    uint16_t len;
+    bool truncated;
+    char data[SIP_RX_SLOT_SIZE];
+} sip_rx_slot_t;
+
+typedef struct {
+    sip_cmd_type_t type;
+    int call_id;                 // SIP_CMD_HANGUP: номер слота, -1 - первый активный
+    char to_uri[URI_LEN];        // SIP_CMD_MAKE_CALL
+} sip_cmd_t;
+
 // Структура для хранения информации о вызове
 typedef struct {
     int id;
@@ -70,6 +106,10 @@ typedef struct {
     // --- Добавлены поля ---
     char record_route[RECORD_ROUTE_LEN]; // <-- Добавлено для хранения Record-Route
     uint32_t ssrc;                       // <-- Добавлено для RTP SSRC
+    uint8_t payload_type;                // Согласованный в SDP аудио кодек
+    bool g729_annexb;                    // Согласованный режим G.729 Annex B
+    uint8_t red_pt;                      // Payload type red/8000 (RFC 2198), 0 - не согласован
+    uint8_t ptime;                       // Длительность RTP пакета, мс (a=ptime)
     // ---
 } call_t;
 
@@ -94,8 +134,11 @@ public:
     // Инициализация с зависимостями
     void init(EnhancedNetworkManager* netMgr, AudioManager* audioMgr, RTPManager* rtpMgr, WebInterface* webInt, ConfigManager* cfgMgr);
 
-    // Основной цикл обработки
+    // Основной цикл обработки: принятые датаграммы, затем таймеры регистрации и вызовов
     void process();
+    // Ожидание датаграммы до timeout_ms (задача Signaling вместо паузы);
+    // после полной пачки - пауза в тик, чтобы всплеск не занял ядро
+    bool waitForPacket(uint32_t timeout_ms);
 
     // Установка учётных данных SIP
     void setSIPCredentials(const char* user, const char* password, const char* server, uint16_t port);
@@ -106,11 +149,11 @@ public:
     // Состояние SIP
     sip_state_t getState() const { return sip_state; }
 
-    // Начать вызов
-    void makeCall(const char* to_uri);
+    // Начать вызов (из любой задачи; false - очередь команд полна или URI длинный)
+    bool makeCall(const char* to_uri);
 
-    // Завершить вызов
-    void hangupCall(int call_id);
+    // Завершить вызов (из любой задачи; -1 - первый активный)
+    bool hangupCall(int call_id);
 
     // --- ГЕТТЕРЫ для WebInterface ---
     call_state_t getCallState(int call_index) const;
@@ -124,7 +167,9 @@ public:
     // Сброс аутентификации (например, при изменении настроек)
     void resetAuth();
     void sendResponse(int code, const char* reason, const char* dst_ip, uint16_t dst_port,
-                     const char* request, const char* to_tag, bool with_sdp, uint16_t local_rtp_port);
+                     const char* request, const char* to_tag, bool with_sdp, uint16_t local_rtp_port,
+                     uint8_t payload_type = AUDIO_CODEC_PCMA, bool g729_annexb = true, uint8_t red_pt = 0,
+                     uint8_t ptime = 0);
 
     void sendRinging(const char* request, const char* dst_ip, uint16_t dst_port, const char* to_tag = nullptr);   
     void sendTrying(const char* request, const char* dst_ip, uint16_t dst_port);
@@ -169,9 +214,21 @@ private:
     call_t* calls;
     uint32_t sip_cseq; // Общий CSeq для запросов
 
+    // --- Очередь приема ---
+    sip_rx_slot_t* rx_slots;
+    QueueHandle_t rx_free;      // Номера свободных ячеек
+    QueueHandle_t rx_ready;     // Номера принятых датаграмм по порядку прихода
+    bool rx_backlog;            // Последний проход разобрал полную пачку
+    QueueHandle_t cmd_queue;    // sip_cmd_t от makeCall/hangupCall
+
     // --- Внутренние методы ---
     void handleRegistration(bool is_retry_after_401 = false); // Изменённый метод
-    void handleIncomingPacket(AsyncUDPPacket& packet); // <-- Изменено объявление, принимает &
+    void enqueuePacket(AsyncUDPPacket& packet); // Поток AsyncUDP
+    void drainPackets();
+    void handleIncomingPacket(sip_rx_slot_t* slot);
+    void drainCommands();
+    void startCall(const char* to_uri);
+    void endCall(int call_id);
     void handleIncomingRequest(const char* data, size_t len, const char* remote_ip, uint16_t remote_port);
     void handleIncomingResponse(const char* data, size_t len, const char* remote_ip, uint16_t remote_port);
     void handleIncomingINVITE(const char* data, size_t len, const char* remote_ip, uint16_t remote_port);
@@ -194,7 +251,12 @@ private:
     bool validateNetwork() const;
     bool validateSIPCredentials() const;
     bool extractFirstViaHeader(const char* data, size_t len, char* output, size_t out_size);
-    void generateSDPBody(char* buffer, size_t buffer_size, const char* local_ip, uint16_t local_rtp_port);
+    void generateSDPBody(char* buffer, size_t buffer_size, const char* local_ip, uint16_t local_rtp_port,
+                         uint8_t payload_type, bool g729_annexb = true, uint8_t red_pt = 0, uint8_t ptime = 0);
+    uint8_t negotiatePayloadType(const char* sdp);
+    bool negotiateG729AnnexB(const char* sdp);
+    uint8_t negotiateRedundancy(const char* sdp, uint8_t payload_type);
+    uint8_t negotiatePacketTime(const char* sdp, uint8_t payload_type);
 };
 
 extern EnhancedSIPClient sipClient;
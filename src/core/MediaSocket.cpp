@@ -0,0 +1,175 @@
+/*
+ * MediaSocket.cpp - Реализация медиа-сокета на raw API lwIP
+ */
+
+#include "MediaSocket.h"
+#include <esp_timer.h>
+
+extern "C" {
+#include "lwip/tcpip.h"
+}
+#include "lwip/priv/tcpip_priv.h"
+
+#define MEDIA_OP_BIND 0
+#define MEDIA_OP_SENDTO 1
+#define MEDIA_OP_REMOVE 2
+
+// Вызов raw API в потоке tcpip (как в AsyncUDP)
+typedef struct {
+    struct tcpip_api_call_data call;
+    int op;
+    struct udp_pcb* pcb;
+    struct pbuf* p;
+    ip_addr_t addr;
+    uint16_t port;
+    udp_recv_fn recv;
+    void* recv_arg;
+    err_t err;
+} media_api_call_t;
+
+TaskHandle_t MediaSocket::tcpip_task = nullptr;
+
+// Сборка цепочек pbuf: все обработчики выполняются в одном потоке tcpip
+static uint8_t* rx_chain_buffer = nullptr;
+
+static err_t mediaApiCall(struct tcpip_api_call_data* data) {
+    media_api_call_t* msg = (media_api_call_t*)data;
+    msg->err = ERR_OK;
+    switch (msg->op) {
+        case MEDIA_OP_BIND:
+            msg->pcb = udp_new();
+            if (!msg->pcb) {
+                msg->err = ERR_MEM;
+                break;
+            }
+            msg->err = udp_bind(msg->pcb, IP_ADDR_ANY, msg->port);
+            if (msg->err != ERR_OK) {
+                udp_remove(msg->pcb);
+                msg->pcb = nullptr;
+                break;
+            }
+            udp_recv(msg->pcb, msg->recv, msg->recv_arg);
+            break;
+        case MEDIA_OP_SENDTO:
+            msg->err = udp_sendto(msg->pcb, msg->p, &msg->addr, msg->port);
+            break;
+        case MEDIA_OP_REMOVE:
+            udp_recv(msg->pcb, nullptr, nullptr);
+            udp_remove(msg->pcb);
+            break;
+    }
+    return msg->err;
+}
+
+MediaSocket::MediaSocket() :
+    pcb(nullptr),
+    handler(nullptr),
+    handler_ctx(nullptr) {
+}
+
+MediaSocket::~MediaSocket() {
+    close();
+}
+
+err_t MediaSocket::call(int op, struct pbuf* p, uint32_t remote_ip, uint16_t remote_port) {
+    media_api_call_t msg;
+    msg.op = op;
+    msg.pcb = pcb;
+    msg.p = p;
+    ip_addr_set_ip4_u32(&msg.addr, remote_ip);
+    msg.port = remote_port;
+    msg.recv = recvCallback;
+    msg.recv_arg = this;
+    msg.err = ERR_OK;
+
+    // Из обработчика приема (ретрансляция) - уже в потоке tcpip
+    if (tcpip_task && xTaskGetCurrentTaskHandle() == tcpip_task) {
+        mediaApiCall(&msg.call);
+    } else {
+        tcpip_api_call(mediaApiCall, &msg.call);
+    }
+    if (op == MEDIA_OP_BIND) {
+        pcb = msg.pcb;
+    }
+    return msg.err;
+}
+
+bool MediaSocket::open(uint16_t local_port, media_packet_handler_t packet_handler, void* ctx) {
+    close();
+    if (!rx_chain_buffer) {
+        rx_chain_buffer = (uint8_t*)malloc(MEDIA_SOCKET_MAX_PACKET);
+        if (!rx_chain_buffer) {
+            Serial.println("MediaSocket: ОШИБКА выделения памяти");
+            return false;
+        }
+    }
+    handler = packet_handler;
+    handler_ctx = ctx;
+    if (call(MEDIA_OP_BIND, nullptr, 0, local_port) != ERR_OK || !pcb) {
+        Serial.printf("MediaSocket: Ошибка привязки порта %d\n", local_port);
+        pcb = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void MediaSocket::close() {
+    if (pcb) {
+        call(MEDIA_OP_REMOVE, nullptr, 0, 0);
+        pcb = nullptr;
+    }
+}
+
+void MediaSocket::recvCallback(void* arg, struct udp_pcb* upcb, struct pbuf* p, const ip_addr_t* addr, u16_t port) {
+    int64_t arrival_us = esp_timer_get_time();
+    MediaSocket* socket = (MediaSocket*)arg;
+    tcpip_task = xTaskGetCurrentTaskHandle();
+    if (!p) return;
+
+    if (socket->handler) {
+        uint32_t remote_ip = ip4_addr_get_u32(ip_2_ip4(addr));
+        if (!p->next) {
+            socket->handler((const uint8_t*)p->payload, p->len, remote_ip, port, arrival_us, socket->handler_ctx);
+        } else {
+            // Цепочка (фрагменты или мелкие буферы драйвера) - единственная копия
+            uint16_t len = pbuf_copy_partial(p, rx_chain_buffer, MEDIA_SOCKET_MAX_PACKET, 0);
+            socket->handler(rx_chain_buffer, len, remote_ip, port, arrival_us, socket->handler_ctx);
+        }
+    }
+    pbuf_free(p);
+}
+
+uint8_t* MediaSocket::beginPacket(media_tx_t* tx, size_t len) {
+    if (tx->p) {
+        // lwIP оставляет заголовки UDP/IP/Ethernet перед данными - возврат к началу пакета
+        if (tx->p->ref == 1 && tx->p->payload != tx->payload) {
+            pbuf_remove_header(tx->p, (uint8_t*)tx->payload - (uint8_t*)tx->p->payload);
+        }
+        // Pbuf еще в очереди драйвера/ARP или другой длины - нужен новый
+        if (tx->p->ref != 1 || tx->p->tot_len != len || tx->p->payload != tx->payload) {
+            releasePacket(tx);
+        }
+    }
+    if (!tx->p) {
+        tx->p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+        if (!tx->p) {
+            return nullptr;
+        }
+        tx->payload = tx->p->payload;
+    }
+    return (uint8_t*)tx->payload;
+}
+
+bool MediaSocket::send(media_tx_t* tx, uint32_t remote_ip, uint16_t remote_port) {
+    if (!pcb || !tx->p || remote_ip == 0) {
+        return false;
+    }
+    return call(MEDIA_OP_SENDTO, tx->p, remote_ip, remote_port) == ERR_OK;
+}
+
+void MediaSocket::releasePacket(media_tx_t* tx) {
+    if (tx->p) {
+        pbuf_free(tx->p);
+        tx->p = nullptr;
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * MediaSocket.h - UDP сокет медиа-потока на raw API lwIP (RTP/RTCP)
+ *
+ * Прием: udp_recv вызывает обработчик прямо в потоке tcpip, без очереди
+ * AsyncUDP, объекта AsyncUDPPacket и переключения в его задачу. Пакет из
+ * одного pbuf передается без копирования, цепочка собирается в буфер сокета.
+ * Передача: пакет собирается сразу в pbuf (beginPacket/send); pbuf прошлого
+ * пакета используется повторно, если драйвер его освободил и размер совпадает
+ * (кадры кодека одинаковой длины). Состояние передачи (media_tx_t) хранит
+ * отправитель, поэтому один сокет могут использовать несколько вызовов.
+ * SIP остается на AsyncUDP.
+ */
+
+#ifndef MEDIA_SOCKET_H
+#define MEDIA_SOCKET_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+extern "C" {
+#include "lwip/udp.h"
+#include "lwip/pbuf.h"
+}
+
+#define MEDIA_SOCKET_MAX_PACKET 1500
+
+// Обработчик входящего пакета: remote_ip - адрес в сетевом порядке (как IPAddress),
+// arrival_us - время прихода в обработчик lwIP. Выполняется в потоке tcpip на его стеке
+// (CONFIG_LWIP_TCPIP_TASK_STACK_SIZE) - без блокировок и длительной обработки
+typedef void (*media_packet_handler_t)(const uint8_t* data, size_t len, uint32_t remote_ip,
+                                       uint16_t remote_port, int64_t arrival_us, void* ctx);
+
+// Pbuf исходящего пакета одного отправителя (вызова)
+typedef struct {
+    struct pbuf* p;
+    void* payload;              // Начало данных до добавления заголовков lwIP
+} media_tx_t;
+
+class MediaSocket {
+private:
+    struct udp_pcb* pcb;
+    media_packet_handler_t handler;
+    void* handler_ctx;
+
+    static TaskHandle_t tcpip_task;
+
+    static void recvCallback(void* arg, struct udp_pcb* upcb, struct pbuf* p, const ip_addr_t* addr, u16_t port);
+    err_t call(int op, struct pbuf* p, uint32_t remote_ip, uint16_t remote_port);
+
+public:
+    MediaSocket();
+    ~MediaSocket();
+
+    bool open(uint16_t local_port, media_packet_handler_t packet_handler, void* ctx);
+    void close();
+    bool isOpen() const { return pcb != nullptr; }
+    // Байт TOS исходящих пакетов: DSCP << 2 (ECN не используется)
+    void setTOS(uint8_t tos) { if (pcb) pcb->tos = tos; }
+    uint8_t getTOS() const { return pcb ? pcb->tos : 0; }
+
+    // Буфер длиной len внутри pbuf следующего пакета (nullptr - нет памяти)
+    static uint8_t* beginPacket(media_tx_t* tx, size_t len);
+    bool send(media_tx_t* tx, uint32_t remote_ip, uint16_t remote_port);
+    static void releasePacket(media_tx_t* tx);
+};
+
+#endif
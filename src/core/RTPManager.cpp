@@ -5,14 +5,59 @@
 #include "RTPManager.h"
 #include "AudioManager.h"
 #include "ConfigManager.h"
+#include "G711Codec.h"
+#include "PacketCapture.h"
+#include "Metrics.h"
+#include "LatencyTracer.h"
+#include <esp_timer.h>
 
 RTPManager rtpManager;
 
+// Таблицы перекодирования G.711 μ-law <-> A-law для ретрансляции
+static uint8_t ulaw_to_alaw_table[256];
+static uint8_t alaw_to_ulaw_table[256];
+
+// Метрики RTP (номера в реестре metrics)
+static int metric_rx_packets = METRIC_NONE;
+static int metric_rx_bytes = METRIC_NONE;
+static int metric_tx_packets = METRIC_NONE;
+static int metric_tx_bytes = METRIC_NONE;
+static int metric_lost = METRIC_NONE;
+static int metric_send_errors = METRIC_NONE;
+static int metric_jitter = METRIC_NONE;
+static int metric_loss = METRIC_NONE;
+static int metric_interarrival = METRIC_NONE;
+static int metric_transit_delta = METRIC_NONE;
+static int metric_malformed = METRIC_NONE;
+static int metric_wrong_source = METRIC_NONE;
+static int metric_wrong_ssrc = METRIC_NONE;
+static int metric_unexpected_pt = METRIC_NONE;
+static int metric_demux_miss = METRIC_NONE;
+static int metric_dscp_marked = METRIC_NONE;
+static int metric_red_recovered = METRIC_NONE;
+static int metric_red_lost = METRIC_NONE;
+static const uint32_t interarrival_bounds[] = { 10, 20, 30, 40, 60, 80, 120, 200, 500 };
+static const uint32_t transit_delta_bounds[] = { 250, 500, 1000, 2000, 4000, 8000, 16000, 32000, 64000 };
+
+// Джиттер и доля потерь вычисляются при опросе /metrics
+static void collectRTPMetrics(void* ctx) {
+    RTPManager* manager = (RTPManager*)ctx;
+    for (int i = 0; i < manager->getMaxChannels(); i++) {
+        metrics.set(metric_jitter, (int32_t)(manager->getJitterMs(i) * 1000.0f), i);
+        metrics.set(metric_loss, (int32_t)(manager->getPacketLossPercent(i) * 100.0f), i);
+    }
+}
+
 RTPManager::RTPManager() : 
     audio_manager(nullptr),
     config_manager(nullptr),
     channels(nullptr),
-    max_channels(0) {
+    max_channels(0),
+    sockets(nullptr),
+    socket_count(0),
+    shared_socket(false),
+    base_port(0),
+    demux_mux(portMUX_INITIALIZER_UNLOCKED) {
 }
 
 void RTPManager::init(AudioManager* audioMgr, ConfigManager* cfgMgr) {
@@ -31,6 +76,9 @@ void RTPManager::init(AudioManager* audioMgr, ConfigManager* cfgMgr) {
     for (int i = 0; i < max_channels; i++) {
         channels[i].active = false;
         channels[i].rtp_socket_ready = false;
+        channels[i].socket = nullptr;
+        channels[i].tx.p = nullptr;
+        channels[i].tx.payload = nullptr;
         channels[i].received_packets = 0;
         channels[i].lost_packets = 0;
         channels[i].jitter = 0;
@@ -39,13 +87,93 @@ void RTPManager::init(AudioManager* audioMgr, ConfigManager* cfgMgr) {
         channels[i].last_packet_time = 0;
         
         // Инициализация джиттера по RFC 3550
-        channels[i].jitter_rfc = 0;
+        channels[i].jitter_q4 = 0;
         channels[i].last_rtp_timestamp = 0;
-        channels[i].last_arrival_time = 0;
+        channels[i].last_arrival_us = 0;
         channels[i].clock_rate = 8000; // По умолчанию 8 kHz
+        
+        channels[i].remote_addr = 0;
+        channels[i].remote_ssrc = 0;
+        channels[i].remote_ssrc_valid = false;
+        channels[i].remote_ssrc_last_us = 0;
+        channels[i].tx_started = false;
+        channels[i].relay_peer = -1;
+        channels[i].owner = this;
+        channels[i].red_pt = 0;
+        channels[i].red_depth = 0;
+        channels[i].red_history = nullptr;
+        resetRelayState(&channels[i]);
+    }
+    
+    // История кадров для избыточности RFC 2198
+    uint8_t* red_pool = (uint8_t*)malloc(max_channels * RTP_RED_MAX_DEPTH * RTP_RED_MAX_FRAME);
+    if (red_pool) {
+        for (int i = 0; i < max_channels; i++) {
+            channels[i].red_history = red_pool + i * RTP_RED_MAX_DEPTH * RTP_RED_MAX_FRAME;
+        }
+    } else {
+        Serial.println("RTPManager: Нет памяти для истории RFC 2198, избыточность отключена");
+    }
+    
+    for (int i = 0; i < 256; i++) {
+        ulaw_to_alaw_table[i] = G711Codec::linearToAlaw(G711Codec::ulawToLinear(i));
+        alaw_to_ulaw_table[i] = G711Codec::linearToUlaw(G711Codec::alawToLinear(i));
+    }
+    
+    metric_rx_packets = metrics.counter("alina_rtp_rx_packets_total", "RTP packets received", true);
+    metric_rx_bytes = metrics.counter("alina_rtp_rx_bytes_total", "RTP bytes received including header", true);
+    metric_tx_packets = metrics.counter("alina_rtp_tx_packets_total", "RTP packets sent", true);
+    metric_tx_bytes = metrics.counter("alina_rtp_tx_bytes_total", "RTP bytes sent including header", true);
+    metric_lost = metrics.counter("alina_rtp_lost_packets_total", "RTP packets lost by sequence gap", true);
+    metric_send_errors = metrics.counter("alina_rtp_send_errors_total", "RTP packets that failed to send", true);
+    metric_jitter = metrics.gauge("alina_rtp_jitter_us", "RFC 3550 interarrival jitter in microseconds", true);
+    metric_loss = metrics.gauge("alina_rtp_loss_permyriad", "RTP packet loss in hundredths of a percent", true);
+    metric_interarrival = metrics.histogram("alina_rtp_interarrival_ms", "Time between received RTP packets",
+                                            interarrival_bounds, sizeof(interarrival_bounds) / sizeof(interarrival_bounds[0]));
+    metric_transit_delta = metrics.histogram("alina_rtp_transit_delta_us",
+                                             "RFC 3550 |D(i-1,i)| per packet in microseconds",
+                                             transit_delta_bounds, sizeof(transit_delta_bounds) / sizeof(transit_delta_bounds[0]), true);
+    metric_malformed = metrics.counter("alina_rtp_malformed_total", "RTP packets with invalid header, CSRC, extension or padding", true);
+    metric_wrong_source = metrics.counter("alina_rtp_wrong_source_total", "RTP packets from an address other than the SDP peer", true);
+    metric_wrong_ssrc = metrics.counter("alina_rtp_wrong_ssrc_total", "RTP packets from a second SSRC while the current one is live", true);
+    metric_unexpected_pt = metrics.counter("alina_rtp_unexpected_pt_total", "RTP packets with a payload type not negotiated for the call", true);
+    metric_red_recovered = metrics.counter("alina_rtp_red_recovered_total", "Lost RTP frames rebuilt from RFC 2198 redundancy", true);
+    metric_red_lost = metrics.counter("alina_rtp_red_lost_total", "Lost RTP frames not recoverable from redundancy", true);
+    metric_dscp_marked = metrics.counter("alina_rtp_dscp_marked_total", "RTP packets sent with a non-zero DSCP", true);
+    metric_demux_miss = metrics.counter("alina_rtp_demux_miss_total", "RTP packets on the shared port that matched no call");
+    metrics.addCollector(collectRTPMetrics, this);
+    
+    // Пул сокетов: вызов не тратит время и память на создание сокета
+    shared_socket = config_manager->isRTPSharedSocket();
+    base_port = config_manager->getRTPBasePort();
+    socket_count = shared_socket ? 1 : max_channels;
+    sockets = new MediaSocket[socket_count];
+    for (int i = 0; i < RTP_DEMUX_SLOTS; i++) {
+        demux_addr[i].channel = -1;
+        demux_ssrc[i].channel = -1;
+    }
+    int opened = 0;
+    for (int i = 0; i < socket_count; i++) {
+        if (openSocket(i)) opened++;
+    }
+    for (int i = 0; i < max_channels; i++) {
+        channels[i].socket = &sockets[shared_socket ? 0 : i];
     }
     
-    Serial.printf("RTPManager: Инициализирован для %d каналов\n", max_channels);
+    Serial.printf("RTPManager: Инициализирован для %d каналов, %s (%d/%d сокетов, порт %d)\n",
+                  max_channels, shared_socket ? "общий RTP порт" : "порт на вызов",
+                  opened, socket_count, base_port);
+}
+
+bool RTPManager::openSocket(int index) {
+    if (shared_socket) {
+        return sockets[0].open(base_port, onSharedMediaPacket, this);
+    }
+    return sockets[index].open(base_port + index * 2, onMediaPacket, &channels[index]);
+}
+
+uint16_t RTPManager::getLocalPort(int channel_id) const {
+    return shared_socket ? base_port : base_port + channel_id * 2;
 }
 
 bool RTPManager::setupChannel(int channel_id, const char* remote_ip, int remote_port, 
@@ -57,15 +185,21 @@ bool RTPManager::setupChannel(int channel_id, const char* remote_ip, int remote_
     
     RTPChannel* channel = &channels[channel_id];
     
-    // Настройка UDP сокета
-    if (!channel->socket.listen(local_port)) {
+    // Сокет открыт при загрузке; повторная попытка, если тогда не удалось
+    if (!channel->socket->isOpen() && !openSocket(shared_socket ? 0 : channel_id)) {
         Serial.printf("RTPManager: Ошибка создания RTP сокета для канала %d порт %d\n", 
-                     channel_id, local_port);
+                     channel_id, getLocalPort(channel_id));
         return false;
     }
+    if (local_port != getLocalPort(channel_id)) {
+        Serial.printf("RTPManager: Канал %d: порт %d не совпадает с портом пула %d\n",
+                      channel_id, local_port, getLocalPort(channel_id));
+        local_port = getLocalPort(channel_id);
+    }
+    // DSCP применяется к каждому вызову - изменение настройки не требует перезагрузки
+    channel->socket->setTOS(config_manager->getRTPDSCP() << 2);
     
     // Настройка параметров канала
-    channel->active = true;
     strncpy(channel->remote_ip, remote_ip, sizeof(channel->remote_ip) - 1);
     channel->remote_ip[sizeof(channel->remote_ip) - 1] = '\0';
     channel->remote_port = remote_port;
@@ -75,19 +209,30 @@ bool RTPManager::setupChannel(int channel_id, const char* remote_ip, int remote_
     channel->timestamp = 0;
     channel->payload_type = payload_type;
     channel->rtp_socket_ready = true;
+    channel->tx_started = false;
+    resetRelayState(channel);
+    
+    // Пакеты принимаются только с адреса из SDP; SSRC фиксируется по первому пакету
+    IPAddress addr;
+    channel->remote_addr = (addr.fromString(remote_ip) && strcmp(remote_ip, "0.0.0.0") != 0) ? (uint32_t)addr : 0;
+    channel->remote_ssrc = 0;
+    channel->remote_ssrc_valid = false;
+    channel->remote_ssrc_last_us = 0;
     
     // Настройка параметров джиттера
-    channel->jitter_rfc = 0;
+    channel->jitter_q4 = 0;
     channel->last_rtp_timestamp = 0;
-    channel->last_arrival_time = 0;
+    channel->last_arrival_us = 0;
     
     // Определяем частоту часов в зависимости от payload type
     switch(payload_type) {
         case 0:  // PCMU
         case 8:  // PCMA
-        case 9:  // G722
             channel->clock_rate = 8000;  // 8 kHz
             break;
+        case 9:  // G722
+            channel->clock_rate = 8000;  // RFC 3551: 8 kHz, хотя аудио 16 kHz
+            break;
         case 18: // G729
             channel->clock_rate = 8000;  // 8 kHz
             break;
@@ -96,58 +241,277 @@ bool RTPManager::setupChannel(int channel_id, const char* remote_ip, int remote_
             break;
     }
     
-    // Настройка обработчика входящих пакетов
-    channel->socket.onPacket([this, channel_id](AsyncUDPPacket packet) {
-        this->processIncomingRTPPacket(packet, channel_id);
-    });
+    // Прием разрешается после настройки: обработчик сокета уже активен
+    channel->active = true;
+    if (shared_socket) {
+        if (channel->remote_addr == 0) {
+            Serial.printf("RTPManager: Канал %d: нет адреса удаленной стороны для общего порта\n", channel_id);
+        }
+        rebuildDemux();
+    }
     
     Serial.printf("RTPManager: Канал %d настроен: %s:%d (local:%d) SSRC:%lu Clock:%dHz\n", 
                   channel_id, remote_ip, remote_port, local_port, ssrc, channel->clock_rate);
     return true;
 }
 
+rtp_parse_result_t RTPManager::parseRTP(const uint8_t* data, size_t len, rtp_view_t* view) {
+    if (len < RTP_HEADER_SIZE) {
+        return RTP_PARSE_TOO_SHORT;
+    }
+    if ((data[0] >> 6) != 2) {
+        return RTP_PARSE_BAD_VERSION;
+    }
+    // SR/RR/SDES/BYE/APP: второй байт 200-204 (RFC 5761)
+    if (data[1] >= 200 && data[1] <= 204) {
+        return RTP_PARSE_RTCP;
+    }
+    
+    size_t offset = RTP_HEADER_SIZE + (data[0] & 0x0F) * 4;
+    if (offset > len) {
+        return RTP_PARSE_BAD_CSRC;
+    }
+    
+    view->extension = nullptr;
+    view->extension_len = 0;
+    view->extension_profile = 0;
+    if (data[0] & 0x10) {
+        if (offset + 4 > len) {
+            return RTP_PARSE_BAD_EXTENSION;
+        }
+        size_t ext_len = ((data[offset + 2] << 8) | data[offset + 3]) * 4;
+        if (offset + 4 + ext_len > len) {
+            return RTP_PARSE_BAD_EXTENSION;
+        }
+        view->extension_profile = (data[offset] << 8) | data[offset + 1];
+        view->extension = data + offset + 4;
+        view->extension_len = ext_len;
+        offset += 4 + ext_len;
+    }
+    
+    size_t payload_len = len - offset;
+    view->padding = 0;
+    if (data[0] & 0x20) {
+        // Счетчик заполнения включает сам себя
+        uint8_t padding = data[len - 1];
+        if (padding == 0 || padding > payload_len) {
+            return RTP_PARSE_BAD_PADDING;
+        }
+        view->padding = padding;
+        payload_len -= padding;
+    }
+    
+    view->payload = data + offset;
+    view->payload_len = payload_len;
+    view->csrc_count = data[0] & 0x0F;
+    view->marker = (data[1] & 0x80) != 0;
+    view->payload_type = data[1] & 0x7F;
+    view->sequence = (data[2] << 8) | data[3];
+    view->timestamp = ((uint32_t)data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+    view->ssrc = ((uint32_t)data[8] << 24) | (data[9] << 16) | (data[10] << 8) | data[11];
+    return RTP_PARSE_OK;
+}
+
+bool RTPManager::acceptSSRC(RTPChannel* channel, uint32_t ssrc, int64_t arrival_us) {
+    if (!channel->remote_ssrc_valid || ssrc == channel->remote_ssrc) {
+        if (shared_socket && !channel->remote_ssrc_valid) {
+            demuxInsert(demux_ssrc, ssrc, 0, channel - channels);
+        }
+        channel->remote_ssrc = ssrc;
+        channel->remote_ssrc_valid = true;
+        channel->remote_ssrc_last_us = arrival_us;
+        return true;
+    }
+    // Второй источник принимается только после паузы текущего (смена источника на SBC)
+    if (arrival_us - channel->remote_ssrc_last_us > RTP_SSRC_SWITCH_MS * 1000LL) {
+        Serial.printf("RTPManager: Смена SSRC %08lX -> %08lX\n",
+                      (unsigned long)channel->remote_ssrc, (unsigned long)ssrc);
+        if (shared_socket) {
+            demuxRemove(demux_ssrc, channel->remote_ssrc, 0);
+            demuxInsert(demux_ssrc, ssrc, 0, channel - channels);
+        }
+        channel->remote_ssrc = ssrc;
+        channel->remote_ssrc_last_us = arrival_us;
+        return true;
+    }
+    return false;
+}
+
+static inline uint32_t demuxHash(uint32_t key, uint16_t port) {
+    return ((key ^ ((uint32_t)port << 16) ^ port) * 2654435761u) >> (32 - RTP_DEMUX_BITS);
+}
+
+int RTPManager::demuxFind(const rtp_demux_entry_t* table, uint32_t key, uint16_t port) {
+    int channel_id = -1;
+    portENTER_CRITICAL(&demux_mux);
+    for (uint32_t i = 0, slot = demuxHash(key, port); i < RTP_DEMUX_SLOTS; i++, slot = (slot + 1) & (RTP_DEMUX_SLOTS - 1)) {
+        const rtp_demux_entry_t& entry = table[slot];
+        if (entry.channel < 0) break;
+        if (entry.key == key && entry.port == port) {
+            channel_id = entry.channel;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&demux_mux);
+    return channel_id;
+}
+
+void RTPManager::demuxPut(rtp_demux_entry_t* table, uint32_t key, uint16_t port, int channel_id) {
+    for (uint32_t i = 0, slot = demuxHash(key, port); i < RTP_DEMUX_SLOTS; i++, slot = (slot + 1) & (RTP_DEMUX_SLOTS - 1)) {
+        rtp_demux_entry_t& entry = table[slot];
+        if (entry.channel < 0 || (entry.key == key && entry.port == port)) {
+            entry.key = key;
+            entry.port = port;
+            entry.channel = channel_id;
+            return;
+        }
+    }
+}
+
+void RTPManager::demuxInsert(rtp_demux_entry_t* table, uint32_t key, uint16_t port, int channel_id) {
+    portENTER_CRITICAL(&demux_mux);
+    demuxPut(table, key, port, channel_id);
+    portEXIT_CRITICAL(&demux_mux);
+}
+
+// Удаление со сдвигом: следующие записи цепочки переносятся на освободившееся
+// место, если оно не раньше их начальной ячейки - поиск не обрывается на пустой
+void RTPManager::demuxRemove(rtp_demux_entry_t* table, uint32_t key, uint16_t port) {
+    const uint32_t mask = RTP_DEMUX_SLOTS - 1;
+    portENTER_CRITICAL(&demux_mux);
+    for (uint32_t i = 0, slot = demuxHash(key, port); i < RTP_DEMUX_SLOTS; i++, slot = (slot + 1) & mask) {
+        if (table[slot].channel < 0) break;
+        if (table[slot].key != key || table[slot].port != port) continue;
+
+        uint32_t hole = slot;
+        for (uint32_t next = (hole + 1) & mask; table[next].channel >= 0 && next != slot; next = (next + 1) & mask) {
+            uint32_t home = demuxHash(table[next].key, table[next].port);
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                table[hole] = table[next];
+                hole = next;
+            }
+        }
+        table[hole].channel = -1;
+        break;
+    }
+    portEXIT_CRITICAL(&demux_mux);
+}
+
+// Таблицы пересобираются при открытии/закрытии канала: новые собираются рядом
+// и подменяют рабочие под блокировкой, поиск в потоке tcpip не видит пустых таблиц
+void RTPManager::rebuildDemux() {
+    rtp_demux_entry_t addr[RTP_DEMUX_SLOTS];
+    rtp_demux_entry_t ssrc[RTP_DEMUX_SLOTS];
+    for (int i = 0; i < RTP_DEMUX_SLOTS; i++) {
+        addr[i].channel = -1;
+        ssrc[i].channel = -1;
+    }
+    for (int i = 0; i < max_channels; i++) {
+        if (!channels[i].active) continue;
+        if (channels[i].remote_addr != 0) {
+            demuxPut(addr, channels[i].remote_addr, channels[i].remote_port, i);
+        }
+        if (channels[i].remote_ssrc_valid) {
+            demuxPut(ssrc, channels[i].remote_ssrc, 0, i);
+        }
+    }
+    portENTER_CRITICAL(&demux_mux);
+    memcpy(demux_addr, addr, sizeof(demux_addr));
+    memcpy(demux_ssrc, ssrc, sizeof(demux_ssrc));
+    portEXIT_CRITICAL(&demux_mux);
+}
+
+void RTPManager::onMediaPacket(const uint8_t* data, size_t len, uint32_t remote_ip, uint16_t remote_port,
+                               int64_t arrival_us, void* ctx) {
+    RTPChannel* channel = (RTPChannel*)ctx;
+    RTPManager* manager = channel->owner;
+    manager->processIncomingRTPPacket(channel - manager->channels, data, len, remote_ip, remote_port, arrival_us);
+}
+
+// Общий порт: вызов по адресу и порту из SDP, иначе по SSRC (порт источника сменился)
+void RTPManager::onSharedMediaPacket(const uint8_t* data, size_t len, uint32_t remote_ip, uint16_t remote_port,
+                                     int64_t arrival_us, void* ctx) {
+    RTPManager* manager = (RTPManager*)ctx;
+    int channel_id = manager->demuxFind(manager->demux_addr, remote_ip, remote_port);
+    if (channel_id < 0 && len >= RTP_HEADER_SIZE) {
+        uint32_t ssrc = ((uint32_t)data[8] << 24) | (data[9] << 16) | (data[10] << 8) | data[11];
+        channel_id = manager->demuxFind(manager->demux_ssrc, ssrc, 0);
+    }
+    if (channel_id < 0) {
+        metrics.inc(metric_demux_miss);
+        return;
+    }
+    manager->processIncomingRTPPacket(channel_id, data, len, remote_ip, remote_port, arrival_us);
+}
+
 // Обработка входящего RTP пакета (SIP -> RTP -> AudioManager -> UART)
-void RTPManager::processIncomingRTPPacket(AsyncUDPPacket packet, int channel_id) {
+// Выполняется в потоке tcpip; arrival_us - время прихода в обработчик сокета
+void RTPManager::processIncomingRTPPacket(int channel_id, const uint8_t* data, size_t len,
+                                          uint32_t remote_ip, uint16_t remote_port, int64_t arrival_us) {
     if (channel_id < 0 || channel_id >= max_channels || !channels[channel_id].active) {
         return;
     }
     
-    if (packet.length() < RTP_HEADER_SIZE) {
-        Serial.printf("RTPManager: Слишком короткий пакет %d байт\n", packet.length());
+    RTPChannel* channel = &channels[channel_id];
+    metrics.inc(metric_rx_packets, channel_id);
+    metrics.inc(metric_rx_bytes, channel_id, len);
+    packetCapture.capture(PacketCapture::classifyRTP(data, len), PCAP_DIR_RX, channel_id,
+                          remote_ip, remote_port, channel->local_port, data, len);
+    
+    // Отбраковка до любой обработки: заголовок, адрес, payload type, SSRC
+    rtp_view_t view;
+    rtp_parse_result_t result = parseRTP(data, len, &view);
+    if (result != RTP_PARSE_OK) {
+        if (result != RTP_PARSE_RTCP) {
+            metrics.inc(metric_malformed, channel_id);
+        }
         return;
     }
-    
-    // Парсинг RTP заголовка (ручная распаковка)
-    uint8_t* data = packet.data();
-    
-    // Проверка версии RTP
-    uint8_t version = (data[0] >> 6) & 0x03;
-    if (version != 2) {
-        Serial.printf("RTPManager: Неверная версия RTP в канале %d: %d\n", channel_id, version);
+    if (channel->remote_addr != 0 && remote_ip != channel->remote_addr) {
+        metrics.inc(metric_wrong_source, channel_id);
+        return;
+    }
+    if (view.payload_type != channel->payload_type && view.payload_type != RTP_PT_TELEPHONE_EVENT &&
+        view.payload_type != RTP_PT_CN && !(channel->red_pt && view.payload_type == channel->red_pt)) {
+        metrics.inc(metric_unexpected_pt, channel_id);
+        return;
+    }
+    if (!acceptSSRC(channel, view.ssrc, arrival_us)) {
+        metrics.inc(metric_wrong_ssrc, channel_id);
         return;
     }
     
-    // Извлечение параметров
-    uint16_t sequence = (data[2] << 8) | data[3];
-    uint32_t timestamp = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
-    uint32_t ssrc = (data[8] << 24) | (data[9] << 16) | (data[10] << 8) | data[11];
-    uint8_t payload_type = data[1] & 0x7F;
+    // RFC 2198: дальше обрабатывается основной блок, пропуски - из избыточных
+    if (channel->red_pt) {
+        rtp_red_block_t blocks[RTP_RED_MAX_BLOCKS];
+        int block_count = 0;
+        if (view.payload_type == channel->red_pt && !parseRedundancy(&view, blocks, &block_count)) {
+            metrics.inc(metric_malformed, channel_id);
+            return;
+        }
+        recoverLost(channel_id, view, blocks, block_count);
+    }
+    
+    latencyTracer.begin(channel_id, LAT_DIR_RX, arrival_us);
     
-    // Извлечение аудио данных
-    int payload_len = packet.length() - RTP_HEADER_SIZE;
-    uint8_t* payload_data = data + RTP_HEADER_SIZE;
+    if (channel->relay_peer >= 0) {
+        // Ретрансляция в парный канал, AudioManager не участвует
+        relayPacket(channel_id, view);
+        updateSync(channel_id, view.timestamp, view.sequence, arrival_us);
+        return;
+    }
     
-    if (payload_len > 0 && audio_manager) {
-        // Отправка в AudioManager для передачи в UART
-        audio_manager->processIncomingRTP(channel_id, payload_data, payload_len, 
-                                         timestamp, sequence, payload_type);
+    if (view.payload_len > 0 && audio_manager) {
+        // Копия в очередь AudioManager: декодирование и UART - в задаче такта медиа
+        audio_manager->queueIncomingRTP(channel_id, view.payload, view.payload_len,
+                                        view.timestamp, view.sequence, view.payload_type);
         
         // Обновление статистики
-        updateSync(channel_id, timestamp, sequence);
+        updateSync(channel_id, view.timestamp, view.sequence, arrival_us);
         
         // Логирование (можно отключить для производительности)
         // Serial.printf("RTP RX: Ch%d, PT%d, Seq%d, TS%lu, Len%d\n",
-        //              channel_id, payload_type, sequence, timestamp, payload_len);
+        //              channel_id, view.payload_type, view.sequence, view.timestamp, view.payload_len);
     }
 }
 
@@ -160,13 +524,27 @@ bool RTPManager::sendAudioData(int channel_id, uint8_t* audio_data, int data_len
     }
 
     RTPChannel* channel = &channels[channel_id];
+    if (channel->relay_peer >= 0) {
+        return false; // Канал занят ретрансляцией
+    }
 
-    // Создание RTP пакета
-    uint8_t rtp_packet[RTP_HEADER_SIZE + data_len];
+    // Избыточность RFC 2198 только для кадров кодека вызова (не telephone-event);
+    // глубина читается один раз - ее меняет поток приема
+    bool red = channel->red_pt && codec_type == channel->payload_type;
+    uint8_t red_depth = red ? channel->red_depth : 0;
+    size_t payload_len = red_depth ?
+        packRedundancy(channel, red_depth, nullptr, audio_data, data_len, timestamp, codec_type) : data_len;
+    
+    // RTP пакет собирается сразу в pbuf сокета
+    uint8_t* rtp_packet = MediaSocket::beginPacket(&channel->tx, RTP_HEADER_SIZE + payload_len);
+    if (!rtp_packet) {
+        metrics.inc(metric_send_errors, channel_id);
+        return false;
+    }
 
     // Заполнение RTP заголовка (ручная упаковка)
     rtp_packet[0] = 0x80; // version=2, padding=0, extension=0, csrc_count=0
-    rtp_packet[1] = codec_type & 0x7F; // marker=0, payload_type
+    rtp_packet[1] = (red_depth ? channel->red_pt : codec_type) & 0x7F; // marker=0, payload_type
     rtp_packet[2] = (sequence >> 8) & 0xFF;
     rtp_packet[3] = sequence & 0xFF;
     rtp_packet[4] = (timestamp >> 24) & 0xFF; // <-- ИСПОЛЬЗУЕМ ПЕРЕДАННЫЙ TIMESTAMP
@@ -179,15 +557,33 @@ bool RTPManager::sendAudioData(int channel_id, uint8_t* audio_data, int data_len
     rtp_packet[11] = channel->ssrc & 0xFF;
 
     // Копирование аудио данных
-    memcpy(rtp_packet + RTP_HEADER_SIZE, audio_data, data_len);
+    if (red_depth) {
+        packRedundancy(channel, red_depth, rtp_packet + RTP_HEADER_SIZE, audio_data, data_len, timestamp, codec_type);
+    } else {
+        memcpy(rtp_packet + RTP_HEADER_SIZE, audio_data, data_len);
+    }
+    if (red) {
+        storeRedundancy(channel, audio_data, data_len, timestamp);
+    }
 
     // Отправка пакета
-    IPAddress remote_ip;
-    if (remote_ip.fromString(channel->remote_ip)) {
-        bool success = channel->socket.writeTo(rtp_packet, RTP_HEADER_SIZE + data_len,
-                                             remote_ip, channel->remote_port);
+    if (channel->remote_addr != 0) {
+        bool success = channel->socket->send(&channel->tx, channel->remote_addr, channel->remote_port);
 
         if (success) {
+            packetCapture.capture(PCAP_KIND_RTP, PCAP_DIR_TX, channel_id, channel->remote_addr,
+                                  channel->remote_port, channel->local_port,
+                                  rtp_packet, RTP_HEADER_SIZE + payload_len);
+            metrics.inc(metric_tx_packets, channel_id);
+            metrics.inc(metric_tx_bytes, channel_id, RTP_HEADER_SIZE + payload_len);
+            if (channel->socket->getTOS()) {
+                metrics.inc(metric_dscp_marked, channel_id);
+            }
+            channel->last_tx_sequence = sequence;
+            channel->last_tx_timestamp = timestamp;
+            channel->last_tx_time = millis();
+            channel->tx_started = true;
+            
             // Обновление счетчиков
             // channel->sequence НЕ увеличиваем здесь, так как теперь sequence приходит извне
             // channel->timestamp НЕ увеличиваем на data_len, это неправильно.
@@ -213,6 +609,7 @@ bool RTPManager::sendAudioData(int channel_id, uint8_t* audio_data, int data_len
 
             return true;
         } else {
+            metrics.inc(metric_send_errors, channel_id);
             Serial.printf("RTPManager: Ошибка отправки пакета в канале %d\n", channel_id);
         }
     } else {
@@ -222,7 +619,7 @@ bool RTPManager::sendAudioData(int channel_id, uint8_t* audio_data, int data_len
     return false;
 }
 
-void RTPManager::updateSync(int channel_id, uint32_t timestamp, uint16_t sequence) {
+void RTPManager::updateSync(int channel_id, uint32_t timestamp, uint16_t sequence, int64_t arrival_us) {
     if (channel_id < 0 || channel_id >= max_channels || !channels[channel_id].active) return;
     
     RTPChannel* channel = &channels[channel_id];
@@ -234,6 +631,7 @@ void RTPManager::updateSync(int channel_id, uint32_t timestamp, uint16_t sequenc
     if (channel->received_packets > 1 && sequence > channel->last_sequence + 1) {
         uint16_t lost = sequence - channel->last_sequence - 1;
         channel->lost_packets += lost;
+        metrics.inc(metric_lost, channel_id, lost);
         if (lost > 0) {
             Serial.printf("RTPManager: Потеряно %d пакетов в канале %d\n", lost, channel_id);
         }
@@ -241,48 +639,417 @@ void RTPManager::updateSync(int channel_id, uint32_t timestamp, uint16_t sequenc
     
     // ВЫЧИСЛЕНИЕ ДЖИТТЕРА ПО RFC 3550
     if (channel->received_packets > 1) {
-        // Разница во времени между пакетами в timestamp units
-        int32_t D = (int32_t)(timestamp - channel->last_rtp_timestamp);
-        
-        // Разница во времени прибытия в миллисекундах, конвертированная в timestamp units
-        uint32_t current_time = millis();
-        uint32_t arrival_diff_ms = current_time - channel->last_arrival_time;
+        int64_t arrival_diff_us = arrival_us - channel->last_arrival_us;
+        metrics.observe(metric_interarrival, (uint32_t)(arrival_diff_us / 1000));
         
-        // Конвертируем разницу прибытия в timestamp units (8000 Hz = 8 units/ms)
-        int32_t arrival_diff_units = arrival_diff_ms * (channel->clock_rate / 1000);
+        // D(i-1,i) в 1/16 timestamp units: прибытие переводится в единицы часов RTP
+        // без округления до миллисекунд (1/16 единицы = 7.8 мкс при 8 кГц)
+        int64_t arrival_diff_q4 = (arrival_diff_us * channel->clock_rate * 16 + 500000) / 1000000;
+        int64_t ts_diff_q4 = (int64_t)(int32_t)(timestamp - channel->last_rtp_timestamp) * 16;
+        int64_t d_q4 = arrival_diff_q4 - ts_diff_q4;
+        if (d_q4 < 0) d_q4 = -d_q4;
+        if (d_q4 > INT32_MAX / 2) d_q4 = INT32_MAX / 2; // Разрыв потока (пауза, смена источника)
         
-        // Разница задержек (вариация)
-        int32_t var = arrival_diff_units - D;
-        
-        // Абсолютное значение (для джиттера)
-        if (var < 0) var = -var;
-        
-        // Экспоненциальное сглаживание джиттера (формула из RFC 3550)
         // J = J + (|D| - J) / 16
-        channel->jitter_rfc = channel->jitter_rfc + (var - channel->jitter_rfc) / 16;
+        channel->jitter_q4 += ((int32_t)d_q4 - channel->jitter_q4 + 8) >> 4;
         
-        // Для обратной совместимости сохраняем упрощенный джиттер
-        channel->jitter = channel->jitter_rfc;
+        // Для обратной совместимости сохраняем джиттер в timestamp units
+        channel->jitter = channel->jitter_q4 >> 4;
         
-        // Логирование для отладки
-        if (var > 1000) { // Логируем только при значительных вариациях
-            Serial.printf("RTPManager: Джиттер канал %d - D=%d, arrival=%d, var=%d, jitter=%d\n",
-                         channel_id, D, arrival_diff_units, var, channel->jitter_rfc);
-        }
+        metrics.observe(metric_transit_delta, (uint32_t)(d_q4 * 1000000 / 16 / channel->clock_rate), channel_id);
     }
     
     // Обновление временных меток
     channel->last_rtp_timestamp = timestamp;
-    channel->last_arrival_time = millis();
+    channel->last_arrival_us = arrival_us;
     channel->last_sequence = sequence;
-    channel->last_packet_time = millis();
+    channel->last_packet_time = (uint32_t)(arrival_us / 1000);
+    
+    if (channel->red_pt) {
+        adaptRedundancy(channel_id);
+    }
+}
+
+void RTPManager::setRedundancy(int channel_id, uint8_t red_pt) {
+    if (channel_id < 0 || channel_id >= max_channels) return;
+    RTPChannel* channel = &channels[channel_id];
+    uint8_t threshold = config_manager ? config_manager->getRedLossThreshold() : 0;
+    channel->red_pt = (channel->red_history && threshold > 0) ? red_pt : 0;
+    channel->red_threshold = threshold;
+    channel->red_depth = 0;
+    channel->red_history_count = 0;
+    channel->red_history_head = 0;
+    channel->red_seq_valid = false;
+    channel->red_recovered = 0;
+    channel->red_lost = 0;
+    channel->red_window_start = millis();
+    channel->red_window_received = channel->received_packets;
+    channel->red_window_lost = channel->lost_packets;
+}
+
+bool RTPManager::getRedundancyStats(int channel_id, uint8_t* depth, uint32_t* recovered, uint32_t* lost) const {
+    if (channel_id < 0 || channel_id >= max_channels || !channels[channel_id].red_pt) {
+        return false;
+    }
+    const RTPChannel* channel = &channels[channel_id];
+    if (depth) *depth = channel->red_depth;
+    if (recovered) *recovered = channel->red_recovered;
+    if (lost) *lost = channel->red_lost;
+    return true;
+}
+
+// Глубина по потерям приема за окно: у радиоканала потери в обе стороны близки,
+// а RTCP отчетов собеседника нет. Выключение - ниже половины порога (гистерезис)
+void RTPManager::adaptRedundancy(int channel_id) {
+    RTPChannel* channel = &channels[channel_id];
+    uint32_t now = millis();
+    if (now - channel->red_window_start < RTP_RED_WINDOW_MS) return;
+    
+    uint32_t received = channel->received_packets - channel->red_window_received;
+    uint32_t lost = channel->lost_packets - channel->red_window_lost;
+    channel->red_window_start = now;
+    channel->red_window_received = channel->received_packets;
+    channel->red_window_lost = channel->lost_packets;
+    if (received + lost == 0) return;
+    
+    uint32_t loss_permille = lost * 1000 / (received + lost);
+    uint32_t threshold_permille = channel->red_threshold * 10;
+    uint8_t depth = channel->red_depth;
+    if (loss_permille >= threshold_permille * 2) {
+        depth = 2;
+    } else if (loss_permille >= threshold_permille) {
+        depth = depth > 1 ? depth : 1;
+    } else if (loss_permille < threshold_permille / 2) {
+        depth = 0;
+    }
+    if (depth > RTP_RED_MAX_DEPTH) depth = RTP_RED_MAX_DEPTH;
+    if (depth != channel->red_depth) {
+        Serial.printf("RTPManager: Канал %d: потери %lu.%lu%%, избыточность RFC 2198 %d -> %d\n",
+                      channel_id, (unsigned long)(loss_permille / 10), (unsigned long)(loss_permille % 10),
+                      channel->red_depth, depth);
+        channel->red_depth = depth;
+    }
+}
+
+// Формат RFC 2198: заголовки избыточных блоков (F=1, PT, смещение timestamp 14 бит,
+// длина 10 бит), заголовок основного блока (F=0, PT), затем данные от старых к новому.
+// out == nullptr - только размер
+size_t RTPManager::packRedundancy(RTPChannel* channel, uint8_t depth, uint8_t* out, const uint8_t* audio_data,
+                                  int data_len, uint32_t timestamp, uint8_t codec_type) {
+    int indexes[RTP_RED_MAX_DEPTH];
+    int count = 0;
+    int available = channel->red_history_count < depth ? channel->red_history_count : depth;
+    for (int k = available; k >= 1; k--) {
+        int index = (channel->red_history_head + RTP_RED_MAX_DEPTH - k) % RTP_RED_MAX_DEPTH;
+        uint32_t offset = timestamp - channel->red_history_ts[index];
+        if (offset > 0 && offset < 0x4000 && channel->red_history_len[index] < 0x400) {
+            indexes[count++] = index;
+        }
+    }
+    
+    size_t size = count * 4 + 1 + data_len;
+    for (int i = 0; i < count; i++) {
+        size += channel->red_history_len[indexes[i]];
+    }
+    if (!out) {
+        return size;
+    }
+    
+    uint8_t* p = out;
+    for (int i = 0; i < count; i++) {
+        uint32_t offset = timestamp - channel->red_history_ts[indexes[i]];
+        uint16_t len = channel->red_history_len[indexes[i]];
+        p[0] = 0x80 | (codec_type & 0x7F);
+        p[1] = (offset >> 6) & 0xFF;
+        p[2] = ((offset & 0x3F) << 2) | ((len >> 8) & 0x03);
+        p[3] = len & 0xFF;
+        p += 4;
+    }
+    *p++ = codec_type & 0x7F;
+    for (int i = 0; i < count; i++) {
+        const uint8_t* frame = channel->red_history + indexes[i] * RTP_RED_MAX_FRAME;
+        memcpy(p, frame, channel->red_history_len[indexes[i]]);
+        p += channel->red_history_len[indexes[i]];
+    }
+    memcpy(p, audio_data, data_len);
+    return size;
+}
+
+void RTPManager::storeRedundancy(RTPChannel* channel, const uint8_t* audio_data, int data_len, uint32_t timestamp) {
+    if (data_len <= 0 || data_len > RTP_RED_MAX_FRAME) {
+        channel->red_history_count = 0; // Кадр не помещается - прежние блоки больше не смежны
+        return;
+    }
+    int index = channel->red_history_head;
+    memcpy(channel->red_history + index * RTP_RED_MAX_FRAME, audio_data, data_len);
+    channel->red_history_len[index] = data_len;
+    channel->red_history_ts[index] = timestamp;
+    channel->red_history_head = (index + 1) % RTP_RED_MAX_DEPTH;
+    if (channel->red_history_count < RTP_RED_MAX_DEPTH) {
+        channel->red_history_count++;
+    }
+}
+
+bool RTPManager::parseRedundancy(rtp_view_t* view, rtp_red_block_t* blocks, int* block_count) {
+    const uint8_t* p = view->payload;
+    size_t remaining = view->payload_len;
+    size_t data_len = 0;
+    int count = 0;
+    
+    // Заголовки блоков до основного (F=0)
+    while (remaining > 0 && (p[0] & 0x80)) {
+        if (remaining < 4) return false;
+        uint16_t len = ((p[2] & 0x03) << 8) | p[3];
+        if (count < RTP_RED_MAX_BLOCKS) {
+            blocks[count].payload_type = p[0] & 0x7F;
+            blocks[count].ts_offset = (p[1] << 6) | (p[2] >> 2);
+            blocks[count].len = len;
+            count++;
+        } else {
+            return false;
+        }
+        data_len += len;
+        p += 4;
+        remaining -= 4;
+    }
+    if (remaining < 1 || data_len > remaining - 1) return false;
+    uint8_t primary_pt = p[0] & 0x7F;
+    p++;
+    remaining--;
+    
+    for (int i = 0; i < count; i++) {
+        blocks[i].data = p;
+        p += blocks[i].len;
+    }
+    view->payload = p;
+    view->payload_len = remaining - data_len;
+    view->payload_type = primary_pt;
+    *block_count = count;
+    return true;
+}
+
+// Пропущенные sequence восстанавливаются из избыточных блоков текущего пакета и
+// передаются в AudioManager перед основным блоком. Для G.711 кадр в байтах равен
+// кадру в отсчетах, поэтому номер блока = sequence - смещение / длина основного
+void RTPManager::recoverLost(int channel_id, const rtp_view_t& view, const rtp_red_block_t* blocks, int block_count) {
+    RTPChannel* channel = &channels[channel_id];
+    if (!channel->red_seq_valid) {
+        channel->red_expected_seq = view.sequence + 1;
+        channel->red_seq_valid = true;
+        return;
+    }
+    int16_t gap = (int16_t)(view.sequence - channel->red_expected_seq);
+    if (gap < 0) {
+        return; // Опоздавший или повторный пакет
+    }
+    channel->red_expected_seq = view.sequence + 1;
+    if (gap == 0) {
+        return;
+    }
+    
+    int recovered = 0;
+    size_t frame_len = view.payload_len;
+    if (channel->relay_peer < 0 && audio_manager && frame_len > 0) {
+        for (int i = 0; i < block_count; i++) {
+            const rtp_red_block_t& block = blocks[i];
+            if (block.payload_type != channel->payload_type || block.len == 0 || block.ts_offset % frame_len != 0) {
+                continue;
+            }
+            uint16_t frames_back = block.ts_offset / frame_len;
+            if (frames_back == 0 || frames_back > gap) {
+                continue; // Блок не из пропущенного интервала
+            }
+            audio_manager->queueIncomingRTP(channel_id, block.data, block.len,
+                                            view.timestamp - block.ts_offset,
+                                            (uint16_t)(view.sequence - frames_back), block.payload_type);
+            recovered++;
+        }
+    }
+    if (gap > 64) {
+        return; // Разрыв потока, а не потери
+    }
+    channel->red_recovered += recovered;
+    channel->red_lost += gap - recovered;
+    metrics.inc(metric_red_recovered, channel_id, recovered);
+    metrics.inc(metric_red_lost, channel_id, gap - recovered);
+}
+
+void RTPManager::resetRelayState(RTPChannel* channel) {
+    channel->relay_synced = false;
+    channel->relay_source_ssrc = 0;
+    channel->relay_seq_offset = 0;
+    channel->relay_ts_offset = 0;
+    channel->relay_packets = 0;
+    channel->relay_transcoded = 0;
+    channel->relay_dropped = 0;
+}
+
+bool RTPManager::startRelay(int channel_a, int channel_b) {
+    if (!isChannelActive(channel_a) || !isChannelActive(channel_b) || channel_a == channel_b) {
+        Serial.printf("RTPManager: Ретрансляция %d <-> %d невозможна\n", channel_a, channel_b);
+        return false;
+    }
+    stopRelay(channel_a);
+    stopRelay(channel_b);
+    
+    int ids[2] = { channel_a, channel_b };
+    for (int i = 0; i < 2; i++) {
+        resetRelayState(&channels[ids[i]]);
+        channels[ids[i]].relay_peer = ids[1 - i];
+        // AudioKit больше не получает и не передает аудио этих вызовов
+        if (audio_manager) {
+            audio_manager->setCallActive(ids[i], false);
+        }
+    }
+    
+    Serial.printf("RTPManager: Ретрансляция %d (PT%d) <-> %d (PT%d)\n",
+                 channel_a, channels[channel_a].payload_type,
+                 channel_b, channels[channel_b].payload_type);
+    return true;
+}
+
+void RTPManager::stopRelay(int channel_id) {
+    if (channel_id < 0 || channel_id >= max_channels) return;
+    int peer = channels[channel_id].relay_peer;
+    if (peer < 0) return;
+    
+    channels[channel_id].relay_peer = -1;
+    if (peer < max_channels && channels[peer].relay_peer == channel_id) {
+        channels[peer].relay_peer = -1;
+    }
+    // Следующий RTP пакет снова активирует вызов в AudioManager
+    Serial.printf("RTPManager: Ретрансляция %d <-> %d остановлена\n", channel_id, peer);
+}
+
+int RTPManager::getRelayPeer(int channel_id) const {
+    if (channel_id < 0 || channel_id >= max_channels) return -1;
+    return channels[channel_id].relay_peer;
+}
+
+void RTPManager::getRelayStats(int channel_id, uint32_t* packets, uint32_t* transcoded, uint32_t* dropped) const {
+    bool valid = channel_id >= 0 && channel_id < max_channels;
+    if (packets) *packets = valid ? channels[channel_id].relay_packets : 0;
+    if (transcoded) *transcoded = valid ? channels[channel_id].relay_transcoded : 0;
+    if (dropped) *dropped = valid ? channels[channel_id].relay_dropped : 0;
+}
+
+void RTPManager::relayPacket(int channel_id, const rtp_view_t& view) {
+    RTPChannel* source = &channels[channel_id];
+    int peer = source->relay_peer;
+    if (peer < 0 || peer >= max_channels || !channels[peer].active) {
+        source->relay_dropped++;
+        return;
+    }
+    RTPChannel* target = &channels[peer];
+    
+    // Полезная нагрузка уже без CSRC, расширения заголовка и заполнения
+    size_t payload_len = view.payload_len;
+    if (payload_len == 0 || payload_len > RTP_PACKET_SIZE) {
+        source->relay_dropped++;
+        return;
+    }
+    const uint8_t* payload = view.payload;
+    
+    // Перекодирование только между G.711 законами, остальное должно совпадать
+    uint8_t in_pt = view.payload_type;
+    uint8_t out_pt = in_pt;
+    const uint8_t* table = nullptr;
+    if (in_pt != target->payload_type) {
+        if (in_pt == 0 && target->payload_type == 8) {
+            table = ulaw_to_alaw_table;
+        } else if (in_pt == 8 && target->payload_type == 0) {
+            table = alaw_to_ulaw_table;
+        } else if (in_pt == source->payload_type) {
+            // Кодек вызова не совпадает и не перекодируется
+            source->relay_dropped++;
+            return;
+        }
+        // Прочие payload type (telephone-event, CN) передаются как есть
+        if (table) {
+            out_pt = target->payload_type;
+        }
+    }
+    
+    uint16_t in_seq = view.sequence;
+    uint32_t in_ts = view.timestamp;
+    uint32_t in_ssrc = view.ssrc;
+    bool marker = view.marker;
+    
+    if (!target->relay_synced || in_ssrc != target->relay_source_ssrc) {
+        // Новый источник: продолжаем исходящий поток канала без скачка sequence,
+        // timestamp продвигается на прошедшее реальное время
+        uint16_t next_seq = target->tx_started ? target->last_tx_sequence + 1 : (uint16_t)esp_random();
+        uint32_t next_ts = target->tx_started ?
+            target->last_tx_timestamp + (millis() - target->last_tx_time) * (target->clock_rate / 1000) :
+            esp_random();
+        target->relay_seq_offset = next_seq - in_seq;
+        target->relay_ts_offset = next_ts - in_ts;
+        target->relay_source_ssrc = in_ssrc;
+        target->relay_synced = true;
+        marker = true;
+    }
+    uint16_t out_seq = in_seq + target->relay_seq_offset;
+    uint32_t out_ts = in_ts + target->relay_ts_offset;
+    
+    uint8_t* out = MediaSocket::beginPacket(&target->tx, RTP_HEADER_SIZE + payload_len);
+    if (!out) {
+        source->relay_dropped++;
+        return;
+    }
+    out[0] = 0x80;
+    out[1] = (marker ? 0x80 : 0x00) | out_pt;
+    out[2] = (out_seq >> 8) & 0xFF;
+    out[3] = out_seq & 0xFF;
+    out[4] = (out_ts >> 24) & 0xFF;
+    out[5] = (out_ts >> 16) & 0xFF;
+    out[6] = (out_ts >> 8) & 0xFF;
+    out[7] = out_ts & 0xFF;
+    out[8] = (target->ssrc >> 24) & 0xFF;
+    out[9] = (target->ssrc >> 16) & 0xFF;
+    out[10] = (target->ssrc >> 8) & 0xFF;
+    out[11] = target->ssrc & 0xFF;
+    if (table) {
+        for (size_t i = 0; i < payload_len; i++) {
+            out[RTP_HEADER_SIZE + i] = table[payload[i]];
+        }
+        source->relay_transcoded++;
+    } else {
+        memcpy(out + RTP_HEADER_SIZE, payload, payload_len);
+    }
+    
+    if (!target->socket->send(&target->tx, target->remote_addr, target->remote_port)) {
+        source->relay_dropped++;
+        metrics.inc(metric_send_errors, source->relay_peer);
+        return;
+    }
+    metrics.inc(metric_tx_packets, source->relay_peer);
+    metrics.inc(metric_tx_bytes, source->relay_peer, RTP_HEADER_SIZE + payload_len);
+    if (target->socket->getTOS()) {
+        metrics.inc(metric_dscp_marked, source->relay_peer);
+    }
+    packetCapture.capture(PCAP_KIND_RTP, PCAP_DIR_TX, source->relay_peer, target->remote_addr,
+                          target->remote_port, target->local_port, out, RTP_HEADER_SIZE + payload_len);
+    
+    // Поздние пакеты (переупорядочивание) не откатывают последние значения
+    if (!target->tx_started || (int16_t)(out_seq - target->last_tx_sequence) > 0) {
+        target->last_tx_sequence = out_seq;
+        target->last_tx_timestamp = out_ts;
+        target->last_tx_time = millis();
+        target->tx_started = true;
+    }
+    source->relay_packets++;
 }
 
 void RTPManager::closeChannel(int channel_id) {
     if (channel_id >= 0 && channel_id < max_channels && channels[channel_id].active) {
+        stopRelay(channel_id);
         channels[channel_id].active = false;
-        channels[channel_id].socket.close();
         channels[channel_id].rtp_socket_ready = false;
+        channels[channel_id].red_pt = 0;
+        // Сокет и pbuf передачи остаются для следующего вызова на этом канале
+        if (shared_socket) {
+            rebuildDemux();
+        }
         
         Serial.printf("RTPManager: Канал %d закрыт\n", channel_id);
     }
@@ -292,13 +1059,20 @@ bool RTPManager::isChannelActive(int channel_id) const {
     return (channel_id >= 0 && channel_id < max_channels && channels[channel_id].active);
 }
 
+uint8_t RTPManager::getPayloadType(int channel_id) const {
+    if (channel_id < 0 || channel_id >= max_channels) {
+        return 0xFF;
+    }
+    return channels[channel_id].payload_type;
+}
+
 // Получить текущий джиттер в миллисекундах
 float RTPManager::getJitterMs(int channel_id) const {
     if (channel_id < 0 || channel_id >= max_channels || !channels[channel_id].active) 
         return 0.0f;
     
     const RTPChannel* channel = &channels[channel_id];
-    return (float)channel->jitter_rfc / (channel->clock_rate / 1000);
+    return (float)channel->jitter_q4 * 1000.0f / (16.0f * channel->clock_rate);
 }
 
 // Получить процент потерь пакетов
@@ -345,9 +1119,100 @@ void RTPManager::printRTPStatus() {
                          (unsigned long)channels[i].received_packets,
                          (unsigned long)channels[i].lost_packets,
                          loss_percent,
-                         channels[i].jitter_rfc,
+                         channels[i].jitter_q4 >> 4,
                          jitter_ms);
         }
     }
     Serial.println("====================");
-}
\ No newline at end of file
+}
+// Заголовок тестового пакета: CSRC, расширение и заполнение задаются параметрами
+static size_t buildTestPacket(uint8_t* buf, uint8_t first_byte, uint8_t pt, int csrc_words,
+                              int ext_words, int payload, uint8_t padding) {
+    size_t len = 0;
+    buf[len++] = first_byte;
+    buf[len++] = pt;
+    for (int i = 0; i < 10; i++) buf[len++] = 0x10 + i;
+    for (int i = 0; i < csrc_words * 4; i++) buf[len++] = 0xCC;
+    if (ext_words >= 0) {
+        buf[len++] = 0xBE;
+        buf[len++] = 0xDE;
+        buf[len++] = 0;
+        buf[len++] = ext_words;
+        for (int i = 0; i < ext_words * 4; i++) buf[len++] = 0xEE;
+    }
+    for (int i = 0; i < payload; i++) buf[len++] = 0xD5;
+    for (int i = 0; i < padding; i++) buf[len++] = i + 1 == padding ? padding : 0;
+    return len;
+}
+
+void RTPManager::benchmarkParser(int iterations) {
+    typedef struct {
+        const char* name;
+        uint8_t first_byte;
+        uint8_t pt;
+        int csrc_words;
+        int ext_words;              // -1 - без расширения
+        int payload;
+        uint8_t padding;
+        int truncate;               // Отрезать байт с конца пакета
+        rtp_parse_result_t expected;
+        size_t payload_offset;
+        size_t payload_len;
+    } parser_case_t;
+    
+    static const parser_case_t cases[] = {
+        { "plain",             0x80, 0,   0, -1, 160, 0, 0,   RTP_PARSE_OK,            12, 160 },
+        { "csrc x2",           0x82, 8,   2, -1, 160, 0, 0,   RTP_PARSE_OK,            20, 160 },
+        { "extension",         0x90, 0,   0, 2,  160, 0, 0,   RTP_PARSE_OK,            24, 160 },
+        { "padding 4",         0xA0, 0,   0, -1, 160, 4, 0,   RTP_PARSE_OK,            12, 160 },
+        { "csrc+ext+padding",  0xB3, 101, 3, 1,  4,   8, 0,   RTP_PARSE_OK,            32, 4 },
+        { "csrc overflow",     0x8F, 0,   2, -1, 0,   0, 0,   RTP_PARSE_BAD_CSRC,      0, 0 },
+        { "extension overflow",0x90, 0,   0, 4,  0,   0, 4,   RTP_PARSE_BAD_EXTENSION, 0, 0 },
+        { "padding 0",         0xA0, 0,   0, -1, 160, 0, 0,   RTP_PARSE_BAD_PADDING,   0, 0 },
+        { "padding > payload", 0xA0, 0,   0, -1, 2,   0, 0,   RTP_PARSE_BAD_PADDING,   0, 0 },
+        { "version 1",         0x40, 0,   0, -1, 160, 0, 0,   RTP_PARSE_BAD_VERSION,   0, 0 },
+        { "rtcp sr",           0x80, 200, 0, -1, 16,  0, 0,   RTP_PARSE_RTCP,          0, 0 },
+        { "too short",         0x80, 0,   0, -1, 0,   0, 4,   RTP_PARSE_TOO_SHORT,     0, 0 },
+    };
+    static uint8_t packet[RTP_HEADER_SIZE + RTP_PACKET_SIZE];
+    
+    Serial.println("=== RTP PARSER SELF-CHECK ===");
+    int failed = 0;
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const parser_case_t& tc = cases[c];
+        size_t len = buildTestPacket(packet, tc.first_byte, tc.pt, tc.csrc_words, tc.ext_words,
+                                     tc.payload, tc.padding);
+        len -= tc.truncate;
+        if (tc.padding == 0 && (tc.first_byte & 0x20)) {
+            packet[len - 1] = tc.payload > 2 ? 0 : 200;     // Некорректный счетчик заполнения
+        }
+        
+        rtp_view_t view;
+        rtp_parse_result_t result = parseRTP(packet, len, &view);
+        bool ok = result == tc.expected;
+        if (ok && result == RTP_PARSE_OK) {
+            ok = (size_t)(view.payload - packet) == tc.payload_offset && view.payload_len == tc.payload_len;
+        }
+        if (!ok) failed++;
+        Serial.printf("%-20s %s (результат %d)\n", tc.name, ok ? "PASS" : "FAIL", result);
+    }
+    
+    // Скорость разбора на типичном пакете G.711 20 мс
+    size_t len = buildTestPacket(packet, 0x80, 0, 0, -1, 160, 0);
+    rtp_view_t view;
+    uint32_t checksum = 0;
+    uint32_t start = ESP.getCycleCount();
+    for (int i = 0; i < iterations; i++) {
+        packet[3] = (uint8_t)i;
+        if (parseRTP(packet, len, &view) == RTP_PARSE_OK) {
+            checksum += view.sequence;
+        }
+    }
+    uint32_t cycles = ESP.getCycleCount() - start;
+    
+    Serial.printf("Разбор: %.1f нс/пакет (%d итераций, контроль %lu)\n",
+                  iterations > 0 ? 1000.0f * cycles / ESP.getCpuFreqMHz() / iterations : 0.0f,
+                  iterations, (unsigned long)checksum);
+    Serial.printf("Итог: %s (%d ошибок)\n", failed ? "FAIL" : "PASS", failed);
+    Serial.println("=============================");
+}
@@ -2,8 +2,8 @@
 #define RTPMANAGER_H
 
 #include <Arduino.h>
-#include <AsyncUDP.h>
 #include "ConfigManager.h"
+#include "MediaSocket.h"
 
 // Предварительное объявление чтобы избежать циклической зависимости
 class AudioManager;
@@ -21,12 +21,70 @@ typedef struct {
 #define RTP_PACKET_SIZE 1024
 #define AUDIO_FRAME_SIZE 160
 
+#define RTP_PT_CN 13                    // Comfort noise (RFC 3389)
+#define RTP_PT_TELEPHONE_EVENT 101      // DTMF RFC 2833, как в SDP предложении
+#define RTP_SSRC_SWITCH_MS 200          // Тишина прежнего SSRC, после которой принимается новый
+
+// Избыточность RFC 2198 (red/8000) для G.711
+#define RTP_RED_MAX_DEPTH 2             // Предыдущих кадров в пакете
+#define RTP_RED_MAX_BLOCKS 4            // Избыточных блоков при разборе входящих пакетов
+#define RTP_RED_MAX_FRAME 480           // Байт кадра в истории (G.711 до 60 мс)
+#define RTP_RED_WINDOW_MS 2000          // Окно измерения потерь для выбора глубины
+
+// Таблицы разделения вызовов на общем сокете (открытая адресация, > 2 * max_calls)
+#define RTP_DEMUX_BITS 5
+#define RTP_DEMUX_SLOTS (1 << RTP_DEMUX_BITS)
+
+// Результат разбора RTP заголовка
+typedef enum {
+    RTP_PARSE_OK,
+    RTP_PARSE_TOO_SHORT,
+    RTP_PARSE_BAD_VERSION,
+    RTP_PARSE_BAD_CSRC,         // Список CSRC выходит за пакет
+    RTP_PARSE_BAD_EXTENSION,    // Расширение заголовка выходит за пакет
+    RTP_PARSE_BAD_PADDING,      // Счетчик заполнения 0 или больше полезной нагрузки
+    RTP_PARSE_RTCP              // RTCP на том же порту (rtcp-mux)
+} rtp_parse_result_t;
+
+// Разобранный RTP пакет без копирования: указатели ссылаются на буфер пакета
+typedef struct {
+    const uint8_t* payload;
+    size_t payload_len;         // Без заполнения
+    const uint8_t* extension;   // Данные расширения после 4-байтового заголовка (nullptr - нет)
+    size_t extension_len;
+    uint16_t extension_profile; // 0xBEDE - одно-байтовые элементы RFC 8285
+    uint16_t sequence;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    uint8_t payload_type;
+    uint8_t csrc_count;
+    uint8_t padding;
+    bool marker;
+} rtp_view_t;
+
+// Избыточный блок RFC 2198 входящего пакета
+typedef struct {
+    const uint8_t* data;
+    uint16_t len;
+    uint16_t ts_offset;         // Смещение назад от timestamp основного блока
+    uint8_t payload_type;
+} rtp_red_block_t;
+
+// Элемент таблицы разделения: адрес+порт удаленной стороны или SSRC -> канал
+typedef struct {
+    uint32_t key;               // IPAddress или SSRC
+    uint16_t port;              // 0 для таблицы SSRC
+    int8_t channel;             // -1 - свободно
+} rtp_demux_entry_t;
+
 class RTPManager {
 public:
     struct RTPChannel {
         bool active;
         bool rtp_socket_ready;
-        AsyncUDP socket;
+        MediaSocket* socket;         // Сокет пула (свой для вызова или общий)
+        media_tx_t tx;               // Pbuf исходящих пакетов канала
+        RTPManager* owner;           // Для обработчика сокета
         char remote_ip[16];
         uint16_t remote_port;
         uint16_t local_port;
@@ -44,10 +102,49 @@ public:
         uint32_t last_packet_time;
         
         // Статистика джиттера по RFC 3550
-        int32_t jitter_rfc;          // Текущий джиттер в timestamp units
+        int32_t jitter_q4;           // Текущий джиттер в 1/16 timestamp units (RFC 3550 A.8)
         uint32_t last_rtp_timestamp; // RTP timestamp последнего пакета
-        uint32_t last_arrival_time;  // Время прибытия последнего пакета (в миллисекундах)
+        int64_t last_arrival_us;     // Время прибытия последнего пакета (esp_timer, мкс)
         uint32_t clock_rate;         // Частота часов (8000 для аудио)
+        
+        // Проверка источника входящих пакетов
+        uint32_t remote_addr;        // IPAddress удаленной стороны (0 - не проверяется)
+        uint32_t remote_ssrc;        // SSRC текущего источника
+        bool remote_ssrc_valid;
+        int64_t remote_ssrc_last_us; // Последний пакет текущего SSRC
+        
+        // Последний отправленный пакет (продолжение потока при смене источника)
+        uint16_t last_tx_sequence;
+        uint32_t last_tx_timestamp;
+        uint32_t last_tx_time;
+        bool tx_started;
+        
+        // Избыточность RFC 2198
+        uint8_t red_pt;              // Согласованный payload type red/8000 (0 - нет)
+        uint8_t red_depth;           // Текущая глубина передачи (0 - только основной кадр)
+        uint8_t red_threshold;       // Порог потерь, % (из настроек на момент вызова)
+        uint8_t red_history_count;
+        uint8_t red_history_head;
+        uint16_t red_history_len[RTP_RED_MAX_DEPTH];
+        uint32_t red_history_ts[RTP_RED_MAX_DEPTH];
+        uint8_t* red_history;        // RTP_RED_MAX_DEPTH последних отправленных кадров
+        uint16_t red_expected_seq;   // Следующий ожидаемый sequence приема
+        bool red_seq_valid;
+        uint32_t red_recovered;      // Кадров восстановлено из избыточных блоков
+        uint32_t red_lost;           // Кадров потеряно без восстановления
+        uint32_t red_window_start;
+        uint32_t red_window_received;
+        uint32_t red_window_lost;
+        
+        // Режим ретрансляции: пакеты этого канала уходят в канал relay_peer
+        int relay_peer;              // -1 - обычный режим (через AudioManager)
+        bool relay_synced;           // Смещения для текущего SSRC источника рассчитаны
+        uint32_t relay_source_ssrc;
+        uint16_t relay_seq_offset;
+        uint32_t relay_ts_offset;
+        uint32_t relay_packets;
+        uint32_t relay_transcoded;
+        uint32_t relay_dropped;
     };
 
     RTPManager();
@@ -60,15 +157,39 @@ public:
     // Основные методы для аудио потока
     bool sendAudioData(int channel_id, uint8_t* audio_data, int data_len,
                       uint32_t timestamp, uint16_t sequence, uint8_t codec_type);
-    void processIncomingRTPPacket(AsyncUDPPacket packet, int channel_id);
+    void processIncomingRTPPacket(int channel_id, const uint8_t* data, size_t len,
+                                  uint32_t remote_ip, uint16_t remote_port, int64_t arrival_us);
     
-    void updateSync(int channel_id, uint32_t timestamp, uint16_t sequence);
+    // Разбор заголовка с CSRC, расширением и заполнением (RFC 3550 5.1)
+    static rtp_parse_result_t parseRTP(const uint8_t* data, size_t len, rtp_view_t* view);
+    // Проверка разбора на наборе пакетов и скорость разбора
+    static void benchmarkParser(int iterations = 100000);
+    
+    // arrival_us - время прихода пакета в обработчик сокета (esp_timer_get_time)
+    void updateSync(int channel_id, uint32_t timestamp, uint16_t sequence, int64_t arrival_us);
     uint32_t getRandomNumber();
     void printRTPStatus();
 
+    // Ретрансляция RTP между двумя каналами без UART: SSRC/sequence/timestamp
+    // переписываются под исходящий поток канала, G.711 μ/A-law перекодируется
+    bool startRelay(int channel_a, int channel_b);
+    void stopRelay(int channel_id);
+    int getRelayPeer(int channel_id) const;
+    void getRelayStats(int channel_id, uint32_t* packets, uint32_t* transcoded, uint32_t* dropped) const;
+    
+    // Избыточность RFC 2198: red_pt из SDP (0 - выключена); глубина выбирается по потерям
+    void setRedundancy(int channel_id, uint8_t red_pt);
+    bool getRedundancyStats(int channel_id, uint8_t* depth, uint32_t* recovered, uint32_t* lost) const;
+    // Разбор заголовков блоков; view заменяется основным блоком
+    static bool parseRedundancy(rtp_view_t* view, rtp_red_block_t* blocks, int* block_count);
+    
     // Управление каналами
     int getMaxChannels() const { return max_channels; }
+    // Локальный RTP порт канала для SDP: общий порт или base + 2 * канал
+    uint16_t getLocalPort(int channel_id) const;
+    bool isSharedSocket() const { return shared_socket; }
     bool isChannelActive(int channel_id) const;
+    uint8_t getPayloadType(int channel_id) const;
     
     // Методы для работы с джиттером
     float getJitterMs(int channel_id) const;
@@ -81,6 +202,35 @@ private:
     ConfigManager* config_manager;
     RTPChannel* channels;
     int max_channels;
+    
+    // Сокеты открываются при загрузке: по одному на канал или один общий
+    MediaSocket* sockets;
+    int socket_count;
+    bool shared_socket;
+    uint16_t base_port;
+    rtp_demux_entry_t demux_addr[RTP_DEMUX_SLOTS];
+    rtp_demux_entry_t demux_ssrc[RTP_DEMUX_SLOTS];
+    portMUX_TYPE demux_mux;
+    
+    bool openSocket(int index);
+    static void onMediaPacket(const uint8_t* data, size_t len, uint32_t remote_ip, uint16_t remote_port,
+                              int64_t arrival_us, void* ctx);
+    static void onSharedMediaPacket(const uint8_t* data, size_t len, uint32_t remote_ip, uint16_t remote_port,
+                                    int64_t arrival_us, void* ctx);
+    int demuxFind(const rtp_demux_entry_t* table, uint32_t key, uint16_t port);
+    void demuxInsert(rtp_demux_entry_t* table, uint32_t key, uint16_t port, int channel_id);
+    void demuxRemove(rtp_demux_entry_t* table, uint32_t key, uint16_t port);
+    // Запись в таблицу без блокировки (рабочая таблица - под demux_mux)
+    static void demuxPut(rtp_demux_entry_t* table, uint32_t key, uint16_t port, int channel_id);
+    void rebuildDemux();
+    void relayPacket(int channel_id, const rtp_view_t& view);
+    size_t packRedundancy(RTPChannel* channel, uint8_t depth, uint8_t* out, const uint8_t* audio_data,
+                          int data_len, uint32_t timestamp, uint8_t codec_type);
+    void storeRedundancy(RTPChannel* channel, const uint8_t* audio_data, int data_len, uint32_t timestamp);
+    void recoverLost(int channel_id, const rtp_view_t& view, const rtp_red_block_t* blocks, int block_count);
+    void adaptRedundancy(int channel_id);
+    bool acceptSSRC(RTPChannel* channel, uint32_t ssrc, int64_t arrival_us);
+    void resetRelayState(RTPChannel* channel);
 };
 
 extern RTPManager rtpManager;
@@ -3,11 +3,12 @@
  */
 
 #include "ALINA_SIP_Phone.h"
+#include "Metrics.h"
 
 // Определение глобального экземпляра
 ALINASIPPhone ALINA;
 
-ALINASIPPhone::ALINASIPPhone() : initialized(false) {
+ALINASIPPhone::ALINASIPPhone() : initialized(false), signaling_task_handle(nullptr) {
 }
 
 ALINASIPPhone::~ALINASIPPhone() {
@@ -34,6 +35,7 @@ bool ALINASIPPhone::begin() {
     if (!config.loadConfig()) {
         Serial.println("Using default configuration");
     }
+    metrics.init(config.getMaxCalls());
     
     // 4. Инициализация сети
     if (!network.init()) {
@@ -63,18 +65,38 @@ bool ALINASIPPhone::begin() {
     // 7. Инициализация веб-интерфейса
     web.init();
     
+#if ALINA_SIGNALING_TASK
+    // 8. SIP и веб на ядре сети: loopTask Arduino работает на ядре медиа
+    taskPlan.create(TASK_SIGNALING, signalingTask, this, &signaling_task_handle);
+#endif
+    
     initialized = true;
     Serial.println("=== ALINA SIP Phone Ready ===");
     
     return true;
 }
 
+void ALINASIPPhone::signalingTask(void* pvParameters) {
+    ALINASIPPhone* phone = (ALINASIPPhone*)pvParameters;
+    
+    Serial.printf("Задача сигнализации запущена (ядро %d)\n", xPortGetCoreID());
+    
+    while (1) {
+        phone->sip.process();
+        phone->web.process();
+        // Просыпается по датаграмме SIP или через период опроса веб-сервера
+        phone->sip.waitForPacket(SIGNALING_POLL_MS);
+    }
+}
+
 void ALINASIPPhone::process() {
     if (!initialized) return;
     
+#if !ALINA_SIGNALING_TASK
     // Обработка основных компонентов
     sip.process();
     web.process();
+#endif
     
     // Проверка состояния системы
     if (monitor.getState() == SYSTEM_STATE_ERROR) {
@@ -92,7 +114,7 @@ bool ALINASIPPhone::answerCall() {
 }
 
 bool ALINASIPPhone::hangupCall() {
-    return sip.hangupCall(-1); // -1 означает активный вызов
+    return sip.hangupCall(-1); // -1 означает первый активный вызов
 }
 
 bool ALINASIPPhone::rejectCall() {
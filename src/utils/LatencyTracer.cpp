@@ -0,0 +1,202 @@
+/*
+ * LatencyTracer.cpp - Реализация трассировки задержки
+ */
+
+#include "LatencyTracer.h"
+#include <esp_timer.h>
+
+LatencyTracer latencyTracer;
+
+static const char* const segment_names[2][2] = {
+    { "rx_decode", "rx_uart_write" },
+    { "tx_encode", "tx_udp_send" }
+};
+
+LatencyTracer::LatencyTracer() :
+    max_calls(0),
+    inflight(nullptr),
+    histograms(nullptr),
+    events(nullptr),
+    event_head(0),
+    event_count(0),
+    mux(portMUX_INITIALIZER_UNLOCKED) {
+}
+
+bool LatencyTracer::init(int max_count) {
+    if (inflight) {
+        return true;
+    }
+    inflight = new lat_inflight_t[max_count][2];
+    histograms = new lat_histogram_t[max_count][2][LAT_SEGMENTS];
+    events = (lat_event_t*)malloc(LAT_TRACE_EVENTS * sizeof(lat_event_t));
+    if (!inflight || !histograms || !events) {
+        Serial.println("LatencyTracer: ОШИБКА выделения памяти");
+        return false;
+    }
+    max_calls = max_count;
+    memset(inflight, 0, max_calls * sizeof(*inflight));
+    reset();
+
+    Serial.printf("LatencyTracer: %d вызовов, %d событий трассировки\n", max_calls, LAT_TRACE_EVENTS);
+    return true;
+}
+
+int LatencyTracer::bucketOf(uint32_t us) {
+    if (us < (1u << LAT_MIN_OCTAVE)) {
+        return 0;
+    }
+    int msb = 31 - __builtin_clz(us);
+    if (msb > LAT_MAX_OCTAVE) {
+        return LAT_BUCKETS - 1;
+    }
+    return (msb - LAT_MIN_OCTAVE) * 4 + ((us >> (msb - 2)) & 3);
+}
+
+uint32_t LatencyTracer::bucketUpper(int bucket) {
+    int msb = bucket / 4 + LAT_MIN_OCTAVE;
+    int sub = bucket % 4;
+    return ((uint32_t)(5 + sub) << (msb - 2)) - 1;
+}
+
+void LatencyTracer::record(lat_histogram_t& hist, uint32_t us) {
+    hist.counts[bucketOf(us)]++;
+    hist.count++;
+    if (us > hist.max_us) {
+        hist.max_us = us;
+    }
+}
+
+void LatencyTracer::begin(int call_id, int dir, int64_t start_us) {
+    if (call_id < 0 || call_id >= max_calls) return;
+    lat_inflight_t& slot = inflight[call_id][dir];
+    slot.start = start_us ? start_us : esp_timer_get_time();
+    slot.mark = 0;
+    slot.open = true;
+}
+
+void LatencyTracer::mark(int call_id, int dir) {
+    if (call_id < 0 || call_id >= max_calls) return;
+    lat_inflight_t& slot = inflight[call_id][dir];
+    if (slot.open && slot.mark == 0) {
+        slot.mark = esp_timer_get_time();
+    }
+}
+
+void LatencyTracer::end(int call_id, int dir) {
+    if (call_id < 0 || call_id >= max_calls) return;
+    lat_inflight_t& slot = inflight[call_id][dir];
+    if (!slot.open || slot.mark == 0) return;
+    slot.open = false;
+
+    int64_t now = esp_timer_get_time();
+    uint32_t process_us = (uint32_t)(slot.mark - slot.start);
+    uint32_t total_us = (uint32_t)(now - slot.start);
+    lat_histogram_t* hist = histograms[call_id][dir];
+    record(hist[LAT_SEGMENT_PROCESS], process_us);
+    record(hist[LAT_SEGMENT_OUTPUT], total_us - process_us);
+    record(hist[LAT_SEGMENT_TOTAL], total_us);
+
+    portENTER_CRITICAL(&mux);
+    lat_event_t& event = events[event_head];
+    event.start_us = (uint32_t)slot.start;
+    event.process_us = process_us;
+    event.total_us = total_us;
+    event.call_id = call_id;
+    event.dir = dir;
+    event_head = (event_head + 1) % LAT_TRACE_EVENTS;
+    if (event_count < LAT_TRACE_EVENTS) {
+        event_count++;
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void LatencyTracer::reset() {
+    if (!histograms) return;
+    memset(histograms, 0, max_calls * sizeof(*histograms));
+    portENTER_CRITICAL(&mux);
+    event_head = 0;
+    event_count = 0;
+    portEXIT_CRITICAL(&mux);
+}
+
+bool LatencyTracer::getSummary(int call_id, int dir, int segment, lat_summary_t* summary) {
+    if (!histograms || call_id < 0 || call_id >= max_calls || !summary) return false;
+
+    // Копия: гистограмму продолжает обновлять медиа-путь
+    lat_histogram_t hist = histograms[call_id][dir][segment];
+    summary->count = hist.count;
+    summary->max_us = hist.max_us;
+    summary->p50_us = 0;
+    summary->p99_us = 0;
+    if (hist.count == 0) {
+        return true;
+    }
+
+    uint32_t p50_rank = (hist.count + 1) / 2;
+    uint32_t p99_rank = hist.count - hist.count / 100;
+    uint32_t cumulative = 0;
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+        cumulative += hist.counts[b];
+        uint32_t upper = bucketUpper(b) < hist.max_us ? bucketUpper(b) : hist.max_us;
+        if (summary->p50_us == 0 && cumulative >= p50_rank) {
+            summary->p50_us = upper;
+        }
+        if (cumulative >= p99_rank) {
+            summary->p99_us = upper;
+            break;
+        }
+    }
+    return true;
+}
+
+void LatencyTracer::exportTrace(int seconds, void (*sink)(const uint8_t* data, size_t len, void* ctx), void* ctx) {
+    char line[224];
+    int len = snprintf(line, sizeof(line), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    sink((const uint8_t*)line, len, ctx);
+
+    // Имена дорожек: одна на вызов и направление
+    bool first = true;
+    for (int call = 0; call < max_calls; call++) {
+        for (int dir = 0; dir < 2; dir++) {
+            len = snprintf(line, sizeof(line),
+                           "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Call %d %s\"}}",
+                           first ? "" : ",", call * 2 + dir, call, dir == LAT_DIR_RX ? "RTP->UART" : "UART->RTP");
+            sink((const uint8_t*)line, len, ctx);
+            first = false;
+        }
+    }
+
+    if (events) {
+        int64_t now = esp_timer_get_time();
+        uint32_t now_low = (uint32_t)now;
+        uint32_t window_us = (uint32_t)seconds * 1000000u;
+
+        portENTER_CRITICAL(&mux);
+        uint32_t count = event_count;
+        uint32_t index = (event_head + LAT_TRACE_EVENTS - count) % LAT_TRACE_EVENTS;
+        portEXIT_CRITICAL(&mux);
+
+        for (uint32_t i = 0; i < count; i++) {
+            lat_event_t event;
+            portENTER_CRITICAL(&mux);
+            event = events[(index + i) % LAT_TRACE_EVENTS];
+            portEXIT_CRITICAL(&mux);
+
+            // Возраст по младшим 32 битам (окно трассировки много меньше 71 минуты)
+            uint32_t age = now_low - event.start_us;
+            if (age > window_us) continue;
+            int64_t start = now - age;
+            int tid = event.call_id * 2 + event.dir;
+            len = snprintf(line, sizeof(line),
+                           ",{\"name\":\"%s\",\"cat\":\"media\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lu}"
+                           ",{\"name\":\"%s\",\"cat\":\"media\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lu}",
+                           segment_names[event.dir][0], tid, (long long)start, (unsigned long)event.process_us,
+                           segment_names[event.dir][1], tid, (long long)(start + event.process_us),
+                           (unsigned long)(event.total_us - event.process_us));
+            if (len >= (int)sizeof(line)) len = sizeof(line) - 1;
+            sink((const uint8_t*)line, len, ctx);
+        }
+    }
+
+    sink((const uint8_t*)"]}", 2, ctx);
+}
@@ -0,0 +1,98 @@
+/*
+ * LatencyTracer.h - Трассировка задержки медиа-пути по этапам (esp_timer, мкс)
+ *
+ * RX: приход пакета в обработчик сокета lwIP -> декодирование -> UARTLink::sendAudio.
+ * TX: кадр UART собран в uartTask -> кодирование -> writeTo RTP сокета.
+ * Путь каждого пакета синхронный, поэтому метки хранятся в одном слоте
+ * "текущего пакета" на вызов и направление. Завершенные пакеты попадают
+ * в гистограммы вызова (p50/p99/max) и в кольцо событий для выгрузки
+ * в формате Chrome trace-event.
+ */
+
+#ifndef LATENCY_TRACER_H
+#define LATENCY_TRACER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+#define LAT_DIR_RX 0
+#define LAT_DIR_TX 1
+
+// Отрезки: первый этап, второй этап, полный путь
+#define LAT_SEGMENT_PROCESS 0       // RX: до декодирования, TX: до кодирования
+#define LAT_SEGMENT_OUTPUT 1        // RX: запись в UART, TX: отправка UDP
+#define LAT_SEGMENT_TOTAL 2
+#define LAT_SEGMENTS 3
+
+// Логарифмические корзины: 4 на октаву от 16 мкс до ~1 с (шаг ~19%)
+#define LAT_MIN_OCTAVE 4
+#define LAT_MAX_OCTAVE 19
+#define LAT_BUCKETS ((LAT_MAX_OCTAVE - LAT_MIN_OCTAVE + 1) * 4)
+
+#define LAT_TRACE_EVENTS 1024       // Кольцо завершенных пакетов (~10 с одного вызова в обе стороны)
+
+typedef struct {
+    int64_t start;
+    int64_t mark;
+    bool open;
+} lat_inflight_t;
+
+typedef struct {
+    uint32_t counts[LAT_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+} lat_histogram_t;
+
+typedef struct {
+    uint32_t start_us;          // Младшие 32 бита esp_timer
+    uint32_t process_us;
+    uint32_t total_us;
+    uint8_t call_id;
+    uint8_t dir;
+} lat_event_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} lat_summary_t;
+
+class LatencyTracer {
+private:
+    int max_calls;
+    lat_inflight_t (*inflight)[2];
+    lat_histogram_t (*histograms)[2][LAT_SEGMENTS];
+    lat_event_t* events;
+    uint32_t event_head;
+    uint32_t event_count;
+    portMUX_TYPE mux;
+
+    static int bucketOf(uint32_t us);
+    static uint32_t bucketUpper(int bucket);
+    void record(lat_histogram_t& hist, uint32_t us);
+
+public:
+    LatencyTracer();
+
+    bool init(int max_count);
+
+    // Медиа-путь: begin - начало пакета, mark - конец первого этапа (повторные вызовы
+    // не сдвигают метку), end - пакет записан; незавершенный пакет заменяется следующим
+    void begin(int call_id, int dir, int64_t start_us = 0);
+    void mark(int call_id, int dir);
+    void end(int call_id, int dir);
+    void cancel(int call_id, int dir) {
+        if (call_id >= 0 && call_id < max_calls) inflight[call_id][dir].open = false;
+    }
+
+    void reset();
+    bool getSummary(int call_id, int dir, int segment, lat_summary_t* summary);
+
+    // Chrome trace-event JSON (chrome://tracing, Perfetto) за последние seconds секунд
+    void exportTrace(int seconds, void (*sink)(const uint8_t* data, size_t len, void* ctx), void* ctx);
+};
+
+extern LatencyTracer latencyTracer;
+
+#endif
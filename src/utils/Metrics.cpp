@@ -0,0 +1,169 @@
+/*
+ * Metrics.cpp - Реализация реестра метрик
+ */
+
+#include "Metrics.h"
+
+Metrics metrics;
+
+Metrics::Metrics() :
+    metric_count(0),
+    pool_used(0),
+    sum_used(0),
+    call_series(METRICS_MAX_CALLS),
+    mux(portMUX_INITIALIZER_UNLOCKED),
+    collector_count(0) {
+    memset(pool, 0, sizeof(pool));
+    memset(sum_pool, 0, sizeof(sum_pool));
+}
+
+void Metrics::init(int max_calls) {
+    call_series = max_calls > 0 && max_calls < METRICS_MAX_CALLS ? max_calls : METRICS_MAX_CALLS;
+    Serial.printf("Metrics: %d метрик, серий вызовов: %d\n", metric_count, call_series);
+}
+
+int Metrics::add(const char* name, const char* help, metric_type_t type, bool per_call,
+                 const uint32_t* bounds, int bucket_count) {
+    int series_count = per_call ? METRICS_MAX_CALLS : 1;
+    int words = type == METRIC_HISTOGRAM ? series_count * (bucket_count + 2) : series_count;
+    int sums = type == METRIC_HISTOGRAM ? series_count : 0;
+
+    portENTER_CRITICAL(&mux);
+    if (metric_count >= METRICS_MAX || pool_used + words > METRICS_POOL_SIZE ||
+        sum_used + sums > (int)(sizeof(sum_pool) / sizeof(sum_pool[0]))) {
+        portEXIT_CRITICAL(&mux);
+        Serial.printf("Metrics: ОШИБКА - нет места для метрики %s\n", name);
+        return METRIC_NONE;
+    }
+    int id = metric_count;
+    metric_t& m = metrics[id];
+    m.name = name;
+    m.help = help;
+    m.type = type;
+    m.per_call = per_call;
+    m.values = pool + pool_used;
+    m.sums = sums ? sum_pool + sum_used : nullptr;
+    m.bounds = bounds;
+    m.bucket_count = bucket_count;
+    pool_used += words;
+    sum_used += sums;
+    metric_count++;
+    portEXIT_CRITICAL(&mux);
+    return id;
+}
+
+int Metrics::counter(const char* name, const char* help, bool per_call) {
+    return add(name, help, METRIC_COUNTER, per_call, nullptr, 0);
+}
+
+int Metrics::gauge(const char* name, const char* help, bool per_call) {
+    return add(name, help, METRIC_GAUGE, per_call, nullptr, 0);
+}
+
+int Metrics::histogram(const char* name, const char* help, const uint32_t* bounds, int bucket_count,
+                       bool per_call) {
+    if (!bounds || bucket_count <= 0 || bucket_count > METRICS_MAX_BUCKETS) {
+        return METRIC_NONE;
+    }
+    return add(name, help, METRIC_HISTOGRAM, per_call, bounds, bucket_count);
+}
+
+void Metrics::addCollector(void (*collector)(void* ctx), void* ctx) {
+    if (!collector || collector_count >= METRICS_MAX_COLLECTORS) return;
+    collectors[collector_count] = collector;
+    collector_ctx[collector_count] = ctx;
+    collector_count++;
+}
+
+void Metrics::observe(int id, uint32_t value, int call_id) {
+    if (id < 0 || id >= metric_count || metrics[id].type != METRIC_HISTOGRAM) return;
+    metric_t& m = metrics[id];
+    int s = series(m, call_id);
+    if (s < 0) return;
+
+    int bucket = 0;
+    while (bucket < m.bucket_count && value > m.bounds[bucket]) {
+        bucket++;
+    }
+    volatile uint32_t* values = m.values + s * (m.bucket_count + 2);
+    portENTER_CRITICAL(&mux);
+    values[bucket]++;
+    values[m.bucket_count + 1]++;
+    m.sums[s] += value;
+    portEXIT_CRITICAL(&mux);
+}
+
+static void emit(void (*sink)(const uint8_t* data, size_t len, void* ctx), void* ctx,
+                 const char* line, int len, size_t capacity) {
+    if (len <= 0) return;
+    if ((size_t)len >= capacity) len = capacity - 1;   // Строка обрезана snprintf
+    sink((const uint8_t*)line, len, ctx);
+}
+
+void Metrics::write(void (*sink)(const uint8_t* data, size_t len, void* ctx), void* ctx) {
+    for (int i = 0; i < collector_count; i++) {
+        collectors[i](collector_ctx[i]);
+    }
+
+    static const char* type_names[] = { "counter", "gauge", "histogram" };
+    char line[192];
+    for (int id = 0; id < metric_count; id++) {
+        const metric_t& m = metrics[id];
+        int len = snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n",
+                           m.name, m.help, m.name, type_names[m.type]);
+        emit(sink, ctx, line, len, sizeof(line));
+
+        int series_count = m.per_call ? call_series : 1;
+        for (int s = 0; s < series_count; s++) {
+            char labels[24] = "";
+            if (m.per_call) {
+                snprintf(labels, sizeof(labels), "call=\"%d\"", s);
+            }
+
+            if (m.type != METRIC_HISTOGRAM) {
+                uint32_t value = m.values[s];
+                if (m.type == METRIC_GAUGE) {
+                    len = snprintf(line, sizeof(line), "%s%s%s%s %ld\n", m.name,
+                                   m.per_call ? "{" : "", labels, m.per_call ? "}" : "", (long)(int32_t)value);
+                } else {
+                    len = snprintf(line, sizeof(line), "%s%s%s%s %lu\n", m.name,
+                                   m.per_call ? "{" : "", labels, m.per_call ? "}" : "", (unsigned long)value);
+                }
+                emit(sink, ctx, line, len, sizeof(line));
+                continue;
+            }
+
+            // Снимок серии гистограммы, чтобы корзины и count были согласованы
+            uint32_t counts[METRICS_MAX_BUCKETS + 2];
+            uint64_t sum;
+            const volatile uint32_t* values = m.values + s * (m.bucket_count + 2);
+            portENTER_CRITICAL(&mux);
+            for (int b = 0; b < m.bucket_count + 2; b++) {
+                counts[b] = values[b];
+            }
+            sum = m.sums[s];
+            portEXIT_CRITICAL(&mux);
+
+            const char* sep = m.per_call ? "," : "";
+            uint32_t cumulative = 0;
+            for (int b = 0; b <= m.bucket_count; b++) {
+                cumulative += counts[b];
+                char le[12];
+                if (b < m.bucket_count) {
+                    snprintf(le, sizeof(le), "%lu", (unsigned long)m.bounds[b]);
+                } else {
+                    strcpy(le, "+Inf");
+                }
+                len = snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"%s\"} %lu\n",
+                               m.name, labels, sep, le, (unsigned long)cumulative);
+                emit(sink, ctx, line, len, sizeof(line));
+            }
+            len = snprintf(line, sizeof(line), "%s_sum%s%s%s %llu\n%s_count%s%s%s %lu\n",
+                           m.name, m.per_call ? "{" : "", labels, m.per_call ? "}" : "",
+                           (unsigned long long)sum,
+                           m.name, m.per_call ? "{" : "", labels, m.per_call ? "}" : "",
+                           (unsigned long)counts[m.bucket_count + 1]);
+            emit(sink, ctx, line, len, sizeof(line));
+        }
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ * Metrics.h - Реестр метрик (счетчики, значения, гистограммы) и вывод в формате Prometheus
+ *
+ * Модули регистрируют метрики в своем init() и сохраняют номер метрики.
+ * Увеличение счетчика на медиа-пути - одна атомарная операция без
+ * блокировок. Значения, которые дешевле вычислить при опросе (куча,
+ * джиттер), обновляются функциями сбора перед выводом.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+#define METRICS_MAX 52                  // Зарегистрированных метрик
+#define METRICS_MAX_CALLS 10            // Серий у метрик с меткой call (max_calls <= 10)
+#define METRICS_MAX_BUCKETS 10
+#define METRICS_MAX_COLLECTORS 8
+#define METRICS_POOL_SIZE 768           // Слов для значений всех метрик
+
+#define METRIC_NONE -1
+
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+} metric_type_t;
+
+typedef struct {
+    const char* name;
+    const char* help;
+    metric_type_t type;
+    bool per_call;              // Серия на каждый вызов с меткой call="N"
+    volatile uint32_t* values;  // Счетчик/значение: по серии; гистограмма: корзины, +Inf, count
+    uint64_t* sums;             // Сумма наблюдений гистограммы по сериям
+    const uint32_t* bounds;     // Верхние границы корзин гистограммы
+    int bucket_count;
+} metric_t;
+
+class Metrics {
+private:
+    metric_t metrics[METRICS_MAX];
+    int metric_count;
+    uint32_t pool[METRICS_POOL_SIZE];
+    uint64_t sum_pool[METRICS_MAX_CALLS * 4];
+    int pool_used;
+    int sum_used;
+    int call_series;
+    portMUX_TYPE mux;
+
+    void (*collectors[METRICS_MAX_COLLECTORS])(void* ctx);
+    void* collector_ctx[METRICS_MAX_COLLECTORS];
+    int collector_count;
+
+    int add(const char* name, const char* help, metric_type_t type, bool per_call,
+            const uint32_t* bounds, int bucket_count);
+    static int series(const metric_t& m, int call_id) {
+        return m.per_call ? (call_id >= 0 && call_id < METRICS_MAX_CALLS ? call_id : -1) : 0;
+    }
+
+public:
+    Metrics();
+
+    // Число выводимых серий per_call (обычно max_calls)
+    void init(int max_calls);
+
+    int counter(const char* name, const char* help, bool per_call = false);
+    int gauge(const char* name, const char* help, bool per_call = false);
+    int histogram(const char* name, const char* help, const uint32_t* bounds, int bucket_count,
+                  bool per_call = false);
+    void addCollector(void (*collector)(void* ctx), void* ctx);
+
+    // Медиа-путь: некорректный номер метрики или вызова игнорируется
+    void inc(int id, int call_id = -1, uint32_t delta = 1) {
+        if (id < 0 || id >= metric_count) return;
+        int s = series(metrics[id], call_id);
+        if (s >= 0) {
+            __atomic_fetch_add(&metrics[id].values[s], delta, __ATOMIC_RELAXED);
+        }
+    }
+    void set(int id, int32_t value, int call_id = -1) {
+        if (id < 0 || id >= metric_count) return;
+        int s = series(metrics[id], call_id);
+        if (s >= 0) {
+            metrics[id].values[s] = (uint32_t)value;
+        }
+    }
+    void observe(int id, uint32_t value, int call_id = -1);
+
+    // Текстовый формат Prometheus 0.0.4 по частям, без сборки всего ответа в памяти
+    void write(void (*sink)(const uint8_t* data, size_t len, void* ctx), void* ctx);
+};
+
+extern Metrics metrics;
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ * PacketCapture.cpp - Реализация захвата пакетов
+ */
+
+#include "PacketCapture.h"
+#include <esp_timer.h>
+#include <sys/time.h>
+
+#define PCAP_MAGIC 0xA1B2C3D4           // Временные метки в микросекундах
+#define PCAP_LINKTYPE_RAW 101           // Пакет начинается с заголовка IPv4
+#define PCAP_IP_UDP_HEADER 28
+
+PacketCapture packetCapture;
+
+PacketCapture::PacketCapture() :
+    ring(nullptr),
+    head(0),
+    tail(0),
+    used(0),
+    next_seq(0),
+    tail_seq(0),
+    mux(portMUX_INITIALIZER_UNLOCKED),
+    enabled(false),
+    kinds(PCAP_KIND_ALL),
+    snaplen(PCAP_DEFAULT_SNAPLEN),
+    call_filter(PCAP_ANY_CALL),
+    captured(0),
+    overwritten(0),
+    filtered(0) {
+}
+
+bool PacketCapture::start(uint8_t kind_mask, uint16_t snap, int call_id) {
+    if (!ring) {
+        ring = (uint8_t*)malloc(PCAP_RING_SIZE);
+        if (!ring) {
+            Serial.println("PacketCapture: ОШИБКА выделения памяти для кольца");
+            return false;
+        }
+    }
+    if (snap < PCAP_MIN_SNAPLEN) snap = PCAP_MIN_SNAPLEN;
+    if (snap > PCAP_MAX_SNAPLEN) snap = PCAP_MAX_SNAPLEN;
+
+    portENTER_CRITICAL(&mux);
+    kinds = kind_mask ? kind_mask : PCAP_KIND_ALL;
+    snaplen = snap;
+    call_filter = call_id;
+    portEXIT_CRITICAL(&mux);
+    enabled = true;
+
+    Serial.printf("PacketCapture: захват включен (типы 0x%02X, snaplen %d, вызов %d)\n",
+                  kinds, snaplen, call_filter);
+    return true;
+}
+
+void PacketCapture::clear() {
+    portENTER_CRITICAL(&mux);
+    head = 0;
+    tail = 0;
+    used = 0;
+    tail_seq = next_seq;
+    captured = 0;
+    overwritten = 0;
+    filtered = 0;
+    portEXIT_CRITICAL(&mux);
+}
+
+void PacketCapture::ringWrite(uint32_t pos, const void* data, uint32_t len) {
+    uint32_t first = PCAP_RING_SIZE - pos;
+    if (first >= len) {
+        memcpy(ring + pos, data, len);
+    } else {
+        memcpy(ring + pos, data, first);
+        memcpy(ring, (const uint8_t*)data + first, len - first);
+    }
+}
+
+void PacketCapture::ringRead(uint32_t pos, void* data, uint32_t len) const {
+    uint32_t first = PCAP_RING_SIZE - pos;
+    if (first >= len) {
+        memcpy(data, ring + pos, len);
+    } else {
+        memcpy(data, ring + pos, first);
+        memcpy((uint8_t*)data + first, ring, len - first);
+    }
+}
+
+void PacketCapture::add(uint8_t kind, uint8_t dir, int call_id, uint32_t remote_ip, uint16_t remote_port,
+                        uint16_t local_port, const uint8_t* data, size_t len) {
+    if (!ring || !data) return;
+
+    pcap_record_t rec;
+    rec.time_us = esp_timer_get_time();
+    rec.remote_ip = remote_ip;
+    rec.remote_port = remote_port;
+    rec.local_port = local_port;
+    rec.orig_len = len > 0xFFFF ? 0xFFFF : (uint16_t)len;
+    rec.call_id = (int8_t)call_id;
+    rec.kind = kind;
+    rec.dir = dir;
+    rec.reserved = 0;
+
+    portENTER_CRITICAL(&mux);
+    if (!(kinds & kind) || (call_filter != PCAP_ANY_CALL && call_id != PCAP_ANY_CALL && call_id != call_filter)) {
+        filtered++;
+        portEXIT_CRITICAL(&mux);
+        return;
+    }
+
+    // Копирование ограничено snaplen, вытеснение - только чтение заголовков
+    rec.cap_len = rec.orig_len < snaplen ? rec.orig_len : snaplen;
+    rec.seq = next_seq++;
+    uint32_t size = recordSize(rec.cap_len);
+    while (PCAP_RING_SIZE - used < size) {
+        uint16_t old_cap;
+        ringRead((tail + offsetof(pcap_record_t, cap_len)) % PCAP_RING_SIZE, &old_cap, sizeof(old_cap));
+        uint32_t old_size = recordSize(old_cap);
+        tail = (tail + old_size) % PCAP_RING_SIZE;
+        used -= old_size;
+        tail_seq++;
+        overwritten++;
+    }
+    ringWrite(head, &rec, sizeof(rec));
+    ringWrite((head + sizeof(rec)) % PCAP_RING_SIZE, data, rec.cap_len);
+    head = (head + size) % PCAP_RING_SIZE;
+    used += size;
+    captured++;
+    portEXIT_CRITICAL(&mux);
+}
+
+void PacketCapture::getStats(pcap_stats_t* stats) {
+    if (!stats) return;
+    portENTER_CRITICAL(&mux);
+    stats->enabled = enabled;
+    stats->kinds = kinds;
+    stats->snaplen = snaplen;
+    stats->call_filter = call_filter;
+    stats->captured = captured;
+    stats->overwritten = overwritten;
+    stats->filtered = filtered;
+    stats->buffered = next_seq - tail_seq;
+    stats->used_bytes = used;
+    portEXIT_CRITICAL(&mux);
+}
+
+static bool containsText(const uint8_t* data, size_t len, const char* text) {
+    size_t text_len = strlen(text);
+    if (text_len == 0 || text_len > len) return false;
+    for (size_t i = 0; i + text_len <= len; i++) {
+        if (data[i] == (uint8_t)text[0] && memcmp(data + i, text, text_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void putBE16(uint8_t* p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+void PacketCapture::exportPcap(uint32_t local_ip, int call_id, const char* sip_call_id,
+                               void (*sink)(const uint8_t* data, size_t len, void* ctx), void* ctx) {
+    uint32_t file_header[6];
+    file_header[0] = PCAP_MAGIC;
+    file_header[1] = 2 | (4 << 16);     // Версия 2.4
+    file_header[2] = 0;                 // Часовой пояс
+    file_header[3] = 0;                 // Точность
+    file_header[4] = PCAP_MAX_SNAPLEN + PCAP_IP_UDP_HEADER;
+    file_header[5] = PCAP_LINKTYPE_RAW;
+    sink((const uint8_t*)file_header, sizeof(file_header), ctx);
+    if (!ring) return;
+
+    // Метки esp_timer переводятся в UTC (если время не синхронизировано - время от старта)
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    int64_t wall_offset = (int64_t)now.tv_sec * 1000000LL + now.tv_usec - esp_timer_get_time();
+
+    uint8_t* buffer = (uint8_t*)malloc(16 + PCAP_IP_UDP_HEADER + PCAP_MAX_SNAPLEN);
+    if (!buffer) {
+        Serial.println("PacketCapture: ОШИБКА выделения памяти для выгрузки");
+        return;
+    }
+    uint8_t* packet = buffer + 16;
+    uint8_t* payload = packet + PCAP_IP_UDP_HEADER;
+
+    portENTER_CRITICAL(&mux);
+    uint32_t cursor = tail;
+    uint32_t cursor_seq = tail_seq;
+    uint32_t end_seq = next_seq;        // Пакеты, захваченные во время выгрузки, не включаются
+    portEXIT_CRITICAL(&mux);
+
+    uint32_t exported = 0;
+    while (true) {
+        pcap_record_t rec;
+        portENTER_CRITICAL(&mux);
+        if (cursor_seq < tail_seq) {
+            // Запись вытеснена во время выгрузки - продолжаем с самой старой
+            cursor = tail;
+            cursor_seq = tail_seq;
+        }
+        if (cursor_seq >= end_seq || cursor_seq >= next_seq) {
+            portEXIT_CRITICAL(&mux);
+            break;
+        }
+        ringRead(cursor, &rec, sizeof(rec));
+        ringRead((cursor + sizeof(rec)) % PCAP_RING_SIZE, payload, rec.cap_len);
+        cursor = (cursor + recordSize(rec.cap_len)) % PCAP_RING_SIZE;
+        cursor_seq++;
+        portEXIT_CRITICAL(&mux);
+
+        if (call_id != PCAP_ANY_CALL) {
+            bool match = rec.kind == PCAP_KIND_SIP ?
+                (sip_call_id && containsText(payload, rec.cap_len, sip_call_id)) :
+                rec.call_id == call_id;
+            if (!match) continue;
+        }
+
+        // Заголовок записи pcap
+        int64_t time_us = rec.time_us + wall_offset;
+        uint32_t* record_header = (uint32_t*)buffer;
+        record_header[0] = (uint32_t)(time_us / 1000000LL);
+        record_header[1] = (uint32_t)(time_us % 1000000LL);
+        record_header[2] = PCAP_IP_UDP_HEADER + rec.cap_len;
+        record_header[3] = PCAP_IP_UDP_HEADER + rec.orig_len;
+
+        // IPv4 + UDP (контрольная сумма UDP не вычисляется - 0 допустим для IPv4)
+        bool rx = rec.dir == PCAP_DIR_RX;
+        uint32_t src_ip = rx ? rec.remote_ip : local_ip;
+        uint32_t dst_ip = rx ? local_ip : rec.remote_ip;
+        memset(packet, 0, PCAP_IP_UDP_HEADER);
+        packet[0] = 0x45;
+        putBE16(packet + 2, PCAP_IP_UDP_HEADER + rec.orig_len);
+        putBE16(packet + 4, (uint16_t)rec.seq);
+        packet[8] = 64;
+        packet[9] = 17;
+        memcpy(packet + 12, &src_ip, 4);
+        memcpy(packet + 16, &dst_ip, 4);
+        uint32_t checksum = 0;
+        for (int i = 0; i < 20; i += 2) {
+            checksum += (packet[i] << 8) | packet[i + 1];
+        }
+        while (checksum >> 16) {
+            checksum = (checksum & 0xFFFF) + (checksum >> 16);
+        }
+        putBE16(packet + 10, ~checksum & 0xFFFF);
+        putBE16(packet + 20, rx ? rec.remote_port : rec.local_port);
+        putBE16(packet + 22, rx ? rec.local_port : rec.remote_port);
+        putBE16(packet + 24, 8 + rec.orig_len);
+
+        sink(buffer, 16 + PCAP_IP_UDP_HEADER + rec.cap_len, ctx);
+        exported++;
+    }
+
+    free(buffer);
+    Serial.printf("PacketCapture: выгружено %lu пакетов\n", exported);
+}
@@ -0,0 +1,114 @@
+/*
+ * PacketCapture.h - Кольцевой буфер захвата SIP/RTP/RTCP пакетов с выгрузкой в pcap
+ *
+ * Медиа-путь копирует заголовок записи и не более snaplen байт пакета
+ * в кольцо фиксированного размера (при переполнении вытесняются самые
+ * старые записи). Выгрузка формирует pcap (LINKTYPE_RAW) с восстановленными
+ * заголовками IPv4/UDP; адрес устройства подставляется при выгрузке.
+ */
+
+#ifndef PACKET_CAPTURE_H
+#define PACKET_CAPTURE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+#define PCAP_RING_SIZE (48 * 1024)      // Размер кольца (выделяется при первом запуске)
+#define PCAP_DEFAULT_SNAPLEN 256
+#define PCAP_MIN_SNAPLEN 16
+#define PCAP_MAX_SNAPLEN 1500
+
+// Типы пакетов (битовая маска фильтра)
+#define PCAP_KIND_SIP  0x01
+#define PCAP_KIND_RTP  0x02
+#define PCAP_KIND_RTCP 0x04
+#define PCAP_KIND_ALL  (PCAP_KIND_SIP | PCAP_KIND_RTP | PCAP_KIND_RTCP)
+
+#define PCAP_DIR_RX 0
+#define PCAP_DIR_TX 1
+
+#define PCAP_ANY_CALL -1
+
+typedef struct {
+    uint32_t seq;               // Номер записи (монотонный)
+    int64_t time_us;            // esp_timer_get_time() в момент захвата
+    uint32_t remote_ip;         // IPAddress в порядке байт сети
+    uint16_t remote_port;
+    uint16_t local_port;
+    uint16_t orig_len;
+    uint16_t cap_len;
+    int8_t call_id;             // Канал RTP или PCAP_ANY_CALL для SIP
+    uint8_t kind;
+    uint8_t dir;
+    uint8_t reserved;
+} pcap_record_t;
+
+typedef struct {
+    bool enabled;
+    uint8_t kinds;
+    uint16_t snaplen;
+    int call_filter;
+    uint32_t captured;
+    uint32_t overwritten;       // Вытеснено из кольца до выгрузки
+    uint32_t filtered;
+    uint32_t buffered;          // Записей в кольце сейчас
+    uint32_t used_bytes;
+} pcap_stats_t;
+
+class PacketCapture {
+private:
+    uint8_t* ring;
+    uint32_t head;              // Позиция записи следующей записи
+    uint32_t tail;              // Позиция самой старой записи
+    uint32_t used;
+    uint32_t next_seq;
+    uint32_t tail_seq;
+    portMUX_TYPE mux;
+
+    volatile bool enabled;
+    uint8_t kinds;
+    uint16_t snaplen;
+    int call_filter;
+
+    uint32_t captured;
+    uint32_t overwritten;
+    uint32_t filtered;
+
+    void ringWrite(uint32_t pos, const void* data, uint32_t len);
+    void ringRead(uint32_t pos, void* data, uint32_t len) const;
+    static uint32_t recordSize(uint16_t cap_len) { return (sizeof(pcap_record_t) + cap_len + 3) & ~3u; }
+
+public:
+    PacketCapture();
+
+    // Запуск/остановка без перезагрузки; call_id = PCAP_ANY_CALL - все вызовы
+    bool start(uint8_t kind_mask, uint16_t snap, int call_id);
+    void stop() { enabled = false; }
+    void clear();
+    bool isEnabled() const { return enabled; }
+
+    // Медиа-путь: при выключенном захвате - одна проверка флага
+    void capture(uint8_t kind, uint8_t dir, int call_id, uint32_t remote_ip, uint16_t remote_port,
+                 uint16_t local_port, const uint8_t* data, size_t len) {
+        if (enabled) {
+            add(kind, dir, call_id, remote_ip, remote_port, local_port, data, len);
+        }
+    }
+    void add(uint8_t kind, uint8_t dir, int call_id, uint32_t remote_ip, uint16_t remote_port,
+             uint16_t local_port, const uint8_t* data, size_t len);
+
+    // RTP порт несет и RTCP (rtcp-mux): тип по второму байту заголовка
+    static uint8_t classifyRTP(const uint8_t* data, size_t len) {
+        return (len >= 2 && data[1] >= 200 && data[1] <= 204) ? PCAP_KIND_RTCP : PCAP_KIND_RTP;
+    }
+
+    void getStats(pcap_stats_t* stats);
+
+    // Поток pcap по частям. sip_call_id - Call-ID для отбора SIP сообщений вызова call_id
+    void exportPcap(uint32_t local_ip, int call_id, const char* sip_call_id,
+                    void (*sink)(const uint8_t* data, size_t len, void* ctx), void* ctx);
+};
+
+extern PacketCapture packetCapture;
+
+#endif
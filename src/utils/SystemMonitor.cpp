@@ -3,9 +3,33 @@
  */
 
 #include "SystemMonitor.h"
+#include "Metrics.h"
+#include "TaskPlan.h"
 
 SystemMonitor systemMonitor;
 
+// Метрики системы (номера в реестре metrics)
+static int metric_heap_free = METRIC_NONE;
+static int metric_heap_min_free = METRIC_NONE;
+static int metric_heap_largest = METRIC_NONE;
+static int metric_heap_fragmentation = METRIC_NONE;
+static int metric_errors = METRIC_NONE;
+static int metric_state = METRIC_NONE;
+static int metric_uptime = METRIC_NONE;
+
+// Состояние кучи снимается при опросе /metrics
+static void collectSystemMetrics(void* ctx) {
+    SystemMonitor* monitor = (SystemMonitor*)ctx;
+    uint32_t free_heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    metrics.set(metric_heap_free, free_heap);
+    metrics.set(metric_heap_min_free, esp_get_minimum_free_heap_size());
+    metrics.set(metric_heap_largest, largest);
+    metrics.set(metric_heap_fragmentation, free_heap > 0 ? 100 - (int32_t)((uint64_t)largest * 100 / free_heap) : 0);
+    metrics.set(metric_state, (int32_t)monitor->getState());
+    metrics.set(metric_uptime, millis() / 1000);
+}
+
 SystemMonitor::SystemMonitor() : 
     currentState(SYSTEM_STATE_OK),
     lastError(ERROR_TYPE_NONE),
@@ -24,11 +48,22 @@ void SystemMonitor::init() {
     watchdogTimer = millis();
     lastWatchdogReset = millis();
     
+    if (metric_heap_free == METRIC_NONE) {
+        metric_heap_free = metrics.gauge("alina_heap_free_bytes", "Free 8-bit heap");
+        metric_heap_min_free = metrics.gauge("alina_heap_min_free_bytes", "Lowest free heap since boot");
+        metric_heap_largest = metrics.gauge("alina_heap_largest_free_block_bytes", "Largest allocatable heap block");
+        metric_heap_fragmentation = metrics.gauge("alina_heap_fragmentation_percent", "100 - largest free block / free heap");
+        metric_errors = metrics.counter("alina_system_errors_total", "Errors reported to SystemMonitor");
+        metric_state = metrics.gauge("alina_system_state", "SystemMonitor state: 0 ok, 1 warning, 2 error, 3 recovery");
+        metric_uptime = metrics.gauge("alina_uptime_seconds", "Seconds since boot");
+        metrics.addCollector(collectSystemMetrics, this);
+    }
+    
     Serial.println("Системный монитор инициализирован");
 }
 
 void SystemMonitor::startMonitoring() {
-    xTaskCreate(monitorTask, "SystemMonitor", 4096, this, 5, &monitorTaskHandle);
+    taskPlan.create(TASK_SYSTEM_MONITOR, monitorTask, this, &monitorTaskHandle);
     Serial.println("Мониторинг системы запущен");
 }
 
@@ -37,6 +72,8 @@ void SystemMonitor::monitorTask(void* pvParameters) {
     
     while (1) {
         monitor->checkSystemHealth();
+        // Единственный источник снимков загрузки: веб и отчет читают последний
+        taskPlan.sample();
         vTaskDelay(5000 / portTICK_PERIOD_MS); // Проверка каждые 5 секунд
     }
 }
@@ -90,6 +127,7 @@ void SystemMonitor::checkTasks() {
 void SystemMonitor::reportError(error_type_t errorType, const char* description) {
     lastError = errorType;
     errorCount++;
+    metrics.inc(metric_errors);
     
     Serial.printf("СИСТЕМНАЯ ОШИБКА [%d]: %s (Количество: %lu)\n", 
                   (int)errorType, description, (unsigned long)errorCount);
@@ -155,4 +193,5 @@ void SystemMonitor::printSystemStatus() {
     Serial.printf("Минимум свободной памяти: %lu байт\n", (unsigned long)esp_get_minimum_free_heap_size());
     Serial.printf("Watchdog: %s\n", watchdogEnabled ? "ВКЛ" : "ВЫКЛ");
     Serial.println("========================");
+    taskPlan.printRuntimeStats();
 }
\ No newline at end of file
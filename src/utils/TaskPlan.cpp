@@ -0,0 +1,114 @@
+/*
+ * TaskPlan.cpp - Таблица задач и снимки загрузки процессора
+ */
+
+#include "TaskPlan.h"
+
+TaskPlan taskPlan;
+
+TaskPlan::TaskPlan()
+    : prev_count(0), prev_total(0), mux(portMUX_INITIALIZER_UNLOCKED), stats_count(0) {
+    // Медиа выше сигнализации; фоновые задачи - ниже всех, на ядре сети
+    static const task_plan_entry_t defaults[TASK_PLAN_COUNT] = {
+        { "UART_Task",      4096, 12, ALINA_MEDIA_CORE },
+        { "UART_Task2",     4096, 12, ALINA_MEDIA_CORE },
+        { "Media_Tick",     4096, 11, ALINA_MEDIA_CORE },
+        { "Signaling",      8192, 4,  ALINA_NET_CORE },
+        { "Rec_Writer",     4096, 3,  ALINA_NET_CORE },
+        { "SystemMonitor",  4096, 2,  ALINA_NET_CORE },
+        { "NetworkMonitor", 2048, 2,  ALINA_NET_CORE }
+    };
+    memcpy(plan, defaults, sizeof(plan));
+}
+
+void TaskPlan::configure(task_plan_id_t id, UBaseType_t priority, uint32_t stack_size) {
+    if (id < 0 || id >= TASK_PLAN_COUNT || priority >= configMAX_PRIORITIES) {
+        return;
+    }
+    plan[id].priority = priority;
+    plan[id].stack_size = stack_size;
+}
+
+BaseType_t TaskPlan::create(task_plan_id_t id, TaskFunction_t function, void* arg, TaskHandle_t* handle) {
+    const task_plan_entry_t& entry = plan[id];
+    BaseType_t result = xTaskCreatePinnedToCore(function, entry.name, entry.stack_size, arg,
+                                                entry.priority, handle, entry.core);
+    if (result != pdPASS) {
+        Serial.printf("TaskPlan: ОШИБКА создания задачи %s (стек %lu)\n", entry.name,
+                      (unsigned long)entry.stack_size);
+    }
+    return result;
+}
+
+void TaskPlan::sample() {
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+    TaskStatus_t status[TASK_STATS_MAX];
+    uint32_t total = 0;
+    UBaseType_t count = uxTaskGetSystemState(status, TASK_STATS_MAX, &total);
+
+    // Таймер времени выполнения общий: каждое ядро набирает за интервал total.
+    // Поиск прошлых счетчиков и расчет - без блокировки: prev_* и next_stats
+    // меняет только sample(), вызывающий его один SystemMonitor
+    uint32_t elapsed = total - prev_total;
+
+    TaskHandle_t handles[TASK_STATS_MAX];
+    uint32_t counters[TASK_STATS_MAX];
+    int n = 0;
+    for (UBaseType_t i = 0; i < count; i++) {
+        uint32_t prev = 0;
+        for (int j = 0; j < prev_count; j++) {
+            if (prev_handles[j] == status[i].xHandle) {
+                prev = prev_counters[j];
+                break;
+            }
+        }
+        task_stats_t& entry = next_stats[n];
+        strncpy(entry.name, status[i].pcTaskName, sizeof(entry.name) - 1);
+        entry.name[sizeof(entry.name) - 1] = '\0';
+#if configTASKLIST_INCLUDE_COREID
+        entry.core = status[i].xCoreID == tskNO_AFFINITY ? -1 : status[i].xCoreID;
+#else
+        entry.core = -1;
+#endif
+        entry.priority = status[i].uxCurrentPriority;
+        entry.cpu_percent = elapsed > 0 ? (status[i].ulRunTimeCounter - prev) * 100.0f / elapsed : 0;
+        entry.stack_free = status[i].usStackHighWaterMark;
+        handles[n] = status[i].xHandle;
+        counters[n] = status[i].ulRunTimeCounter;
+        n++;
+    }
+    memcpy(prev_handles, handles, n * sizeof(TaskHandle_t));
+    memcpy(prev_counters, counters, n * sizeof(uint32_t));
+    prev_count = n;
+    prev_total = total;
+
+    portENTER_CRITICAL(&mux);
+    memcpy(stats, next_stats, n * sizeof(task_stats_t));
+    stats_count = n;
+    portEXIT_CRITICAL(&mux);
+#endif
+}
+
+int TaskPlan::getStats(task_stats_t* out, int max_tasks) {
+    portENTER_CRITICAL(&mux);
+    int count = stats_count < max_tasks ? stats_count : max_tasks;
+    memcpy(out, stats, count * sizeof(task_stats_t));
+    portEXIT_CRITICAL(&mux);
+    return count;
+}
+
+void TaskPlan::printRuntimeStats() {
+    task_stats_t report[TASK_STATS_MAX];
+    int count = getStats(report, TASK_STATS_MAX);
+    if (count == 0) {
+        Serial.println("TaskPlan: снимка загрузки нет (статистика времени выполнения отключена в FreeRTOS?)");
+        return;
+    }
+    Serial.println("=== ЗАГРУЗКА ЗАДАЧ ===");
+    Serial.println("Задача            Ядро Приор  ЦП,%  Стек");
+    for (int i = 0; i < count; i++) {
+        Serial.printf("%-17s %4d %5u %5.1f %5lu\n", report[i].name, report[i].core,
+                      (unsigned)report[i].priority, report[i].cpu_percent, (unsigned long)report[i].stack_free);
+    }
+    Serial.println("======================");
+}
@@ -0,0 +1,100 @@
+/*
+ * TaskPlan.h - Размещение задач по ядрам, приоритеты и стеки; загрузка процессора
+ *
+ * PRO_CPU (0): Ethernet, lwIP (tcpip), сигнализация (SIP, веб) и фоновые задачи.
+ * APP_CPU (1): медиа - прием UART и такт медиа. loopTask Arduino тоже работает
+ * на APP_CPU, поэтому SIP и веб-сервер вынесены из loop() в задачу Signaling на
+ * PRO_CPU: сборка страницы настроек больше не делит ядро с тактом медиа.
+ * Прием RTP в потоке tcpip (PRO_CPU) только проверяет пакет и копирует его в
+ * очередь такта медиа: декодирование и UART - на APP_CPU.
+ *
+ * Все задачи создаются через taskPlan.create по записи таблицы; приоритет и
+ * стек меняются taskPlan.configure до запуска, ядра - флагами сборки.
+ */
+
+#ifndef TASK_PLAN_H
+#define TASK_PLAN_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#ifndef ALINA_MEDIA_CORE
+#define ALINA_MEDIA_CORE 1
+#endif
+#ifndef ALINA_NET_CORE
+#define ALINA_NET_CORE 0
+#endif
+// SIP и веб в своей задаче на ALINA_NET_CORE (0 - в loop() скетча, как раньше)
+#ifndef ALINA_SIGNALING_TASK
+#define ALINA_SIGNALING_TASK 1
+#endif
+
+#define TASK_STATS_MAX 32           // Задач в отчете о загрузке
+
+typedef enum {
+    TASK_UART,                      // Прием канала AudioKit 1
+    TASK_UART2,                     // Прием канала AudioKit 2
+    TASK_MEDIA_TICK,
+    TASK_SIGNALING,                 // SIP и веб-сервер
+    TASK_REC_WRITER,
+    TASK_SYSTEM_MONITOR,
+    TASK_NETWORK_MONITOR,
+    TASK_PLAN_COUNT
+} task_plan_id_t;
+
+typedef struct {
+    const char* name;
+    uint32_t stack_size;
+    UBaseType_t priority;
+    BaseType_t core;
+} task_plan_entry_t;
+
+// Загрузка задачи с прошлого снимка
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    int core;                       // -1 - без привязки
+    UBaseType_t priority;
+    float cpu_percent;              // Доля одного ядра
+    uint32_t stack_free;            // Минимум свободного стека, байт
+} task_stats_t;
+
+class TaskPlan {
+private:
+    task_plan_entry_t plan[TASK_PLAN_COUNT];
+
+    // Счетчики прошлого снимка и сборка нового - только у sample()
+    TaskHandle_t prev_handles[TASK_STATS_MAX];
+    uint32_t prev_counters[TASK_STATS_MAX];
+    int prev_count;
+    uint32_t prev_total;
+    task_stats_t next_stats[TASK_STATS_MAX];
+
+    // Опубликованный снимок; mux - его читают веб (задача Signaling) и отчет
+    // в Serial. Под блокировкой только копирование
+    portMUX_TYPE mux;
+    task_stats_t stats[TASK_STATS_MAX];
+    int stats_count;
+
+public:
+    TaskPlan();
+
+    // Приоритет и стек задачи (до ее создания)
+    void configure(task_plan_id_t id, UBaseType_t priority, uint32_t stack_size);
+    const task_plan_entry_t& get(task_plan_id_t id) const { return plan[id]; }
+
+    BaseType_t create(task_plan_id_t id, TaskFunction_t function, void* arg, TaskHandle_t* handle);
+
+    // Снимок загрузки по задачам с прошлого вызова (vTaskGetRunTimeStats в
+    // виде дельт). Вызывает только SystemMonitor по своему периоду: второй
+    // источник вызовов укоротил бы интервал первого
+    void sample();
+    // Копия последнего снимка; 0 - снимка еще нет или сборка FreeRTOS без
+    // статистики времени выполнения
+    int getStats(task_stats_t* out, int max_tasks);
+    void printRuntimeStats();
+};
+
+extern TaskPlan taskPlan;
+
+#endif
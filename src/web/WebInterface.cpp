@@ -8,6 +8,13 @@
 #include "DeviceManager.h"
 #include "EnhancedSIPClient.h"
 #include "RTPManager.h"
+#include "AudioManager.h"
+#include "CallRecorder.h"
+#include "PacketCapture.h"
+#include "Metrics.h"
+#include "LatencyTracer.h"
+#include "TaskPlan.h"
+#include <LittleFS.h>
 
 extern EnhancedSIPClient sipClient;
 extern ConfigManager configManager;
@@ -44,6 +51,29 @@ void WebInterface::handleApiCalls() {
             // Было: json += "\"remote_ip\":\"" + String(sipClient.calls[i].remote_ip) + "\",";
             json += "\"remote_ip\":\"" + String(sipClient.getRemoteIP(i)) + "\",";
             json += "\"state\":\"active\"";
+            drift_stats_t drift;
+            if (audioManager.getCallDriftStats(i, &drift)) {
+                json += ",\"drift_ppm\":" + String(drift.ppm, 1);
+                json += ",\"drift_locked\":" + String(drift.locked ? "true" : "false");
+                json += ",\"slips_dropped\":" + String(drift.dropped);
+                json += ",\"slips_inserted\":" + String(drift.inserted);
+            }
+            uint32_t rx_misses, tx_misses;
+            if (audioManager.getDeadlineMisses(i, &rx_misses, &tx_misses)) {
+                json += ",\"rx_deadline_misses\":" + String(rx_misses);
+                json += ",\"tx_deadline_misses\":" + String(tx_misses);
+            }
+            json += ",\"jitter_ms\":" + String(rtpManager.getJitterMs(i), 3);
+            json += ",\"conference\":" + String(audioManager.isInConference(i) ? "true" : "false");
+            json += ",\"relay_peer\":" + String(rtpManager.getRelayPeer(i));
+            json += ",\"ptime\":" + String(audioManager.getCallPacketTime(i));
+            uint32_t red_recovered, red_lost;
+            uint8_t red_depth;
+            if (rtpManager.getRedundancyStats(i, &red_depth, &red_recovered, &red_lost)) {
+                json += ",\"red_depth\":" + String(red_depth);
+                json += ",\"red_recovered\":" + String(red_recovered);
+                json += ",\"red_lost\":" + String(red_lost);
+            }
             json += "}";
             first = false;
         }
@@ -52,11 +82,428 @@ void WebInterface::handleApiCalls() {
     server.send(200, "application/json", json);
 }
 
+void WebInterface::handleApiConference() {
+    if (server.method() == HTTP_POST) {
+        if (!server.hasArg("action") || !server.hasArg("id")) {
+            server.send(400, "application/json", "{\"success\":false,\"error\":\"Missing 'action' or 'id' parameter\"}");
+            return;
+        }
+        String action = server.arg("action");
+        int id = server.arg("id").toInt();
+        bool ok;
+        if (action == "join") {
+            ok = audioManager.joinConference(id);
+        } else if (action == "leave") {
+            audioManager.leaveConference(id);
+            ok = true;
+        } else {
+            server.send(400, "application/json", "{\"success\":false,\"error\":\"Unknown action\"}");
+            return;
+        }
+        server.send(ok ? 200 : 409, "application/json",
+            "{\"success\":" + String(ok ? "true" : "false") + "}");
+        return;
+    }
+    
+    ConferenceMixer& mixer = audioManager.getConferenceMixer();
+    conf_participant_info_t info[CONF_MAX_PARTICIPANTS];
+    int count = mixer.getParticipants(info, CONF_MAX_PARTICIPANTS);
+    
+    String json = "{";
+    json += "\"anchor\":" + String(audioManager.getConferenceAnchor()) + ",";
+    json += "\"sample_rate\":" + String(CONF_SAMPLE_RATE) + ",";
+    json += "\"tick_cycles\":" + String(mixer.getTickCycles()) + ",";
+    json += "\"participants\":[";
+    for (int i = 0; i < count; i++) {
+        if (i > 0) json += ",";
+        json += "{";
+        json += "\"id\":" + String(info[i].id) + ",";
+        json += "\"local\":" + String(info[i].id == CONF_LOCAL_ID ? "true" : "false") + ",";
+        json += "\"level\":" + String(info[i].level) + ",";
+        json += "\"speaking\":" + String(info[i].speaking ? "true" : "false") + ",";
+        json += "\"underruns\":" + String(info[i].underruns) + ",";
+        json += "\"overruns\":" + String(info[i].overruns);
+        json += "}";
+    }
+    json += "]}";
+    server.send(200, "application/json", json);
+}
+
+void WebInterface::handleApiRelay() {
+    if (server.method() == HTTP_POST) {
+        String action = server.arg("action");
+        bool ok;
+        if (action == "start" && server.hasArg("a") && server.hasArg("b")) {
+            ok = rtpManager.startRelay(server.arg("a").toInt(), server.arg("b").toInt());
+        } else if (action == "stop" && server.hasArg("id")) {
+            rtpManager.stopRelay(server.arg("id").toInt());
+            ok = true;
+        } else {
+            server.send(400, "application/json", "{\"success\":false,\"error\":\"Expected action=start&a=&b= or action=stop&id=\"}");
+            return;
+        }
+        server.send(ok ? 200 : 409, "application/json",
+            "{\"success\":" + String(ok ? "true" : "false") + "}");
+        return;
+    }
+    
+    String json = "[";
+    bool first = true;
+    for (int i = 0; i < rtpManager.getMaxChannels(); i++) {
+        int peer = rtpManager.getRelayPeer(i);
+        if (peer < 0) continue;
+        uint32_t packets, transcoded, dropped;
+        rtpManager.getRelayStats(i, &packets, &transcoded, &dropped);
+        if (!first) json += ",";
+        json += "{";
+        json += "\"id\":" + String(i) + ",";
+        json += "\"peer\":" + String(peer) + ",";
+        json += "\"packets\":" + String(packets) + ",";
+        json += "\"transcoded\":" + String(transcoded) + ",";
+        json += "\"dropped\":" + String(dropped);
+        json += "}";
+        first = false;
+    }
+    json += "]";
+    server.send(200, "application/json", json);
+}
+
+void WebInterface::handleApiRecording() {
+    String action = server.arg("action");
+    if (!server.hasArg("id") || (action != "start" && action != "stop")) {
+        server.send(400, "application/json", "{\"success\":false,\"error\":\"Expected action=start|stop&id=\"}");
+        return;
+    }
+    int id = server.arg("id").toInt();
+    bool ok = true;
+    if (action == "start") {
+        ok = audioManager.isCallActive(id) &&
+             callRecorder.start(id, audioManager.getActiveCodec(id) == CODEC_PCMU ? REC_LAW_ULAW : REC_LAW_ALAW);
+    } else {
+        callRecorder.stop(id);
+    }
+    server.send(ok ? 200 : 409, "application/json",
+        "{\"success\":" + String(ok ? "true" : "false") + "}");
+}
+
+void WebInterface::handleApiRecordings() {
+    String json = "{";
+    json += "\"enabled\":" + String(configManager.isCallRecordingEnabled() ? "true" : "false") + ",";
+    json += "\"ready\":" + String(callRecorder.isReady() ? "true" : "false") + ",";
+
+    recording_info_t info[REC_MAX_ACTIVE];
+    int count = callRecorder.getActiveRecordings(info, REC_MAX_ACTIVE);
+    json += "\"active\":[";
+    for (int i = 0; i < count; i++) {
+        if (i > 0) json += ",";
+        json += "{";
+        json += "\"id\":" + String(info[i].call_id) + ",";
+        json += "\"file\":\"" + String(info[i].path + strlen(REC_DIR) + 1) + "\",";
+        json += "\"seconds\":" + String(info[i].seconds) + ",";
+        json += "\"bytes\":" + String(info[i].bytes_written) + ",";
+        json += "\"dropped\":" + String(info[i].dropped_bytes);
+        json += "}";
+    }
+    json += "],\"files\":[";
+
+    if (callRecorder.isReady()) {
+        File dir = LittleFS.open(REC_DIR);
+        bool first = true;
+        File entry = dir.openNextFile();
+        while (entry) {
+            String name = entry.name();
+            int slash = name.lastIndexOf('/');
+            if (slash >= 0) name = name.substring(slash + 1);
+            if (!entry.isDirectory() && CallRecorder::isValidName(name)) {
+                if (!first) json += ",";
+                json += "{\"name\":\"" + name + "\",\"size\":" + String((uint32_t)entry.size()) + "}";
+                first = false;
+            }
+            entry.close();
+            entry = dir.openNextFile();
+        }
+        dir.close();
+        json += "],\"free\":" + String((uint32_t)(LittleFS.totalBytes() - LittleFS.usedBytes()));
+    } else {
+        json += "],\"free\":0";
+    }
+    json += "}";
+    server.send(200, "application/json", json);
+}
+
+static bool recordingInUse(const String& path) {
+    recording_info_t info[REC_MAX_ACTIVE];
+    int count = callRecorder.getActiveRecordings(info, REC_MAX_ACTIVE);
+    for (int i = 0; i < count; i++) {
+        if (path == info[i].path) return true;
+    }
+    return false;
+}
+
+static void sendRecordingChunk(const uint8_t* data, size_t len, void* ctx) {
+    WebServer* web = (WebServer*)ctx;
+    web->sendContent((const char*)data, len);
+}
+
+void WebInterface::handleDownloadRecording() {
+    String name = server.arg("file");
+    if (!callRecorder.isReady() || !CallRecorder::isValidName(name)) {
+        server.send(400, "text/plain", "Invalid recording name");
+        return;
+    }
+    String path = String(REC_DIR) + "/" + name;
+    if (recordingInUse(path)) {
+        server.send(409, "text/plain", "Recording in progress");
+        return;
+    }
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+        server.send(404, "text/plain", "Recording not found");
+        return;
+    }
+
+    // Длина известна заранее: WAV отдается потоком без сборки в памяти
+    uint32_t frames = CallRecorder::getFrameCount(file);
+    String wav_name = name.substring(0, name.length() - 4) + ".wav";
+    server.setContentLength(CallRecorder::getWAVSize(frames));
+    server.sendHeader("Content-Disposition", "attachment; filename=\"" + wav_name + "\"");
+    server.send(200, "audio/wav", "");
+    if (!CallRecorder::exportWAV(file, sendRecordingChunk, &server)) {
+        Serial.printf("WebInterface: ошибка экспорта записи %s\n", path.c_str());
+    }
+    file.close();
+}
+
+void WebInterface::handleDeleteRecording() {
+    String name = server.arg("file");
+    if (!callRecorder.isReady() || !CallRecorder::isValidName(name)) {
+        server.send(400, "application/json", "{\"success\":false,\"error\":\"Invalid recording name\"}");
+        return;
+    }
+    String path = String(REC_DIR) + "/" + name;
+    if (recordingInUse(path)) {
+        server.send(409, "application/json", "{\"success\":false,\"error\":\"Recording in progress\"}");
+        return;
+    }
+    bool ok = LittleFS.remove(path);
+    server.send(ok ? 200 : 404, "application/json",
+        "{\"success\":" + String(ok ? "true" : "false") + "}");
+}
+
+// Накопление мелких частей (записи pcap, строки метрик) в один блок chunked-ответа
+typedef struct {
+    WebServer* server;
+    uint8_t data[1460];
+    size_t fill;
+} chunk_stream_t;
+
+static void sendStreamChunk(const uint8_t* data, size_t len, void* ctx) {
+    chunk_stream_t* stream = (chunk_stream_t*)ctx;
+    while (len > 0) {
+        size_t part = sizeof(stream->data) - stream->fill;
+        if (part > len) part = len;
+        memcpy(stream->data + stream->fill, data, part);
+        stream->fill += part;
+        data += part;
+        len -= part;
+        if (stream->fill == sizeof(stream->data)) {
+            stream->server->sendContent((const char*)stream->data, stream->fill);
+            stream->fill = 0;
+        }
+    }
+}
+
+// Начало chunked-ответа неизвестной длины; nullptr - ответ с ошибкой уже отправлен
+static chunk_stream_t* beginStream(WebServer& server, const char* content_type, const char* file_name) {
+    chunk_stream_t* stream = (chunk_stream_t*)malloc(sizeof(chunk_stream_t));
+    if (!stream) {
+        server.send(500, "text/plain", "Out of memory");
+        return nullptr;
+    }
+    stream->server = &server;
+    stream->fill = 0;
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    if (file_name) {
+        server.sendHeader("Content-Disposition", "attachment; filename=\"" + String(file_name) + "\"");
+    }
+    server.send(200, content_type, "");
+    return stream;
+}
+
+static void endStream(chunk_stream_t* stream) {
+    if (stream->fill > 0) {
+        stream->server->sendContent((const char*)stream->data, stream->fill);
+    }
+    stream->server->sendContent("");
+    free(stream);
+}
+
+void WebInterface::handleApiCapture() {
+    if (server.method() == HTTP_POST) {
+        String action = server.arg("action");
+        bool ok = true;
+        if (action == "start") {
+            uint8_t kinds = 0;
+            String types = server.hasArg("types") ? server.arg("types") : String("sip,rtp,rtcp");
+            if (types.indexOf("sip") >= 0) kinds |= PCAP_KIND_SIP;
+            if (types.indexOf("rtp") >= 0) kinds |= PCAP_KIND_RTP;
+            if (types.indexOf("rtcp") >= 0) kinds |= PCAP_KIND_RTCP;
+            int snaplen = server.hasArg("snaplen") ? server.arg("snaplen").toInt() : PCAP_DEFAULT_SNAPLEN;
+            int call = server.hasArg("call") ? server.arg("call").toInt() : PCAP_ANY_CALL;
+            if (server.hasArg("clear")) {
+                packetCapture.clear();
+            }
+            ok = packetCapture.start(kinds, snaplen, call);
+        } else if (action == "stop") {
+            packetCapture.stop();
+        } else if (action == "clear") {
+            packetCapture.clear();
+        } else {
+            server.send(400, "application/json", "{\"success\":false,\"error\":\"Expected action=start|stop|clear\"}");
+            return;
+        }
+        server.send(ok ? 200 : 500, "application/json",
+            "{\"success\":" + String(ok ? "true" : "false") + "}");
+        return;
+    }
+
+    // GET: поток pcap; call=N оставляет RTP канала и SIP с его Call-ID
+    int call = server.hasArg("call") ? server.arg("call").toInt() : PCAP_ANY_CALL;
+    const char* sip_call_id = nullptr;
+    if (call != PCAP_ANY_CALL) {
+        sip_call_id = sipClient.getCallId(call);
+        if (sip_call_id && sip_call_id[0] == '\0') sip_call_id = nullptr;
+    }
+    IPAddress local_ip;
+    local_ip.fromString(networkManager.getLocalIP());
+
+    chunk_stream_t* stream = beginStream(server, "application/vnd.tcpdump.pcap", "alina.pcap");
+    if (!stream) return;
+    packetCapture.exportPcap((uint32_t)local_ip, call, sip_call_id, sendStreamChunk, stream);
+    endStream(stream);
+}
+
+void WebInterface::handleMetrics() {
+    chunk_stream_t* stream = beginStream(server, "text/plain; version=0.0.4", nullptr);
+    if (!stream) return;
+    metrics.write(sendStreamChunk, stream);
+    endStream(stream);
+}
+
+// Загрузка процессора по задачам: последний снимок SystemMonitor
+void WebInterface::handleApiTasks() {
+    static task_stats_t stats[TASK_STATS_MAX];
+    int count = taskPlan.getStats(stats, TASK_STATS_MAX);
+    String json = "[";
+    for (int i = 0; i < count; i++) {
+        if (i > 0) json += ",";
+        json += "{\"name\":\"" + String(stats[i].name) + "\"";
+        json += ",\"core\":" + String(stats[i].core);
+        json += ",\"priority\":" + String((unsigned)stats[i].priority);
+        json += ",\"cpu_percent\":" + String(stats[i].cpu_percent, 1);
+        json += ",\"stack_free\":" + String((unsigned long)stats[i].stack_free);
+        json += "}";
+    }
+    json += "]";
+    server.send(200, "application/json", json);
+}
+
+void WebInterface::handleApiLatency() {
+    if (server.method() == HTTP_POST) {
+        if (server.arg("action") != "reset") {
+            server.send(400, "application/json", "{\"success\":false,\"error\":\"Expected action=reset\"}");
+            return;
+        }
+        latencyTracer.reset();
+        server.send(200, "application/json", "{\"success\":true}");
+        return;
+    }
+    
+    static const char* const dir_names[2] = { "rx", "tx" };
+    static const char* const segment_names[2][LAT_SEGMENTS] = {
+        { "decode", "uart_write", "total" },
+        { "encode", "udp_send", "total" }
+    };
+    String json = "[";
+    bool first = true;
+    for (int i = 0; i < configManager.getMaxCalls(); i++) {
+        lat_summary_t total[2];
+        if (!latencyTracer.getSummary(i, LAT_DIR_RX, LAT_SEGMENT_TOTAL, &total[0]) ||
+            !latencyTracer.getSummary(i, LAT_DIR_TX, LAT_SEGMENT_TOTAL, &total[1]) ||
+            total[0].count + total[1].count == 0) {
+            continue;
+        }
+        if (!first) json += ",";
+        json += "{\"id\":" + String(i);
+        for (int dir = 0; dir < 2; dir++) {
+            json += ",\"" + String(dir_names[dir]) + "\":{\"count\":" + String(total[dir].count);
+            for (int seg = 0; seg < LAT_SEGMENTS; seg++) {
+                lat_summary_t summary;
+                latencyTracer.getSummary(i, dir, seg, &summary);
+                json += ",\"" + String(segment_names[dir][seg]) + "\":{";
+                json += "\"p50_us\":" + String(summary.p50_us) + ",";
+                json += "\"p99_us\":" + String(summary.p99_us) + ",";
+                json += "\"max_us\":" + String(summary.max_us) + "}";
+            }
+            json += "}";
+        }
+        json += "}";
+        first = false;
+    }
+    json += "]";
+    server.send(200, "application/json", json);
+}
+
+void WebInterface::handleLatencyTrace() {
+    int seconds = server.hasArg("seconds") ? server.arg("seconds").toInt() : 10;
+    if (seconds <= 0 || seconds > 3600) seconds = 10;
+    chunk_stream_t* stream = beginStream(server, "application/json", "alina_trace.json");
+    if (!stream) return;
+    latencyTracer.exportTrace(seconds, sendStreamChunk, stream);
+    endStream(stream);
+}
+
+void WebInterface::handleApiCaptureStatus() {
+    pcap_stats_t stats;
+    packetCapture.getStats(&stats);
+    String json = "{";
+    json += "\"enabled\":" + String(stats.enabled ? "true" : "false") + ",";
+    json += "\"sip\":" + String((stats.kinds & PCAP_KIND_SIP) ? "true" : "false") + ",";
+    json += "\"rtp\":" + String((stats.kinds & PCAP_KIND_RTP) ? "true" : "false") + ",";
+    json += "\"rtcp\":" + String((stats.kinds & PCAP_KIND_RTCP) ? "true" : "false") + ",";
+    json += "\"snaplen\":" + String(stats.snaplen) + ",";
+    json += "\"call\":" + String(stats.call_filter) + ",";
+    json += "\"captured\":" + String(stats.captured) + ",";
+    json += "\"overwritten\":" + String(stats.overwritten) + ",";
+    json += "\"filtered\":" + String(stats.filtered) + ",";
+    json += "\"buffered\":" + String(stats.buffered) + ",";
+    json += "\"used_bytes\":" + String(stats.used_bytes) + ",";
+    json += "\"ring_bytes\":" + String(PCAP_RING_SIZE);
+    json += "}";
+    server.send(200, "application/json", json);
+}
+
 void WebInterface::init() {
     Serial.println("Инициализация Web интерфейса Alina");
     
     // Настройка маршрутов
     server.on("/api/calls", HTTP_GET, [this]() { this->handleApiCalls(); });
+    server.on("/api/conference", HTTP_GET, [this]() { this->handleApiConference(); });
+    server.on("/api/conference", HTTP_POST, [this]() { this->handleApiConference(); });
+    server.on("/api/relay", HTTP_GET, [this]() { this->handleApiRelay(); });
+    server.on("/api/relay", HTTP_POST, [this]() { this->handleApiRelay(); });
+    server.on("/api/recordings", HTTP_GET, [this]() { this->handleApiRecordings(); });
+    server.on("/api/recordings/delete", HTTP_POST, [this]() { this->handleDeleteRecording(); });
+    server.on("/api/recording", HTTP_POST, [this]() { this->handleApiRecording(); });
+    server.on("/recordings/wav", HTTP_GET, [this]() { this->handleDownloadRecording(); });
+    server.on("/api/capture", HTTP_GET, [this]() { this->handleApiCapture(); });
+    server.on("/api/capture", HTTP_POST, [this]() { this->handleApiCapture(); });
+    server.on("/api/capture/status", HTTP_GET, [this]() { this->handleApiCaptureStatus(); });
+    server.on("/metrics", HTTP_GET, [this]() { this->handleMetrics(); });
+    server.on("/api/latency", HTTP_GET, [this]() { this->handleApiLatency(); });
+    server.on("/api/latency", HTTP_POST, [this]() { this->handleApiLatency(); });
+    server.on("/api/latency/trace", HTTP_GET, [this]() { this->handleLatencyTrace(); });
+    server.on("/api/tasks", HTTP_GET, [this]() { this->handleApiTasks(); });
     server.on("/", HTTP_GET, [this]() { this->handleRoot(); });
     server.on("/login", HTTP_GET, [this]() { this->handleLogin(); });
     server.on("/login", HTTP_POST, [this]() { this->handleLogin(); });
@@ -344,6 +791,21 @@ void WebInterface::handleSaveConfig() {
         configManager.setUARTBaudRate(server.arg("uart_baud_rate").toInt());
     }
     configManager.setDTMFEnabled(server.hasArg("dtmf_enabled"));
+    configManager.setG729AnnexBEnabled(server.hasArg("g729_annexb"));
+    configManager.setCallRecordingEnabled(server.hasArg("call_recording"));
+    configManager.setUARTLinkV2Enabled(server.hasArg("uart_link_v2"));
+    configManager.setUARTLinkADPCMEnabled(server.hasArg("uart_link_adpcm"));
+    configManager.setUARTLinkCount(server.hasArg("uart_link2") ? 2 : 1);
+    if (server.hasArg("uart_link2_baud_rate")) {
+        configManager.setUARTLink2BaudRate(server.arg("uart_link2_baud_rate").toInt());
+    }
+    if (server.hasArg("uart_link2_tx_pin") && server.hasArg("uart_link2_rx_pin")) {
+        configManager.setUARTLink2Pins(server.arg("uart_link2_tx_pin").toInt(), server.arg("uart_link2_rx_pin").toInt());
+    }
+    configManager.setRTPSharedSocket(server.hasArg("rtp_shared_socket"));
+    if (server.hasArg("red_loss_threshold")) {
+        configManager.setRedLossThreshold(server.arg("red_loss_threshold").toInt());
+    }
 
     // Сохранение сетевых настроек
     if (server.hasArg("static_ip")) {
@@ -359,6 +821,12 @@ void WebInterface::handleSaveConfig() {
         configManager.setDNS(server.arg("dns").c_str());
     }
     configManager.setDHCPServer(server.hasArg("dhcp_enabled"));
+    if (server.hasArg("rtp_dscp")) {
+        configManager.setRTPDSCP(server.arg("rtp_dscp").toInt());
+    }
+    if (server.hasArg("sip_dscp")) {
+        configManager.setSIPDSCP(server.arg("sip_dscp").toInt());
+    }
 
     // Сохранение настроек устройства
     if (server.hasArg("device_name")) {
@@ -794,6 +1262,14 @@ String WebInterface::getSettingsPage() {
     html += "<input type='checkbox' id='dhcp_enabled' name='dhcp_enabled' " + String(config->dhcp_enabled ? "checked" : "") + ">";
     html += "<label for='dhcp_enabled'>Enable DHCP Server</label>";
     html += "</div>";
+    html += "<div class='form-group'>";
+    html += "<label for='rtp_dscp'>RTP DSCP (46 = EF):</label>";
+    html += "<input type='number' id='rtp_dscp' name='rtp_dscp' min='0' max='63' value='" + String(config->rtp_dscp) + "'>";
+    html += "</div>";
+    html += "<div class='form-group'>";
+    html += "<label for='sip_dscp'>SIP DSCP (24 = CS3, 26 = AF31):</label>";
+    html += "<input type='number' id='sip_dscp' name='sip_dscp' min='0' max='63' value='" + String(config->sip_dscp) + "'>";
+    html += "</div>";
     html += "</div>"; // Закрытие Network Settings
     html += "</div>"; // Закрытие tab-content Network
 
@@ -821,8 +1297,13 @@ String WebInterface::getSettingsPage() {
     html += "</select>";
     html += "</div>";
     html += "<div class='form-group'>";
-    html += "<label for='audio_sample_rate'>Sample Rate (Hz):</label>";
-    html += "<input type='number' id='audio_sample_rate' name='audio_sample_rate' value='" + String(config->audio_sample_rate) + "' required>";
+    html += "<label for='audio_sample_rate'>AudioKit Sample Rate:</label>";
+    html += "<select id='audio_sample_rate' name='audio_sample_rate'>";
+    html += "<option value='0'" + String(config->audio_sample_rate == 0 ? " selected" : "") + ">Codec native</option>";
+    html += "<option value='8000'" + String(config->audio_sample_rate == 8000 ? " selected" : "") + ">8000 Hz</option>";
+    html += "<option value='16000'" + String(config->audio_sample_rate == 16000 ? " selected" : "") + ">16000 Hz</option>";
+    html += "<option value='48000'" + String(config->audio_sample_rate == 48000 ? " selected" : "") + ">48000 Hz</option>";
+    html += "</select>";
     html += "</div>";
     html += "<div class='form-group'>";
     html += "<label for='audio_frame_size'>Frame Size (samples):</label>";
@@ -830,7 +1311,12 @@ String WebInterface::getSettingsPage() {
     html += "</div>";
     html += "<div class='form-group'>";
     html += "<label for='audio_packet_time'>Packet Time (ms):</label>";
-    html += "<input type='number' id='audio_packet_time' name='audio_packet_time' value='" + String(config->audio_packet_time) + "' required>";
+    html += "<select id='audio_packet_time' name='audio_packet_time'>";
+    const int packet_times[] = { 10, 20, 30, 40, 60 };
+    for (int ms : packet_times) {
+        html += "<option value='" + String(ms) + "'" + String(config->audio_packet_time == ms ? " selected" : "") + ">" + String(ms) + " ms</option>";
+    }
+    html += "</select>";
     html += "</div>";
     html += "<div class='form-group'>";
     html += "<label for='rtp_base_port'>RTP Base Port:</label>";
@@ -844,6 +1330,46 @@ String WebInterface::getSettingsPage() {
     html += "<input type='checkbox' id='dtmf_enabled' name='dtmf_enabled' " + String(config->enable_dtmf_rfc2833 ? "checked" : "") + ">";
     html += "<label for='dtmf_enabled'>Enable DTMF RFC2833</label>";
     html += "</div>";
+    html += "<div class='form-group checkbox-group'>";
+    html += "<input type='checkbox' id='g729_annexb' name='g729_annexb' " + String(config->g729_annexb ? "checked" : "") + ">";
+    html += "<label for='g729_annexb'>G.729 Annex B (VAD/CNG)</label>";
+    html += "</div>";
+    html += "<div class='form-group checkbox-group'>";
+    html += "<input type='checkbox' id='call_recording' name='call_recording' " + String(config->call_recording ? "checked" : "") + ">";
+    html += "<label for='call_recording'>Record calls (LittleFS)</label>";
+    html += "</div>";
+    html += "<div class='form-group checkbox-group'>";
+    html += "<input type='checkbox' id='uart_link_v2' name='uart_link_v2' " + String(config->uart_link_v2 ? "checked" : "") + ">";
+    html += "<label for='uart_link_v2'>AudioKit link protocol v2 (CRC, batching, credits)</label>";
+    html += "</div>";
+    html += "<div class='form-group checkbox-group'>";
+    html += "<input type='checkbox' id='uart_link_adpcm' name='uart_link_adpcm' " + String(config->uart_link_adpcm ? "checked" : "") + ">";
+    html += "<label for='uart_link_adpcm'>Compress PCM on the AudioKit link (IMA ADPCM)</label>";
+    html += "</div>";
+    html += "<div class='form-group checkbox-group'>";
+    html += "<input type='checkbox' id='uart_link2' name='uart_link2' " + String(config->uart_link_count > 1 ? "checked" : "") + ">";
+    html += "<label for='uart_link2'>Second AudioKit on UART1 (after reboot)</label>";
+    html += "</div>";
+    html += "<div class='form-group'>";
+    html += "<label for='uart_link2_baud_rate'>UART1 Baud Rate:</label>";
+    html += "<input type='number' id='uart_link2_baud_rate' name='uart_link2_baud_rate' value='" + String(config->uart_link2_baud_rate) + "'>";
+    html += "</div>";
+    html += "<div class='form-group'>";
+    html += "<label for='uart_link2_tx_pin'>UART1 TX Pin:</label>";
+    html += "<input type='number' id='uart_link2_tx_pin' name='uart_link2_tx_pin' value='" + String(config->uart_link2_tx_pin) + "'>";
+    html += "</div>";
+    html += "<div class='form-group'>";
+    html += "<label for='uart_link2_rx_pin'>UART1 RX Pin:</label>";
+    html += "<input type='number' id='uart_link2_rx_pin' name='uart_link2_rx_pin' value='" + String(config->uart_link2_rx_pin) + "'>";
+    html += "</div>";
+    html += "<div class='form-group checkbox-group'>";
+    html += "<input type='checkbox' id='rtp_shared_socket' name='rtp_shared_socket' " + String(config->rtp_shared_socket ? "checked" : "") + ">";
+    html += "<label for='rtp_shared_socket'>Single RTP port for all calls (after reboot)</label>";
+    html += "</div>";
+    html += "<div class='form-group'>";
+    html += "<label for='red_loss_threshold'>RFC 2198 redundancy from loss (%, 0 = off):</label>";
+    html += "<input type='number' id='red_loss_threshold' name='red_loss_threshold' min='0' max='50' value='" + String(config->red_loss_threshold) + "'>";
+    html += "</div>";
     html += "</div>"; // Закрытие Audio Settings
     html += "</div>"; // Закрытие tab-content Audio
 
@@ -1262,7 +1788,27 @@ String WebInterface::getHistoryPage() {
     html += " });";
     html += "  }";
     html += " }";
-    html += "window.onload = loadHistory;";
+    html += "function loadRecordings() {";
+    html += "  fetch('/api/recordings').then(response => response.json()).then(data => {";
+    html += "    const tbody = document.getElementById('recordings_body');";
+    html += "    tbody.innerHTML = '';";
+    html += "    const active = data.active.map(r => r.file);";
+    html += "    data.files.forEach(f => {";
+    html += "      const row = document.createElement('tr');";
+    html += "      const busy = active.includes(f.name);";
+    html += "      const actions = busy ? 'Recording...' : `<a href='/recordings/wav?file=\${f.name}'>Download WAV</a> | <a href='#' onclick=\"deleteRecording('\${f.name}');return false;\">Delete</a>`;";
+    html += "      row.innerHTML = `<td>\${f.name}</td><td>\${(f.size/1024).toFixed(1)} KB</td><td>\${actions}</td>`;";
+    html += "      tbody.appendChild(row);";
+    html += "    });";
+    html += "    document.getElementById('recordings_free').textContent = (data.free/1024).toFixed(0) + ' KB free';";
+    html += "  });";
+    html += "}";
+    html += "function deleteRecording(name) {";
+    html += "  if (confirm('Delete recording ' + name + '?')) {";
+    html += "    fetch('/api/recordings/delete?file=' + encodeURIComponent(name), {method: 'POST'}).then(() => loadRecordings());";
+    html += "  }";
+    html += "}";
+    html += "window.onload = function() { loadHistory(); loadRecordings(); };";
     html += "</script>";
     html += "</head><body>";
     html += "<div class='container'>";
@@ -1325,6 +1871,20 @@ String WebInterface::getHistoryPage() {
     html += "</tbody>";
     html += "</table>";
     
+    html += "<h2>Recordings</h2>";
+    html += "<p id='recordings_free'></p>";
+    html += "<table class='history-table'>";
+    html += "<thead>";
+    html += "<tr>";
+    html += "<th>File</th>";
+    html += "<th>Size</th>";
+    html += "<th>Actions</th>";
+    html += "</tr>";
+    html += "</thead>";
+    html += "<tbody id='recordings_body'>";
+    html += "</tbody>";
+    html += "</table>";
+    
     html += "</div>";
     html += "</div>";
     html += "</body></html>";
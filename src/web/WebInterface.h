@@ -94,6 +94,18 @@ public:
     bool isCallAccepted(const char* call_id);
     void resetCallState(const char* call_id);
     void handleApiCalls();
+    void handleApiConference();
+    void handleApiRelay();
+    void handleApiRecording();
+    void handleApiRecordings();
+    void handleDownloadRecording();
+    void handleDeleteRecording();
+    void handleApiCapture();
+    void handleApiCaptureStatus();
+    void handleMetrics();
+    void handleApiLatency();
+    void handleLatencyTrace();
+    void handleApiTasks();
 };
 
 extern WebInterface webInterface;